@@ -0,0 +1,230 @@
+/*--------------------------------------------------------------------*/
+/* bloom.c                                                            */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include "bloom.h"
+
+/* Sizing limits for a filter */
+enum { MIN_COUNTERS = 8, MAX_HASHES = 16 };
+
+/* A counting Bloom filter */
+struct bloom {
+   /* the counters, each saturating at UCHAR_MAX */
+   unsigned char *pucCounters;
+   /* the number of counters, a power of two */
+   size_t ulCounters;
+   /* the number of counters each key maps to */
+   size_t ulHashes;
+   /* the number of membership queries made */
+   size_t ulQueries;
+   /* the number of queries answered with a definite miss */
+   size_t ulMisses;
+   /* the number of queries reported as false positives */
+   size_t ulFalsePositives;
+};
+
+/*
+  Computes two independent 32-bit FNV-1a hashes of pcKey into *pulH1
+  and *pulH2, from which all of a key's counter positions are derived
+  by double hashing. *pulH2 is made odd, and so coprime with the
+  number of counters, a power of two, so that a key's positions do
+  not repeat until it has visited every counter.
+*/
+static void Bloom_hash(const char *pcKey, unsigned long *pulH1,
+                       unsigned long *pulH2) {
+   const unsigned long FNV_PRIME = 16777619UL;
+   const unsigned long MASK = 0xffffffffUL;
+   unsigned long ulH1 = 2166136261UL;
+   unsigned long ulH2 = 0x811c9dc5UL ^ 0x5bd1e995UL;
+
+   assert(pcKey != NULL);
+   assert(pulH1 != NULL);
+   assert(pulH2 != NULL);
+
+   for(; *pcKey != '\0'; pcKey++) {
+      ulH1 = ((ulH1 ^ (unsigned char) *pcKey) * FNV_PRIME) & MASK;
+      ulH2 = ((ulH2 ^ (unsigned char) *pcKey) * FNV_PRIME) & MASK;
+      ulH2 ^= ulH2 >> 15;
+   }
+
+   *pulH1 = ulH1;
+   *pulH2 = ulH2 | 1;
+}
+
+/*
+  Returns the smallest power of two that is at least ulCount, or the
+  largest one a size_t holds if there is none.
+*/
+static size_t Bloom_roundUp(size_t ulCount) {
+   size_t ulPower = 1;
+
+   while(ulPower < ulCount && ulPower <= ((size_t) -1) / 2)
+      ulPower *= 2;
+   return ulPower;
+}
+
+Bloom_T Bloom_new(size_t ulExpected, double dFalsePositiveRate,
+                  size_t ulMaxBytes) {
+   /* bits per key per hash function at the optimal load, 1/ln(2) */
+   const double COUNTERS_PER_HASH = 1.4427;
+   Bloom_T oBNew;
+   double dRate = 0.5;
+   size_t ulHashes = 1;
+   size_t ulCounters;
+
+   assert(dFalsePositiveRate > 0.0 && dFalsePositiveRate < 1.0);
+
+   if(ulExpected == 0)
+      ulExpected = 1;
+
+   /* the optimal number of hashes is -log2 of the target rate */
+   while(dRate > dFalsePositiveRate && ulHashes < MAX_HASHES) {
+      dRate /= 2;
+      ulHashes++;
+   }
+   ulCounters = Bloom_roundUp((size_t) ((double) ulExpected
+                                        * (double) ulHashes
+                                        * COUNTERS_PER_HASH) + 1);
+
+   /* under a memory cap, use the largest power of two within it and
+      the hash count optimal for that size */
+   if(ulMaxBytes != 0 && ulCounters > ulMaxBytes) {
+      ulCounters = Bloom_roundUp(ulMaxBytes / 2 + 1);
+      if(ulCounters < MIN_COUNTERS)
+         ulCounters = MIN_COUNTERS;
+      ulHashes = (size_t) ((double) ulCounters / (double) ulExpected
+                           / COUNTERS_PER_HASH + 0.5);
+      if(ulHashes == 0)
+         ulHashes = 1;
+   }
+   if(ulCounters < MIN_COUNTERS)
+      ulCounters = MIN_COUNTERS;
+
+   oBNew = malloc(sizeof(struct bloom));
+   if(oBNew == NULL)
+      return NULL;
+
+   oBNew->pucCounters = calloc(ulCounters, sizeof(unsigned char));
+   if(oBNew->pucCounters == NULL) {
+      free(oBNew);
+      return NULL;
+   }
+   oBNew->ulCounters = ulCounters;
+   oBNew->ulHashes = ulHashes;
+   oBNew->ulQueries = 0;
+   oBNew->ulMisses = 0;
+   oBNew->ulFalsePositives = 0;
+
+   return oBNew;
+}
+
+void Bloom_free(Bloom_T oBFilter) {
+   if(oBFilter == NULL)
+      return;
+
+   free(oBFilter->pucCounters);
+   free(oBFilter);
+}
+
+void Bloom_add(Bloom_T oBFilter, const char *pcKey) {
+   unsigned long ulH1, ulH2;
+   size_t i;
+
+   assert(oBFilter != NULL);
+   assert(pcKey != NULL);
+
+   Bloom_hash(pcKey, &ulH1, &ulH2);
+   for(i = 0; i < oBFilter->ulHashes; i++) {
+      unsigned char *pucCounter = &oBFilter->pucCounters[
+         (ulH1 + i * ulH2) & (oBFilter->ulCounters - 1)];
+      unsigned char ucOld = __atomic_load_n(pucCounter, __ATOMIC_RELAXED);
+
+      /* other threads may update the counter meanwhile, so it is
+         incremented by compare-and-swap, short of saturating */
+      while(ucOld != UCHAR_MAX &&
+            !__atomic_compare_exchange_n(pucCounter, &ucOld,
+                                         (unsigned char) (ucOld + 1), 0,
+                                         __ATOMIC_RELAXED,
+                                         __ATOMIC_RELAXED))
+         ;
+   }
+}
+
+void Bloom_remove(Bloom_T oBFilter, const char *pcKey) {
+   unsigned long ulH1, ulH2;
+   size_t i;
+
+   assert(oBFilter != NULL);
+   assert(pcKey != NULL);
+
+   Bloom_hash(pcKey, &ulH1, &ulH2);
+   for(i = 0; i < oBFilter->ulHashes; i++) {
+      unsigned char *pucCounter = &oBFilter->pucCounters[
+         (ulH1 + i * ulH2) & (oBFilter->ulCounters - 1)];
+      unsigned char ucOld = __atomic_load_n(pucCounter, __ATOMIC_RELAXED);
+
+      /* a saturated counter has lost count of its keys, so it must
+         stay saturated to avoid false negatives */
+      do {
+         assert(ucOld != 0);
+         if(ucOld == UCHAR_MAX)
+            break;
+      } while(!__atomic_compare_exchange_n(pucCounter, &ucOld,
+                                           (unsigned char) (ucOld - 1), 0,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED));
+   }
+}
+
+boolean Bloom_mayContain(Bloom_T oBFilter, const char *pcKey) {
+   unsigned long ulH1, ulH2;
+   size_t i;
+
+   assert(oBFilter != NULL);
+   assert(pcKey != NULL);
+
+   /* concurrent readers may query one filter, so its statistics
+      are counted atomically */
+   (void) __atomic_fetch_add(&oBFilter->ulQueries, 1, __ATOMIC_RELAXED);
+   Bloom_hash(pcKey, &ulH1, &ulH2);
+   for(i = 0; i < oBFilter->ulHashes; i++) {
+      if(__atomic_load_n(&oBFilter->pucCounters[
+            (ulH1 + i * ulH2) & (oBFilter->ulCounters - 1)],
+                          __ATOMIC_RELAXED) == 0) {
+         (void) __atomic_fetch_add(&oBFilter->ulMisses, 1,
+                                   __ATOMIC_RELAXED);
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+void Bloom_reportFalsePositive(Bloom_T oBFilter) {
+   assert(oBFilter != NULL);
+
+   (void) __atomic_fetch_add(&oBFilter->ulFalsePositives, 1,
+                             __ATOMIC_RELAXED);
+}
+
+void Bloom_getStats(Bloom_T oBFilter, size_t *pulQueries,
+                    size_t *pulMisses, size_t *pulFalsePositives,
+                    size_t *pulBytes, size_t *pulHashes) {
+   assert(oBFilter != NULL);
+
+   if(pulQueries != NULL)
+      *pulQueries = __atomic_load_n(&oBFilter->ulQueries,
+                                    __ATOMIC_RELAXED);
+   if(pulMisses != NULL)
+      *pulMisses = __atomic_load_n(&oBFilter->ulMisses, __ATOMIC_RELAXED);
+   if(pulFalsePositives != NULL)
+      *pulFalsePositives = __atomic_load_n(&oBFilter->ulFalsePositives,
+                                           __ATOMIC_RELAXED);
+   if(pulBytes != NULL)
+      *pulBytes = oBFilter->ulCounters * sizeof(unsigned char);
+   if(pulHashes != NULL)
+      *pulHashes = oBFilter->ulHashes;
+}
@@ -0,0 +1,66 @@
+/*--------------------------------------------------------------------*/
+/* bloom.h                                                            */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef BLOOM_INCLUDED
+#define BLOOM_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Bloom_T is a counting Bloom filter over strings: a set that may
+  report a string it does not hold (a false positive), but never
+  fails to report a string it does hold. Each position in the filter
+  is a small counter rather than a bit, so strings can be removed.
+*/
+typedef struct bloom *Bloom_T;
+
+/*
+  Returns a new, empty filter sized to hold ulExpected strings with a
+  false positive rate of at most dFalsePositiveRate, or NULL if
+  insufficient memory is available. If ulMaxBytes is nonzero, the
+  filter uses at most ulMaxBytes bytes of counters, trading a higher
+  false positive rate for the smaller footprint.
+*/
+Bloom_T Bloom_new(size_t ulExpected, double dFalsePositiveRate,
+                  size_t ulMaxBytes);
+
+/* Frees oBFilter. */
+void Bloom_free(Bloom_T oBFilter);
+
+/* Adds pcKey to oBFilter. */
+void Bloom_add(Bloom_T oBFilter, const char *pcKey);
+
+/*
+  Removes pcKey from oBFilter. pcKey must have been added to oBFilter
+  (and not since removed).
+*/
+void Bloom_remove(Bloom_T oBFilter, const char *pcKey);
+
+/*
+  Returns FALSE if pcKey is definitely not in oBFilter, or TRUE if it
+  may be. Counts the query, and the definite miss if there is one.
+  Queries (and Bloom_reportFalsePositive) may run concurrently with
+  each other and with threads calling Bloom_add or Bloom_remove; a
+  query concurrent with adding pcKey may miss it.
+*/
+boolean Bloom_mayContain(Bloom_T oBFilter, const char *pcKey);
+
+/*
+  Counts a query for which Bloom_mayContain returned TRUE though the
+  key was not in the set.
+*/
+void Bloom_reportFalsePositive(Bloom_T oBFilter);
+
+/*
+  Stores oBFilter's statistics into the non-NULL parameters: the
+  number of queries, definite misses and reported false positives,
+  the number of bytes of counters and the number of hash functions.
+*/
+void Bloom_getStats(Bloom_T oBFilter, size_t *pulQueries,
+                    size_t *pulMisses, size_t *pulFalsePositives,
+                    size_t *pulBytes, size_t *pulHashes);
+
+#endif
@@ -0,0 +1,413 @@
+/*--------------------------------------------------------------------*/
+/* cas.c                                                              */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for pthread_mutex_t */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef FT_NO_LOCKING
+#include <pthread.h>
+#endif
+#include "cas.h"
+
+/*
+  The shape of the hash: HASH_WORDS 32-bit words of output, computed
+  from HASH_LANES independent 32-bit accumulators that each consume
+  one word of every HASH_STRIPE-byte stripe of the input. The lanes
+  share no state until the stripes run out, so a compiler can keep
+  them in one vector register and update them all at once.
+*/
+enum { HASH_WORDS = 4, HASH_LANES = 8, HASH_STRIPE = HASH_LANES * 4 };
+
+/* The initial number of buckets in a store's table, a power of 2 */
+enum { MIN_BUCKETS = 64 };
+
+/* The multipliers of the hash, odd 32-bit primes */
+#define PRIME1 2654435761UL
+#define PRIME2 2246822519UL
+#define PRIME3 3266489917UL
+#define PRIME4 668265263UL
+
+/* The mask keeping the low 32 bits of an unsigned long */
+#define MASK32 0xffffffffUL
+
+/* Rotates the 32-bit value ul left by iBits bits, 0 < iBits < 32 */
+#define ROTL32(ul, iBits) \
+   ((((ul) << (iBits)) | ((ul) >> (32 - (iBits)))) & MASK32)
+
+/* A blob, the header of the block that also holds its bytes */
+struct blob {
+   /* the store holding the blob */
+   Cas_T oCStore;
+   /* the next blob in the same bucket */
+   struct blob *psNext;
+   /* the hash of the blob's bytes */
+   unsigned long aulHash[HASH_WORDS];
+   /* the number of bytes the blob holds */
+   size_t ulLength;
+   /* the number of references to the blob */
+   size_t ulRefs;
+};
+
+/*
+  The header of a blob's block, padded so that the bytes after it are
+  aligned for any type.
+*/
+union blobHeader {
+   struct blob sBlob;
+   long double ldAlign;
+   void *pvAlign;
+};
+
+/* A content-addressed store */
+struct cas {
+   /* the buckets of the table of blobs, chained through psNext */
+   struct blob **ppsBuckets;
+   /* the number of buckets, a power of 2 */
+   size_t ulBuckets;
+   /* the number of blobs held */
+   size_t ulBlobs;
+   /* the number of references to them */
+   size_t ulRefs;
+   /* the number of bytes the blobs hold */
+   size_t ulStoredBytes;
+   /* the number of bytes the references refer to */
+   size_t ulLogicalBytes;
+   /* TRUE once the store has been closed */
+   boolean bClosed;
+#ifndef FT_NO_LOCKING
+   /* the lock serializing changes to the table and the counts */
+   pthread_mutex_t sLock;
+#endif
+};
+
+/* Acquires oCStore's lock. */
+static void Cas_lock(Cas_T oCStore) {
+   assert(oCStore != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_mutex_lock(&oCStore->sLock);
+#else
+   (void) oCStore;
+#endif
+}
+
+/* Releases oCStore's lock. */
+static void Cas_unlock(Cas_T oCStore) {
+   assert(oCStore != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_mutex_unlock(&oCStore->sLock);
+#else
+   (void) oCStore;
+#endif
+}
+
+/* Frees oCStore, which holds no blobs, and its table. */
+static void Cas_destroy(Cas_T oCStore) {
+   assert(oCStore != NULL);
+   assert(oCStore->ulBlobs == 0);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_mutex_destroy(&oCStore->sLock);
+#endif
+   free(oCStore->ppsBuckets);
+   free(oCStore);
+}
+
+/* Returns the 32-bit little-endian word in the 4 bytes at puc. */
+static unsigned long Cas_read32(const unsigned char *puc) {
+   assert(puc != NULL);
+
+   return (unsigned long) puc[0] | ((unsigned long) puc[1] << 8)
+      | ((unsigned long) puc[2] << 16) | ((unsigned long) puc[3] << 24);
+}
+
+/*
+  Computes the 128-bit hash of the ulLength bytes at puc into
+  aulHash. This is not a cryptographic hash: blobs with equal hashes
+  are compared byte for byte before they are shared.
+*/
+static void Cas_hash(const unsigned char *puc, size_t ulLength,
+                     unsigned long aulHash[HASH_WORDS]) {
+   unsigned long aulAcc[HASH_LANES];
+   unsigned long ulSum;
+   size_t ulDone = 0;
+   size_t i;
+
+   assert(puc != NULL || ulLength == 0);
+   assert(aulHash != NULL);
+
+   for(i = 0; i < HASH_LANES; i++)
+      aulAcc[i] = (PRIME1 * (i + 1) + PRIME2) & MASK32;
+
+   /* the bulk of the input, a stripe at a time across all lanes */
+   while(ulLength - ulDone >= HASH_STRIPE) {
+      for(i = 0; i < HASH_LANES; i++) {
+         aulAcc[i] = (aulAcc[i]
+                      + Cas_read32(puc + ulDone + 4 * i) * PRIME2)
+            & MASK32;
+         aulAcc[i] = (ROTL32(aulAcc[i], 13) * PRIME1) & MASK32;
+      }
+      ulDone += HASH_STRIPE;
+   }
+
+   /* fold the lanes into the words of the hash */
+   for(i = 0; i < HASH_WORDS; i++)
+      aulHash[i] = (ROTL32(aulAcc[i], 1 + 4 * i)
+                    + aulAcc[i + HASH_WORDS] * PRIME3
+                    + ((unsigned long) ulLength & MASK32)) & MASK32;
+
+   /* the remaining bytes, spread over the words */
+   for(i = 0; ulDone < ulLength; i++, ulDone++) {
+      aulHash[i % HASH_WORDS] = (aulHash[i % HASH_WORDS]
+                                 + puc[ulDone] * PRIME4) & MASK32;
+      aulHash[i % HASH_WORDS] =
+         (ROTL32(aulHash[i % HASH_WORDS], 11) * PRIME1) & MASK32;
+   }
+
+   /* make each word depend on every lane, then avalanche it */
+   ulSum = 0;
+   for(i = 0; i < HASH_WORDS; i++)
+      ulSum += aulHash[i];
+   for(i = 0; i < HASH_WORDS; i++) {
+      aulHash[i] = (aulHash[i] + ulSum) & MASK32;
+      aulHash[i] ^= aulHash[i] >> 15;
+      aulHash[i] = (aulHash[i] * PRIME2) & MASK32;
+      aulHash[i] ^= aulHash[i] >> 13;
+      aulHash[i] = (aulHash[i] * PRIME3) & MASK32;
+      aulHash[i] ^= aulHash[i] >> 16;
+   }
+}
+
+/* Returns the bytes of the blob psBlob. */
+static void *Cas_bytes(struct blob *psBlob) {
+   assert(psBlob != NULL);
+
+   return (union blobHeader *) (void *) psBlob + 1;
+}
+
+/*
+  Returns the blob of oCStore with hash aulHash holding the ulLength
+  bytes at pvContents, or NULL if it holds none. Must be called with
+  oCStore's lock held.
+*/
+static struct blob *Cas_findLocked(Cas_T oCStore,
+                                   const unsigned long *aulHash,
+                                   const void *pvContents,
+                                   size_t ulLength) {
+   struct blob *psBlob;
+
+   assert(oCStore != NULL);
+   assert(aulHash != NULL);
+
+   for(psBlob = oCStore->ppsBuckets[aulHash[0]
+                                    & (oCStore->ulBuckets - 1)];
+       psBlob != NULL; psBlob = psBlob->psNext)
+      if(psBlob->ulLength == ulLength
+         && memcmp(psBlob->aulHash, aulHash,
+                   sizeof(psBlob->aulHash)) == 0
+         && (ulLength == 0
+             || memcmp(Cas_bytes(psBlob), pvContents, ulLength) == 0))
+         return psBlob;
+   return NULL;
+}
+
+/*
+  Doubles the number of buckets of oCStore, if memory allows; a store
+  that cannot grow only has longer chains. Must be called with
+  oCStore's lock held.
+*/
+static void Cas_growLocked(Cas_T oCStore) {
+   struct blob **ppsBuckets;
+   struct blob *psBlob;
+   struct blob *psNext;
+   size_t ulBuckets;
+   size_t i;
+
+   assert(oCStore != NULL);
+
+   ulBuckets = oCStore->ulBuckets * 2;
+   ppsBuckets = calloc(ulBuckets, sizeof(struct blob *));
+   if(ppsBuckets == NULL)
+      return;
+
+   for(i = 0; i < oCStore->ulBuckets; i++)
+      for(psBlob = oCStore->ppsBuckets[i]; psBlob != NULL;
+          psBlob = psNext) {
+         psNext = psBlob->psNext;
+         psBlob->psNext =
+            ppsBuckets[psBlob->aulHash[0] & (ulBuckets - 1)];
+         ppsBuckets[psBlob->aulHash[0] & (ulBuckets - 1)] = psBlob;
+      }
+
+   free(oCStore->ppsBuckets);
+   oCStore->ppsBuckets = ppsBuckets;
+   oCStore->ulBuckets = ulBuckets;
+}
+
+Cas_T Cas_new(void) {
+   Cas_T oCNew;
+
+   oCNew = malloc(sizeof(struct cas));
+   if(oCNew == NULL)
+      return NULL;
+
+   oCNew->ppsBuckets = calloc(MIN_BUCKETS, sizeof(struct blob *));
+   if(oCNew->ppsBuckets == NULL) {
+      free(oCNew);
+      return NULL;
+   }
+#ifndef FT_NO_LOCKING
+   if(pthread_mutex_init(&oCNew->sLock, NULL) != 0) {
+      free(oCNew->ppsBuckets);
+      free(oCNew);
+      return NULL;
+   }
+#endif
+
+   oCNew->ulBuckets = MIN_BUCKETS;
+   oCNew->ulBlobs = 0;
+   oCNew->ulRefs = 0;
+   oCNew->ulStoredBytes = 0;
+   oCNew->ulLogicalBytes = 0;
+   oCNew->bClosed = FALSE;
+   return oCNew;
+}
+
+void Cas_close(Cas_T oCStore) {
+   boolean bEmpty;
+
+   if(oCStore == NULL)
+      return;
+
+   Cas_lock(oCStore);
+   assert(!oCStore->bClosed);
+   oCStore->bClosed = TRUE;
+   bEmpty = (boolean) (oCStore->ulBlobs == 0);
+   Cas_unlock(oCStore);
+
+   /* otherwise the release of the last blob frees the store */
+   if(bEmpty)
+      Cas_destroy(oCStore);
+}
+
+void *Cas_intern(Cas_T oCStore, const void *pvContents,
+                 size_t ulLength) {
+   unsigned long aulHash[HASH_WORDS];
+   union blobHeader *psHeader;
+   struct blob *psBlob;
+   size_t ulBucket;
+
+   assert(oCStore != NULL);
+   assert(pvContents != NULL || ulLength == 0);
+
+   /* hash, and copy a new blob, outside the lock */
+   Cas_hash(pvContents, ulLength, aulHash);
+
+   Cas_lock(oCStore);
+   assert(!oCStore->bClosed);
+   psBlob = Cas_findLocked(oCStore, aulHash, pvContents, ulLength);
+   if(psBlob != NULL) {
+      psBlob->ulRefs++;
+      oCStore->ulRefs++;
+      oCStore->ulLogicalBytes += ulLength;
+      Cas_unlock(oCStore);
+      return Cas_bytes(psBlob);
+   }
+   Cas_unlock(oCStore);
+
+   if(ulLength > (size_t) -1 - sizeof(union blobHeader))
+      return NULL;
+   psHeader = malloc(sizeof(union blobHeader) + ulLength);
+   if(psHeader == NULL)
+      return NULL;
+   if(ulLength != 0)
+      memcpy(psHeader + 1, pvContents, ulLength);
+   psHeader->sBlob.oCStore = oCStore;
+   memcpy(psHeader->sBlob.aulHash, aulHash, sizeof(aulHash));
+   psHeader->sBlob.ulLength = ulLength;
+   psHeader->sBlob.ulRefs = 1;
+
+   Cas_lock(oCStore);
+   /* another thread may have stored the same bytes meanwhile */
+   psBlob = Cas_findLocked(oCStore, aulHash, pvContents, ulLength);
+   if(psBlob != NULL) {
+      psBlob->ulRefs++;
+      oCStore->ulRefs++;
+      oCStore->ulLogicalBytes += ulLength;
+      Cas_unlock(oCStore);
+      free(psHeader);
+      return Cas_bytes(psBlob);
+   }
+
+   psBlob = &psHeader->sBlob;
+   ulBucket = aulHash[0] & (oCStore->ulBuckets - 1);
+   psBlob->psNext = oCStore->ppsBuckets[ulBucket];
+   oCStore->ppsBuckets[ulBucket] = psBlob;
+   oCStore->ulBlobs++;
+   oCStore->ulRefs++;
+   oCStore->ulStoredBytes += ulLength;
+   oCStore->ulLogicalBytes += ulLength;
+   if(oCStore->ulBlobs > oCStore->ulBuckets)
+      Cas_growLocked(oCStore);
+   Cas_unlock(oCStore);
+
+   return Cas_bytes(psBlob);
+}
+
+void Cas_release(void *pvBlob) {
+   struct blob *psBlob;
+   struct blob **ppsLink;
+   Cas_T oCStore;
+   boolean bDestroy = FALSE;
+
+   assert(pvBlob != NULL);
+
+   psBlob = &((union blobHeader *) pvBlob - 1)->sBlob;
+   oCStore = psBlob->oCStore;
+
+   Cas_lock(oCStore);
+   assert(psBlob->ulRefs > 0);
+   oCStore->ulRefs--;
+   oCStore->ulLogicalBytes -= psBlob->ulLength;
+   if(--psBlob->ulRefs != 0) {
+      Cas_unlock(oCStore);
+      return;
+   }
+
+   ppsLink = &oCStore->ppsBuckets[psBlob->aulHash[0]
+                                  & (oCStore->ulBuckets - 1)];
+   while(*ppsLink != psBlob)
+      ppsLink = &(*ppsLink)->psNext;
+   *ppsLink = psBlob->psNext;
+   oCStore->ulBlobs--;
+   oCStore->ulStoredBytes -= psBlob->ulLength;
+   if(oCStore->bClosed && oCStore->ulBlobs == 0)
+      bDestroy = TRUE;
+   Cas_unlock(oCStore);
+
+   free(psBlob);
+   if(bDestroy)
+      Cas_destroy(oCStore);
+}
+
+void Cas_getStats(Cas_T oCStore, size_t *pulBlobs, size_t *pulRefs,
+                  size_t *pulStoredBytes, size_t *pulLogicalBytes) {
+   assert(oCStore != NULL);
+
+   Cas_lock(oCStore);
+   if(pulBlobs != NULL)
+      *pulBlobs = oCStore->ulBlobs;
+   if(pulRefs != NULL)
+      *pulRefs = oCStore->ulRefs;
+   if(pulStoredBytes != NULL)
+      *pulStoredBytes = oCStore->ulStoredBytes;
+   if(pulLogicalBytes != NULL)
+      *pulLogicalBytes = oCStore->ulLogicalBytes;
+   Cas_unlock(oCStore);
+}
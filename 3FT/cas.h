@@ -0,0 +1,61 @@
+/*--------------------------------------------------------------------*/
+/* cas.h                                                              */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef CAS_INCLUDED
+#define CAS_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Cas_T is a content-addressed store of blobs: byte strings kept
+  once each, however many times they are stored, and found by a
+  128-bit hash of their bytes. Each blob is reference counted, and
+  freed when its last reference is released. A Cas_T may be shared
+  between threads.
+*/
+typedef struct cas *Cas_T;
+
+/*
+  Returns a new, empty store, or NULL if insufficient memory is
+  available.
+*/
+Cas_T Cas_new(void);
+
+/*
+  Closes oCStore to further interning, and frees it once the last of
+  its blobs is released, at once if it holds none. Does nothing if
+  oCStore is NULL.
+*/
+void Cas_close(Cas_T oCStore);
+
+/*
+  Returns a blob of oCStore holding the ulLength bytes at pvContents,
+  with a new reference to it that the caller must release, or NULL if
+  insufficient memory is available. Shares the blob that oCStore
+  holds if it already holds those bytes, and copies them into a new
+  one otherwise. oCStore must not be closed. The blob must not be
+  written.
+*/
+void *Cas_intern(Cas_T oCStore, const void *pvContents,
+                 size_t ulLength);
+
+/*
+  Releases a reference to the blob pvBlob, returned by Cas_intern,
+  freeing it if that was the last. Has the signature of a function
+  that frees contents, so that blobs can be given owners (see
+  Node_newOwner).
+*/
+void Cas_release(void *pvBlob);
+
+/*
+  Stores oCStore's statistics into the non-NULL parameters: the number
+  of blobs it holds, the number of references to them, and the number
+  of bytes the blobs hold, once each and once per reference.
+*/
+void Cas_getStats(Cas_T oCStore, size_t *pulBlobs, size_t *pulRefs,
+                  size_t *pulStoredBytes, size_t *pulLogicalBytes);
+
+#endif
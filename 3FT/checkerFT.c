@@ -75,6 +75,11 @@ boolean CheckerFT_Node_isValid(Node_T oNNode) {
 */
 static boolean CheckerFT_treeCheck(Node_T oNNode, size_t *node_count) {
    size_t ulIndex;
+   /* the totals of oNNode's subtree, summed over its children */
+   size_t ulFiles = 0, ulDirs = 1, ulBytes = 0;
+   size_t ulHasFiles, ulHasDirs, ulHasBytes;
+   /* the largest bound on file lengths among oNNode's children */
+   size_t ulMaxLength = 0;
 
    assert(node_count!=NULL);
 
@@ -99,6 +104,13 @@ static boolean CheckerFT_treeCheck(Node_T oNNode, size_t *node_count) {
          return FALSE;
       }
 
+      /* Checks that the child's parent is the node it is listed
+         under, which copying a node for a snapshot must preserve */
+      if(Node_getParent(oNChild) != oNNode) {
+         fprintf(stderr, "Child's parent is not the node it is under\n");
+         return FALSE;
+      }
+
       /* Checks that 1) nodes are in lexicographic order 
       and 2) there are no duplicate nodes. */
       if (ulIndex + 1 < Node_getNumChildren(oNNode)){
@@ -123,8 +135,34 @@ static boolean CheckerFT_treeCheck(Node_T oNNode, size_t *node_count) {
          farther down, passes the failure back up immediately */
       if(!CheckerFT_treeCheck(oNChild, node_count))
          return FALSE;
+
+      Node_getTotals(oNChild, &ulHasFiles, &ulHasDirs, &ulHasBytes);
+      ulFiles += ulHasFiles;
+      ulDirs += ulHasDirs;
+      ulBytes += ulHasBytes;
+      if(Node_getMaxLength(oNChild) > ulMaxLength)
+         ulMaxLength = Node_getMaxLength(oNChild);
    }
-   
+
+   /* Checks that a directory's cached totals are those of its
+      children, with itself counted as a directory */
+   if(!Node_isFile(oNNode)) {
+      Node_getTotals(oNNode, &ulHasFiles, &ulHasDirs, &ulHasBytes);
+      if(ulHasFiles != ulFiles || ulHasDirs != ulDirs ||
+         ulHasBytes != ulBytes) {
+         fprintf(stderr, "Directory totals do not match its subtree: "
+                 "(%s)\n", Path_getPathname(Node_getPath(oNNode)));
+         return FALSE;
+      }
+      /* the bound on file lengths may be loose, but must cover every
+         file below the directory */
+      if(Node_getMaxLength(oNNode) < ulMaxLength) {
+         fprintf(stderr, "Directory bound on file lengths is too low: "
+                 "(%s)\n", Path_getPathname(Node_getPath(oNNode)));
+         return FALSE;
+      }
+   }
+
    return TRUE;
 }
 
@@ -0,0 +1,366 @@
+/*--------------------------------------------------------------------*/
+/* ckpt.c                                                             */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for fileno and fsync */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ckpt.h"
+
+/*
+  The layout of a checkpoint file: an 8-byte header naming the format
+  and its version, the number of nodes, then the nodes in pre-order.
+  Each node is a 1-byte kind, the length of its name, its name
+  (without its terminating '\0'), then its number of children, for a
+  directory, or the length of its contents, for a file, followed by
+  the contents, for a file that has them. Numbers are variable-length:
+  7 bits per byte, least significant first, with the high bit set in
+  every byte but the last.
+*/
+enum { CKPT_HEADER_BYTES = 8, BUFFER_BYTES = 65536,
+       MIN_NODE_BYTES = 4 };
+
+/* The kinds of node in a checkpoint */
+enum { KIND_DIR, KIND_FILE, KIND_BARE_FILE };
+
+/* The header of a checkpoint file of the current version */
+static const char acCkptHeader[CKPT_HEADER_BYTES] = "FTCKPT\0\1";
+
+/* The suffix of the temporary file that a checkpoint is written to */
+static const char acTempSuffix[] = ".tmp";
+
+/* A checkpoint file */
+struct ckpt {
+   /* the file, buffered in BUFFER_BYTES */
+   FILE *psFile;
+   /* TRUE if the checkpoint is being written, FALSE if read */
+   boolean bWriting;
+   /* the name of the file that a checkpoint being written replaces,
+      and of the temporary file it is written to meanwhile */
+   char *pcFile;
+   char *pcTemp;
+   /* the number of bytes of a checkpoint being read not yet read */
+   size_t ulRemaining;
+   /* the name of the node last read, and its buffer's capacity */
+   char *pcName;
+   size_t ulNameCapacity;
+};
+
+/*
+  Writes ulValue to oCFile as a variable-length number. Returns
+  SUCCESS, or IO_ERROR if it could not be written.
+*/
+static int Ckpt_putNumber(Ckpt_T oCFile, size_t ulValue) {
+   assert(oCFile != NULL);
+
+   while(ulValue >= 0x80) {
+      if(putc((int) ((ulValue & 0x7F) | 0x80), oCFile->psFile) == EOF)
+         return IO_ERROR;
+      ulValue >>= 7;
+   }
+   if(putc((int) ulValue, oCFile->psFile) == EOF)
+      return IO_ERROR;
+   return SUCCESS;
+}
+
+/*
+  Reads a variable-length number from oCFile into *pulValue. Returns
+  SUCCESS, or IO_ERROR if it could not be read or does not fit.
+*/
+static int Ckpt_getNumber(Ckpt_T oCFile, size_t *pulValue) {
+   size_t ulValue = 0;
+   size_t ulShift = 0;
+   int iByte;
+
+   assert(oCFile != NULL);
+   assert(pulValue != NULL);
+
+   do {
+      if(oCFile->ulRemaining == 0)
+         return IO_ERROR;
+      iByte = getc(oCFile->psFile);
+      if(iByte == EOF)
+         return IO_ERROR;
+      oCFile->ulRemaining--;
+      if(ulShift >= sizeof(size_t) * 8 ||
+         (((size_t) (iByte & 0x7F) << ulShift) >> ulShift)
+            != (size_t) (iByte & 0x7F))
+         return IO_ERROR;
+      ulValue |= (size_t) (iByte & 0x7F) << ulShift;
+      ulShift += 7;
+   } while(iByte & 0x80);
+
+   *pulValue = ulValue;
+   return SUCCESS;
+}
+
+/*
+  Returns a new checkpoint, for writing if bWriting is TRUE, with no
+  file open, or NULL if insufficient memory is available. Copies
+  pcFile, and for writing, names a temporary file after it.
+*/
+static Ckpt_T Ckpt_new(const char *pcFile, boolean bWriting) {
+   Ckpt_T oCNew;
+
+   assert(pcFile != NULL);
+
+   oCNew = malloc(sizeof(struct ckpt));
+   if(oCNew == NULL)
+      return NULL;
+   oCNew->psFile = NULL;
+   oCNew->bWriting = bWriting;
+   oCNew->pcTemp = NULL;
+   oCNew->ulRemaining = 0;
+   oCNew->pcName = NULL;
+   oCNew->ulNameCapacity = 0;
+
+   oCNew->pcFile = malloc(strlen(pcFile) + 1);
+   if(oCNew->pcFile == NULL) {
+      free(oCNew);
+      return NULL;
+   }
+   strcpy(oCNew->pcFile, pcFile);
+
+   if(bWriting) {
+      oCNew->pcTemp = malloc(strlen(pcFile) + sizeof(acTempSuffix));
+      if(oCNew->pcTemp == NULL) {
+         free(oCNew->pcFile);
+         free(oCNew);
+         return NULL;
+      }
+      strcpy(oCNew->pcTemp, pcFile);
+      strcat(oCNew->pcTemp, acTempSuffix);
+   }
+   return oCNew;
+}
+
+/* Frees oCFile, whose file must be closed. */
+static void Ckpt_free(Ckpt_T oCFile) {
+   assert(oCFile != NULL);
+
+   free(oCFile->pcName);
+   free(oCFile->pcTemp);
+   free(oCFile->pcFile);
+   free(oCFile);
+}
+
+int Ckpt_create(const char *pcFile, size_t ulNodes, Ckpt_T *poCResult) {
+   Ckpt_T oCNew;
+
+   assert(pcFile != NULL);
+   assert(poCResult != NULL);
+
+   oCNew = Ckpt_new(pcFile, TRUE);
+   if(oCNew == NULL)
+      return MEMORY_ERROR;
+
+   oCNew->psFile = fopen(oCNew->pcTemp, "wb");
+   if(oCNew->psFile == NULL) {
+      Ckpt_free(oCNew);
+      return IO_ERROR;
+   }
+   (void) setvbuf(oCNew->psFile, NULL, _IOFBF, BUFFER_BYTES);
+
+   if(fwrite(acCkptHeader, 1, CKPT_HEADER_BYTES, oCNew->psFile)
+         != CKPT_HEADER_BYTES ||
+      Ckpt_putNumber(oCNew, ulNodes) != SUCCESS) {
+      (void) Ckpt_close(oCNew);
+      return IO_ERROR;
+   }
+
+   *poCResult = oCNew;
+   return SUCCESS;
+}
+
+/*
+  Appends to oCFile the kind iKind, name pcName and size ulSize of a
+  node. Returns SUCCESS, or IO_ERROR if they could not be written.
+*/
+static int Ckpt_putNode(Ckpt_T oCFile, int iKind, const char *pcName,
+                        size_t ulSize) {
+   size_t ulNameLength;
+
+   assert(oCFile != NULL);
+   assert(oCFile->bWriting);
+   assert(pcName != NULL);
+
+   ulNameLength = strlen(pcName);
+   if(putc(iKind, oCFile->psFile) == EOF ||
+      Ckpt_putNumber(oCFile, ulNameLength) != SUCCESS ||
+      fwrite(pcName, 1, ulNameLength, oCFile->psFile) != ulNameLength ||
+      Ckpt_putNumber(oCFile, ulSize) != SUCCESS)
+      return IO_ERROR;
+   return SUCCESS;
+}
+
+int Ckpt_putDir(Ckpt_T oCFile, const char *pcName, size_t ulChildren) {
+   return Ckpt_putNode(oCFile, KIND_DIR, pcName, ulChildren);
+}
+
+int Ckpt_putFile(Ckpt_T oCFile, const char *pcName,
+                 const void *pvContents, size_t ulLength) {
+   int iStatus;
+
+   assert(pvContents != NULL || ulLength == 0);
+
+   if(pvContents == NULL)
+      return Ckpt_putNode(oCFile, KIND_BARE_FILE, pcName, 0);
+
+   iStatus = Ckpt_putNode(oCFile, KIND_FILE, pcName, ulLength);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(fwrite(pvContents, 1, ulLength, oCFile->psFile) != ulLength)
+      return IO_ERROR;
+   return SUCCESS;
+}
+
+int Ckpt_commit(Ckpt_T oCFile) {
+   int iStatus = SUCCESS;
+
+   assert(oCFile != NULL);
+   assert(oCFile->bWriting);
+
+   if(fflush(oCFile->psFile) != 0 || ferror(oCFile->psFile) ||
+      fsync(fileno(oCFile->psFile)) != 0)
+      iStatus = IO_ERROR;
+   if(fclose(oCFile->psFile) != 0)
+      iStatus = IO_ERROR;
+   if(iStatus == SUCCESS && rename(oCFile->pcTemp, oCFile->pcFile) != 0)
+      iStatus = IO_ERROR;
+   if(iStatus != SUCCESS)
+      (void) remove(oCFile->pcTemp);
+
+   Ckpt_free(oCFile);
+   return iStatus;
+}
+
+int Ckpt_open(const char *pcFile, Ckpt_T *poCResult, size_t *pulNodes) {
+   Ckpt_T oCNew;
+   char acHeader[CKPT_HEADER_BYTES];
+   long lSize;
+
+   assert(pcFile != NULL);
+   assert(poCResult != NULL);
+   assert(pulNodes != NULL);
+
+   oCNew = Ckpt_new(pcFile, FALSE);
+   if(oCNew == NULL)
+      return MEMORY_ERROR;
+
+   oCNew->psFile = fopen(pcFile, "rb");
+   if(oCNew->psFile == NULL) {
+      Ckpt_free(oCNew);
+      return IO_ERROR;
+   }
+   (void) setvbuf(oCNew->psFile, NULL, _IOFBF, BUFFER_BYTES);
+
+   /* the size of the file bounds every length read from it */
+   if(fseek(oCNew->psFile, 0L, SEEK_END) != 0 ||
+      (lSize = ftell(oCNew->psFile)) < CKPT_HEADER_BYTES ||
+      fseek(oCNew->psFile, 0L, SEEK_SET) != 0 ||
+      fread(acHeader, 1, CKPT_HEADER_BYTES, oCNew->psFile)
+         != CKPT_HEADER_BYTES ||
+      memcmp(acHeader, acCkptHeader, CKPT_HEADER_BYTES) != 0) {
+      (void) Ckpt_close(oCNew);
+      return IO_ERROR;
+   }
+   oCNew->ulRemaining = (size_t) lSize - CKPT_HEADER_BYTES;
+
+   if(Ckpt_getNumber(oCNew, pulNodes) != SUCCESS ||
+      *pulNodes > oCNew->ulRemaining / MIN_NODE_BYTES) {
+      (void) Ckpt_close(oCNew);
+      return IO_ERROR;
+   }
+
+   *poCResult = oCNew;
+   return SUCCESS;
+}
+
+int Ckpt_getNode(Ckpt_T oCFile, boolean *pbIsFile, const char **ppcName,
+                 size_t *pulSize, boolean *pbHasContents) {
+   int iKind;
+   size_t ulNameLength;
+   size_t ulSize;
+
+   assert(oCFile != NULL);
+   assert(!oCFile->bWriting);
+   assert(pbIsFile != NULL);
+   assert(ppcName != NULL);
+   assert(pulSize != NULL);
+   assert(pbHasContents != NULL);
+
+   if(oCFile->ulRemaining == 0)
+      return IO_ERROR;
+   iKind = getc(oCFile->psFile);
+   if(iKind == EOF || iKind > KIND_BARE_FILE)
+      return IO_ERROR;
+   oCFile->ulRemaining--;
+
+   if(Ckpt_getNumber(oCFile, &ulNameLength) != SUCCESS ||
+      ulNameLength == 0 || ulNameLength > oCFile->ulRemaining)
+      return IO_ERROR;
+   if(ulNameLength >= oCFile->ulNameCapacity) {
+      char *pcNew = realloc(oCFile->pcName, ulNameLength + 1);
+      if(pcNew == NULL)
+         return MEMORY_ERROR;
+      oCFile->pcName = pcNew;
+      oCFile->ulNameCapacity = ulNameLength + 1;
+   }
+   if(fread(oCFile->pcName, 1, ulNameLength, oCFile->psFile)
+      != ulNameLength)
+      return IO_ERROR;
+   oCFile->ulRemaining -= ulNameLength;
+   oCFile->pcName[ulNameLength] = '\0';
+
+   /* a name is a single component of a path */
+   if(strlen(oCFile->pcName) != ulNameLength ||
+      strchr(oCFile->pcName, '/') != NULL)
+      return IO_ERROR;
+
+   if(Ckpt_getNumber(oCFile, &ulSize) != SUCCESS)
+      return IO_ERROR;
+   if((iKind == KIND_DIR &&
+       ulSize > oCFile->ulRemaining / MIN_NODE_BYTES) ||
+      (iKind == KIND_FILE && ulSize > oCFile->ulRemaining) ||
+      (iKind == KIND_BARE_FILE && ulSize != 0))
+      return IO_ERROR;
+
+   *pbIsFile = (boolean) (iKind != KIND_DIR);
+   *ppcName = oCFile->pcName;
+   *pulSize = ulSize;
+   *pbHasContents = (boolean) (iKind == KIND_FILE);
+   return SUCCESS;
+}
+
+int Ckpt_getContents(Ckpt_T oCFile, void *pvContents, size_t ulLength) {
+   assert(oCFile != NULL);
+   assert(!oCFile->bWriting);
+   assert(pvContents != NULL || ulLength == 0);
+   assert(ulLength <= oCFile->ulRemaining);
+
+   if(fread(pvContents, 1, ulLength, oCFile->psFile) != ulLength)
+      return IO_ERROR;
+   oCFile->ulRemaining -= ulLength;
+   return SUCCESS;
+}
+
+int Ckpt_close(Ckpt_T oCFile) {
+   int iStatus = SUCCESS;
+
+   assert(oCFile != NULL);
+
+   if(!oCFile->bWriting && oCFile->ulRemaining != 0)
+      iStatus = IO_ERROR;
+   (void) fclose(oCFile->psFile);
+   if(oCFile->bWriting)
+      (void) remove(oCFile->pcTemp);
+
+   Ckpt_free(oCFile);
+   return iStatus;
+}
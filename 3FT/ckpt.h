@@ -0,0 +1,98 @@
+/*--------------------------------------------------------------------*/
+/* ckpt.h                                                             */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef CKPT_INCLUDED
+#define CKPT_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Ckpt_T is a checkpoint of a File Tree in a file, being either
+  written or read as a single sequential stream. A checkpoint holds
+  the number of nodes in the tree, then the nodes in pre-order, each
+  as its kind, its name relative to its parent, and either its number
+  of children or its contents, so that a reader can rebuild the tree
+  in one pass, allocating each directory's children exactly once.
+  Checkpoints are versioned, so that a reader rejects the formats of
+  other versions rather than misreading them.
+*/
+typedef struct ckpt *Ckpt_T;
+
+/*
+  Begins writing a checkpoint of a tree of ulNodes nodes, which is to
+  replace the file named pcFile, and sets *poCResult to it. The
+  checkpoint is written to a temporary file beside pcFile, which
+  Ckpt_commit renames over pcFile, so that pcFile never holds part of
+  a checkpoint. Returns SUCCESS, or:
+  * IO_ERROR if the temporary file cannot be created
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Ckpt_create(const char *pcFile, size_t ulNodes, Ckpt_T *poCResult);
+
+/*
+  Appends to checkpoint oCFile a directory named pcName with ulChildren
+  children, which must follow it in pre-order. Returns SUCCESS, or
+  IO_ERROR if the checkpoint could not be written.
+*/
+int Ckpt_putDir(Ckpt_T oCFile, const char *pcName, size_t ulChildren);
+
+/*
+  Appends to checkpoint oCFile a file named pcName with contents
+  pvContents of ulLength bytes, or without contents if pvContents is
+  NULL. Returns SUCCESS, or IO_ERROR if the checkpoint could not be
+  written.
+*/
+int Ckpt_putFile(Ckpt_T oCFile, const char *pcName,
+                 const void *pvContents, size_t ulLength);
+
+/*
+  Syncs checkpoint oCFile, now holding every node it was begun for, to
+  disk, renames it over the file it replaces, and frees it. Returns
+  SUCCESS, or IO_ERROR if it could not be written, synced or renamed,
+  in which case it is discarded and the file it was to replace is
+  unchanged.
+*/
+int Ckpt_commit(Ckpt_T oCFile);
+
+/*
+  Opens the checkpoint in the file named pcFile for reading, sets
+  *poCResult to it and *pulNodes to the number of nodes it holds.
+  Returns SUCCESS, or:
+  * IO_ERROR if the file cannot be opened or read, or is not a
+    checkpoint of the current version
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Ckpt_open(const char *pcFile, Ckpt_T *poCResult, size_t *pulNodes);
+
+/*
+  Reads the next node of checkpoint oCFile, setting *pbIsFile to
+  whether it is a file, *ppcName to its name, valid until the next
+  call, and *pulSize to its number of children, if it is a directory,
+  or to the length of its contents, if it is a file. Sets
+  *pbHasContents to whether the file has contents, which must then be
+  read with Ckpt_getContents before the next node. Returns SUCCESS,
+  or:
+  * IO_ERROR if the node cannot be read or is malformed
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Ckpt_getNode(Ckpt_T oCFile, boolean *pbIsFile, const char **ppcName,
+                 size_t *pulSize, boolean *pbHasContents);
+
+/*
+  Reads the ulLength bytes of contents of the file last read from
+  checkpoint oCFile into pvContents. Returns SUCCESS, or IO_ERROR if
+  they cannot be read.
+*/
+int Ckpt_getContents(Ckpt_T oCFile, void *pvContents, size_t ulLength);
+
+/*
+  Closes and frees checkpoint oCFile. A checkpoint being written is
+  discarded. Returns SUCCESS, or IO_ERROR if oCFile is being read and
+  holds anything past the nodes read from it.
+*/
+int Ckpt_close(Ckpt_T oCFile);
+
+#endif
@@ -0,0 +1,274 @@
+/*--------------------------------------------------------------------*/
+/* epoch.c                                                            */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for posix_memalign and pthread_mutex_t */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "epoch.h"
+
+/*
+  The sizing of a domain: readers announce themselves in one of
+  2^EPOCH_SLOT_BITS slots, each padded to a cache line of its own so
+  that readers in different slots never contend. A retired object is
+  kept on the list of the epoch it was retired in, modulo LIMBO_LISTS.
+*/
+enum { EPOCH_SLOT_BITS = 6, EPOCH_SLOTS = 1 << EPOCH_SLOT_BITS,
+       CACHE_LINE = 64, LIMBO_LISTS = 3 };
+
+/* A slot in which one reader at a time announces itself */
+struct readerSlot {
+   /* 0 if no reader is in the slot, or else the epoch its reader
+      entered in, shifted left one bit, with the low bit set */
+   size_t ulState;
+   /* padding to the end of the cache line */
+   char acPad[CACHE_LINE - sizeof(size_t)];
+};
+
+/* An object awaiting reclamation */
+struct retired {
+   /* the object */
+   void *pvObject;
+   /* the function that frees it */
+   void (*pfFree)(void *pvObject);
+   /* the next object retired in the same epoch */
+   struct retired *psNext;
+};
+
+/*
+  An epoch-based reclamation domain. The global epoch advances only
+  once every reader inside the domain has entered in the current
+  epoch, so no reader can hold a pointer to an object retired two
+  epochs before the current one: such objects were unlinked before
+  any current reader entered.
+*/
+struct epoch {
+   /* the global epoch */
+   size_t ulEpoch;
+   /* padding, so that the epoch and the slots do not share a line */
+   char acPad[CACHE_LINE - sizeof(size_t)];
+   /* the reader slots */
+   struct readerSlot asSlots[EPOCH_SLOTS];
+   /* the objects retired in each of the last LIMBO_LISTS epochs */
+   struct retired *apsLimbo[LIMBO_LISTS];
+   /* the number of objects on all of the lists */
+   size_t ulPending;
+   /* the lock serializing writers' access to the lists and their
+      advances of the epoch */
+   pthread_mutex_t sLimboLock;
+};
+
+/*
+  Returns the slot at which a reader whose stack holds pvLocal starts
+  looking for a free slot. Threads' stacks lie far apart, so hashing
+  the address spreads concurrent readers over different slots.
+*/
+static size_t Epoch_startSlot(const void *pvLocal) {
+   const size_t MULTIPLIER = (size_t) 2654435761UL;
+   size_t ulHash = (size_t) pvLocal;
+
+   /* the high bits of the product depend on every bit of the address */
+   ulHash *= MULTIPLIER;
+   return ulHash >> (sizeof(size_t) * CHAR_BIT - EPOCH_SLOT_BITS);
+}
+
+/*
+  Returns TRUE if every reader in oEDomain entered in epoch ulEpoch,
+  or FALSE if some reader entered in an earlier one.
+*/
+static int Epoch_allObserved(Epoch_T oEDomain, size_t ulEpoch) {
+   size_t i;
+
+   assert(oEDomain != NULL);
+
+   for(i = 0; i < EPOCH_SLOTS; i++) {
+      size_t ulState = __atomic_load_n(&oEDomain->asSlots[i].ulState,
+                                       __ATOMIC_SEQ_CST);
+      if((ulState & 1) && (ulState >> 1) != ulEpoch)
+         return 0;
+   }
+   return 1;
+}
+
+/*
+  Frees every object on oEDomain's list for epochs congruent to
+  ulList modulo LIMBO_LISTS, leaving the list empty.
+*/
+static void Epoch_freeList(Epoch_T oEDomain, size_t ulList) {
+   struct retired *psCurr;
+
+   assert(oEDomain != NULL);
+   assert(ulList < LIMBO_LISTS);
+
+   psCurr = oEDomain->apsLimbo[ulList];
+   oEDomain->apsLimbo[ulList] = NULL;
+   while(psCurr != NULL) {
+      struct retired *psNext = psCurr->psNext;
+      (*psCurr->pfFree)(psCurr->pvObject);
+      free(psCurr);
+      oEDomain->ulPending--;
+      psCurr = psNext;
+   }
+}
+
+/*
+  Advances oEDomain's epoch unconditionally and waits until every
+  reader that entered in an earlier epoch has exited, after which no
+  reader holds a pointer to any object unlinked before the call.
+*/
+static void Epoch_synchronize(Epoch_T oEDomain) {
+   size_t ulEpoch;
+   size_t i;
+
+   assert(oEDomain != NULL);
+
+   ulEpoch = __atomic_load_n(&oEDomain->ulEpoch, __ATOMIC_RELAXED) + 1;
+   __atomic_store_n(&oEDomain->ulEpoch, ulEpoch, __ATOMIC_SEQ_CST);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   for(i = 0; i < EPOCH_SLOTS; i++) {
+      for(;;) {
+         size_t ulState = __atomic_load_n(&oEDomain->asSlots[i].ulState,
+                                          __ATOMIC_SEQ_CST);
+         if(!(ulState & 1) || (ulState >> 1) == ulEpoch)
+            break;
+      }
+   }
+}
+
+Epoch_T Epoch_new(void) {
+   void *pvNew;
+   Epoch_T oENew;
+   size_t i;
+
+   /* align the domain so that each slot fills exactly one line */
+   if(posix_memalign(&pvNew, CACHE_LINE, sizeof(struct epoch)) != 0)
+      return NULL;
+   oENew = pvNew;
+
+   oENew->ulEpoch = 0;
+   for(i = 0; i < EPOCH_SLOTS; i++)
+      oENew->asSlots[i].ulState = 0;
+   for(i = 0; i < LIMBO_LISTS; i++)
+      oENew->apsLimbo[i] = NULL;
+   oENew->ulPending = 0;
+   if(pthread_mutex_init(&oENew->sLimboLock, NULL) != 0) {
+      free(oENew);
+      return NULL;
+   }
+   return oENew;
+}
+
+void Epoch_free(Epoch_T oEDomain) {
+   size_t i;
+
+   if(oEDomain == NULL)
+      return;
+
+   for(i = 0; i < LIMBO_LISTS; i++)
+      Epoch_freeList(oEDomain, i);
+   assert(oEDomain->ulPending == 0);
+   (void) pthread_mutex_destroy(&oEDomain->sLimboLock);
+   free(oEDomain);
+}
+
+size_t Epoch_enter(Epoch_T oEDomain) {
+   size_t ulSlot;
+
+   if(oEDomain == NULL)
+      return 0;
+
+   ulSlot = Epoch_startSlot(&oEDomain);
+   for(;;) {
+      size_t ulFree = 0;
+      size_t ulEpoch = __atomic_load_n(&oEDomain->ulEpoch,
+                                       __ATOMIC_SEQ_CST);
+
+      if(__atomic_compare_exchange_n(&oEDomain->asSlots[ulSlot].ulState,
+                                     &ulFree, (ulEpoch << 1) | 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+         break;
+      ulSlot = (ulSlot + 1) % EPOCH_SLOTS;
+   }
+
+   /* order the announcement before every read of the structure, so
+      that a writer scanning the slots cannot miss this reader while
+      it reads an object the writer has just unlinked */
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   return ulSlot;
+}
+
+void Epoch_exit(Epoch_T oEDomain, size_t ulToken) {
+   if(oEDomain == NULL)
+      return;
+
+   assert(ulToken < EPOCH_SLOTS);
+   assert(oEDomain->asSlots[ulToken].ulState & 1);
+
+   __atomic_store_n(&oEDomain->asSlots[ulToken].ulState, 0,
+                    __ATOMIC_RELEASE);
+}
+
+void Epoch_retire(Epoch_T oEDomain, void *pvObject,
+                  void (*pfFree)(void *pvObject)) {
+   struct retired *psNew;
+   size_t ulList;
+
+   assert(pfFree != NULL);
+
+   if(oEDomain == NULL) {
+      (*pfFree)(pvObject);
+      return;
+   }
+
+   psNew = malloc(sizeof(struct retired));
+   (void) pthread_mutex_lock(&oEDomain->sLimboLock);
+   if(psNew == NULL) {
+      Epoch_synchronize(oEDomain);
+      (void) pthread_mutex_unlock(&oEDomain->sLimboLock);
+      (*pfFree)(pvObject);
+      return;
+   }
+
+   ulList = __atomic_load_n(&oEDomain->ulEpoch, __ATOMIC_RELAXED)
+            % LIMBO_LISTS;
+   psNew->pvObject = pvObject;
+   psNew->pfFree = pfFree;
+   psNew->psNext = oEDomain->apsLimbo[ulList];
+   oEDomain->apsLimbo[ulList] = psNew;
+   oEDomain->ulPending++;
+   (void) pthread_mutex_unlock(&oEDomain->sLimboLock);
+}
+
+void Epoch_reclaim(Epoch_T oEDomain) {
+   size_t ulEpoch;
+
+   if(oEDomain == NULL)
+      return;
+
+   /* a writer that finds another reclaiming leaves the work to it */
+   if(pthread_mutex_trylock(&oEDomain->sLimboLock) != 0)
+      return;
+   if(oEDomain->ulPending == 0) {
+      (void) pthread_mutex_unlock(&oEDomain->sLimboLock);
+      return;
+   }
+
+   /* order the writer's unlinking stores before the scan of the
+      slots, pairing with the fence in Epoch_enter */
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   ulEpoch = __atomic_load_n(&oEDomain->ulEpoch, __ATOMIC_RELAXED);
+   if(Epoch_allObserved(oEDomain, ulEpoch)) {
+      __atomic_store_n(&oEDomain->ulEpoch, ulEpoch + 1, __ATOMIC_SEQ_CST);
+      /* the objects retired in epoch ulEpoch - 1 were unlinked before
+         any reader now inside entered */
+      Epoch_freeList(oEDomain, (ulEpoch + 2) % LIMBO_LISTS);
+   }
+   (void) pthread_mutex_unlock(&oEDomain->sLimboLock);
+}
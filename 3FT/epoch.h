@@ -0,0 +1,71 @@
+/*--------------------------------------------------------------------*/
+/* epoch.h                                                            */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef EPOCH_INCLUDED
+#define EPOCH_INCLUDED
+
+#include <stddef.h>
+
+/*
+  An Epoch_T is an epoch-based reclamation domain. Readers that take
+  no locks bracket each access to a shared structure with Epoch_enter
+  and Epoch_exit. A writer that unlinks an object from the structure
+  retires it with Epoch_retire rather than freeing it, and the domain
+  frees it only once every reader that might still hold a pointer to
+  it has exited.
+
+  Readers may run concurrently with each other and with any number
+  of writers retiring and reclaiming objects. A reader must never
+  block on anything a writer holds, since a writer short of memory
+  waits in Epoch_retire for the readers inside the domain to exit.
+
+  Every function accepts a NULL domain, standing for a structure that
+  is never read concurrently: entering and exiting do nothing, and
+  retired objects are freed immediately.
+*/
+typedef struct epoch *Epoch_T;
+
+/*
+  Returns a new reclamation domain with no readers and no retired
+  objects, or NULL if insufficient memory is available.
+*/
+Epoch_T Epoch_new(void);
+
+/*
+  Frees oEDomain, first freeing every object still retired in it.
+  No reader may be inside oEDomain.
+*/
+void Epoch_free(Epoch_T oEDomain);
+
+/*
+  Enters a read-side critical section of oEDomain. Objects retired
+  after this call are not freed before the matching Epoch_exit.
+  Returns a token to pass to Epoch_exit. Critical sections must not
+  nest within one thread.
+*/
+size_t Epoch_enter(Epoch_T oEDomain);
+
+/* Leaves the critical section of oEDomain that returned ulToken. */
+void Epoch_exit(Epoch_T oEDomain, size_t ulToken);
+
+/*
+  Retires pvObject, which must already be unreachable by any reader
+  entering oEDomain from now on: (*pfFree)(pvObject) is called once
+  no reader that entered before now remains. If no memory is
+  available to defer it, waits for those readers to exit and frees
+  pvObject at once.
+*/
+void Epoch_retire(Epoch_T oEDomain, void *pvObject,
+                  void (*pfFree)(void *pvObject));
+
+/*
+  Advances oEDomain's epoch if every reader inside it has observed the
+  current one, freeing the objects that no reader can still reach.
+  Called by writers after each update, so that retired objects do not
+  accumulate; does nothing if another writer is reclaiming already.
+*/
+void Epoch_reclaim(Epoch_T oEDomain);
+
+#endif
@@ -3,95 +3,471 @@
 /* Authors: David Wang and Will Grimes                                */
 /*--------------------------------------------------------------------*/
 
+/* for pthread_rwlock_t */
+#define _POSIX_C_SOURCE 200112L
+
 #include <stddef.h>
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#ifndef FT_NO_LOCKING
+#include <pthread.h>
+#endif
 
 #include "dynarray.h"
 #include "path.h"
 #include "node.h"
 #include "checkerFT.h"
+#include "bloom.h"
+#include "epoch.h"
+#include "wal.h"
+#include "ckpt.h"
+#include "image.h"
+#include "cas.h"
+#include "rope.h"
+#include "lz.h"
+#include "spill.h"
+#include "map.h"
 #include "ft.h"
 
 
 /*
   A File Tree is a representation of a hierarchy of directories and
-  files, represented as an AO with 3 state variables:
+  files, represented as an instance of struct ft with 13 state
+  variables. The functions without an FT_T parameter operate on the
+  default instance, sDefault.
+*/
+struct ft {
+    /* 1. a flag for being in an initialized state (TRUE) or not
+          (FALSE) */
+    boolean bIsInitialized;
+    /* 2. a pointer to the root node in the hierarchy */
+    Node_T oNRoot;
+    /* 3. a counter of the number of nodes in the hierarchy */
+    size_t ulCount;
+    /* 4. an optional filter over the pathnames of all nodes in the
+          hierarchy, answering definite misses without a traversal,
+          or NULL if filtering is disabled */
+    Bloom_T oBFilter;
+    /* 5. the table mapping identifiers to the nodes in the hierarchy,
+          kept across FT_destroy so that identifiers issued before
+          it never validate afterwards */
+    Node_IDTable_T oITable;
+    /* 6. the domain through which everything unlinked from the
+          hierarchy is reclaimed once no reader can still reach it,
+          or NULL if the FT is built without locking */
+    Epoch_T oEReclaim;
+    /* 7. the state of transactions on the FT, made only once like
+          the table, or NULL before the default FT's first FT_init */
+    struct txn *psTxn;
+    /* 8. the write-ahead log recording every change to the
+          hierarchy, or NULL if none is open */
+    Wal_T oWLog;
+    /* 9. the read-only image that the FT is a view of, or NULL; an
+          FT with an image is uninitialized, so that every function
+          but those that only read fails on it */
+    Image_T oIImage;
+    /* 10. the function with which the FT frees the contents that it
+           takes over from FT_insertFileIn and the functions like it,
+           or NULL if it leaves them to the client */
+    void (*pfFreeContents)(void *pvContents);
+    /* 11. the content store through which the FT shares one copy of
+           the contents of its own that are the same in several
+           files, or NULL if deduplication is disabled */
+    Cas_T oCStore;
+    /* 12. the compressor with which FT_compressIn compresses the
+           contents that the FT owns, keeping statistics of its work,
+           or NULL before the first FT_compressIn */
+    Lz_T oLCompressor;
+    /* 13. the memory budget under which the FT spills the contents it
+           owns to disk, made only once like the state of
+           transactions, or NULL before the first FT_enableSpillIn */
+    struct budget *psBudget;
+#ifndef FT_NO_LOCKING
+    /* the lock that operations writing single paths hold shared,
+       each locking only the directories along its path, and that
+       operations on the whole hierarchy hold exclusively; operations
+       that only read take no lock */
+    pthread_rwlock_t sTreeLock;
+    /* the lock guarding the root, which stands in for the root's
+       parent when writers lock their way down from the root */
+    pthread_mutex_t sRootLock;
+#endif
+};
+
+/* The default FT instance */
+#ifndef FT_NO_LOCKING
+static struct ft sDefault = {FALSE, NULL, 0, NULL, NULL, NULL, NULL,
+                             NULL, NULL, NULL, NULL, NULL, NULL,
+                             PTHREAD_RWLOCK_INITIALIZER,
+                             PTHREAD_MUTEX_INITIALIZER};
+#else
+static struct ft sDefault;
+#endif
+
+/* An open handle on a directory in the FT */
+struct ftDir {
+    /* the FT that the directory is in */
+    FT_T oFTree;
+    /* the identifier of the directory's node */
+    size_t ulDirID;
+};
+
+/* The state of transactions on an FT */
+struct txn {
+    /* the undo log of the open transaction, an array of its changes
+       in the order made, or NULL if no transaction is open */
+    DynArray_T oDUndo;
+#ifndef FT_NO_LOCKING
+    /* the thread that opened the transaction */
+    pthread_t sOwner;
+#endif
+};
+
+/*
+  The memory budget of an FT. Its time is a count advanced each time
+  the budget is enforced, by which files read since are told from
+  those left unread longer.
+*/
+struct budget {
+    /* the spill file, or NULL before the first FT_enableSpillIn and
+       after FT_destroy */
+    Spill_T oSFile;
+    /* the number of bytes of contents that the FT may keep in memory,
+       while spilling is enabled */
+    size_t ulBudget;
+    /* the current time */
+    size_t ulClock;
+    /* the number of bytes of contents added to memory since the
+       budget was last enforced */
+    size_t ulAdded;
+    /* the number of bytes that may be added before the budget is
+       enforced again, or (size_t) -1 while spilling is disabled */
+    size_t ulSlack;
+};
+
+/* The kinds of change to the hierarchy that an undo log records */
+enum undoKind {UNDO_INSERT, UNDO_REMOVE, UNDO_REPLACE};
+
+/* A change made by an open transaction, with what undoing it needs */
+struct undoRecord {
+    /* the kind of change */
+    enum undoKind eKind;
+    /* the first node inserted, the root of the subtree removed, or
+       the file whose contents were replaced */
+    Node_T oNNode;
+    /* the file's old contents, for a replacement */
+    void *pvContents;
+    /* the owner of the file's old contents, or NULL */
+    Node_Owner_T oOOwner;
+    /* the file's old length, or the number of nodes removed */
+    size_t ulLength;
+    /* the spare memory for relinking the subtree removed */
+    void *pvSpare;
+};
+
+/* The token of a reader that entered no reclamation domain */
+#define FT_NO_READER ((size_t) -1)
+
+/* --------------------------------------------------------------------
+
+  The following functions synchronize the threads sharing an FT.
+  Readers take no lock at all: an operation that only reads runs in a
+  read-side critical section of the FT's reclamation domain, finding
+  every node and children array it reaches through atomic loads.
+  Operations that write publish each change with a single atomic
+  store, and retire rather than free whatever they unlink.
+
+  An operation that writes a single path holds the FT's tree lock
+  shared and locks its way down from the root: it locks each
+  directory along the path while still holding the lock of the
+  directory's parent (the root lock standing in for the root's
+  parent), then releases the parent's lock, and it changes only the
+  children of the directory it holds. Every writer thus acquires
+  locks top-down, so writers never deadlock, and writers in different
+  subtrees proceed in parallel. An operation on the whole hierarchy
+  holds the tree lock exclusively instead, and locks no directory. So
+  does a transaction, from FT_beginIn to its end, and the operations
+  that its thread calls meanwhile run under the lock it holds.
+  When built with FT_NO_LOCKING defined, the functions do nothing,
+  for clients that never share an FT between threads.
+*/
+
+/*
+  Enters a read-side critical section on oFTree, so that nothing the
+  reader reaches is freed before the matching FT_exitReader. Returns
+  the token to pass to FT_exitReader.
+*/
+static size_t FT_enterReader(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+#ifndef FT_NO_LOCKING
+    {
+        /* the default FT has no domain until its first FT_init, and
+           a reader before then has nothing to protect */
+        Epoch_T oEReclaim = __atomic_load_n(&oFTree->oEReclaim,
+                                            __ATOMIC_ACQUIRE);
+        if(oEReclaim != NULL)
+            return Epoch_enter(oEReclaim);
+    }
+#else
+    (void) oFTree;
+#endif
+    return FT_NO_READER;
+}
+
+/* Leaves the read-side critical section on oFTree that returned
+   ulToken. */
+static void FT_exitReader(FT_T oFTree, size_t ulToken) {
+    assert(oFTree != NULL);
+
+    if(ulToken != FT_NO_READER)
+        Epoch_exit(oFTree->oEReclaim, ulToken);
+}
+
+/*
+  Returns whether the calling thread has a transaction open on
+  oFTree, and so already holds oFTree's tree lock exclusively.
+*/
+static boolean FT_ownsTxn(FT_T oFTree) {
+    struct txn *psTxn;
+#ifndef FT_NO_LOCKING
+    pthread_t sOwner;
+#endif
+
+    assert(oFTree != NULL);
+
+    psTxn = __atomic_load_n(&oFTree->psTxn, __ATOMIC_ACQUIRE);
+    if(psTxn == NULL ||
+       __atomic_load_n(&psTxn->oDUndo, __ATOMIC_ACQUIRE) == NULL)
+        return FALSE;
+#ifndef FT_NO_LOCKING
+    /* once the log is seen, the owner stored before it is seen too */
+    __atomic_load(&psTxn->sOwner, &sOwner, __ATOMIC_RELAXED);
+    return (boolean) (pthread_equal(sOwner, pthread_self()) != 0);
+#else
+    return TRUE;
+#endif
+}
+
+/*
+  Acquires oFTree's tree lock shared, for an operation that writes a
+  single path alongside other such operations.
+*/
+static void FT_lockWriters(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+#ifndef FT_NO_LOCKING
+    if(!FT_ownsTxn(oFTree))
+        (void) pthread_rwlock_rdlock(&oFTree->sTreeLock);
+#else
+    (void) oFTree;
+#endif
+}
+
+/*
+  Acquires oFTree's tree lock exclusively, for an operation on the
+  whole hierarchy, once no other writer remains.
+*/
+static void FT_lockTree(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+#ifndef FT_NO_LOCKING
+    if(!FT_ownsTxn(oFTree))
+        (void) pthread_rwlock_wrlock(&oFTree->sTreeLock);
+#else
+    (void) oFTree;
+#endif
+}
+
+/*
+  Frees whatever oFTree's writers have retired that no reader can
+  still reach, and releases oFTree's tree lock, whether it was
+  acquired by FT_lockWriters or by FT_lockTree.
+*/
+static void FT_unlockWriters(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    Epoch_reclaim(oFTree->oEReclaim);
+#ifndef FT_NO_LOCKING
+    if(!FT_ownsTxn(oFTree))
+        (void) pthread_rwlock_unlock(&oFTree->sTreeLock);
+#endif
+}
+
+/*
+  Acquires the lock of directory oNDir in oFTree, or oFTree's root
+  lock if oNDir is NULL.
+*/
+static void FT_lockDir(FT_T oFTree, Node_T oNDir) {
+    assert(oFTree != NULL);
+
+#ifndef FT_NO_LOCKING
+    if(oNDir == NULL)
+        (void) pthread_mutex_lock(&oFTree->sRootLock);
+    else
+        Node_lock(oNDir);
+#else
+    (void) oFTree;
+    (void) oNDir;
+#endif
+}
+
+/* Releases the lock that FT_lockDir(oFTree, oNDir) acquired. */
+static void FT_unlockDir(FT_T oFTree, Node_T oNDir) {
+    assert(oFTree != NULL);
+
+#ifndef FT_NO_LOCKING
+    if(oNDir == NULL)
+        (void) pthread_mutex_unlock(&oFTree->sRootLock);
+    else
+        Node_unlock(oNDir);
+#else
+    (void) oFTree;
+    (void) oNDir;
+#endif
+}
+
+/*
+  Waits until no writer is inside the subtree rooted at directory
+  oNDir, whose parent's lock (or oFTree's root lock, for the root)
+  the caller holds: locks each directory of the subtree while holding
+  its parent's, top-down like any writer, then releases it. Writers
+  reach the subtree only through the lock the caller holds, so none
+  can enter it again before the caller releases that lock.
+*/
+static void FT_drainSubtree(FT_T oFTree, Node_T oNDir) {
+    size_t c;
+
+    assert(oFTree != NULL);
+    assert(oNDir != NULL);
+    assert(!Node_isFile(oNDir));
+
+    FT_lockDir(oFTree, oNDir);
+    for(c = 0; c < Node_getNumChildren(oNDir); c++) {
+        int iStatus;
+        Node_T oNChild = NULL;
+        iStatus = Node_getChild(oNDir, c, &oNChild);
+        assert(iStatus == SUCCESS);
+        (void) iStatus;
+        if(!Node_isFile(oNChild))
+            FT_drainSubtree(oFTree, oNChild);
+    }
+    FT_unlockDir(oFTree, oNDir);
+}
+
+#ifndef NDEBUG
+/*
+  Returns whether oFTree satisfies its invariants, checking only if
+  no writer is active (which is always so for a single thread): a
+  concurrent writer could change the hierarchy beneath the check.
+  For assertions outside any of oFTree's locks.
+*/
+static boolean FT_isValidIfIdle(FT_T oFTree) {
+    boolean bIsValid = TRUE;
+
+    assert(oFTree != NULL);
+
+#ifndef FT_NO_LOCKING
+    if(pthread_rwlock_trywrlock(&oFTree->sTreeLock) != 0)
+        return TRUE;
+#endif
+    bIsValid = CheckerFT_isValid(oFTree->bIsInitialized, oFTree->oNRoot,
+                                 oFTree->ulCount);
+#ifndef FT_NO_LOCKING
+    (void) pthread_rwlock_unlock(&oFTree->sTreeLock);
+#endif
+    return bIsValid;
+}
+#endif
+
+/* Returns oFTree's root, as published to readers. */
+static Node_T FT_loadRoot(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    return __atomic_load_n(&oFTree->oNRoot, __ATOMIC_ACQUIRE);
+}
+
+/* Publishes oNRoot as oFTree's root. */
+static void FT_storeRoot(FT_T oFTree, Node_T oNRoot) {
+    assert(oFTree != NULL);
+
+    __atomic_store_n(&oFTree->oNRoot, oNRoot, __ATOMIC_RELEASE);
+}
+
+/* Returns whether oFTree is initialized, as published to readers. */
+static boolean FT_isInitialized(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    return __atomic_load_n(&oFTree->bIsInitialized, __ATOMIC_ACQUIRE);
+}
+
+/* Returns oFTree's filter, as published to readers. */
+static Bloom_T FT_loadFilter(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    return __atomic_load_n(&oFTree->oBFilter, __ATOMIC_ACQUIRE);
+}
+
+/* Frees pvFilter, a Bloom_T that no reader can still reach. */
+static void FT_freeFilter(void *pvFilter) {
+    Bloom_free(pvFilter);
+}
+
+/*
+  Publishes oBFilter as oFTree's filter, retiring the filter it
+  replaces.
 */
+static void FT_storeFilter(FT_T oFTree, Bloom_T oBFilter) {
+    Bloom_T oBOld;
+
+    assert(oFTree != NULL);
 
-/* 1. a flag for being in an initialized state (TRUE) or not (FALSE) */
-static boolean bIsInitialized;
-/* 2. a pointer to the root node in the hierarchy */
-static Node_T oNRoot;
-/* 3. a counter of the number of nodes in the hierarchy */
-static size_t ulCount;
+    oBOld = oFTree->oBFilter;
+    __atomic_store_n(&oFTree->oBFilter, oBFilter, __ATOMIC_RELEASE);
+    if(oBOld != NULL)
+        Epoch_retire(oFTree->oEReclaim, oBOld, FT_freeFilter);
+}
 
 /*--------------------------------------------------------------------*/
 
 /*
-  Traverses the FT starting at the root as far as possible towards
-  absolute path oPPath. If able to traverse, returns an int SUCCESS
-  status and sets *poNFurthest to the furthest node reached (which may
-  be only a prefix of oPPath, or even NULL if the root is NULL).
+  Traverses the FT starting at oNStart, whose path must be a prefix of
+  absolute path oPPath, as far as possible towards oPPath. If able to
+  traverse, returns an int SUCCESS status and sets *poNFurthest to the
+  furthest node reached (which may be only a prefix of oPPath).
   Otherwise, sets *poNFurthest to NULL and returns with status:
-  * CONFLICTING_PATH if the root's path is not a prefix of oPPath
-    or if the further node reachable is a file
+  * NOT_A_DIRECTORY if the furthest node reachable is a file
+    that is not oPPath itself (in which case *poNFurthest is set)
   * MEMORY_ERROR if memory could not be allocated to complete request
 */
-static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
-    /* added check that node along path is not a file */
-    /* if furthest node is a file, return CONFLICTING_PATH */
+static int FT_traverseFrom(Node_T oNStart, Path_T oPPath,
+                           Node_T *poNFurthest) {
     int iStatus;
     Path_T oPPrefix = NULL;
     Node_T oNCurr;
     Node_T oNChild = NULL;
     size_t ulDepth;
     size_t i;
-    size_t ulChildID;
 
+    assert(oNStart != NULL);
     assert(oPPath != NULL);
     assert(poNFurthest != NULL);
 
-    /* root is NULL -> won't find anything */
-    if(oNRoot == NULL) {
-        *poNFurthest = NULL;
-        return SUCCESS;
-    }
-
-    iStatus = Path_prefix(oPPath, 1, &oPPrefix);
-    if(iStatus != SUCCESS) {
-        *poNFurthest = NULL;
-        return iStatus;
-    }
-
-    if(Path_comparePath(Node_getPath(oNRoot), oPPrefix)) {
-        Path_free(oPPrefix);
-        *poNFurthest = NULL;
-        return CONFLICTING_PATH;
-    }
-    Path_free(oPPrefix);
-    oPPrefix = NULL;
-
-    oNCurr = oNRoot;
+    oNCurr = oNStart;
     ulDepth = Path_getDepth(oPPath);
-    for(i = 2; i <= ulDepth; i++) {
+    for(i = Path_getDepth(Node_getPath(oNStart)) + 1; i <= ulDepth; i++) {
         iStatus = Path_prefix(oPPath, i, &oPPrefix);
         if(iStatus != SUCCESS) {
             *poNFurthest = NULL;
             return iStatus;
         }
         if(!Node_isFile(oNCurr) && 
-            Node_hasChild(oNCurr, oPPrefix, &ulChildID)) {
+            Node_findChild(oNCurr, oPPrefix, &oNChild)) {
             /* go to that child and continue with next prefix */
             Path_free(oPPrefix);
             oPPrefix = NULL;
-            iStatus = Node_getChild(oNCurr, ulChildID, &oNChild);
-            if(iStatus != SUCCESS) {
-                *poNFurthest = NULL;
-                return iStatus;
-            }
             oNCurr = oNChild;
         }
         else {
@@ -116,7 +492,50 @@ static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
 }
 
 /*
-  Traverses the FT to find a node with absolute path pcPath. Returns an
+  Traverses oFTree starting at the root as far as possible towards
+  absolute path oPPath. If able to traverse, returns an int SUCCESS
+  status and sets *poNFurthest to the furthest node reached (which may
+  be only a prefix of oPPath, or even NULL if the root is NULL).
+  Otherwise, sets *poNFurthest to NULL and returns with status:
+  * CONFLICTING_PATH if the root's path is not a prefix of oPPath
+  * NOT_A_DIRECTORY if the furthest node reachable is a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_traversePath(FT_T oFTree, Path_T oPPath,
+                           Node_T *poNFurthest) {
+    int iStatus;
+    Path_T oPPrefix = NULL;
+    Node_T oNRoot;
+
+    assert(oFTree != NULL);
+    assert(oPPath != NULL);
+    assert(poNFurthest != NULL);
+
+    /* root is NULL -> won't find anything */
+    oNRoot = FT_loadRoot(oFTree);
+    if(oNRoot == NULL) {
+        *poNFurthest = NULL;
+        return SUCCESS;
+    }
+
+    iStatus = Path_prefix(oPPath, 1, &oPPrefix);
+    if(iStatus != SUCCESS) {
+        *poNFurthest = NULL;
+        return iStatus;
+    }
+
+    if(Path_comparePath(Node_getPath(oNRoot), oPPrefix)) {
+        Path_free(oPPrefix);
+        *poNFurthest = NULL;
+        return CONFLICTING_PATH;
+    }
+    Path_free(oPPrefix);
+
+    return FT_traverseFrom(oNRoot, oPPath, poNFurthest);
+}
+
+/*
+  Traverses oFTree to find a node with absolute path pcPath. Returns an
   int NOT_A_DIRECTORY or NOT_A_FILE status depending on whether the file is a 
   file or a directory, and sets *poNResult to be the node, if found.
   Otherwise, sets *poNResult to NULL and returns with status:
@@ -127,17 +546,19 @@ static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
   * MEMORY_ERROR if memory could not be allocated to complete request
  */
 
-static int FT_findNode(const char *pcPath, Node_T *poNResult) {
+static int FT_findNode(FT_T oFTree, const char *pcPath,
+                       Node_T *poNResult) {
     /* returns NOT_A_DIRECTORY or NOT_A_FILE */
 
     Path_T oPPath = NULL;
     Node_T oNFound = NULL;
     int iStatus;
 
+    assert(oFTree != NULL);
     assert(pcPath != NULL);
     assert(poNResult != NULL);
 
-    if(!bIsInitialized) {
+    if(!FT_isInitialized(oFTree)) {
         *poNResult = NULL;
         return INITIALIZATION_ERROR;
     }
@@ -148,7 +569,7 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult) {
         return iStatus;
     }
 
-    iStatus = FT_traversePath(oPPath, &oNFound);
+    iStatus = FT_traversePath(oFTree, oPPath, &oNFound);
     if(iStatus != SUCCESS)
     {
         Path_free(oPPath);
@@ -174,187 +595,911 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult) {
     return IS_DIRECTORY;
 }
 
-/*--------------------------------------------------------------------*/
-
-int FT_insertDir(const char *pcPath)
-{
-    /* made bIsFile FALSE for the Node_new call 
-        when constructing path. */
+/*
+  Takes *poNNode, a node of oFTree, over from any snapshot sharing
+  it, by replacing it with a copy (publishing the copy as oFTree's
+  root if *poNNode is the root) and setting *poNNode to the copy.
+  Must be called with the lock of *poNNode's parent (or oFTree's root
+  lock, if *poNNode is the root) held and, if *poNNode is a
+  directory, its own lock, which is handed over to the copy. Since
+  snapshots are taken with no writer active, a writer that finds a
+  node shared is the first to reach it since, and none is inside it.
+  Returns SUCCESS, or MEMORY_ERROR if the copy could not be made, in
+  which case *poNNode is unchanged and still locked.
+*/
+static int FT_ownNode(FT_T oFTree, Node_T *poNNode) {
     int iStatus;
-    Path_T oPPath = NULL;
-    Node_T oNFirstNew = NULL;
-    Node_T oNCurr = NULL;
-    size_t ulDepth, ulIndex;
-    size_t ulNewNodes = 0;
+    Node_T oNCopy = NULL;
+    Node_T oNOld;
 
-    assert(pcPath != NULL);
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+    assert(oFTree != NULL);
+    assert(poNNode != NULL);
+    assert(*poNNode != NULL);
 
-    /* validate pcPath and generate a Path_T for it */
-    if(!bIsInitialized)
-        return INITIALIZATION_ERROR;
+    oNOld = *poNNode;
+    if(!Node_isShared(oNOld))
+        return SUCCESS;
 
-    iStatus = Path_new(pcPath, &oPPath);
-    if(iStatus != SUCCESS)
+    /* the copy drops the parent's reference to the old directory, and
+       a snapshot released meanwhile may drop the last other one, so
+       hold one until its lock is let go */
+    if(!Node_isFile(oNOld))
+        Node_retain(oNOld);
+    iStatus = Node_copy(oNOld, oFTree->oITable, &oNCopy);
+    if(iStatus != SUCCESS) {
+        if(!Node_isFile(oNOld))
+            Node_release(oNOld, oFTree->oITable);
         return iStatus;
+    }
+    if(Node_getParent(oNCopy) == NULL)
+        FT_storeRoot(oFTree, oNCopy);
+    if(!Node_isFile(oNCopy)) {
+        FT_lockDir(oFTree, oNCopy);
+        FT_unlockDir(oFTree, oNOld);
+        Node_release(oNOld, oFTree->oITable);
+    }
+    *poNNode = oNCopy;
+    return SUCCESS;
+}
 
-    /* find the closest ancestor of oPPath already in the tree */
-    iStatus= FT_traversePath(oPPath, &oNCurr);
-    if(iStatus != SUCCESS)
-    {
-        Path_free(oPPath);
+/*
+  Traverses oFTree from the root towards absolute path oPPath as
+  FT_traversePath does, but for a writer: locks its way down (see the
+  locking functions above) through the directories along oPPath
+  above its last component, taking each of them over from any
+  snapshot sharing it (see FT_ownNode), so that the caller may change
+  the directory it holds. If able to traverse, returns an int
+  SUCCESS status, sets *poNFurthest to the furthest node reached
+  (which may be only a prefix of oPPath, or even NULL if the root is
+  NULL), and sets *poNLocked to the directory whose lock is still
+  held: *poNFurthest itself if it is a directory above oPPath, or
+  else its parent, where NULL means oFTree's root lock. The caller
+  must release that lock with FT_unlockDir. Otherwise, holds no lock,
+  sets *poNFurthest and *poNLocked to NULL and returns with status:
+  * CONFLICTING_PATH if the root's path is not a prefix of oPPath
+  * NOT_A_DIRECTORY if the furthest node reachable is a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_lockPath(FT_T oFTree, Path_T oPPath, Node_T *poNFurthest,
+                       Node_T *poNLocked) {
+    int iStatus;
+    Path_T oPPrefix = NULL;
+    Node_T oNCurr;
+    Node_T oNLocked = NULL;
+    size_t ulDepth;
+    size_t i;
+
+    assert(oFTree != NULL);
+    assert(oPPath != NULL);
+    assert(poNFurthest != NULL);
+    assert(poNLocked != NULL);
+
+    *poNFurthest = NULL;
+    *poNLocked = NULL;
+
+    /* root is NULL -> won't find anything, and the root lock keeps it
+       NULL for the caller to insert a new one */
+    FT_lockDir(oFTree, NULL);
+    oNCurr = oFTree->oNRoot;
+    if(oNCurr == NULL)
+        return SUCCESS;
+
+    iStatus = Path_prefix(oPPath, 1, &oPPrefix);
+    if(iStatus != SUCCESS) {
+        FT_unlockDir(oFTree, NULL);
         return iStatus;
     }
-
-    /* no ancestor node found, so if root is not NULL,
-        pcPath isn't underneath root. */
-    if(oNCurr == NULL && oNRoot != NULL) {
-        Path_free(oPPath);
+    if(Path_comparePath(Node_getPath(oNCurr), oPPrefix)) {
+        Path_free(oPPrefix);
+        FT_unlockDir(oFTree, NULL);
         return CONFLICTING_PATH;
     }
+    Path_free(oPPrefix);
 
     ulDepth = Path_getDepth(oPPath);
-    if(oNCurr == NULL) /* new root! */
-        ulIndex = 1;
-    else {
-        ulIndex = Path_getDepth(Node_getPath(oNCurr))+1;
-
-        /* oNCurr is the node we're trying to insert */
-        if(ulIndex == ulDepth+1 && !Path_comparePath(oPPath,
-                                        Node_getPath(oNCurr))) {
-            Path_free(oPPath);
-            return ALREADY_IN_TREE;
-        }
-    }
-
-    /* starting at oNCurr, build rest of the path one level at a time */
-    while(ulIndex <= ulDepth) {
-        Path_T oPPrefix = NULL;
-        Node_T oNNewNode = NULL;
+    for(i = 2; i <= ulDepth && !Node_isFile(oNCurr); i++) {
+        Node_T oNChild = NULL;
+        boolean bFound;
 
-        /* generate a Path_T for this level */
-        iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
+        /* hand over from the parent's lock to oNCurr's, copying
+           oNCurr first if a snapshot shares it */
+        FT_lockDir(oFTree, oNCurr);
+        iStatus = FT_ownNode(oFTree, &oNCurr);
         if(iStatus != SUCCESS) {
-            Path_free(oPPath);
-            if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew);
-            assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+            FT_unlockDir(oFTree, oNCurr);
+            FT_unlockDir(oFTree, oNLocked);
             return iStatus;
         }
+        FT_unlockDir(oFTree, oNLocked);
+        oNLocked = oNCurr;
 
-        /* insert the new node for this level */
-        iStatus = Node_new(oPPrefix, oNCurr, &oNNewNode, FALSE, NULL, 0);
+        iStatus = Path_prefix(oPPath, i, &oPPrefix);
         if(iStatus != SUCCESS) {
-            Path_free(oPPath);
-            Path_free(oPPrefix);
-            if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew);
-            assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+            FT_unlockDir(oFTree, oNLocked);
             return iStatus;
         }
-
-        /* set up for next level */
+        bFound = Node_findChild(oNCurr, oPPrefix, &oNChild);
         Path_free(oPPrefix);
-        oNCurr = oNNewNode;
-        ulNewNodes++;
-        if(oNFirstNew == NULL)
-            oNFirstNew = oNCurr;
-        ulIndex++;
+        if(!bFound)
+            break;
+        oNCurr = oNChild;
     }
 
-    Path_free(oPPath);
-    /* update FT state variables to reflect insertion */
-    if(oNRoot == NULL)
-        oNRoot = oNFirstNew;
-    ulCount += ulNewNodes;
+    /* if the furthest node's path is not equal to oPPath and
+       it is a file, then oPPath is unreachable */
+    if(Path_comparePath(Node_getPath(oNCurr), oPPath) &&
+       Node_isFile(oNCurr)) {
+        FT_unlockDir(oFTree, oNLocked);
+        return NOT_A_DIRECTORY;
+    }
 
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+    *poNFurthest = oNCurr;
+    *poNLocked = oNLocked;
     return SUCCESS;
 }
 
-boolean FT_containsDir(const char *pcPath)
-{
-    /* changed return from SUCCESS to NOT_A_FILE. */
+/*
+  Finds the node with absolute path oPPath in oFTree as FT_findNode
+  does, but for a writer, locking its way down as FT_lockPath does.
+  If found, returns an int IS_FILE or IS_DIRECTORY status, sets
+  *poNResult to the node, and holds the lock of its parent (or
+  oFTree's root lock, if the node is the root), which the caller must
+  release with FT_unlockDir(oFTree, Node_getParent(*poNResult)).
+  Otherwise, holds no lock, sets *poNResult to NULL and returns with
+  status:
+  * CONFLICTING_PATH if the root's path is not a prefix of oPPath
+  * NOT_A_DIRECTORY if a proper prefix of oPPath exists as a file
+  * NO_SUCH_PATH if no node with oPPath exists in the hierarchy
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_findLocked(FT_T oFTree, Path_T oPPath, Node_T *poNResult) {
     int iStatus;
     Node_T oNFound = NULL;
+    Node_T oNLocked = NULL;
 
-    assert(pcPath != NULL);
+    assert(oFTree != NULL);
+    assert(oPPath != NULL);
+    assert(poNResult != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNFound);
-    return (boolean) (iStatus == IS_DIRECTORY);
+    *poNResult = NULL;
+    iStatus = FT_lockPath(oFTree, oPPath, &oNFound, &oNLocked);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(oNFound == NULL ||
+       Path_comparePath(Node_getPath(oNFound), oPPath) != 0) {
+        FT_unlockDir(oFTree, oNLocked);
+        return NO_SUCH_PATH;
+    }
+    assert(Node_getParent(oNFound) == oNLocked);
+
+    *poNResult = oNFound;
+    if(Node_isFile(oNFound))
+        return IS_FILE;
+    return IS_DIRECTORY;
 }
 
-int FT_rmDir(const char *pcPath)
-{
-    /* changed status check */
+/*
+  Behaves as FT_findNode, except that if oFTree's negative-lookup
+  filter is enabled and rules pcPath out, returns NO_SUCH_PATH immediately
+  without validating pcPath or traversing the FT.
+*/
+static int FT_findFiltered(FT_T oFTree, const char *pcPath,
+                           Node_T *poNResult) {
     int iStatus;
-    Node_T oNFound = NULL;
+    Bloom_T oBFilter;
 
+    assert(oFTree != NULL);
     assert(pcPath != NULL);
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+    assert(poNResult != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNFound);
+    oBFilter = FT_loadFilter(oFTree);
+    if(oBFilter == NULL)
+        return FT_findNode(oFTree, pcPath, poNResult);
 
-    if(iStatus != IS_DIRECTORY) {
-      if (iStatus == IS_FILE) return NOT_A_DIRECTORY;
-      return iStatus;
+    if(!Bloom_mayContain(oBFilter, pcPath)) {
+        *poNResult = NULL;
+        return NO_SUCH_PATH;
     }
-    
 
-    ulCount -= Node_free(oNFound);
-    if(ulCount == 0)
-        oNRoot = NULL;
+    iStatus = FT_findNode(oFTree, pcPath, poNResult);
+    if(iStatus != IS_FILE && iStatus != IS_DIRECTORY)
+        Bloom_reportFalsePositive(oBFilter);
+    return iStatus;
+}
 
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+/*
+  Looks up pcPath in oFTree's image as Image_find does, setting
+  *pulLength and *ppvContents to a file's length and contents only
+  where pulLength and ppvContents are not NULL.
+*/
+static int FT_findImage(FT_T oFTree, const char *pcPath,
+                        size_t *pulLength, void **ppvContents) {
+    size_t ulLength = 0;
+    void *pvContents = NULL;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(oFTree->oIImage != NULL);
+    assert(pcPath != NULL);
+
+    iStatus = Image_find(oFTree->oIImage, pcPath, &ulLength, &pvContents);
+    if(pulLength != NULL)
+        *pulLength = ulLength;
+    if(ppvContents != NULL)
+        *ppvContents = pvContents;
+    return iStatus;
+}
+
+/*
+  Adds the pathname of every node in the subtree rooted at oNNode to
+  negative-lookup filter oBFilter if bAdd is TRUE, or removes them
+  from it if bAdd is FALSE.
+*/
+static void FT_filterSubtree(Bloom_T oBFilter, Node_T oNNode,
+                             boolean bAdd) {
+    size_t c;
+
+    assert(oBFilter != NULL);
+    assert(oNNode != NULL);
+
+    if(bAdd)
+        Bloom_add(oBFilter, Path_getPathname(Node_getPath(oNNode)));
+    else
+        Bloom_remove(oBFilter, Path_getPathname(Node_getPath(oNNode)));
+
+    for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+        int iStatus;
+        Node_T oNChild = NULL;
+        iStatus = Node_getChild(oNNode, c, &oNChild);
+        assert(iStatus == SUCCESS);
+        (void) iStatus;
+        FT_filterSubtree(oBFilter, oNChild, bAdd);
+    }
+}
+
+/* Returns the number of nodes in the subtree rooted at oNNode. */
+static size_t FT_countSubtree(Node_T oNNode) {
+    size_t ulCount = 1;
+    size_t c;
+
+    assert(oNNode != NULL);
+
+    for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+        int iStatus;
+        Node_T oNChild = NULL;
+        iStatus = Node_getChild(oNNode, c, &oNChild);
+        assert(iStatus == SUCCESS);
+        (void) iStatus;
+        ulCount += FT_countSubtree(oNChild);
+    }
+    return ulCount;
+}
+
+/*
+  If a transaction is open on oFTree, appends to its undo log a new
+  record of a change of kind eKind to oNNode and sets *ppsRecord to
+  it, for the caller to complete once it makes the change; otherwise
+  sets *ppsRecord to NULL. A change is recorded before it is made, so
+  that one that cannot be recorded is not made. Must be called by the
+  transaction's thread. Returns SUCCESS, or MEMORY_ERROR if memory
+  could not be allocated for the record.
+*/
+static int FT_logChange(FT_T oFTree, enum undoKind eKind, Node_T oNNode,
+                        struct undoRecord **ppsRecord) {
+    struct undoRecord *psRecord;
+
+    assert(oFTree != NULL);
+    assert(ppsRecord != NULL);
+
+    *ppsRecord = NULL;
+    if(oFTree->psTxn == NULL || oFTree->psTxn->oDUndo == NULL)
+        return SUCCESS;
+
+    psRecord = malloc(sizeof(struct undoRecord));
+    if(psRecord == NULL)
+        return MEMORY_ERROR;
+    psRecord->eKind = eKind;
+    psRecord->oNNode = oNNode;
+    psRecord->pvContents = NULL;
+    psRecord->oOOwner = NULL;
+    psRecord->ulLength = 0;
+    psRecord->pvSpare = NULL;
+    if(!DynArray_add(oFTree->psTxn->oDUndo, psRecord)) {
+        free(psRecord);
+        return MEMORY_ERROR;
+    }
+
+    *ppsRecord = psRecord;
     return SUCCESS;
 }
 
-int FT_insertFile(const char *pcPath, void *pvContents,
-                  size_t ulLength)
-{
-    /* when creating nodes for path, made it so that final node in path
-        is a file with contents pvContents. */
+/*
+  Drops psRecord, the last record that FT_logChange made in oFTree's
+  undo log, for a change that was not made after all. Does nothing if
+  psRecord is NULL.
+*/
+static void FT_unlogChange(FT_T oFTree, struct undoRecord *psRecord) {
+    DynArray_T oDUndo;
+
+    assert(oFTree != NULL);
+
+    if(psRecord == NULL)
+        return;
+
+    oDUndo = oFTree->psTxn->oDUndo;
+    assert(DynArray_get(oDUndo, DynArray_getLength(oDUndo) - 1) ==
+           psRecord);
+    (void) DynArray_removeAt(oDUndo, DynArray_getLength(oDUndo) - 1);
+    free(psRecord);
+}
+
+/*
+  Appends a record of a change of kind iKind to pcPath, with contents
+  pvContents of ulLength bytes for kinds that set them, to oFTree's
+  write-ahead log, if one is open. A change is appended after it is
+  made, and before the lock that orders it with conflicting changes is
+  released, so that the log replays changes to the same path in the
+  order they were made. A failure to append sticks in the log, which
+  reports it from FT_syncLogIn and FT_closeLogIn.
+*/
+static void FT_appendLog(FT_T oFTree, int iKind, const char *pcPath,
+                         const void *pvContents, size_t ulLength) {
+    assert(oFTree != NULL);
+
+    if(oFTree->oWLog != NULL)
+        (void) Wal_append(oFTree->oWLog, iKind, pcPath, pvContents,
+                          ulLength);
+}
+
+/*
+  Returns the current time of oFTree's memory budget (see struct
+  budget), or 0 if it has none.
+*/
+static size_t FT_now(FT_T oFTree) {
+    struct budget *psBudget;
+
+    assert(oFTree != NULL);
+
+    psBudget = __atomic_load_n(&oFTree->psBudget, __ATOMIC_ACQUIRE);
+    if(psBudget == NULL)
+        return 0;
+    return __atomic_load_n(&psBudget->ulClock, __ATOMIC_RELAXED);
+}
+
+/*
+  Counts ulBytes of contents added to oFTree's memory, against its
+  memory budget if it has one.
+*/
+static void FT_chargeBudget(FT_T oFTree, size_t ulBytes) {
+    struct budget *psBudget;
+
+    assert(oFTree != NULL);
+
+    psBudget = __atomic_load_n(&oFTree->psBudget, __ATOMIC_ACQUIRE);
+    if(psBudget != NULL)
+        (void) __atomic_add_fetch(&psBudget->ulAdded, ulBytes,
+                                  __ATOMIC_RELAXED);
+}
+
+/*
+  Returns contents pvContents, whose owner frees them with pfFree, as
+  one block, the first call for chunked contents (see FT_writeAtIn)
+  flattening them, for compressed contents (see FT_compressIn)
+  decompressing them, and for spilled contents (see FT_enableSpillIn)
+  reading them back, into a block kept until they are dropped, and
+  for mapped contents (see FT_insertFileMappedIn) mapping them; or
+  NULL if memory could not be allocated for the block, the spill file
+  could not be read or the mapping could not be made.
+*/
+static void *FT_flattenContents(void *pvContents,
+                                void (*pfFree)(void *pvContents)) {
+    if(pfFree == Rope_free)
+        return Rope_flatten(pvContents);
+    if(pfFree == Lz_free)
+        return Lz_expand(pvContents);
+    if(pfFree == Spill_free)
+        return Spill_load(pvContents);
+    if(pfFree == Map_free)
+        return Map_load(pvContents);
+    return pvContents;
+}
+
+/*
+  Returns the contents of file oNNode as FT_flattenContents does. Must
+  be called inside a read-side critical section on oNNode's FT, or by
+  a writer.
+*/
+static void *FT_flatContents(Node_T oNNode) {
+    void (*pfFree)(void *pvContents);
+    void *pvContents;
+    size_t ulLength;
+
+    assert(oNNode != NULL);
+
+    pvContents = Node_readContents(oNNode, &ulLength, &pfFree);
+    return FT_flattenContents(pvContents, pfFree);
+}
+
+/*
+  Returns the contents of file oNNode in oFTree as FT_flatContents
+  does, for a client reading them, so that FT_compressIn counts them
+  as read and oFTree's memory budget counts them as recently used,
+  and charges the budget with the copy kept the first time spilled
+  contents are read back, compressed contents decompressed, or
+  chunked contents flattened.
+*/
+static void *FT_readContents(FT_T oFTree, Node_T oNNode) {
+    void (*pfFree)(void *pvContents);
+    void *pvContents;
+    size_t ulLength;
+
+    assert(oFTree != NULL);
+    assert(oNNode != NULL);
+
+    Node_markRead(oNNode, FT_now(oFTree));
+    pvContents = Node_readContents(oNNode, &ulLength, &pfFree);
+    if((pfFree == Spill_free && !Spill_isLoaded(pvContents))
+       || (pfFree == Lz_free && !Lz_isExpanded(pvContents))
+       || (pfFree == Rope_free && !Rope_isFlat(pvContents)))
+        FT_chargeBudget(oFTree, ulLength);
+    return FT_flatContents(oNNode);
+}
+
+/*
+  Contents given to an FT, as it is to store them: the client's, or
+  the FT's own, either as given or as a blob of its content store.
+*/
+struct adopted {
+    /* the contents to store in the file */
+    void *pvContents;
+    /* their owner, held by the operation until a file takes it over,
+       or NULL if the contents are the client's */
+    Node_Owner_T oOOwner;
+    /* TRUE if the contents are a blob of the content store */
+    boolean bInterned;
+    /* the contents given, if the FT stores a blob in their place and
+       frees them with pfFree once the blob is in the file, or NULL */
+    void *pvGiven;
+    /* the function that frees pvGiven */
+    void (*pfFree)(void *pvContents);
+};
+
+/*
+  Fills *psAdopted with the ulLength bytes at pvContents as oFTree is
+  to store them: as a copy of its own if bCopy is TRUE, as its own to
+  free with (*pfFree)(pvContents) if pfFree is not NULL, and as the
+  client's otherwise, or if pvContents is NULL. Contents of its own
+  are a blob of oFTree's content store, if it has one, shared with
+  every other file with the same bytes. Must be called with oFTree's
+  tree lock held shared. Returns SUCCESS, or MEMORY_ERROR if memory
+  could not be allocated for the copy, the blob or the owner.
+*/
+static int FT_adoptContents(FT_T oFTree, void *pvContents,
+                            size_t ulLength,
+                            void (*pfFree)(void *pvContents),
+                            boolean bCopy, struct adopted *psAdopted) {
+    assert(oFTree != NULL);
+    assert(psAdopted != NULL);
+
+    psAdopted->pvContents = pvContents;
+    psAdopted->oOOwner = NULL;
+    psAdopted->bInterned = FALSE;
+    psAdopted->pvGiven = NULL;
+    psAdopted->pfFree = NULL;
+    if(pvContents == NULL || (pfFree == NULL && !bCopy))
+        return SUCCESS;
+
+    if(oFTree->oCStore != NULL) {
+        psAdopted->pvContents = Cas_intern(oFTree->oCStore, pvContents,
+                                           ulLength);
+        if(psAdopted->pvContents == NULL)
+            return MEMORY_ERROR;
+        psAdopted->bInterned = TRUE;
+        psAdopted->oOOwner = Node_newOwner(psAdopted->pvContents,
+                                           Cas_release);
+        if(psAdopted->oOOwner == NULL) {
+            Cas_release(psAdopted->pvContents);
+            return MEMORY_ERROR;
+        }
+        if(!bCopy) {
+            psAdopted->pvGiven = pvContents;
+            psAdopted->pfFree = pfFree;
+        }
+    }
+    /* the copy is allocated with its owner, and freed with it */
+    else if(bCopy)
+        psAdopted->oOOwner = Node_newCopy(pvContents, ulLength,
+                                          &psAdopted->pvContents);
+    else
+        psAdopted->oOOwner = Node_newOwner(pvContents, pfFree);
+
+    if(psAdopted->oOOwner == NULL)
+        return MEMORY_ERROR;
+    FT_chargeBudget(oFTree, ulLength);
+    return SUCCESS;
+}
+
+/*
+  Completes the adoption of *psAdopted, once a file has taken over its
+  owner if bStored is TRUE, by freeing the contents given in place of
+  which a blob was stored; or undoes it otherwise, freeing what
+  FT_adoptContents allocated and leaving the contents given to the
+  client.
+*/
+static void FT_settleContents(struct adopted *psAdopted,
+                              boolean bStored) {
+    assert(psAdopted != NULL);
+
+    if(bStored) {
+        if(psAdopted->pvGiven != NULL)
+            (*psAdopted->pfFree)(psAdopted->pvGiven);
+        return;
+    }
+    Node_freeOwner(psAdopted->oOOwner);
+    if(psAdopted->bInterned)
+        Cas_release(psAdopted->pvContents);
+}
+
+/*
+  Gives oNFile, a file of oFTree taken over from any snapshot sharing
+  it, contents pvNewContents of ulNewLength bytes, taking over the
+  caller's hold on oOOwner, their owner or NULL. If psRecord is not
+  NULL, keeps the old contents, owner and all, in psRecord, the
+  record of the change in an open transaction, to put them back if it
+  aborts; otherwise releases their owner. Returns the old contents if
+  they were the client's, or NULL if oFTree owned them. Must be
+  called with the lock of oNFile's parent held.
+*/
+static void *FT_installContents(FT_T oFTree, Node_T oNFile,
+                                struct undoRecord *psRecord,
+                                void *pvNewContents, size_t ulNewLength,
+                                Node_Owner_T oOOwner) {
+    void *pvOldContents;
+    size_t ulOldLength;
+
+    assert(oFTree != NULL);
+    assert(oNFile != NULL);
+
+    ulOldLength = Node_getLength(oNFile);
+    pvOldContents = Node_editContents(oNFile, pvNewContents, ulNewLength,
+                                      &oOOwner);
+    if(psRecord != NULL) {
+        psRecord->pvContents = pvOldContents;
+        psRecord->ulLength = ulOldLength;
+        psRecord->oOOwner = oOOwner;
+    }
+    else
+        Node_releaseOwner(oOOwner, oFTree->oITable);
+    return oOOwner == NULL ? pvOldContents : NULL;
+}
+
+/*
+  Returns the number of bytes of memory that the contents of file
+  oNFile take, as counted against its FT's memory budget: none for
+  contents that are the client's, that are deduplicated and so shared
+  with other files, that are spilled and not read back, or that are
+  mapped and so in the page cache; and, for chunked contents, their
+  flattened copy too, if one is kept. Must be called by a writer.
+*/
+static size_t FT_footprint(Node_T oNFile) {
+    void (*pfFree)(void *pvContents);
+    void *pvContents;
+    size_t ulLength;
+
+    assert(oNFile != NULL);
+
+    pvContents = Node_readContents(oNFile, &ulLength, &pfFree);
+    if(pvContents == NULL || !Node_hasOwner(oNFile)
+       || pfFree == Cas_release || pfFree == Map_free)
+        return 0;
+    if(pfFree == Lz_free)
+        return Lz_getFootprint(pvContents);
+    if(pfFree == Spill_free)
+        return Spill_isLoaded(pvContents) ? ulLength : 0;
+    if(pfFree == Rope_free && Rope_isFlat(pvContents))
+        return 2 * ulLength;
+    return ulLength;
+}
+
+/*
+  Adds the footprint (see FT_footprint) of every file in the subtree
+  rooted at oNNode to *pulResident and, unless oDCold is NULL, adds
+  to oDCold every file with a footprint not read since before time
+  ulNow, but for those in subtrees that a snapshot shares, or in all
+  of the subtree if bShared is TRUE. Must be called with the tree
+  lock of oNNode's FT held exclusively.
+*/
+static void FT_collectCold(Node_T oNNode, boolean bShared, size_t ulNow,
+                           DynArray_T oDCold, size_t *pulResident) {
+    Node_T oNChild;
+    size_t ulBytes;
+    size_t c;
     int iStatus;
-    Path_T oPPath = NULL;
-    Node_T oNFirstNew = NULL;
-    Node_T oNCurr = NULL;
-    size_t ulDepth, ulIndex;
-    size_t ulNewNodes = 0;
 
-    assert(pcPath != NULL);
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+    assert(oNNode != NULL);
+    assert(pulResident != NULL);
 
-    /* validate pcPath and generate a Path_T for it */
-    if(!bIsInitialized)
-        return INITIALIZATION_ERROR;
+    if(Node_isShared(oNNode))
+        bShared = TRUE;
+    if(Node_isFile(oNNode)) {
+        ulBytes = FT_footprint(oNNode);
+        *pulResident += ulBytes;
+        /* a file that cannot be added is only kept in memory */
+        if(oDCold != NULL && !bShared && ulBytes != 0
+           && Node_getReadTime(oNNode) < ulNow)
+            (void) DynArray_add(oDCold, oNNode);
+        return;
+    }
+    for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+        oNChild = NULL;
+        iStatus = Node_getChild(oNNode, c, &oNChild);
+        assert(iStatus == SUCCESS);
+        (void) iStatus;
+        FT_collectCold(oNChild, bShared, ulNow, oDCold, pulResident);
+    }
+}
 
-    iStatus = Path_new(pcPath, &oPPath);
-    if(iStatus != SUCCESS) {
-        Path_free(oPPath);
-        return iStatus;
+/*
+  Compares files oNFirst and oNSecond by the time they were last
+  read, returning <0, 0, or >0 if oNFirst was read before, at the same
+  time as, or after oNSecond.
+*/
+static int FT_compareReadTimes(Node_T oNFirst, Node_T oNSecond) {
+    size_t ulFirst;
+    size_t ulSecond;
+
+    assert(oNFirst != NULL);
+    assert(oNSecond != NULL);
+
+    ulFirst = Node_getReadTime(oNFirst);
+    ulSecond = Node_getReadTime(oNSecond);
+    if(ulFirst < ulSecond)
+        return -1;
+    return ulFirst > ulSecond;
+}
+
+/*
+  Spills the contents of file oNFile in oFTree to oFTree's spill file,
+  or only drops their copy read back if they are spilled already.
+  Returns TRUE if the contents no longer take memory, and FALSE if
+  they were left as they were, because they could not be written or
+  memory could not be allocated. Must be called with oFTree's tree
+  lock held exclusively, on a file that no snapshot shares.
+*/
+static boolean FT_spillFile(FT_T oFTree, Node_T oNFile) {
+    void (*pfFree)(void *pvContents);
+    void *pvContents;
+    size_t ulLength;
+    Spill_Block_T oSNew;
+    Node_Owner_T oOOwner;
+
+    assert(oFTree != NULL);
+    assert(oNFile != NULL);
+
+    pvContents = Node_readContents(oNFile, &ulLength, &pfFree);
+    if(pfFree == Spill_free)
+        oSNew = Spill_share(pvContents);
+    else {
+        pvContents = FT_flatContents(oNFile);
+        if(pvContents == NULL)
+            return FALSE;
+        oSNew = Spill_write(oFTree->psBudget->oSFile, pvContents,
+                            ulLength);
     }
+    if(oSNew == NULL)
+        return FALSE;
 
-    /* find the closest ancestor of oPPath already in the tree */
-    iStatus= FT_traversePath(oPPath, &oNCurr);
-    if(iStatus != SUCCESS)
-    {
-        Path_free(oPPath);
-        return iStatus;
+    oOOwner = Node_newOwner(oSNew, Spill_free);
+    if(oOOwner == NULL) {
+        Spill_free(oSNew);
+        return FALSE;
     }
+    /* the contents read the same, so neither the log nor a
+       transaction has anything to record */
+    (void) FT_installContents(oFTree, oNFile, NULL, oSNew, ulLength,
+                              oOOwner);
+    return TRUE;
+}
 
-    /* validate that not adding file as root */
-    if(!oNRoot && Path_getDepth(oPPath)==1) {
-        Path_free(oPPath);
-        return CONFLICTING_PATH;
+/*
+  Enforces oFTree's memory budget: if the contents in memory take
+  more than three quarters of it, spills the files least recently
+  read until they take no more, sparing files read since the budget
+  was last enforced, then advances the budget's time. Files that
+  cannot be spilled, or memory that cannot be allocated to order
+  them, leave the contents over the budget until the next time. Must
+  be called with oFTree's tree lock held exclusively, and spilling
+  enabled.
+*/
+static void FT_spillColdest(FT_T oFTree) {
+    struct budget *psBudget;
+    DynArray_T oDCold;
+    size_t ulResident = 0;
+    size_t ulTarget;
+    size_t ulNow;
+    size_t ulBytes;
+    size_t i;
+    Node_T oNFile;
+
+    assert(oFTree != NULL);
+    assert(oFTree->psBudget != NULL);
+    assert(oFTree->psBudget->oSFile != NULL);
+
+    psBudget = oFTree->psBudget;
+    ulNow = __atomic_load_n(&psBudget->ulClock, __ATOMIC_RELAXED);
+    ulTarget = psBudget->ulBudget - psBudget->ulBudget / 4;
+
+    oDCold = DynArray_new(0);
+    if(oFTree->oNRoot != NULL)
+        FT_collectCold(oFTree->oNRoot, FALSE, ulNow, oDCold,
+                       &ulResident);
+    if(oDCold != NULL) {
+        if(ulResident > ulTarget)
+            DynArray_sort(oDCold,
+                (int (*)(const void *, const void *)) FT_compareReadTimes);
+        for(i = 0; i < DynArray_getLength(oDCold)
+                && ulResident > ulTarget; i++) {
+            oNFile = DynArray_get(oDCold, i);
+            ulBytes = FT_footprint(oNFile);
+            if(FT_spillFile(oFTree, oNFile))
+                ulResident -= ulBytes;
+        }
+        DynArray_free(oDCold);
     }
-    
 
-    /* no ancestor node found, so if root is not NULL,
-        pcPath isn't underneath root. */
-    if(oNCurr == NULL && oNRoot != NULL) {
-        Path_free(oPPath);
-        return CONFLICTING_PATH;
+    /* with the contents down to the target, enforcing again waits for
+       at least a quarter of the budget to be added */
+    __atomic_store_n(&psBudget->ulSlack, ulResident <= ulTarget
+                     ? psBudget->ulBudget - ulResident
+                     : psBudget->ulBudget / 4, __ATOMIC_RELAXED);
+    __atomic_store_n(&psBudget->ulAdded, 0, __ATOMIC_RELAXED);
+    (void) __atomic_add_fetch(&psBudget->ulClock, 1, __ATOMIC_RELAXED);
+}
+
+/*
+  Enforces oFTree's memory budget (see FT_spillColdest) if enough
+  contents were added to memory since it was last enforced, acquiring
+  oFTree's tree lock exclusively meanwhile, waiting for it if bWait is
+  TRUE and giving up if it is FALSE and the lock is taken, in which
+  case the next operation that finds it free enforces the budget
+  instead. Does nothing if the calling thread has a transaction open
+  on oFTree. Must be called with no lock of oFTree held.
+*/
+static void FT_keepBudget(FT_T oFTree, boolean bWait) {
+    struct budget *psBudget;
+
+    assert(oFTree != NULL);
+
+    psBudget = __atomic_load_n(&oFTree->psBudget, __ATOMIC_ACQUIRE);
+    if(psBudget == NULL
+       || __atomic_load_n(&psBudget->ulAdded, __ATOMIC_RELAXED)
+          <= __atomic_load_n(&psBudget->ulSlack, __ATOMIC_RELAXED)
+       || FT_ownsTxn(oFTree))
+        return;
+
+#ifndef FT_NO_LOCKING
+    if(!bWait) {
+        if(pthread_rwlock_trywrlock(&oFTree->sTreeLock) != 0)
+            return;
+    }
+    else
+        (void) pthread_rwlock_wrlock(&oFTree->sTreeLock);
+#else
+    (void) bWait;
+#endif
+    /* another thread may have enforced it meanwhile */
+    if(oFTree->bIsInitialized && psBudget->oSFile != NULL
+       && __atomic_load_n(&psBudget->ulAdded, __ATOMIC_RELAXED)
+          > __atomic_load_n(&psBudget->ulSlack, __ATOMIC_RELAXED))
+        FT_spillColdest(oFTree);
+    Epoch_reclaim(oFTree->oEReclaim);
+#ifndef FT_NO_LOCKING
+    (void) pthread_rwlock_unlock(&oFTree->sTreeLock);
+#endif
+}
+
+/*
+  Removes the subtree rooted at oNNode from oFTree, freeing all of its
+  nodes and updating oFTree's state variables to reflect the removal.
+  If a transaction is open on oFTree, unlinks the subtree and records
+  it in the undo log instead of freeing it. Must be called with the
+  lock of oNNode's parent (or oFTree's root lock, if oNNode is the
+  root) held and no writer inside the subtree, or with oFTree's tree
+  lock held exclusively. Returns SUCCESS, or MEMORY_ERROR if the
+  removal could not be recorded, in which case oFTree is unchanged.
+  The filter forgets the subtree just before it is unlinked, so a
+  filtered lookup concurrent with the removal may already miss a node
+  that an unfiltered one still finds.
+*/
+static int FT_removeSubtree(FT_T oFTree, Node_T oNNode) {
+    int iStatus;
+    struct undoRecord *psRecord = NULL;
+    size_t ulRemoved;
+
+    assert(oFTree != NULL);
+    assert(oNNode != NULL);
+
+    iStatus = FT_logChange(oFTree, UNDO_REMOVE, oNNode, &psRecord);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(oFTree->oBFilter != NULL)
+        FT_filterSubtree(oFTree->oBFilter, oNNode, FALSE);
+
+    /* a root is unpublished before it is retired */
+    if(Node_getParent(oNNode) == NULL)
+        FT_storeRoot(oFTree, NULL);
+
+    if(psRecord == NULL)
+        ulRemoved = Node_free(oNNode, oFTree->oITable);
+    else {
+        /* the transaction keeps the subtree, identifiers and all, to
+           relink it if the transaction aborts */
+        iStatus = Node_unlink(oNNode, oFTree->oITable,
+                              &psRecord->pvSpare);
+        if(iStatus != SUCCESS) {
+            if(Node_getParent(oNNode) == NULL)
+                FT_storeRoot(oFTree, oNNode);
+            if(oFTree->oBFilter != NULL)
+                FT_filterSubtree(oFTree->oBFilter, oNNode, TRUE);
+            FT_unlogChange(oFTree, psRecord);
+            return iStatus;
+        }
+        ulRemoved = FT_countSubtree(oNNode);
+        psRecord->ulLength = ulRemoved;
     }
+    (void) __atomic_sub_fetch(&oFTree->ulCount, ulRemoved,
+                              __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
+/*
+  Removes the elements of oDNodes past the first ulLength, if oDNodes
+  is not NULL.
+*/
+static void FT_truncateNodes(DynArray_T oDNodes, size_t ulLength) {
+    if(oDNodes == NULL)
+        return;
+    while(DynArray_getLength(oDNodes) > ulLength)
+        (void) DynArray_removeAt(oDNodes, DynArray_getLength(oDNodes) - 1);
+}
+
+/*
+  Builds the nodes of absolute path oPPath that are missing below
+  oNCurr, the closest ancestor of oPPath already in oFTree (or NULL if
+  oFTree is empty). All new nodes are directories, except that the
+  final node is a file with contents pvContents of size ulLength bytes
+  if bIsFile is TRUE, which the file takes over the caller's hold on
+  oOOwner for, if oOOwner is not NULL, once the nodes are inserted:
+  the file is built last, with its owner from the start, so that no
+  reader sees contents that are not bytes without the owner that
+  tells what they are. If oDNewNodes is not NULL, appends the new
+  nodes to it in order of depth. Updates oFTree's state variables to reflect
+  the insertion, records it in the undo log of the transaction open
+  on oFTree, if any, and appends it to oFTree's write-ahead log, if
+  any. Must be called with the lock of oNCurr (or
+  oFTree's root lock, if oNCurr is NULL) held, which keeps every new
+  node out of other writers' reach until it is released, or with
+  oFTree's tree lock held exclusively. Returns SUCCESS if the nodes are inserted
+  successfully. Otherwise, leaves oFTree and oDNewNodes unchanged
+  and returns:
+  * ALREADY_IN_TREE if oNCurr is oPPath itself
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_buildPath(FT_T oFTree, Path_T oPPath, Node_T oNCurr,
+                        boolean bIsFile, void *pvContents,
+                        size_t ulLength, Node_Owner_T oOOwner,
+                        DynArray_T oDNewNodes) {
+    int iStatus;
+    struct undoRecord *psRecord = NULL;
+    Node_T oNFirstNew = NULL;
+    size_t ulDepth, ulIndex, ulOldLength;
+    size_t ulNewNodes = 0;
+    size_t i;
+
+    assert(oFTree != NULL);
+    assert(oPPath != NULL);
 
     ulDepth = Path_getDepth(oPPath);
     if(oNCurr == NULL) /* new root! */
@@ -364,9 +1509,22 @@ int FT_insertFile(const char *pcPath, void *pvContents,
 
         /* oNCurr is the node we're trying to insert */
         if(ulIndex == ulDepth+1 && !Path_comparePath(oPPath,
-                                        Node_getPath(oNCurr))) {
-            Path_free(oPPath);
+                                        Node_getPath(oNCurr)))
             return ALREADY_IN_TREE;
+    }
+
+    iStatus = FT_logChange(oFTree, UNDO_INSERT, NULL, &psRecord);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    /* the new nodes get their places in oDNewNodes first, so that
+       nothing can fail once the file is built */
+    ulOldLength = oDNewNodes != NULL ? DynArray_getLength(oDNewNodes) : 0;
+    for(i = ulIndex; oDNewNodes != NULL && i <= ulDepth; i++) {
+        if(!DynArray_add(oDNewNodes, NULL)) {
+            FT_truncateNodes(oDNewNodes, ulOldLength);
+            FT_unlogChange(oFTree, psRecord);
+            return MEMORY_ERROR;
         }
     }
 
@@ -378,34 +1536,50 @@ int FT_insertFile(const char *pcPath, void *pvContents,
         /* generate a Path_T for this level */
         iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
         if(iStatus != SUCCESS) {
-            Path_free(oPPath);
-            if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew);
-            assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+            if(oNFirstNew != NULL) {
+                if(oFTree->oBFilter != NULL)
+                    FT_filterSubtree(oFTree->oBFilter, oNFirstNew, FALSE);
+                (void) Node_free(oNFirstNew, oFTree->oITable);
+            }
+            FT_truncateNodes(oDNewNodes, ulOldLength);
+            FT_unlogChange(oFTree, psRecord);
             return iStatus;
         }
 
+        /* the filter learns of the new node before Node_new publishes
+           it, so that no filtered reader misses a node it can reach */
+        if(oFTree->oBFilter != NULL)
+            Bloom_add(oFTree->oBFilter, Path_getPathname(oPPrefix));
+
         /* insert the new node for this level.
-        if the index == the final depth, make the new node a file. */
-        if (ulIndex == ulDepth) {
-        iStatus = Node_new(oPPrefix, oNCurr, &oNNewNode, 
-            TRUE, pvContents, ulLength);
-        }
-        else {
-        iStatus = Node_new(oPPrefix, oNCurr, &oNNewNode, FALSE, NULL, 0);
-        }
-        
+        if the index == the final depth and we are inserting a file,
+        make the new node a file. */
+        if (bIsFile && ulIndex == ulDepth)
+            iStatus = Node_new(oPPrefix, oNCurr, oFTree->oITable,
+                &oNNewNode, TRUE, pvContents, ulLength, oOOwner);
+        else
+            iStatus = Node_new(oPPrefix, oNCurr, oFTree->oITable,
+                &oNNewNode, FALSE, NULL, 0, NULL);
+
         if(iStatus != SUCCESS) {
-            Path_free(oPPath);
+            if(oFTree->oBFilter != NULL)
+                Bloom_remove(oFTree->oBFilter, Path_getPathname(oPPrefix));
             Path_free(oPPrefix);
-            if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew);
-            assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+            if(oNFirstNew != NULL) {
+                if(oFTree->oBFilter != NULL)
+                    FT_filterSubtree(oFTree->oBFilter, oNFirstNew, FALSE);
+                (void) Node_free(oNFirstNew, oFTree->oITable);
+            }
+            FT_truncateNodes(oDNewNodes, ulOldLength);
+            FT_unlogChange(oFTree, psRecord);
             return iStatus;
         }
+        Path_free(oPPrefix);
 
         /* set up for next level */
-        Path_free(oPPrefix);
+        if(oDNewNodes != NULL)
+            (void) DynArray_set(oDNewNodes, ulOldLength + ulNewNodes,
+                                oNNewNode);
         oNCurr = oNNewNode;
         ulNewNodes++;
         if(oNFirstNew == NULL)
@@ -413,239 +1587,4435 @@ int FT_insertFile(const char *pcPath, void *pvContents,
         ulIndex++;
     }
 
-    Path_free(oPPath);
-    /* update FT state variables to reflect insertion */
-    if(oNRoot == NULL)
-        oNRoot = oNFirstNew;
-    ulCount += ulNewNodes;
+    /* update FT state variables to reflect insertion. a new root is
+       published only now, once its whole path is built */
+    if(oNFirstNew != NULL && Node_getParent(oNFirstNew) == NULL)
+        FT_storeRoot(oFTree, oNFirstNew);
+    if(psRecord != NULL)
+        psRecord->oNNode = oNFirstNew;
+    (void) __atomic_add_fetch(&oFTree->ulCount, ulNewNodes,
+                              __ATOMIC_RELAXED);
+    /* the log records the bytes of contents that are not a block */
+    FT_appendLog(oFTree, bIsFile ? WAL_INSERT_FILE : WAL_INSERT_DIR,
+                 Path_getPathname(oPPath),
+                 bIsFile ? FT_flatContents(oNCurr) : pvContents,
+                 ulLength);
 
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
     return SUCCESS;
 }
 
-boolean FT_containsFile(const char *pcPath)
-{
-    /* changed return from SUCCESS to NOT_A_DIRECTORY. */
-    int iStatus;
-    Node_T oNFound = NULL;
-
-    assert(pcPath != NULL);
-
-    iStatus = FT_findNode(pcPath, &oNFound);
-    
-    return (boolean) (iStatus == IS_FILE);
-}
+/*--------------------------------------------------------------------*/
 
-int FT_rmFile(const char *pcPath)
+/* FT_insertDirIn, with oFTree's tree lock held shared. */
+static int FT_insertDirUnlocked(FT_T oFTree, const char *pcPath)
 {
     int iStatus;
-    Node_T oNFound = NULL;
+    Path_T oPPath = NULL;
+    Node_T oNCurr = NULL;
+    Node_T oNLocked = NULL;
 
+    assert(oFTree != NULL);
     assert(pcPath != NULL);
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
 
-    iStatus = FT_findNode(pcPath, &oNFound);
+    /* validate pcPath and generate a Path_T for it */
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
 
-    if(iStatus != IS_FILE) {
-        if (iStatus == IS_DIRECTORY) return NOT_A_FILE;
+    iStatus = Path_new(pcPath, &oPPath);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    /* find and lock the closest ancestor of oPPath already in the
+       tree */
+    iStatus= FT_lockPath(oFTree, oPPath, &oNCurr, &oNLocked);
+    if(iStatus != SUCCESS)
+    {
+        Path_free(oPPath);
         return iStatus;
     }
 
-    ulCount -= Node_free(oNFound);
-    if(ulCount == 0)
-        oNRoot = NULL;
+    iStatus = FT_buildPath(oFTree, oPPath, oNCurr, FALSE, NULL, 0, NULL,
+                           NULL);
+    FT_unlockDir(oFTree, oNLocked);
+    Path_free(oPPath);
 
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
-    return SUCCESS;
+    return iStatus;
 }
 
-void *FT_getFileContents(const char *pcPath)
+int FT_insertDirIn(FT_T oFTree, const char *pcPath)
 {
     int iStatus;
-    Node_T oNFound = NULL;
 
-    assert(pcPath != NULL);
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
 
-    iStatus = FT_findNode(pcPath, &oNFound);
-    if (iStatus != IS_FILE) return NULL;
+    FT_lockWriters(oFTree);
+    iStatus = FT_insertDirUnlocked(oFTree, pcPath);
+    FT_unlockWriters(oFTree);
 
-    return Node_getContents(oNFound);
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
 }
 
-void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
-                             size_t ulNewLength) 
+/* FT_containsDirIn, inside a read-side critical section on oFTree. */
+static boolean FT_containsDirUnlocked(FT_T oFTree, const char *pcPath)
 {
+    /* changed return from SUCCESS to NOT_A_FILE. */
     int iStatus;
     Node_T oNFound = NULL;
-    void *pvOldContents;
 
+    assert(oFTree != NULL);
     assert(pcPath != NULL);
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
-
-    iStatus = FT_findNode(pcPath, &oNFound);
-    if (iStatus != IS_FILE) return NULL;
 
-    pvOldContents = Node_editContents(oNFound, pvNewContents, 
-        ulNewLength);
+    if(oFTree->oIImage != NULL)
+        return (boolean) (FT_findImage(oFTree, pcPath, NULL, NULL)
+                          == IS_DIRECTORY);
 
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
-    return pvOldContents;
+    iStatus = FT_findFiltered(oFTree, pcPath, &oNFound);
+    return (boolean) (iStatus == IS_DIRECTORY);
 }
 
-int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize) 
+boolean FT_containsDirIn(FT_T oFTree, const char *pcPath)
 {
-    int iStatus;
-    Node_T oNFound = NULL;
+    boolean bResult;
+    size_t ulToken;
 
-    assert(pcPath != NULL);
-    assert(pbIsFile != NULL);
-    assert(pulSize != NULL);
+    assert(oFTree != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNFound);
-    
-    if (iStatus != IS_FILE && iStatus != IS_DIRECTORY) {
+    ulToken = FT_enterReader(oFTree);
+    bResult = FT_containsDirUnlocked(oFTree, pcPath);
+    FT_exitReader(oFTree, ulToken);
+    return bResult;
+}
+
+/*
+  FT_rmDirIn, with oFTree's tree lock held shared. Writes already
+  inside the directory finish before it is removed, and writes that
+  reach it after it is found find it gone.
+*/
+static int FT_rmDirUnlocked(FT_T oFTree, const char *pcPath)
+{
+    /* changed status check */
+    int iStatus;
+    Path_T oPPath = NULL;
+    Node_T oNFound = NULL;
+    Node_T oNParent;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    iStatus = Path_new(pcPath, &oPPath);
+    if(iStatus != SUCCESS)
         return iStatus;
+
+    iStatus = FT_findLocked(oFTree, oPPath, &oNFound);
+    Path_free(oPPath);
+
+    if(iStatus != IS_DIRECTORY) {
+      if (iStatus == IS_FILE) {
+        FT_unlockDir(oFTree, Node_getParent(oNFound));
+        return NOT_A_DIRECTORY;
+      }
+      return iStatus;
     }
-    /* if node is a directory */
-    else if (iStatus == IS_DIRECTORY) {
-        *pbIsFile = FALSE;
+
+    /* holding the parent's lock keeps new writers out of the
+       directory, so once those inside are done, none remain */
+    oNParent = Node_getParent(oNFound);
+    FT_drainSubtree(oFTree, oNFound);
+    iStatus = FT_removeSubtree(oFTree, oNFound);
+    if(iStatus == SUCCESS)
+        FT_appendLog(oFTree, WAL_REMOVE, pcPath, NULL, 0);
+    FT_unlockDir(oFTree, oNParent);
+
+    return iStatus;
+}
+
+int FT_rmDirIn(FT_T oFTree, const char *pcPath)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    iStatus = FT_rmDirUnlocked(oFTree, pcPath);
+    FT_unlockWriters(oFTree);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+int FT_setContentsFreeIn(FT_T oFTree, void (*pfFree)(void *pvContents))
+{
+    int iStatus = SUCCESS;
+
+    assert(oFTree != NULL);
+
+    /* no writer is inside an operation that reads the function */
+    FT_lockTree(oFTree);
+    if(!oFTree->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    else
+        oFTree->pfFreeContents = pfFree;
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+/*
+  FT_insertFileIn, with oFTree's tree lock held shared, except that
+  the file takes over the caller's hold on oOOwner, the owner of
+  pvContents or NULL, if it is inserted.
+*/
+static int FT_insertFileUnlocked(FT_T oFTree, const char *pcPath,
+                                 void *pvContents, size_t ulLength,
+                                 Node_Owner_T oOOwner)
+{
+    int iStatus;
+    Path_T oPPath = NULL;
+    Node_T oNCurr = NULL;
+    Node_T oNLocked = NULL;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+
+    /* validate pcPath and generate a Path_T for it */
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    iStatus = Path_new(pcPath, &oPPath);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    /* find and lock the closest ancestor of oPPath already in the
+       tree */
+    iStatus= FT_lockPath(oFTree, oPPath, &oNCurr, &oNLocked);
+    if(iStatus != SUCCESS)
+    {
+        Path_free(oPPath);
+        return iStatus;
     }
-    /* if node is a file */
-    else if (iStatus == IS_FILE) {
-        *pbIsFile = TRUE;
-        *pulSize = Node_getLength(oNFound);
+
+    /* validate that not adding file as root (with the root lock still
+       held if the root is NULL) */
+    if(oNCurr == NULL && Path_getDepth(oPPath)==1) {
+        FT_unlockDir(oFTree, oNLocked);
+        Path_free(oPPath);
+        return CONFLICTING_PATH;
     }
-    return SUCCESS;
+
+    iStatus = FT_buildPath(oFTree, oPPath, oNCurr, TRUE, pvContents,
+                          ulLength, oOOwner, NULL);
+    FT_unlockDir(oFTree, oNLocked);
+    Path_free(oPPath);
+
+    return iStatus;
 }
 
-int FT_init(void) 
+/*
+  FT_insertFileOwnedIn, with oFTree's tree lock held shared, or
+  FT_insertFileCopyIn if bCopy is TRUE, in which case pvContents are
+  only read.
+*/
+static int FT_insertFileOwnedUnlocked(FT_T oFTree, const char *pcPath,
+                                      void *pvContents, size_t ulLength,
+                                      void (*pfFree)(void *pvContents),
+                                      boolean bCopy)
 {
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+    int iStatus;
+    struct adopted sAdopted;
 
-    if(bIsInitialized)
+    assert(oFTree != NULL);
+
+    if(!oFTree->bIsInitialized)
         return INITIALIZATION_ERROR;
+    iStatus = FT_adoptContents(oFTree, pvContents, ulLength, pfFree,
+                               bCopy, &sAdopted);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_insertFileUnlocked(oFTree, pcPath, sAdopted.pvContents,
+                                    ulLength, sAdopted.oOOwner);
+    FT_settleContents(&sAdopted, (boolean) (iStatus == SUCCESS));
+    return iStatus;
+}
 
-    bIsInitialized = TRUE;
-    oNRoot = NULL;
-    ulCount = 0;
+int FT_insertFileIn(FT_T oFTree, const char *pcPath, void *pvContents,
+                    size_t ulLength)
+{
+    int iStatus;
 
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
-    return SUCCESS;
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    iStatus = FT_insertFileOwnedUnlocked(oFTree, pcPath, pvContents,
+                                         ulLength,
+                                         oFTree->pfFreeContents, FALSE);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+int FT_insertFileOwnedIn(FT_T oFTree, const char *pcPath,
+                         void *pvContents, size_t ulLength,
+                         void (*pfFree)(void *pvContents))
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    iStatus = FT_insertFileOwnedUnlocked(oFTree, pcPath, pvContents,
+                                         ulLength, pfFree, FALSE);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+int FT_insertFileCopyIn(FT_T oFTree, const char *pcPath,
+                        const void *pvContents, size_t ulLength)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    iStatus = FT_insertFileOwnedUnlocked(oFTree, pcPath,
+                                         (void *) pvContents, ulLength,
+                                         NULL, TRUE);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
 }
 
-int FT_destroy(void) 
+/* FT_insertFileMappedIn, with oFTree's tree lock held shared. */
+static int FT_insertFileMappedUnlocked(FT_T oFTree, const char *pcPath,
+                                       const char *pcFile,
+                                       size_t ulOffset, size_t ulLength)
 {
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+    int iStatus;
+    Map_T oMNew;
+    Node_Owner_T oOOwner;
 
-    if(!bIsInitialized)
+    assert(oFTree != NULL);
+    assert(pcFile != NULL);
+
+    if(!oFTree->bIsInitialized)
         return INITIALIZATION_ERROR;
+    iStatus = Map_open(pcFile, ulOffset, ulLength, &oMNew);
+    if(iStatus != SUCCESS)
+        return iStatus;
 
-    if(oNRoot) {
-        ulCount -= Node_free(oNRoot);
-        oNRoot = NULL;
+    /* the log records the bytes, so they are mapped now to be read */
+    if(oFTree->oWLog != NULL && Map_load(oMNew) == NULL) {
+        Map_free(oMNew);
+        return IO_ERROR;
+    }
+    oOOwner = Node_newOwner(oMNew, Map_free);
+    if(oOOwner == NULL) {
+        Map_free(oMNew);
+        return MEMORY_ERROR;
     }
+    iStatus = FT_insertFileUnlocked(oFTree, pcPath, oMNew, ulLength,
+                                    oOOwner);
+    if(iStatus != SUCCESS) {
+        Node_freeOwner(oOOwner);
+        Map_free(oMNew);
+    }
+    return iStatus;
+}
+
+int FT_insertFileMappedIn(FT_T oFTree, const char *pcPath,
+                          const char *pcFile, size_t ulOffset,
+                          size_t ulLength)
+{
+    int iStatus;
 
-    bIsInitialized = FALSE;
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
 
-    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
-    return SUCCESS;
+    FT_lockWriters(oFTree);
+    iStatus = FT_insertFileMappedUnlocked(oFTree, pcPath, pcFile,
+                                          ulOffset, ulLength);
+    FT_unlockWriters(oFTree);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
 }
 
-/* --------------------------------------------------------------------
+/* FT_containsFileIn, inside a read-side critical section on oFTree. */
+static boolean FT_containsFileUnlocked(FT_T oFTree, const char *pcPath)
+{
+    /* changed return from SUCCESS to NOT_A_DIRECTORY. */
+    int iStatus;
+    Node_T oNFound = NULL;
 
-  The following auxiliary functions are used for generating the
-  string representation of the FT.
-*/
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
 
-/*
-  Performs a pre-order traversal of the tree rooted at n,
-  inserting each payload to DynArray_T d beginning at index i.
-  Returns the next unused index in d after the insertion(s).
-*/
-static size_t FT_preOrderTraversal(Node_T n, DynArray_T d, size_t i) {
-    size_t c;
+    if(oFTree->oIImage != NULL)
+        return (boolean) (FT_findImage(oFTree, pcPath, NULL, NULL)
+                          == IS_FILE);
 
-    assert(d != NULL);
+    iStatus = FT_findFiltered(oFTree, pcPath, &oNFound);
+    
+    return (boolean) (iStatus == IS_FILE);
+}
 
-    if(n != NULL) {
-        (void) DynArray_set(d, i, n);
-        i++;
-        
-        /* add all files in level */
-        for(c = 0; c < Node_getNumChildren(n); c++) {
-            int iStatus;
-            Node_T oNChild = NULL;
-            iStatus = Node_getChild(n,c, &oNChild);
-            assert(iStatus == SUCCESS);
-            if (Node_isFile(oNChild)) 
-                (void) DynArray_set(d, i++, oNChild);
-        }
+boolean FT_containsFileIn(FT_T oFTree, const char *pcPath)
+{
+    boolean bResult;
+    size_t ulToken;
 
-        for(c = 0; c < Node_getNumChildren(n); c++) {
-            int iStatus;
-            Node_T oNChild = NULL;
-            iStatus = Node_getChild(n,c, &oNChild);
-            assert(iStatus == SUCCESS);
-            if (!Node_isFile(oNChild))
-                i = FT_preOrderTraversal(oNChild, d, i);
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    bResult = FT_containsFileUnlocked(oFTree, pcPath);
+    FT_exitReader(oFTree, ulToken);
+    return bResult;
+}
+
+/* FT_rmFileIn, with oFTree's tree lock held shared. */
+static int FT_rmFileUnlocked(FT_T oFTree, const char *pcPath)
+{
+    int iStatus;
+    Path_T oPPath = NULL;
+    Node_T oNFound = NULL;
+    Node_T oNParent;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    iStatus = Path_new(pcPath, &oPPath);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    iStatus = FT_findLocked(oFTree, oPPath, &oNFound);
+    Path_free(oPPath);
+
+    if(iStatus != IS_FILE) {
+        if (iStatus == IS_DIRECTORY) {
+            FT_unlockDir(oFTree, Node_getParent(oNFound));
+            return NOT_A_FILE;
         }
+        return iStatus;
     }
-    return i;
+
+    oNParent = Node_getParent(oNFound);
+    iStatus = FT_removeSubtree(oFTree, oNFound);
+    if(iStatus == SUCCESS)
+        FT_appendLog(oFTree, WAL_REMOVE, pcPath, NULL, 0);
+    FT_unlockDir(oFTree, oNParent);
+
+    return iStatus;
 }
 
-/*
-  Alternate version of strlen that uses pulAcc as an in-out parameter
-  to accumulate a string length, rather than returning the length of
-  oNNode's path, and also always adds one addition byte to the sum.
-*/
-static void FT_strlenAccumulate(Node_T oNNode, size_t *pulAcc) {
-   assert(pulAcc != NULL);
+int FT_rmFileIn(FT_T oFTree, const char *pcPath)
+{
+    int iStatus;
 
-   if(oNNode != NULL)
-      *pulAcc += (Path_getStrLength(Node_getPath(oNNode)) + 1);
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    iStatus = FT_rmFileUnlocked(oFTree, pcPath);
+    FT_unlockWriters(oFTree);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+/* FT_getFileContentsIn, inside a read-side critical section on oFTree. */
+static void *FT_getFileContentsUnlocked(FT_T oFTree, const char *pcPath)
+{
+    int iStatus;
+    Node_T oNFound = NULL;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+
+    if(oFTree->oIImage != NULL) {
+        void *pvContents = NULL;
+        iStatus = FT_findImage(oFTree, pcPath, NULL, &pvContents);
+        return iStatus == IS_FILE ? pvContents : NULL;
+    }
+
+    iStatus = FT_findFiltered(oFTree, pcPath, &oNFound);
+    if (iStatus != IS_FILE) return NULL;
+
+    return FT_readContents(oFTree, oNFound);
+}
+
+void *FT_getFileContentsIn(FT_T oFTree, const char *pcPath)
+{
+    void *pvResult;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    pvResult = FT_getFileContentsUnlocked(oFTree, pcPath);
+    FT_exitReader(oFTree, ulToken);
+    FT_keepBudget(oFTree, FALSE);
+    return pvResult;
 }
 
 /*
-  Alternate version of strcat that inverts the typical argument
-  order, appending oNNode's path onto pcAcc, and also always adds one
-  newline at the end of the concatenated string.
+  Replaces the contents of the file with absolute path oPPath in
+  oFTree with pvNewContents of size ulNewLength bytes, provided that
+  ulID is 0 or the file's identifier, holding the lock of the file's
+  parent meanwhile. The file takes over the caller's hold on oOOwner,
+  the owner of pvNewContents or NULL, if they replace its contents.
+  Sets *ppvOldContents to the old contents if they were the client's,
+  and to NULL if oFTree owned them, in which case it frees them once
+  no snapshot or open transaction still needs them. Must be called
+  with oFTree's tree lock held shared. Returns SUCCESS, a status that
+  FT_findLocked returns when it finds no node, or:
+  * NO_SUCH_PATH if the file's identifier is not ulID
+  * NOT_A_FILE if oPPath is a directory
+  * MEMORY_ERROR if memory could not be allocated to copy the file
+    from a snapshot that shares it, or to record the change in an
+    open transaction
+  in which case the file and *ppvOldContents are unchanged.
 */
-static void FT_strcatAccumulate(Node_T oNNode, char *pcAcc) {
-   assert(pcAcc != NULL);
+static int FT_replaceLocked(FT_T oFTree, Path_T oPPath, size_t ulID,
+                            void *pvNewContents, size_t ulNewLength,
+                            Node_Owner_T oOOwner, void **ppvOldContents) {
+    int iStatus;
+    struct undoRecord *psRecord = NULL;
+    Node_T oNFound = NULL;
 
-   if(oNNode != NULL) {
-      strcat(pcAcc, Path_getPathname(Node_getPath(oNNode)));
-      strcat(pcAcc, "\n");
-   }
+    assert(oFTree != NULL);
+    assert(oPPath != NULL);
+    assert(ppvOldContents != NULL);
+
+    iStatus = FT_findLocked(oFTree, oPPath, &oNFound);
+    if(iStatus != IS_FILE && iStatus != IS_DIRECTORY)
+        return iStatus;
+
+    if(iStatus == IS_DIRECTORY)
+        iStatus = NOT_A_FILE;
+    else if(ulID != 0 && Node_getID(oNFound) != ulID)
+        iStatus = NO_SUCH_PATH;
+    else
+        iStatus = FT_ownNode(oFTree, &oNFound);
+    if(iStatus == SUCCESS)
+        iStatus = FT_logChange(oFTree, UNDO_REPLACE, oNFound, &psRecord);
+
+    if(iStatus == SUCCESS) {
+        *ppvOldContents = FT_installContents(oFTree, oNFound, psRecord,
+                                             pvNewContents, ulNewLength,
+                                             oOOwner);
+        FT_appendLog(oFTree, WAL_REPLACE, Path_getPathname(oPPath),
+                     pvNewContents, ulNewLength);
+    }
+    FT_unlockDir(oFTree, Node_getParent(oNFound));
+    return iStatus;
 }
-/*--------------------------------------------------------------------*/
 
-char *FT_toString(void) 
+/*
+  FT_replaceFileContentsIn, with oFTree's tree lock held shared,
+  except that it takes over the caller's hold on oOOwner as
+  FT_replaceLocked does, sets *ppvOldContents as FT_replaceLocked
+  does, and returns a status as FT_replaceFileContentsOwnedIn does.
+*/
+static int FT_replaceFileContentsUnlocked(FT_T oFTree,
+                                          const char *pcPath,
+                                          void *pvNewContents,
+                                          size_t ulNewLength,
+                                          Node_Owner_T oOOwner,
+                                          void **ppvOldContents)
 {
-    DynArray_T nodes;
-    size_t totalStrlen = 1;
-    char *result = NULL;
+    Path_T oPPath = NULL;
+    int iStatus;
 
-    if(!bIsInitialized)
-        return NULL;
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
 
-    nodes = DynArray_new(ulCount);
-    (void) FT_preOrderTraversal(oNRoot, nodes, 0);
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+    iStatus = Path_new(pcPath, &oPPath);
+    if(iStatus != SUCCESS)
+        return iStatus;
 
-    DynArray_map(nodes, (void (*)(void *, void*)) FT_strlenAccumulate,
-                (void*) &totalStrlen);
+    iStatus = FT_replaceLocked(oFTree, oPPath, 0, pvNewContents,
+                               ulNewLength, oOOwner, ppvOldContents);
+    Path_free(oPPath);
 
-    result = malloc(totalStrlen);
-    if(result == NULL) {
-        DynArray_free(nodes);
-        return NULL;
-    }
-    *result = '\0';
+    return iStatus;
+}
 
-    DynArray_map(nodes, (void (*)(void *, void*)) FT_strcatAccumulate,
-                (void *) result);
+/*
+  FT_replaceFileContentsOwnedIn, with oFTree's tree lock held shared,
+  or FT_replaceFileContentsCopyIn if bCopy is TRUE, in which case
+  pvNewContents are only read, which sets *ppvOldContents as
+  FT_replaceLocked does.
+*/
+static int FT_replaceFileContentsOwnedUnlocked(FT_T oFTree,
+                                               const char *pcPath,
+                                               void *pvNewContents,
+                                               size_t ulNewLength,
+                                               void (*pfFree)(void *pvContents),
+                                               boolean bCopy,
+                                               void **ppvOldContents)
+{
+    int iStatus;
+    struct adopted sAdopted;
 
-    DynArray_free(nodes);
+    assert(oFTree != NULL);
 
-    return result;
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+    iStatus = FT_adoptContents(oFTree, pvNewContents, ulNewLength,
+                               pfFree, bCopy, &sAdopted);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_replaceFileContentsUnlocked(oFTree, pcPath,
+                                             sAdopted.pvContents,
+                                             ulNewLength,
+                                             sAdopted.oOOwner,
+                                             ppvOldContents);
+    FT_settleContents(&sAdopted, (boolean) (iStatus == SUCCESS));
+    return iStatus;
+}
+
+void *FT_replaceFileContentsIn(FT_T oFTree, const char *pcPath,
+                               void *pvNewContents, size_t ulNewLength)
+{
+    void *pvResult = NULL;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    (void) FT_replaceFileContentsOwnedUnlocked(oFTree, pcPath,
+                                               pvNewContents, ulNewLength,
+                                               oFTree->pfFreeContents,
+                                               FALSE, &pvResult);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return pvResult;
+}
+
+int FT_replaceFileContentsOwnedIn(FT_T oFTree, const char *pcPath,
+                                  void *pvNewContents, size_t ulNewLength,
+                                  void (*pfFree)(void *pvContents))
+{
+    void *pvOldContents;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    iStatus = FT_replaceFileContentsOwnedUnlocked(oFTree, pcPath,
+                                                  pvNewContents,
+                                                  ulNewLength, pfFree,
+                                                  FALSE, &pvOldContents);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+int FT_replaceFileContentsCopyIn(FT_T oFTree, const char *pcPath,
+                                 const void *pvNewContents,
+                                 size_t ulNewLength)
+{
+    int iStatus;
+    void *pvOldContents;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    iStatus = FT_replaceFileContentsOwnedUnlocked(oFTree, pcPath,
+                                                  (void *) pvNewContents,
+                                                  ulNewLength, NULL, TRUE,
+                                                  &pvOldContents);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+/*
+  Returns a new version of chunked contents holding the ulOldLength
+  bytes at pvOldContents, the contents of a file that its owner frees
+  with pfFree, with the ulLength bytes at pvBytes written at ulOffset,
+  or NULL if memory could not be allocated for it. Contents that are
+  not already chunked are copied into chunks first, decompressed if
+  they are compressed, read back if they are spilled and mapped if
+  they are mapped.
+*/
+static Rope_T FT_writeRope(void *pvOldContents, size_t ulOldLength,
+                           void (*pfFree)(void *pvContents),
+                           size_t ulOffset, const void *pvBytes,
+                           size_t ulLength) {
+    Rope_T oRFlat;
+    Rope_T oRNew;
+
+    if(pfFree == Rope_free)
+        return Rope_write(pvOldContents, ulOffset, pvBytes, ulLength);
+    /* contents with an owner are never NULL */
+    if(pfFree != NULL) {
+        pvOldContents = FT_flattenContents(pvOldContents, pfFree);
+        if(pvOldContents == NULL)
+            return NULL;
+    }
+
+    oRFlat = Rope_write(NULL, 0, pvOldContents, ulOldLength);
+    if(oRFlat == NULL)
+        return NULL;
+    oRNew = Rope_write(oRFlat, ulOffset, pvBytes, ulLength);
+    Rope_free(oRFlat);
+    return oRNew;
+}
+
+/*
+  FT_writeAtIn on absolute path oPPath, or FT_appendIn if bAppend is
+  TRUE, in which case ulOffset is ignored, holding the lock of the
+  file's parent meanwhile. Must be called with oFTree's tree lock held
+  shared.
+*/
+static int FT_writeLocked(FT_T oFTree, Path_T oPPath, size_t ulOffset,
+                          boolean bAppend, const void *pvBytes,
+                          size_t ulLength) {
+    int iStatus;
+    struct undoRecord *psRecord = NULL;
+    Node_T oNFound = NULL;
+    Node_Owner_T oOOwner = NULL;
+    Rope_T oRNew = NULL;
+    void (*pfFree)(void *pvContents);
+    void *pvOldContents;
+    size_t ulOldLength;
+
+    assert(oFTree != NULL);
+    assert(oPPath != NULL);
+    assert(pvBytes != NULL || ulLength == 0);
+
+    iStatus = FT_findLocked(oFTree, oPPath, &oNFound);
+    if(iStatus != IS_FILE && iStatus != IS_DIRECTORY)
+        return iStatus;
+
+    if(iStatus == IS_DIRECTORY)
+        iStatus = NOT_A_FILE;
+    else
+        iStatus = FT_ownNode(oFTree, &oNFound);
+    if(iStatus == SUCCESS)
+        iStatus = FT_logChange(oFTree, UNDO_REPLACE, oNFound, &psRecord);
+
+    if(iStatus == SUCCESS) {
+        pvOldContents = Node_readContents(oNFound, &ulOldLength, &pfFree);
+        if(bAppend)
+            ulOffset = ulOldLength;
+        oRNew = FT_writeRope(pvOldContents, ulOldLength, pfFree, ulOffset,
+                             pvBytes, ulLength);
+        if(oRNew != NULL) {
+            oOOwner = Node_newOwner(oRNew, Rope_free);
+            if(oOOwner == NULL)
+                Rope_free(oRNew);
+        }
+        if(oOOwner == NULL) {
+            FT_unlogChange(oFTree, psRecord);
+            iStatus = MEMORY_ERROR;
+        }
+    }
+
+    if(iStatus == SUCCESS) {
+        (void) FT_installContents(oFTree, oNFound, psRecord, oRNew,
+                                  Rope_getLength(oRNew), oOOwner);
+        /* a write uses the file as much as a read does */
+        Node_markRead(oNFound, FT_now(oFTree));
+        FT_chargeBudget(oFTree, ulLength);
+        /* the log holds only the bytes written, not the whole file */
+        if(oFTree->oWLog != NULL)
+            (void) Wal_appendWrite(oFTree->oWLog,
+                                   Path_getPathname(oPPath), ulOffset,
+                                   pvBytes, ulLength);
+    }
+    FT_unlockDir(oFTree, Node_getParent(oNFound));
+    return iStatus;
+}
+
+/* FT_writeAtIn or FT_appendIn, with oFTree's tree lock held shared. */
+static int FT_writeAtUnlocked(FT_T oFTree, const char *pcPath,
+                              size_t ulOffset, boolean bAppend,
+                              const void *pvBytes, size_t ulLength)
+{
+    Path_T oPPath = NULL;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+    iStatus = Path_new(pcPath, &oPPath);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    iStatus = FT_writeLocked(oFTree, oPPath, ulOffset, bAppend, pvBytes,
+                             ulLength);
+    Path_free(oPPath);
+
+    return iStatus;
+}
+
+int FT_writeAtIn(FT_T oFTree, const char *pcPath, size_t ulOffset,
+                 const void *pvBytes, size_t ulLength)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    iStatus = FT_writeAtUnlocked(oFTree, pcPath, ulOffset, FALSE,
+                                 pvBytes, ulLength);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+int FT_appendIn(FT_T oFTree, const char *pcPath, const void *pvBytes,
+                size_t ulLength)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    iStatus = FT_writeAtUnlocked(oFTree, pcPath, 0, TRUE, pvBytes,
+                                 ulLength);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+/* FT_readAtIn, inside a read-side critical section on oFTree. */
+static int FT_readAtUnlocked(FT_T oFTree, const char *pcPath,
+                             size_t ulOffset, void *pvBuf,
+                             size_t ulLength, size_t *pulRead)
+{
+    int iStatus;
+    Node_T oNFound = NULL;
+    void (*pfFree)(void *pvContents) = NULL;
+    void *pvContents = NULL;
+    size_t ulSize = 0;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+    assert(pvBuf != NULL || ulLength == 0);
+    assert(pulRead != NULL);
+
+    if(oFTree->oIImage != NULL)
+        iStatus = FT_findImage(oFTree, pcPath, &ulSize, &pvContents);
+    else {
+        iStatus = FT_findFiltered(oFTree, pcPath, &oNFound);
+        if(iStatus == IS_FILE) {
+            Node_markRead(oNFound, FT_now(oFTree));
+            pvContents = Node_readContents(oNFound, &ulSize, &pfFree);
+        }
+    }
+    if(iStatus == IS_DIRECTORY)
+        return NOT_A_FILE;
+    if(iStatus != IS_FILE)
+        return iStatus;
+
+    if(pfFree == Lz_free || pfFree == Map_free) {
+        pvContents = FT_flattenContents(pvContents, pfFree);
+        if(pvContents == NULL)
+            return pfFree == Lz_free ? MEMORY_ERROR : IO_ERROR;
+    }
+    if(pfFree == Rope_free)
+        *pulRead = Rope_read(pvContents, ulOffset, pvBuf, ulLength);
+    else if(pfFree == Spill_free) {
+        /* spilled contents are read in place, not read back whole */
+        *pulRead = 0;
+        if(ulOffset < ulSize) {
+            *pulRead = ulSize - ulOffset < ulLength ? ulSize - ulOffset
+                : ulLength;
+            if(!Spill_read(pvContents, ulOffset, pvBuf, *pulRead))
+                return IO_ERROR;
+        }
+    }
+    else {
+        *pulRead = 0;
+        if(ulOffset < ulSize) {
+            *pulRead = ulSize - ulOffset < ulLength ? ulSize - ulOffset
+                : ulLength;
+            memcpy(pvBuf, (char *) pvContents + ulOffset, *pulRead);
+        }
+    }
+    return SUCCESS;
+}
+
+int FT_readAtIn(FT_T oFTree, const char *pcPath, size_t ulOffset,
+                void *pvBuf, size_t ulLength, size_t *pulRead)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_readAtUnlocked(oFTree, pcPath, ulOffset, pvBuf,
+                                ulLength, pulRead);
+    FT_exitReader(oFTree, ulToken);
+    return iStatus;
+}
+
+/* FT_statIn, inside a read-side critical section on oFTree. */
+static int FT_statUnlocked(FT_T oFTree, const char *pcPath, boolean *pbIsFile,
+                           size_t *pulSize)
+{
+    int iStatus;
+    Node_T oNFound = NULL;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+    assert(pbIsFile != NULL);
+    assert(pulSize != NULL);
+
+    if(oFTree->oIImage != NULL) {
+        size_t ulLength = 0;
+        iStatus = FT_findImage(oFTree, pcPath, &ulLength, NULL);
+        if(iStatus == IS_FILE)
+            *pulSize = ulLength;
+        if(iStatus == IS_FILE || iStatus == IS_DIRECTORY) {
+            *pbIsFile = (boolean) (iStatus == IS_FILE);
+            return SUCCESS;
+        }
+        return iStatus;
+    }
+
+    iStatus = FT_findNode(oFTree, pcPath, &oNFound);
+    
+    if (iStatus != IS_FILE && iStatus != IS_DIRECTORY) {
+        return iStatus;
+    }
+    /* if node is a directory */
+    else if (iStatus == IS_DIRECTORY) {
+        *pbIsFile = FALSE;
+    }
+    /* if node is a file */
+    else if (iStatus == IS_FILE) {
+        *pbIsFile = TRUE;
+        *pulSize = Node_getLength(oNFound);
+    }
+    return SUCCESS;
+}
+
+int FT_statIn(FT_T oFTree, const char *pcPath, boolean *pbIsFile,
+              size_t *pulSize)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_statUnlocked(oFTree, pcPath, pbIsFile, pulSize);
+    FT_exitReader(oFTree, ulToken);
+    return iStatus;
+}
+
+int FT_getCountIn(FT_T oFTree, size_t *pulCount)
+{
+    assert(oFTree != NULL);
+    assert(pulCount != NULL);
+
+    if(oFTree->oIImage != NULL) {
+        *pulCount = Image_getCount(oFTree->oIImage);
+        return SUCCESS;
+    }
+    if(!FT_isInitialized(oFTree))
+        return INITIALIZATION_ERROR;
+
+    *pulCount = __atomic_load_n(&oFTree->ulCount, __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
+/* FT_duIn, inside a read-side critical section on oFTree. */
+static int FT_duUnlocked(FT_T oFTree, const char *pcPath, size_t *pulFiles,
+                         size_t *pulDirs, size_t *pulBytes)
+{
+    int iStatus;
+    Node_T oNFound = NULL;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+    assert(pulFiles != NULL);
+    assert(pulDirs != NULL);
+    assert(pulBytes != NULL);
+
+    /* an image keeps no totals, and its FT is not initialized */
+    iStatus = FT_findNode(oFTree, pcPath, &oNFound);
+    if(iStatus != IS_FILE && iStatus != IS_DIRECTORY)
+        return iStatus;
+
+    Node_getTotals(oNFound, pulFiles, pulDirs, pulBytes);
+    return SUCCESS;
+}
+
+int FT_duIn(FT_T oFTree, const char *pcPath, size_t *pulFiles,
+            size_t *pulDirs, size_t *pulBytes)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_duUnlocked(oFTree, pcPath, pulFiles, pulDirs, pulBytes);
+    FT_exitReader(oFTree, ulToken);
+    return iStatus;
+}
+
+/*
+  Returns the size that FT_topK ranks oNNode by under eBy: the length
+  of a file, or the total length of the files below a directory.
+*/
+static size_t FT_rankSize(Node_T oNNode, FT_RankBy_T eBy) {
+    size_t ulFiles, ulDirs, ulBytes;
+
+    assert(oNNode != NULL);
+
+    if(eBy == FT_BY_FILE_SIZE)
+        return Node_getLength(oNNode);
+    Node_getTotals(oNNode, &ulFiles, &ulDirs, &ulBytes);
+    return ulBytes;
+}
+
+/*
+  Returns a bound on the size, under eBy, of anything FT_topK could
+  rank in the subtree rooted at directory oNDir: the directory's bound
+  on the lengths of its files, or its own total, since no directory
+  below it holds more.
+*/
+static size_t FT_rankBound(Node_T oNDir, FT_RankBy_T eBy) {
+    assert(oNDir != NULL);
+
+    if(eBy == FT_BY_FILE_SIZE)
+        return Node_getMaxLength(oNDir);
+    return FT_rankSize(oNDir, eBy);
+}
+
+/*
+  Returns TRUE if oNFirst ranks behind oNSecond under eBy, being
+  smaller or, as large, later in path order, and FALSE otherwise.
+*/
+static boolean FT_ranksBehind(Node_T oNFirst, Node_T oNSecond,
+                              FT_RankBy_T eBy) {
+    size_t ulFirst = FT_rankSize(oNFirst, eBy);
+    size_t ulSecond = FT_rankSize(oNSecond, eBy);
+
+    if(ulFirst != ulSecond)
+        return (boolean) (ulFirst < ulSecond);
+    return (boolean) (Path_comparePath(Node_getPath(oNFirst),
+                                       Node_getPath(oNSecond)) > 0);
+}
+
+/*
+  Returns TRUE if directory oNFirst's bound under eBy is above
+  directory oNSecond's, and FALSE otherwise.
+*/
+static boolean FT_boundsAbove(Node_T oNFirst, Node_T oNSecond,
+                              FT_RankBy_T eBy) {
+    return (boolean) (FT_rankBound(oNFirst, eBy)
+                      > FT_rankBound(oNSecond, eBy));
+}
+
+/* A test of whether one node belongs above another in a heap */
+typedef boolean (*FT_Above_T)(Node_T, Node_T, FT_RankBy_T);
+
+/*
+  Moves the node at ulIndex of binary heap oDHeap, ordered by pfAbove
+  under eBy, down until neither of its children belongs above it.
+*/
+static void FT_heapSiftDown(DynArray_T oDHeap, size_t ulIndex,
+                            FT_RankBy_T eBy, FT_Above_T pfAbove) {
+    size_t ulLength = DynArray_getLength(oDHeap);
+    size_t ulChild;
+    Node_T oNNode = DynArray_get(oDHeap, ulIndex);
+
+    for(;;) {
+        ulChild = 2 * ulIndex + 1;
+        if(ulChild >= ulLength)
+            break;
+        if(ulChild + 1 < ulLength
+           && pfAbove(DynArray_get(oDHeap, ulChild + 1),
+                      DynArray_get(oDHeap, ulChild), eBy))
+            ulChild++;
+        if(!pfAbove(DynArray_get(oDHeap, ulChild), oNNode, eBy))
+            break;
+        (void) DynArray_set(oDHeap, ulIndex, DynArray_get(oDHeap, ulChild));
+        ulIndex = ulChild;
+    }
+    (void) DynArray_set(oDHeap, ulIndex, oNNode);
+}
+
+/*
+  Adds oNNode to binary heap oDHeap, ordered by pfAbove under eBy.
+  Returns SUCCESS, or MEMORY_ERROR if insufficient memory is
+  available, in which case oDHeap is unchanged.
+*/
+static int FT_heapPush(DynArray_T oDHeap, Node_T oNNode, FT_RankBy_T eBy,
+                       FT_Above_T pfAbove) {
+    size_t ulIndex = DynArray_getLength(oDHeap);
+
+    if(!DynArray_add(oDHeap, oNNode))
+        return MEMORY_ERROR;
+    while(ulIndex > 0
+          && pfAbove(oNNode, DynArray_get(oDHeap, (ulIndex - 1) / 2), eBy)) {
+        (void) DynArray_set(oDHeap, ulIndex,
+                            DynArray_get(oDHeap, (ulIndex - 1) / 2));
+        ulIndex = (ulIndex - 1) / 2;
+    }
+    (void) DynArray_set(oDHeap, ulIndex, oNNode);
+    return SUCCESS;
+}
+
+/*
+  Removes and returns the top node of the non-empty binary heap
+  oDHeap, ordered by pfAbove under eBy.
+*/
+static Node_T FT_heapPop(DynArray_T oDHeap, FT_RankBy_T eBy,
+                         FT_Above_T pfAbove) {
+    Node_T oNTop = DynArray_get(oDHeap, 0);
+    Node_T oNLast = DynArray_removeAt(oDHeap,
+                                      DynArray_getLength(oDHeap) - 1);
+
+    if(DynArray_getLength(oDHeap) > 0) {
+        (void) DynArray_set(oDHeap, 0, oNLast);
+        FT_heapSiftDown(oDHeap, 0, eBy, pfAbove);
+    }
+    return oNTop;
+}
+
+/*
+  Offers oNNode to oDBest, a heap of the ulK largest nodes under eBy
+  found so far with the one that ranks last on top, so that it holds
+  oNNode in place of that one if oNNode ranks ahead of it. Returns
+  SUCCESS, or MEMORY_ERROR if insufficient memory is available.
+*/
+static int FT_offerRanked(DynArray_T oDBest, size_t ulK, Node_T oNNode,
+                          FT_RankBy_T eBy) {
+    if(DynArray_getLength(oDBest) < ulK)
+        return FT_heapPush(oDBest, oNNode, eBy, FT_ranksBehind);
+    if(FT_ranksBehind(DynArray_get(oDBest, 0), oNNode, eBy)) {
+        (void) DynArray_set(oDBest, 0, oNNode);
+        FT_heapSiftDown(oDBest, 0, eBy, FT_ranksBehind);
+    }
+    return SUCCESS;
+}
+
+/*
+  Returns TRUE if nothing in the subtree rooted at directory oNDir can
+  rank among oDBest, a full heap of the ulK largest nodes under eBy
+  found so far, and FALSE otherwise.
+*/
+static boolean FT_canPrune(DynArray_T oDBest, size_t ulK, Node_T oNDir,
+                           FT_RankBy_T eBy) {
+    return (boolean) (DynArray_getLength(oDBest) == ulK
+                      && FT_rankBound(oNDir, eBy)
+                         < FT_rankSize(DynArray_get(oDBest, 0), eBy));
+}
+
+/*
+  Searches the subtree rooted at directory oNStart best first for the
+  ulK largest nodes under eBy below it, leaving them in oDBest, a heap
+  with the one that ranks last on top. oDFrontier, empty, holds the
+  directories yet to be searched, the one with the highest bound on
+  top: once that bound falls below the last of ulK found, nothing left
+  can rank, and the search stops. Returns SUCCESS, or MEMORY_ERROR if
+  insufficient memory is available.
+*/
+static int FT_searchRanked(Node_T oNStart, size_t ulK, FT_RankBy_T eBy,
+                           DynArray_T oDFrontier, DynArray_T oDBest) {
+    Node_T oNDir;
+    Node_T oNChild = NULL;
+    size_t ulIndex;
+    int iStatus;
+
+    iStatus = FT_heapPush(oDFrontier, oNStart, eBy, FT_boundsAbove);
+    while(iStatus == SUCCESS && DynArray_getLength(oDFrontier) > 0) {
+        oNDir = FT_heapPop(oDFrontier, eBy, FT_boundsAbove);
+        if(FT_canPrune(oDBest, ulK, oNDir, eBy))
+            break;
+        if(eBy == FT_BY_SUBTREE_BYTES && oNDir != oNStart)
+            iStatus = FT_offerRanked(oDBest, ulK, oNDir, eBy);
+
+        for(ulIndex = 0; iStatus == SUCCESS
+                && ulIndex < Node_getNumChildren(oNDir); ulIndex++) {
+            (void) Node_getChild(oNDir, ulIndex, &oNChild);
+            if(Node_isFile(oNChild)) {
+                if(eBy == FT_BY_FILE_SIZE)
+                    iStatus = FT_offerRanked(oDBest, ulK, oNChild, eBy);
+            }
+            else if(!FT_canPrune(oDBest, ulK, oNChild, eBy))
+                iStatus = FT_heapPush(oDFrontier, oNChild, eBy,
+                                      FT_boundsAbove);
+        }
+    }
+    return iStatus;
+}
+
+/*
+  FT_topKIn, with oFTree's tree lock held exclusively, or on a
+  snapshot's view, so that the directories searched stay as they are.
+*/
+static int FT_topKUnlocked(FT_T oFTree, const char *pcPath, size_t ulK,
+                           FT_RankBy_T eBy, char **ppcPaths,
+                           size_t *pulSizes, size_t *pulFound)
+{
+    int iStatus;
+    Node_T oNFound = NULL;
+    DynArray_T oDFrontier;
+    DynArray_T oDBest;
+    Node_T oNNode;
+    const char *pcFound;
+    size_t ulFound;
+    size_t ulIndex;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+    assert(eBy == FT_BY_FILE_SIZE || eBy == FT_BY_SUBTREE_BYTES);
+    assert(ppcPaths != NULL || ulK == 0);
+    assert(pulSizes != NULL || ulK == 0);
+    assert(pulFound != NULL);
+
+    iStatus = FT_findNode(oFTree, pcPath, &oNFound);
+    if(iStatus == IS_FILE)
+        return NOT_A_DIRECTORY;
+    if(iStatus != IS_DIRECTORY)
+        return iStatus;
+
+    oDFrontier = DynArray_new(0);
+    oDBest = DynArray_new(0);
+    if(oDFrontier == NULL || oDBest == NULL) {
+        if(oDFrontier != NULL)
+            DynArray_free(oDFrontier);
+        if(oDBest != NULL)
+            DynArray_free(oDBest);
+        return MEMORY_ERROR;
+    }
+
+    if(ulK > 0)
+        iStatus = FT_searchRanked(oNFound, ulK, eBy, oDFrontier, oDBest);
+    else
+        iStatus = SUCCESS;
+
+    /* the heap gives up the last-ranked first, so fill from the back */
+    ulFound = DynArray_getLength(oDBest);
+    for(ulIndex = ulFound; iStatus == SUCCESS && ulIndex > 0; ulIndex--) {
+        oNNode = FT_heapPop(oDBest, eBy, FT_ranksBehind);
+        pcFound = Path_getPathname(Node_getPath(oNNode));
+        ppcPaths[ulIndex - 1] = malloc(strlen(pcFound) + 1);
+        if(ppcPaths[ulIndex - 1] == NULL) {
+            for(; ulIndex < ulFound; ulIndex++)
+                free(ppcPaths[ulIndex]);
+            iStatus = MEMORY_ERROR;
+            break;
+        }
+        strcpy(ppcPaths[ulIndex - 1], pcFound);
+        pulSizes[ulIndex - 1] = FT_rankSize(oNNode, eBy);
+    }
+
+    DynArray_free(oDFrontier);
+    DynArray_free(oDBest);
+    if(iStatus == SUCCESS)
+        *pulFound = ulFound;
+    return iStatus;
+}
+
+int FT_topKIn(FT_T oFTree, const char *pcPath, size_t ulK,
+              FT_RankBy_T eBy, char **ppcPaths, size_t *pulSizes,
+              size_t *pulFound)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    FT_lockTree(oFTree);
+    iStatus = FT_topKUnlocked(oFTree, pcPath, ulK, eBy, ppcPaths,
+                              pulSizes, pulFound);
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+/*
+  Frees all nodes in oFTree and its negative-lookup filter, if any,
+  and closes its write-ahead log, if any, leaving oFTree empty. Must
+  be called with oFTree's tree lock held exclusively.
+*/
+static void FT_clear(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    if(oFTree->oNRoot) {
+        Node_T oNRoot = oFTree->oNRoot;
+
+        FT_storeRoot(oFTree, NULL);
+        oFTree->ulCount -= Node_free(oNRoot, oFTree->oITable);
+    }
+
+    FT_storeFilter(oFTree, NULL);
+
+    /* blobs still in snapshots or awaiting reclamation keep the
+       store until they are released */
+    Cas_close(oFTree->oCStore);
+    oFTree->oCStore = NULL;
+    Lz_close(oFTree->oLCompressor);
+    oFTree->oLCompressor = NULL;
+    /* likewise, spilled contents keep the spill file */
+    if(oFTree->psBudget != NULL) {
+        Spill_close(oFTree->psBudget->oSFile);
+        oFTree->psBudget->oSFile = NULL;
+        __atomic_store_n(&oFTree->psBudget->ulSlack, (size_t) -1,
+                         __ATOMIC_RELAXED);
+    }
+
+    if(oFTree->oWLog != NULL) {
+        (void) Wal_close(oFTree->oWLog);
+        oFTree->oWLog = NULL;
+    }
+}
+
+FT_T FT_new(void)
+{
+    FT_T oFTNew;
+
+    oFTNew = malloc(sizeof(struct ft));
+    if(oFTNew == NULL)
+        return NULL;
+
+    oFTNew->oEReclaim = NULL;
+#ifndef FT_NO_LOCKING
+    oFTNew->oEReclaim = Epoch_new();
+    if(oFTNew->oEReclaim == NULL) {
+        free(oFTNew);
+        return NULL;
+    }
+#endif
+    oFTNew->oITable = Node_newIDTable(oFTNew->oEReclaim);
+    if(oFTNew->oITable == NULL) {
+        Epoch_free(oFTNew->oEReclaim);
+        free(oFTNew);
+        return NULL;
+    }
+    oFTNew->psTxn = malloc(sizeof(struct txn));
+    if(oFTNew->psTxn == NULL) {
+        Node_freeIDTable(oFTNew->oITable);
+        Epoch_free(oFTNew->oEReclaim);
+        free(oFTNew);
+        return NULL;
+    }
+    oFTNew->psTxn->oDUndo = NULL;
+#ifndef FT_NO_LOCKING
+    if(pthread_rwlock_init(&oFTNew->sTreeLock, NULL) != 0) {
+        free(oFTNew->psTxn);
+        Node_freeIDTable(oFTNew->oITable);
+        Epoch_free(oFTNew->oEReclaim);
+        free(oFTNew);
+        return NULL;
+    }
+    if(pthread_mutex_init(&oFTNew->sRootLock, NULL) != 0) {
+        (void) pthread_rwlock_destroy(&oFTNew->sTreeLock);
+        free(oFTNew->psTxn);
+        Node_freeIDTable(oFTNew->oITable);
+        Epoch_free(oFTNew->oEReclaim);
+        free(oFTNew);
+        return NULL;
+    }
+#endif
+    oFTNew->bIsInitialized = TRUE;
+    oFTNew->oNRoot = NULL;
+    oFTNew->ulCount = 0;
+    oFTNew->oBFilter = NULL;
+    oFTNew->oWLog = NULL;
+    oFTNew->oIImage = NULL;
+    oFTNew->pfFreeContents = NULL;
+    oFTNew->oCStore = NULL;
+    oFTNew->oLCompressor = NULL;
+    oFTNew->psBudget = NULL;
+
+    assert(CheckerFT_isValid(oFTNew->bIsInitialized, oFTNew->oNRoot,
+                             oFTNew->ulCount));
+    return oFTNew;
+}
+
+void FT_free(FT_T oFTree)
+{
+    if(oFTree == NULL)
+        return;
+
+    assert(CheckerFT_isValid(oFTree->bIsInitialized, oFTree->oNRoot,
+                             oFTree->ulCount));
+    assert(oFTree->psTxn->oDUndo == NULL);
+
+    FT_clear(oFTree);
+    Image_close(oFTree->oIImage);
+    free(oFTree->psBudget);
+    free(oFTree->psTxn);
+    Node_freeIDTable(oFTree->oITable);
+    Epoch_free(oFTree->oEReclaim);
+#ifndef FT_NO_LOCKING
+    (void) pthread_mutex_destroy(&oFTree->sRootLock);
+    (void) pthread_rwlock_destroy(&oFTree->sTreeLock);
+#endif
+    free(oFTree);
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions operate relative to an open directory
+  handle, so repeated operations beneath one directory only traverse
+  from that directory rather than from the root.
+*/
+
+/*
+  Sets *poNResult to oDDir's directory node, found through its FT's
+  node ID table without any traversal. Returns SUCCESS if the
+  directory is still in the FT. Otherwise, sets *poNResult to NULL and
+  returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * NO_SUCH_PATH if oDDir's directory has been removed from the FT
+*/
+static int FT_resolveDir(FT_Dir_T oDDir, Node_T *poNResult) {
+    assert(oDDir != NULL);
+    assert(poNResult != NULL);
+
+    if(!FT_isInitialized(oDDir->oFTree)) {
+        *poNResult = NULL;
+        return INITIALIZATION_ERROR;
+    }
+
+    *poNResult = Node_fromID(oDDir->oFTree->oITable, oDDir->ulDirID);
+    if(*poNResult == NULL)
+        return NO_SUCH_PATH;
+
+    return SUCCESS;
+}
+
+/*
+  Resolves pcName relative to oDDir, setting *poNDir to oDDir's
+  directory node and *poPResult to the absolute path of pcName
+  beneath it. Returns SUCCESS if pcName is well-formatted. Otherwise,
+  sets *poNDir and *poPResult to NULL and returns with status:
+  * any status returned by FT_resolveDir
+  * BAD_PATH if pcName does not represent a well-formatted path
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_pathAt(FT_Dir_T oDDir, const char *pcName,
+                     Node_T *poNDir, Path_T *poPResult) {
+    int iStatus;
+    Path_T oPDirPath;
+    char *pcPath;
+
+    assert(oDDir != NULL);
+    assert(pcName != NULL);
+    assert(poNDir != NULL);
+    assert(poPResult != NULL);
+
+    *poPResult = NULL;
+
+    iStatus = FT_resolveDir(oDDir, poNDir);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    /* an empty name would otherwise name the directory itself */
+    if(*pcName == '\0') {
+        *poNDir = NULL;
+        return BAD_PATH;
+    }
+
+    /* join the directory's path and pcName into an absolute path */
+    oPDirPath = Node_getPath(*poNDir);
+    pcPath = malloc(Path_getStrLength(oPDirPath) + strlen(pcName) + 2);
+    if(pcPath == NULL) {
+        *poNDir = NULL;
+        return MEMORY_ERROR;
+    }
+    strcpy(pcPath, Path_getPathname(oPDirPath));
+    strcat(pcPath, "/");
+    strcat(pcPath, pcName);
+
+    iStatus = Path_new(pcPath, poPResult);
+    free(pcPath);
+    if(iStatus != SUCCESS)
+        *poNDir = NULL;
+    return iStatus;
+}
+
+/*
+  Resolves pcName relative to oDDir, setting *poPResult to the
+  absolute path of pcName beneath oDDir's directory and *poNFurthest
+  to the furthest node reached towards it from that directory.
+  Returns SUCCESS if able to traverse. Otherwise, sets *poPResult and
+  *poNFurthest to NULL and returns with status:
+  * any status returned by FT_pathAt
+  * NOT_A_DIRECTORY if a proper prefix of pcName exists as a file
+*/
+static int FT_traverseAt(FT_Dir_T oDDir, const char *pcName,
+                         Path_T *poPResult, Node_T *poNFurthest) {
+    int iStatus;
+    Node_T oNDir = NULL;
+
+    assert(oDDir != NULL);
+    assert(pcName != NULL);
+    assert(poPResult != NULL);
+    assert(poNFurthest != NULL);
+
+    *poNFurthest = NULL;
+
+    iStatus = FT_pathAt(oDDir, pcName, &oNDir, poPResult);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    iStatus = FT_traverseFrom(oNDir, *poPResult, poNFurthest);
+    if(iStatus != SUCCESS) {
+        Path_free(*poPResult);
+        *poPResult = NULL;
+        *poNFurthest = NULL;
+    }
+    return iStatus;
+}
+
+/* FT_openDirIn, inside a read-side critical section on oFTree. */
+static int FT_openDirUnlocked(FT_T oFTree, const char *pcPath,
+                              FT_Dir_T *poDResult)
+{
+    int iStatus;
+    Node_T oNFound = NULL;
+    FT_Dir_T oDNew;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+    assert(poDResult != NULL);
+
+    *poDResult = NULL;
+
+    iStatus = FT_findNode(oFTree, pcPath, &oNFound);
+    if(iStatus != IS_DIRECTORY) {
+        if(iStatus == IS_FILE)
+            return NOT_A_DIRECTORY;
+        return iStatus;
+    }
+
+    oDNew = malloc(sizeof(struct ftDir));
+    if(oDNew == NULL)
+        return MEMORY_ERROR;
+    oDNew->oFTree = oFTree;
+    oDNew->ulDirID = Node_getID(oNFound);
+
+    *poDResult = oDNew;
+    return SUCCESS;
+}
+
+int FT_openDirIn(FT_T oFTree, const char *pcPath, FT_Dir_T *poDResult)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_openDirUnlocked(oFTree, pcPath, poDResult);
+    FT_exitReader(oFTree, ulToken);
+    return iStatus;
+}
+
+void FT_closeDir(FT_Dir_T oDDir)
+{
+    free(oDDir);
+}
+
+/*
+  Returns TRUE if oNNode or one of its ancestors is at depth ulDepth
+  and has identifier ulID, or FALSE if not (or if oNNode is NULL).
+*/
+static boolean FT_hasAncestor(Node_T oNNode, size_t ulDepth,
+                              size_t ulID) {
+    size_t ulNodeDepth;
+
+    if(oNNode == NULL)
+        return FALSE;
+
+    ulNodeDepth = Path_getDepth(Node_getPath(oNNode));
+    if(ulNodeDepth < ulDepth)
+        return FALSE;
+    for(; ulNodeDepth > ulDepth; ulNodeDepth--)
+        oNNode = Node_getParent(oNNode);
+    return (boolean) (Node_getID(oNNode) == ulID);
+}
+
+/* Returns whether oDDir's directory is still in its FT. */
+static boolean FT_isDirOpen(FT_Dir_T oDDir) {
+    Node_T oNDir = NULL;
+    size_t ulToken;
+    int iStatus;
+
+    assert(oDDir != NULL);
+
+    ulToken = FT_enterReader(oDDir->oFTree);
+    iStatus = FT_resolveDir(oDDir, &oNDir);
+    FT_exitReader(oDDir->oFTree, ulToken);
+    return (boolean) (iStatus == SUCCESS);
+}
+
+/*
+  FT_insertFileAt, with oDDir's FT's tree lock held shared. A writer
+  must not wait for a lock inside a read-side critical section (see
+  epoch.h), so the handle only yields the file's absolute path inside
+  one; the insertion then locks its way down from the root like any
+  other, and checks that it reached the handle's directory.
+*/
+static int FT_insertFileAtUnlocked(FT_Dir_T oDDir, const char *pcName,
+                                   void *pvContents, size_t ulLength)
+{
+    int iStatus;
+    FT_T oFTree;
+    Path_T oPPath = NULL;
+    Node_T oNDir = NULL;
+    Node_T oNCurr = NULL;
+    Node_T oNLocked = NULL;
+    struct adopted sAdopted;
+    size_t ulDirDepth = 0;
+    size_t ulToken;
+
+    assert(oDDir != NULL);
+    assert(pcName != NULL);
+
+    oFTree = oDDir->oFTree;
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_pathAt(oDDir, pcName, &oNDir, &oPPath);
+    if(iStatus == SUCCESS)
+        ulDirDepth = Path_getDepth(Node_getPath(oNDir));
+    FT_exitReader(oFTree, ulToken);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    iStatus = FT_lockPath(oFTree, oPPath, &oNCurr, &oNLocked);
+    if(iStatus != SUCCESS) {
+        Path_free(oPPath);
+        /* the path may no longer lead to the directory at all */
+        if(!FT_isDirOpen(oDDir))
+            return NO_SUCH_PATH;
+        return iStatus;
+    }
+
+    if(!FT_hasAncestor(oNCurr, ulDirDepth, oDDir->ulDirID))
+        iStatus = NO_SUCH_PATH;
+    else {
+        iStatus = FT_adoptContents(oFTree, pvContents, ulLength,
+                                   oFTree->pfFreeContents, FALSE,
+                                   &sAdopted);
+        if(iStatus == SUCCESS) {
+            iStatus = FT_buildPath(oFTree, oPPath, oNCurr, TRUE,
+                                   sAdopted.pvContents, ulLength,
+                                   sAdopted.oOOwner, NULL);
+            FT_settleContents(&sAdopted,
+                              (boolean) (iStatus == SUCCESS));
+        }
+    }
+    FT_unlockDir(oFTree, oNLocked);
+    Path_free(oPPath);
+
+    return iStatus;
+}
+
+int FT_insertFileAt(FT_Dir_T oDDir, const char *pcName,
+                    void *pvContents, size_t ulLength)
+{
+    int iStatus;
+
+    assert(oDDir != NULL);
+    assert(FT_isValidIfIdle(oDDir->oFTree));
+
+    FT_lockWriters(oDDir->oFTree);
+    iStatus = FT_insertFileAtUnlocked(oDDir, pcName, pvContents,
+                                      ulLength);
+    FT_unlockWriters(oDDir->oFTree);
+    FT_keepBudget(oDDir->oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oDDir->oFTree));
+    return iStatus;
+}
+
+/* FT_getFileContentsAt, inside a read-side critical section on oDDir's FT. */
+static void *FT_getFileContentsAtUnlocked(FT_Dir_T oDDir, const char *pcName)
+{
+    int iStatus;
+    Path_T oPPath = NULL;
+    Node_T oNFound = NULL;
+    void *pvContents = NULL;
+
+    assert(oDDir != NULL);
+    assert(pcName != NULL);
+
+    iStatus = FT_traverseAt(oDDir, pcName, &oPPath, &oNFound);
+    if(iStatus != SUCCESS)
+        return NULL;
+
+    if(!Path_comparePath(Node_getPath(oNFound), oPPath) &&
+       Node_isFile(oNFound))
+        pvContents = FT_readContents(oDDir->oFTree, oNFound);
+
+    Path_free(oPPath);
+    return pvContents;
+}
+
+void *FT_getFileContentsAt(FT_Dir_T oDDir, const char *pcName)
+{
+    void *pvResult;
+    size_t ulToken;
+
+    assert(oDDir != NULL);
+
+    ulToken = FT_enterReader(oDDir->oFTree);
+    pvResult = FT_getFileContentsAtUnlocked(oDDir, pcName);
+    FT_exitReader(oDDir->oFTree, ulToken);
+    FT_keepBudget(oDDir->oFTree, FALSE);
+    return pvResult;
+}
+
+/* FT_statAt, inside a read-side critical section on oDDir's FT. */
+static int FT_statAtUnlocked(FT_Dir_T oDDir, const char *pcName,
+                             boolean *pbIsFile, size_t *pulSize)
+{
+    int iStatus;
+    Path_T oPPath = NULL;
+    Node_T oNFound = NULL;
+
+    assert(oDDir != NULL);
+    assert(pcName != NULL);
+    assert(pbIsFile != NULL);
+    assert(pulSize != NULL);
+
+    iStatus = FT_traverseAt(oDDir, pcName, &oPPath, &oNFound);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(Path_comparePath(Node_getPath(oNFound), oPPath)) {
+        Path_free(oPPath);
+        return NO_SUCH_PATH;
+    }
+    Path_free(oPPath);
+
+    if(Node_isFile(oNFound)) {
+        *pbIsFile = TRUE;
+        *pulSize = Node_getLength(oNFound);
+    }
+    else
+        *pbIsFile = FALSE;
+    return SUCCESS;
+}
+
+int FT_statAt(FT_Dir_T oDDir, const char *pcName,
+              boolean *pbIsFile, size_t *pulSize)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oDDir != NULL);
+
+    ulToken = FT_enterReader(oDDir->oFTree);
+    iStatus = FT_statAtUnlocked(oDDir, pcName, pbIsFile, pulSize);
+    FT_exitReader(oDDir->oFTree, ulToken);
+    return iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions access nodes by identifier, validating the
+  identifier through the node ID table in constant time rather than
+  traversing from the root.
+*/
+
+/* FT_lookupIdIn, inside a read-side critical section on oFTree. */
+static int FT_lookupIdUnlocked(FT_T oFTree, const char *pcPath, size_t *pulID)
+{
+    int iStatus;
+    Node_T oNFound = NULL;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+    assert(pulID != NULL);
+
+    iStatus = FT_findNode(oFTree, pcPath, &oNFound);
+    if(iStatus != IS_FILE && iStatus != IS_DIRECTORY)
+        return iStatus;
+
+    *pulID = Node_getID(oNFound);
+    return SUCCESS;
+}
+
+int FT_lookupIdIn(FT_T oFTree, const char *pcPath, size_t *pulID)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_lookupIdUnlocked(oFTree, pcPath, pulID);
+    FT_exitReader(oFTree, ulToken);
+    return iStatus;
+}
+
+/* FT_getContentsByIdIn, inside a read-side critical section on oFTree. */
+static void *FT_getContentsByIdUnlocked(FT_T oFTree, size_t ulID)
+{
+    Node_T oNFound;
+
+    assert(oFTree != NULL);
+
+    if(!FT_isInitialized(oFTree))
+        return NULL;
+
+    oNFound = Node_fromID(oFTree->oITable, ulID);
+    if(oNFound == NULL || !Node_isFile(oNFound))
+        return NULL;
+
+    return FT_readContents(oFTree, oNFound);
+}
+
+void *FT_getContentsByIdIn(FT_T oFTree, size_t ulID)
+{
+    void *pvResult;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    pvResult = FT_getContentsByIdUnlocked(oFTree, ulID);
+    FT_exitReader(oFTree, ulToken);
+    FT_keepBudget(oFTree, FALSE);
+    return pvResult;
+}
+
+/* FT_statByIdIn, inside a read-side critical section on oFTree. */
+static int FT_statByIdUnlocked(FT_T oFTree, size_t ulID, boolean *pbIsFile,
+                               size_t *pulSize)
+{
+    Node_T oNFound;
+
+    assert(oFTree != NULL);
+    assert(pbIsFile != NULL);
+    assert(pulSize != NULL);
+
+    if(!FT_isInitialized(oFTree))
+        return INITIALIZATION_ERROR;
+
+    oNFound = Node_fromID(oFTree->oITable, ulID);
+    if(oNFound == NULL)
+        return NO_SUCH_PATH;
+
+    if(Node_isFile(oNFound)) {
+        *pbIsFile = TRUE;
+        *pulSize = Node_getLength(oNFound);
+    }
+    else
+        *pbIsFile = FALSE;
+    return SUCCESS;
+}
+
+int FT_statByIdIn(FT_T oFTree, size_t ulID, boolean *pbIsFile,
+                  size_t *pulSize)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_statByIdUnlocked(oFTree, ulID, pbIsFile, pulSize);
+    FT_exitReader(oFTree, ulToken);
+    return iStatus;
+}
+
+/*
+  FT_replaceContentsByIdIn, with oFTree's tree lock held shared. As in
+  FT_insertFileAtUnlocked, the identifier only yields the file's path
+  inside a read-side critical section, and the replacement locks its
+  way down to the file and checks that it is still the same one.
+*/
+static void *FT_replaceContentsByIdUnlocked(FT_T oFTree, size_t ulID,
+                                            void *pvNewContents,
+                                            size_t ulNewLength)
+{
+    Node_T oNFound;
+    Path_T oPPath = NULL;
+    struct adopted sAdopted;
+    int iStatus;
+    void *pvOldContents = NULL;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    if(!oFTree->bIsInitialized)
+        return NULL;
+
+    ulToken = FT_enterReader(oFTree);
+    oNFound = Node_fromID(oFTree->oITable, ulID);
+    if(oNFound != NULL && Node_isFile(oNFound))
+        (void) Path_dup(Node_getPath(oNFound), &oPPath);
+    FT_exitReader(oFTree, ulToken);
+    if(oPPath == NULL)
+        return NULL;
+
+    iStatus = FT_adoptContents(oFTree, pvNewContents, ulNewLength,
+                               oFTree->pfFreeContents, FALSE, &sAdopted);
+    if(iStatus == SUCCESS) {
+        iStatus = FT_replaceLocked(oFTree, oPPath, ulID,
+                                   sAdopted.pvContents, ulNewLength,
+                                   sAdopted.oOOwner, &pvOldContents);
+        FT_settleContents(&sAdopted, (boolean) (iStatus == SUCCESS));
+    }
+    Path_free(oPPath);
+
+    return pvOldContents;
+}
+
+void *FT_replaceContentsByIdIn(FT_T oFTree, size_t ulID,
+                               void *pvNewContents, size_t ulNewLength)
+{
+    void *pvResult;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockWriters(oFTree);
+    pvResult = FT_replaceContentsByIdUnlocked(oFTree, ulID,
+                                              pvNewContents,
+                                              ulNewLength);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return pvResult;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions resolve a batch of paths in one merged walk:
+  the paths are visited in sorted order, so consecutive paths tend to
+  share a prefix, and each path descends only from the deepest node
+  it shares with the path before it.
+*/
+
+/*
+  Compares the strings that pcpFirst and pcpSecond point to, for
+  sorting a batch of paths.
+*/
+static int FT_comparePathSlots(const char **pcpFirst,
+                               const char **pcpSecond) {
+    assert(pcpFirst != NULL);
+    assert(pcpSecond != NULL);
+
+    return strcmp(*pcpFirst, *pcpSecond);
+}
+
+/*
+  Traverses the FT to find a node with absolute path oPPath, given
+  that oDAncestors holds the nodes along oPPrev, the path previously
+  resolved in the batch (or NULL if there is none): index d holds the
+  node at depth d+1, for as many levels as oPPrev could be resolved.
+  Updates oDAncestors to hold the nodes along oPPath in the same way.
+  Returns the same statuses as FT_findNode, setting *poNResult to the
+  node if found and to NULL otherwise.
+*/
+static int FT_findBatched(FT_T oFTree, Path_T oPPath, Path_T oPPrev,
+                          DynArray_T oDAncestors, Node_T *poNResult) {
+    int iStatus;
+    Path_T oPPrefix = NULL;
+    Node_T oNRoot;
+    Node_T oNCurr;
+    Node_T oNChild = NULL;
+    size_t ulDepth, ulShared, i;
+
+    assert(oPPath != NULL);
+    assert(oDAncestors != NULL);
+    assert(poNResult != NULL);
+
+    *poNResult = NULL;
+    oNRoot = FT_loadRoot(oFTree);
+    if(oNRoot == NULL)
+        return NO_SUCH_PATH;
+
+    /* discard the previous path's nodes below the shared prefix */
+    ulShared = 0;
+    if(oPPrev != NULL)
+        ulShared = Path_getSharedPrefixDepth(oPPrev, oPPath);
+    while(DynArray_getLength(oDAncestors) > ulShared)
+        (void) DynArray_removeAt(oDAncestors,
+                                 DynArray_getLength(oDAncestors) - 1);
+
+    if(DynArray_getLength(oDAncestors) == 0) {
+        if(strcmp(Path_getPathname(Node_getPath(oNRoot)),
+                  Path_getComponent(oPPath, 0)))
+            return CONFLICTING_PATH;
+        if(!DynArray_add(oDAncestors, oNRoot))
+            return MEMORY_ERROR;
+    }
+
+    /* descend from the deepest shared node */
+    oNCurr = DynArray_get(oDAncestors,
+                          DynArray_getLength(oDAncestors) - 1);
+    ulDepth = Path_getDepth(oPPath);
+    for(i = DynArray_getLength(oDAncestors) + 1; i <= ulDepth; i++) {
+        if(Node_isFile(oNCurr))
+            break;
+        iStatus = Path_prefix(oPPath, i, &oPPrefix);
+        if(iStatus != SUCCESS)
+            return iStatus;
+        if(!Node_findChild(oNCurr, oPPrefix, &oNChild)) {
+            Path_free(oPPrefix);
+            break;
+        }
+        Path_free(oPPrefix);
+        if(!DynArray_add(oDAncestors, oNChild))
+            return MEMORY_ERROR;
+        oNCurr = oNChild;
+    }
+
+    if(DynArray_getLength(oDAncestors) == ulDepth) {
+        *poNResult = oNCurr;
+        if(Node_isFile(oNCurr))
+            return IS_FILE;
+        return IS_DIRECTORY;
+    }
+    if(Node_isFile(oNCurr))
+        return NOT_A_DIRECTORY;
+    return NO_SUCH_PATH;
+}
+
+/*
+  Resolves each of the ulPaths absolute paths in ppcPaths, visiting
+  them in sorted order unless bSorted indicates that they already are,
+  and calls (*pfVisit)(i, iStatus, oNFound, pvExtra) for the ith path,
+  where iStatus and oNFound are as FT_findNode would return and set.
+  Returns SUCCESS if every path was visited. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_resolveMany(FT_T oFTree, const char **ppcPaths,
+                          size_t ulPaths,
+                          boolean bSorted,
+                          void (*pfVisit)(size_t ulIndex, int iStatus,
+                                          Node_T oNFound, void *pvExtra),
+                          void *pvExtra) {
+    int iStatus;
+    DynArray_T oDOrder = NULL;
+    DynArray_T oDAncestors;
+    Path_T oPPrev = NULL;
+    size_t i;
+
+    assert(ppcPaths != NULL);
+    assert(pfVisit != NULL);
+
+    if(!FT_isInitialized(oFTree))
+        return INITIALIZATION_ERROR;
+
+    /* order the batch by pointers to its path slots */
+    if(!bSorted) {
+        oDOrder = DynArray_new(ulPaths);
+        if(oDOrder == NULL)
+            return MEMORY_ERROR;
+        for(i = 0; i < ulPaths; i++)
+            (void) DynArray_set(oDOrder, i, &ppcPaths[i]);
+        DynArray_sort(oDOrder,
+            (int (*)(const void *, const void *)) FT_comparePathSlots);
+    }
+
+    oDAncestors = DynArray_new(0);
+    if(oDAncestors == NULL) {
+        if(oDOrder != NULL)
+            DynArray_free(oDOrder);
+        return MEMORY_ERROR;
+    }
+
+    for(i = 0; i < ulPaths; i++) {
+        size_t ulIndex = i;
+        Path_T oPPath = NULL;
+        Node_T oNFound = NULL;
+
+        if(oDOrder != NULL)
+            ulIndex = (size_t) ((const char **) DynArray_get(oDOrder, i)
+                                - ppcPaths);
+        assert(ppcPaths[ulIndex] != NULL);
+
+        iStatus = Path_new(ppcPaths[ulIndex], &oPPath);
+        if(iStatus == SUCCESS) {
+            iStatus = FT_findBatched(oFTree, oPPath, oPPrev, oDAncestors,
+                                     &oNFound);
+            Path_free(oPPrev);
+            oPPrev = oPPath;
+        }
+        (*pfVisit)(ulIndex, iStatus, oNFound, pvExtra);
+    }
+
+    Path_free(oPPrev);
+    DynArray_free(oDAncestors);
+    if(oDOrder != NULL)
+        DynArray_free(oDOrder);
+    return SUCCESS;
+}
+
+/* The output arrays of FT_getFileContentsMany */
+struct contentsOut {
+    /* the FT that the files are in */
+    FT_T oFTree;
+    /* the contents of each file */
+    void **ppvContents;
+    /* the status of each lookup */
+    int *piStatuses;
+};
+
+/*
+  Stores the result of resolving the ulIndex'th path of a
+  FT_getFileContentsMany batch into the arrays in psOut.
+*/
+static void FT_visitContents(size_t ulIndex, int iStatus,
+                             Node_T oNFound, struct contentsOut *psOut) {
+    assert(psOut != NULL);
+
+    psOut->ppvContents[ulIndex] = NULL;
+    if(iStatus == IS_FILE) {
+        psOut->ppvContents[ulIndex] = FT_readContents(psOut->oFTree,
+                                                      oNFound);
+        psOut->piStatuses[ulIndex] = SUCCESS;
+    }
+    else if(iStatus == IS_DIRECTORY)
+        psOut->piStatuses[ulIndex] = NOT_A_FILE;
+    else
+        psOut->piStatuses[ulIndex] = iStatus;
+}
+
+/* FT_getFileContentsManyIn, inside a read-side critical section on oFTree. */
+static int FT_getFileContentsManyUnlocked(FT_T oFTree, const char **ppcPaths,
+                                          size_t ulPaths, boolean bSorted,
+                                          void **ppvContents, int *piStatuses)
+{
+    struct contentsOut sOut;
+
+    assert(oFTree != NULL);
+    assert(ppcPaths != NULL);
+    assert(ppvContents != NULL);
+    assert(piStatuses != NULL);
+
+    sOut.oFTree = oFTree;
+    sOut.ppvContents = ppvContents;
+    sOut.piStatuses = piStatuses;
+    return FT_resolveMany(oFTree, ppcPaths, ulPaths, bSorted,
+        (void (*)(size_t, int, Node_T, void *)) FT_visitContents,
+        &sOut);
+}
+
+int FT_getFileContentsManyIn(FT_T oFTree, const char **ppcPaths,
+                             size_t ulPaths, boolean bSorted,
+                             void **ppvContents, int *piStatuses)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_getFileContentsManyUnlocked(oFTree, ppcPaths, ulPaths,
+                                             bSorted, ppvContents,
+                                             piStatuses);
+    FT_exitReader(oFTree, ulToken);
+    FT_keepBudget(oFTree, FALSE);
+    return iStatus;
+}
+
+/* The output arrays of FT_statMany */
+struct statOut {
+    /* whether each node is a file */
+    boolean *pbIsFile;
+    /* the length of each file's contents */
+    size_t *pulSizes;
+    /* the status of each lookup */
+    int *piStatuses;
+};
+
+/*
+  Stores the result of resolving the ulIndex'th path of a FT_statMany
+  batch into the arrays in psOut.
+*/
+static void FT_visitStat(size_t ulIndex, int iStatus,
+                         Node_T oNFound, struct statOut *psOut) {
+    assert(psOut != NULL);
+
+    if(iStatus == IS_FILE) {
+        psOut->pbIsFile[ulIndex] = TRUE;
+        psOut->pulSizes[ulIndex] = Node_getLength(oNFound);
+        psOut->piStatuses[ulIndex] = SUCCESS;
+    }
+    else if(iStatus == IS_DIRECTORY) {
+        psOut->pbIsFile[ulIndex] = FALSE;
+        psOut->piStatuses[ulIndex] = SUCCESS;
+    }
+    else
+        psOut->piStatuses[ulIndex] = iStatus;
+}
+
+/* FT_statManyIn, inside a read-side critical section on oFTree. */
+static int FT_statManyUnlocked(FT_T oFTree, const char **ppcPaths,
+                               size_t ulPaths, boolean bSorted,
+                               boolean *pbIsFile, size_t *pulSizes,
+                               int *piStatuses)
+{
+    struct statOut sOut;
+
+    assert(oFTree != NULL);
+    assert(ppcPaths != NULL);
+    assert(pbIsFile != NULL);
+    assert(pulSizes != NULL);
+    assert(piStatuses != NULL);
+
+    sOut.pbIsFile = pbIsFile;
+    sOut.pulSizes = pulSizes;
+    sOut.piStatuses = piStatuses;
+    return FT_resolveMany(oFTree, ppcPaths, ulPaths, bSorted,
+        (void (*)(size_t, int, Node_T, void *)) FT_visitStat, &sOut);
+}
+
+int FT_statManyIn(FT_T oFTree, const char **ppcPaths, size_t ulPaths,
+                  boolean bSorted, boolean *pbIsFile, size_t *pulSizes,
+                  int *piStatuses)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_statManyUnlocked(oFTree, ppcPaths, ulPaths, bSorted,
+                                  pbIsFile, pulSizes, piStatuses);
+    FT_exitReader(oFTree, ulToken);
+    return iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions load a stream of records into the FT. While
+  the records arrive in sorted order, each one descends only from the
+  deepest directory it shares with the record before it, and each new
+  node is appended to its parent's children without a search; a
+  record out of order falls back to a traversal from the root.
+*/
+
+/*
+  Closes the directories of oFTree on the bulk-load stack oDOpen
+  deeper than ulDepth. If bFit is TRUE, the directories will receive
+  no more children from the load, so fits each one's children array
+  to its final size.
+*/
+static void FT_closeOpenDirs(FT_T oFTree, DynArray_T oDOpen,
+                             size_t ulDepth, boolean bFit) {
+    assert(oFTree != NULL);
+    assert(oDOpen != NULL);
+
+    while(DynArray_getLength(oDOpen) > ulDepth) {
+        Node_T oNClosed = DynArray_removeAt(oDOpen,
+                              DynArray_getLength(oDOpen) - 1);
+        if(bFit && !Node_isFile(oNClosed) && !Node_isShared(oNClosed))
+            (void) Node_fitChildren(oNClosed, oFTree->oITable);
+    }
+}
+
+/*
+  Fills the empty bulk-load stack oDOpen with the nodes from the root
+  to the closest ancestor of oPPath in the FT, by traversal. The
+  load will add children to those nodes, so the traversal takes them
+  over from any snapshot as writers do, under locks that no one else
+  contends for while the load holds the tree lock exclusively.
+  Returns SUCCESS, or any error status FT_lockPath returns.
+*/
+static int FT_seedOpenDirs(FT_T oFTree, Path_T oPPath, DynArray_T oDOpen) {
+    int iStatus;
+    Node_T oNFurthest = NULL;
+    Node_T oNLocked = NULL;
+    size_t ulDepth, i;
+
+    assert(oPPath != NULL);
+    assert(oDOpen != NULL);
+    assert(DynArray_getLength(oDOpen) == 0);
+
+    iStatus = FT_lockPath(oFTree, oPPath, &oNFurthest, &oNLocked);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    FT_unlockDir(oFTree, oNLocked);
+    if(oNFurthest == NULL)
+        return SUCCESS;
+
+    ulDepth = Path_getDepth(Node_getPath(oNFurthest));
+    for(i = 0; i < ulDepth; i++)
+        if(!DynArray_add(oDOpen, NULL)) {
+            while(DynArray_getLength(oDOpen) != 0)
+                (void) DynArray_removeAt(oDOpen,
+                                         DynArray_getLength(oDOpen) - 1);
+            return MEMORY_ERROR;
+        }
+    for(i = ulDepth; i > 0; i--) {
+        (void) DynArray_set(oDOpen, i - 1, oNFurthest);
+        oNFurthest = Node_getParent(oNFurthest);
+    }
+    return SUCCESS;
+}
+
+/*
+  Inserts the record with absolute path oPPath, type bIsFile and (for
+  a file) contents pvContents of size ulLength bytes, given the path
+  oPPrev of the previous record (or NULL if there is none) and the
+  bulk-load stack oDOpen holding the nodes along oPPrev. Leaves the
+  nodes along oPPath on oDOpen. Sets *pbInOrder to FALSE if oPPath
+  does not sort after oPPrev. Returns the same statuses as
+  FT_insertDir or FT_insertFile (other than INITIALIZATION_ERROR).
+*/
+static int FT_bulkInsert(FT_T oFTree, Path_T oPPath, Path_T oPPrev,
+                         DynArray_T oDOpen, boolean *pbInOrder,
+                         boolean bIsFile, void *pvContents,
+                         size_t ulLength) {
+    Node_T oNCurr = NULL;
+    struct adopted sAdopted;
+    size_t ulShared = 0;
+    size_t ulOpen;
+    int iStatus;
+
+    assert(oPPath != NULL);
+    assert(oDOpen != NULL);
+    assert(pbInOrder != NULL);
+
+    /* keep open only the directories shared with the previous record,
+       and none at all if the records are out of order */
+    if(oPPrev != NULL) {
+        if(Path_comparePath(oPPrev, oPPath) < 0)
+            ulShared = Path_getSharedPrefixDepth(oPPrev, oPPath);
+        else
+            *pbInOrder = FALSE;
+    }
+    FT_closeOpenDirs(oFTree, oDOpen, ulShared, *pbInOrder);
+
+    ulOpen = DynArray_getLength(oDOpen);
+    if(ulOpen != 0) {
+        size_t ulNumChildren;
+
+        oNCurr = DynArray_get(oDOpen, ulOpen - 1);
+        if(Node_isFile(oNCurr))
+            return NOT_A_DIRECTORY;
+
+        /* the next level is known to be absent only if it sorts after
+           all of the open directory's children. they share all
+           components but their last, so comparing those suffices */
+        ulNumChildren = Node_getNumChildren(oNCurr);
+        if(ulNumChildren != 0) {
+            Node_T oNLast = NULL;
+
+            (void) Node_getChild(oNCurr, ulNumChildren - 1, &oNLast);
+            if(strcmp(Path_getComponent(Node_getPath(oNLast), ulOpen),
+                      Path_getComponent(oPPath, ulOpen)) >= 0)
+                FT_closeOpenDirs(oFTree, oDOpen, 0, FALSE);
+        }
+    }
+
+    if(DynArray_getLength(oDOpen) == 0) {
+        iStatus = FT_seedOpenDirs(oFTree, oPPath, oDOpen);
+        if(iStatus != SUCCESS)
+            return iStatus;
+    }
+
+    if(DynArray_getLength(oDOpen) == 0) {
+        /* the FT is empty, and a file cannot be its root */
+        if(bIsFile && Path_getDepth(oPPath) == 1)
+            return CONFLICTING_PATH;
+        oNCurr = NULL;
+    }
+    else
+        oNCurr = DynArray_get(oDOpen, DynArray_getLength(oDOpen) - 1);
+
+    iStatus = FT_adoptContents(oFTree, bIsFile ? pvContents : NULL,
+                               ulLength, oFTree->pfFreeContents, FALSE,
+                               &sAdopted);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_buildPath(oFTree, oPPath, oNCurr, bIsFile,
+                           sAdopted.pvContents, ulLength,
+                           sAdopted.oOOwner, oDOpen);
+    FT_settleContents(&sAdopted, (boolean) (iStatus == SUCCESS));
+    return iStatus;
+}
+
+/* FT_bulkLoadIn, with oFTree's tree lock held exclusively. */
+static int FT_bulkLoadUnlocked(FT_T oFTree,
+                               boolean (*pfNext)(void *pvExtra,
+                                                 const char **ppcPath,
+                                                 boolean *pbIsFile,
+                                                 void **ppvContents,
+                                                 size_t *pulLength),
+                               void *pvExtra)
+{
+    int iStatus = SUCCESS;
+    DynArray_T oDOpen;
+    Path_T oPPrev = NULL;
+    boolean bInOrder = TRUE;
+    const char *pcPath;
+    boolean bIsFile;
+    void *pvContents;
+    size_t ulLength;
+
+    assert(oFTree != NULL);
+    assert(pfNext != NULL);
+    assert(CheckerFT_isValid(oFTree->bIsInitialized, oFTree->oNRoot,
+                             oFTree->ulCount));
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    oDOpen = DynArray_new(0);
+    if(oDOpen == NULL)
+        return MEMORY_ERROR;
+
+    while(iStatus == SUCCESS) {
+        Path_T oPPath = NULL;
+
+        pvContents = NULL;
+        ulLength = 0;
+        if(!(*pfNext)(pvExtra, &pcPath, &bIsFile, &pvContents, &ulLength))
+            break;
+        assert(pcPath != NULL);
+
+        iStatus = Path_new(pcPath, &oPPath);
+        if(iStatus != SUCCESS)
+            break;
+        if(!bIsFile) {
+            pvContents = NULL;
+            ulLength = 0;
+        }
+
+        iStatus = FT_bulkInsert(oFTree, oPPath, oPPrev, oDOpen, &bInOrder,
+                                bIsFile, pvContents, ulLength);
+        Path_free(oPPrev);
+        oPPrev = oPPath;
+    }
+
+    FT_closeOpenDirs(oFTree, oDOpen, 0, bInOrder);
+    DynArray_free(oDOpen);
+    Path_free(oPPrev);
+
+    assert(CheckerFT_isValid(oFTree->bIsInitialized, oFTree->oNRoot,
+                             oFTree->ulCount));
+    return iStatus;
+}
+
+int FT_bulkLoadIn(FT_T oFTree,
+                  boolean (*pfNext)(void *pvExtra, const char **ppcPath,
+                                    boolean *pbIsFile, void **ppvContents,
+                                    size_t *pulLength),
+                  void *pvExtra)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    FT_lockTree(oFTree);
+    iStatus = FT_bulkLoadUnlocked(oFTree, pfNext, pvExtra);
+    FT_unlockWriters(oFTree);
+    FT_keepBudget(oFTree, TRUE);
+    return iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions manage the negative-lookup filter.
+*/
+
+/* FT_enableFilterIn, with oFTree's tree lock held exclusively. */
+static int FT_enableFilterUnlocked(FT_T oFTree, size_t ulExpectedPaths,
+                                   double dFalsePositiveRate,
+                                   size_t ulMaxBytes)
+{
+    Bloom_T oBNew;
+
+    assert(oFTree != NULL);
+    assert(dFalsePositiveRate > 0.0 && dFalsePositiveRate < 1.0);
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    oBNew = Bloom_new(ulExpectedPaths, dFalsePositiveRate, ulMaxBytes);
+    if(oBNew == NULL)
+        return MEMORY_ERROR;
+
+    /* fill the new filter before readers can consult it */
+    if(oFTree->oNRoot != NULL)
+        FT_filterSubtree(oBNew, oFTree->oNRoot, TRUE);
+    FT_storeFilter(oFTree, oBNew);
+
+    return SUCCESS;
+}
+
+int FT_enableFilterIn(FT_T oFTree, size_t ulExpectedPaths,
+                      double dFalsePositiveRate, size_t ulMaxBytes)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    FT_lockTree(oFTree);
+    iStatus = FT_enableFilterUnlocked(oFTree, ulExpectedPaths,
+                                      dFalsePositiveRate, ulMaxBytes);
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+/* FT_disableFilterIn, with oFTree's tree lock held exclusively. */
+static int FT_disableFilterUnlocked(FT_T oFTree)
+{
+    assert(oFTree != NULL);
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    FT_storeFilter(oFTree, NULL);
+    return SUCCESS;
+}
+
+int FT_disableFilterIn(FT_T oFTree)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    FT_lockTree(oFTree);
+    iStatus = FT_disableFilterUnlocked(oFTree);
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+/* FT_getFilterStatsIn, inside a read-side critical section on oFTree. */
+static int FT_getFilterStatsUnlocked(FT_T oFTree, size_t *pulQueries,
+                                     size_t *pulMisses,
+                                     size_t *pulFalsePositives,
+                                     size_t *pulBytes)
+{
+    Bloom_T oBFilter;
+
+    assert(oFTree != NULL);
+
+    if(!FT_isInitialized(oFTree))
+        return INITIALIZATION_ERROR;
+    oBFilter = FT_loadFilter(oFTree);
+    if(oBFilter == NULL)
+        return NO_SUCH_PATH;
+
+    Bloom_getStats(oBFilter, pulQueries, pulMisses, pulFalsePositives,
+                   pulBytes, NULL);
+    return SUCCESS;
+}
+
+int FT_getFilterStatsIn(FT_T oFTree, size_t *pulQueries,
+                        size_t *pulMisses, size_t *pulFalsePositives,
+                        size_t *pulBytes)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_getFilterStatsUnlocked(oFTree, pulQueries, pulMisses,
+                                        pulFalsePositives, pulBytes);
+    FT_exitReader(oFTree, ulToken);
+    return iStatus;
+}
+
+/* FT_enableDedupIn, with oFTree's tree lock held exclusively. */
+static int FT_enableDedupUnlocked(FT_T oFTree)
+{
+    assert(oFTree != NULL);
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    /* keep sharing through the store already enabled, if any */
+    if(oFTree->oCStore == NULL) {
+        oFTree->oCStore = Cas_new();
+        if(oFTree->oCStore == NULL)
+            return MEMORY_ERROR;
+    }
+    return SUCCESS;
+}
+
+int FT_enableDedupIn(FT_T oFTree)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    /* no writer is inside an operation that reads the store */
+    FT_lockTree(oFTree);
+    iStatus = FT_enableDedupUnlocked(oFTree);
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+int FT_disableDedupIn(FT_T oFTree)
+{
+    int iStatus = SUCCESS;
+
+    assert(oFTree != NULL);
+
+    FT_lockTree(oFTree);
+    if(!oFTree->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    else {
+        /* the blobs in files keep the store until they are released */
+        Cas_close(oFTree->oCStore);
+        oFTree->oCStore = NULL;
+    }
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+int FT_getDedupStatsIn(FT_T oFTree, size_t *pulBlobs, size_t *pulRefs,
+                       size_t *pulStoredBytes, size_t *pulBytesSaved,
+                       double *pdRatio)
+{
+    size_t ulStoredBytes;
+    size_t ulLogicalBytes;
+    int iStatus = SUCCESS;
+
+    assert(oFTree != NULL);
+
+    /* the tree lock keeps the store from being closed meanwhile */
+    FT_lockWriters(oFTree);
+    if(!oFTree->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    else if(oFTree->oCStore == NULL)
+        iStatus = NO_SUCH_PATH;
+    else
+        Cas_getStats(oFTree->oCStore, pulBlobs, pulRefs, &ulStoredBytes,
+                     &ulLogicalBytes);
+    FT_unlockWriters(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(pulStoredBytes != NULL)
+        *pulStoredBytes = ulStoredBytes;
+    if(pulBytesSaved != NULL)
+        *pulBytesSaved = ulLogicalBytes - ulStoredBytes;
+    if(pdRatio != NULL)
+        *pdRatio = ulStoredBytes == 0 ? 1.0
+            : (double) ulLogicalBytes / (double) ulStoredBytes;
+    return SUCCESS;
+}
+
+/*
+  Compresses the contents of file oNFile in oFTree, if they are its
+  own, with its compressor: contents of ulThreshold bytes or more, and
+  contents not read since the last FT_compressIn. Compressed contents
+  not read since then lose their decompressed copy instead. Returns
+  TRUE if contents were compressed, and FALSE if they were left as
+  they were, or memory could not be allocated to compress them. Must
+  be called with oFTree's tree lock held exclusively, on a file that
+  no snapshot shares.
+*/
+static boolean FT_compressFile(FT_T oFTree, Node_T oNFile,
+                               size_t ulThreshold) {
+    void (*pfFree)(void *pvContents);
+    void *pvContents;
+    size_t ulLength;
+    boolean bRead;
+    Lz_Block_T oLNew;
+    Node_Owner_T oOOwner;
+
+    assert(oFTree != NULL);
+    assert(oNFile != NULL);
+
+    bRead = Node_takeRead(oNFile);
+    pvContents = Node_readContents(oNFile, &ulLength, &pfFree);
+
+    /* contents the client's, chunked, deduplicated, spilled or mapped
+       are left alone */
+    if(pvContents == NULL || !Node_hasOwner(oNFile)
+       || pfFree == Rope_free || pfFree == Cas_release
+       || pfFree == Spill_free || pfFree == Map_free)
+        return FALSE;
+
+    if(pfFree == Lz_free) {
+        if(bRead || !Lz_isExpanded(pvContents))
+            return FALSE;
+        oLNew = Lz_repack(pvContents);
+    }
+    else if(bRead && ulLength < ulThreshold)
+        return FALSE;
+    else
+        oLNew = Lz_compress(oFTree->oLCompressor, pvContents, ulLength);
+    if(oLNew == NULL)
+        return FALSE;
+
+    oOOwner = Node_newOwner(oLNew, Lz_free);
+    if(oOOwner == NULL) {
+        Lz_free(oLNew);
+        return FALSE;
+    }
+    /* the contents read the same, so neither the log nor a
+       transaction has anything to record */
+    (void) FT_installContents(oFTree, oNFile, NULL, oLNew, ulLength,
+                              oOOwner);
+    return (boolean) (pfFree != Lz_free);
+}
+
+/*
+  Calls FT_compressFile on every file in the subtree rooted at oNNode
+  but those in subtrees that a snapshot shares, adding the number of
+  files compressed to *pulCompressed.
+*/
+static void FT_compressSubtree(FT_T oFTree, Node_T oNNode,
+                               size_t ulThreshold,
+                               size_t *pulCompressed) {
+    Node_T oNChild;
+    size_t c;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(oNNode != NULL);
+    assert(pulCompressed != NULL);
+
+    if(Node_isShared(oNNode))
+        return;
+    if(Node_isFile(oNNode)) {
+        *pulCompressed += FT_compressFile(oFTree, oNNode, ulThreshold);
+        return;
+    }
+    for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+        oNChild = NULL;
+        iStatus = Node_getChild(oNNode, c, &oNChild);
+        assert(iStatus == SUCCESS);
+        (void) iStatus;
+        FT_compressSubtree(oFTree, oNChild, ulThreshold, pulCompressed);
+    }
+}
+
+/* FT_compressIn, with oFTree's tree lock held exclusively. */
+static int FT_compressUnlocked(FT_T oFTree, size_t ulThreshold,
+                               size_t *pulCompressed)
+{
+    size_t ulCompressed = 0;
+
+    assert(oFTree != NULL);
+
+    /* an open transaction may yet restore contents that it would
+       have to compress again */
+    if(!oFTree->bIsInitialized || FT_ownsTxn(oFTree))
+        return INITIALIZATION_ERROR;
+
+    if(oFTree->oLCompressor == NULL) {
+        oFTree->oLCompressor = Lz_new();
+        if(oFTree->oLCompressor == NULL)
+            return MEMORY_ERROR;
+    }
+    if(oFTree->oNRoot != NULL)
+        FT_compressSubtree(oFTree, oFTree->oNRoot, ulThreshold,
+                           &ulCompressed);
+
+    if(pulCompressed != NULL)
+        *pulCompressed = ulCompressed;
+    return SUCCESS;
+}
+
+int FT_compressIn(FT_T oFTree, size_t ulThreshold, size_t *pulCompressed)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockTree(oFTree);
+    iStatus = FT_compressUnlocked(oFTree, ulThreshold, pulCompressed);
+    FT_unlockWriters(oFTree);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+int FT_getCompressionStatsIn(FT_T oFTree, size_t *pulPlainBytes,
+                             size_t *pulPackedBytes, double *pdRatio,
+                             double *pdCompressSeconds,
+                             double *pdExpandSeconds, size_t *pulHits,
+                             size_t *pulMisses)
+{
+    size_t ulPlainBytes;
+    size_t ulPackedBytes;
+    int iStatus = SUCCESS;
+
+    assert(oFTree != NULL);
+
+    /* the tree lock keeps the compressor from being closed meanwhile */
+    FT_lockWriters(oFTree);
+    if(!oFTree->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    else if(oFTree->oLCompressor == NULL)
+        iStatus = NO_SUCH_PATH;
+    else
+        Lz_getStats(oFTree->oLCompressor, &ulPlainBytes, &ulPackedBytes,
+                    pdCompressSeconds, pdExpandSeconds, pulHits,
+                    pulMisses);
+    FT_unlockWriters(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(pulPlainBytes != NULL)
+        *pulPlainBytes = ulPlainBytes;
+    if(pulPackedBytes != NULL)
+        *pulPackedBytes = ulPackedBytes;
+    if(pdRatio != NULL)
+        *pdRatio = ulPackedBytes == 0 ? 1.0
+            : (double) ulPlainBytes / (double) ulPackedBytes;
+    return SUCCESS;
+}
+
+/* FT_enableSpillIn, with oFTree's tree lock held exclusively. */
+static int FT_enableSpillUnlocked(FT_T oFTree, const char *pcSpillFile,
+                                  size_t ulBudget)
+{
+    struct budget *psNew;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcSpillFile != NULL);
+
+    /* an open transaction may yet restore contents that it would
+       have to spill again */
+    if(!oFTree->bIsInitialized || FT_ownsTxn(oFTree))
+        return INITIALIZATION_ERROR;
+
+    if(oFTree->psBudget == NULL) {
+        psNew = malloc(sizeof(struct budget));
+        if(psNew == NULL)
+            return MEMORY_ERROR;
+        psNew->oSFile = NULL;
+        psNew->ulBudget = 0;
+        /* files never read are older than any time */
+        psNew->ulClock = 1;
+        psNew->ulAdded = 0;
+        psNew->ulSlack = (size_t) -1;
+        __atomic_store_n(&oFTree->psBudget, psNew, __ATOMIC_RELEASE);
+    }
+    /* keep spilling to the file already open, if any */
+    if(oFTree->psBudget->oSFile == NULL) {
+        iStatus = Spill_open(pcSpillFile, &oFTree->psBudget->oSFile);
+        if(iStatus != SUCCESS)
+            return iStatus;
+    }
+
+    oFTree->psBudget->ulBudget = ulBudget;
+    FT_spillColdest(oFTree);
+    return SUCCESS;
+}
+
+int FT_enableSpillIn(FT_T oFTree, const char *pcSpillFile,
+                     size_t ulBudget)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(FT_isValidIfIdle(oFTree));
+
+    FT_lockTree(oFTree);
+    iStatus = FT_enableSpillUnlocked(oFTree, pcSpillFile, ulBudget);
+    FT_unlockWriters(oFTree);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+int FT_disableSpillIn(FT_T oFTree)
+{
+    int iStatus = SUCCESS;
+
+    assert(oFTree != NULL);
+
+    FT_lockTree(oFTree);
+    if(!oFTree->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    /* spilled contents keep the spill file, and are still read back */
+    else if(oFTree->psBudget != NULL)
+        __atomic_store_n(&oFTree->psBudget->ulSlack, (size_t) -1,
+                         __ATOMIC_RELAXED);
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+/*
+  Advises the spill file that the contents of the file that a
+  FT_prefetchIn batch resolved to oNFound, if iStatus is IS_FILE, are
+  about to be read, if they are spilled.
+*/
+static void FT_visitPrefetch(size_t ulIndex, int iStatus,
+                             Node_T oNFound, void *pvExtra) {
+    void (*pfFree)(void *pvContents);
+    void *pvContents;
+    size_t ulLength;
+
+    (void) ulIndex;
+    (void) pvExtra;
+
+    if(iStatus != IS_FILE)
+        return;
+    pvContents = Node_readContents(oNFound, &ulLength, &pfFree);
+    if(pfFree == Spill_free)
+        Spill_prefetch(pvContents);
+}
+
+int FT_prefetchIn(FT_T oFTree, const char **ppcPaths, size_t ulPaths,
+                  boolean bSorted)
+{
+    int iStatus;
+    size_t ulToken;
+
+    assert(oFTree != NULL);
+
+    ulToken = FT_enterReader(oFTree);
+    iStatus = FT_resolveMany(oFTree, ppcPaths, ulPaths, bSorted,
+                             FT_visitPrefetch, NULL);
+    FT_exitReader(oFTree, ulToken);
+    return iStatus;
+}
+
+int FT_getSpillStatsIn(FT_T oFTree, size_t *pulSpills, size_t *pulReloads,
+                       size_t *pulPrefetches, size_t *pulResidentBytes,
+                       size_t *pulSpillBytes)
+{
+    size_t ulResident = 0;
+    int iStatus = SUCCESS;
+
+    assert(oFTree != NULL);
+
+    /* the footprints are only counted with no writer changing them */
+    FT_lockTree(oFTree);
+    if(!oFTree->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    else if(oFTree->psBudget == NULL || oFTree->psBudget->oSFile == NULL)
+        iStatus = NO_SUCH_PATH;
+    else {
+        Spill_getStats(oFTree->psBudget->oSFile, pulSpills, pulReloads,
+                       pulPrefetches, pulSpillBytes);
+        if(pulResidentBytes != NULL && oFTree->oNRoot != NULL)
+            FT_collectCold(oFTree->oNRoot, FALSE, 0, NULL, &ulResident);
+    }
+    FT_unlockWriters(oFTree);
+
+    if(iStatus == SUCCESS && pulResidentBytes != NULL)
+        *pulResidentBytes = ulResident;
+    return iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions are used for generating the
+  string representation of the FT.
+*/
+
+/*
+  Performs a pre-order traversal of the tree rooted at n,
+  inserting each payload to DynArray_T d beginning at index i.
+  Returns the next unused index in d after the insertion(s).
+*/
+static size_t FT_preOrderTraversal(Node_T n, DynArray_T d, size_t i) {
+    size_t c;
+
+    assert(d != NULL);
+
+    if(n != NULL) {
+        (void) DynArray_set(d, i, n);
+        i++;
+        
+        /* add all files in level */
+        for(c = 0; c < Node_getNumChildren(n); c++) {
+            int iStatus;
+            Node_T oNChild = NULL;
+            iStatus = Node_getChild(n,c, &oNChild);
+            assert(iStatus == SUCCESS);
+            (void) iStatus;
+            if (Node_isFile(oNChild)) 
+                (void) DynArray_set(d, i++, oNChild);
+        }
+
+        for(c = 0; c < Node_getNumChildren(n); c++) {
+            int iStatus;
+            Node_T oNChild = NULL;
+            iStatus = Node_getChild(n,c, &oNChild);
+            assert(iStatus == SUCCESS);
+            (void) iStatus;
+            if (!Node_isFile(oNChild))
+                i = FT_preOrderTraversal(oNChild, d, i);
+        }
+    }
+    return i;
+}
+
+/*
+  Alternate version of strlen that uses pulAcc as an in-out parameter
+  to accumulate a string length, rather than returning the length of
+  oNNode's path, and also always adds one addition byte to the sum.
+*/
+static void FT_strlenAccumulate(Node_T oNNode, size_t *pulAcc) {
+   assert(pulAcc != NULL);
+
+   if(oNNode != NULL)
+      *pulAcc += (Path_getStrLength(Node_getPath(oNNode)) + 1);
+}
+
+/*
+  Alternate version of strcat that inverts the typical argument
+  order, appending oNNode's path onto pcAcc, and also always adds one
+  newline at the end of the concatenated string.
+*/
+static void FT_strcatAccumulate(Node_T oNNode, char *pcAcc) {
+   assert(pcAcc != NULL);
+
+   if(oNNode != NULL) {
+      strcat(pcAcc, Path_getPathname(Node_getPath(oNNode)));
+      strcat(pcAcc, "\n");
+   }
+}
+/*--------------------------------------------------------------------*/
+
+/*
+  FT_toStringIn, with oFTree's tree lock held exclusively, so that the
+  string reflects one state of the whole hierarchy rather than a walk
+  over a hierarchy changing beneath it.
+*/
+static char *FT_toStringUnlocked(FT_T oFTree)
+{
+    DynArray_T nodes;
+    size_t totalStrlen = 1;
+    char *result = NULL;
+
+    assert(oFTree != NULL);
+
+    if(!oFTree->bIsInitialized)
+        return NULL;
+
+    nodes = DynArray_new(oFTree->ulCount);
+    (void) FT_preOrderTraversal(oFTree->oNRoot, nodes, 0);
+
+    DynArray_map(nodes, (void (*)(void *, void*)) FT_strlenAccumulate,
+                (void*) &totalStrlen);
+
+    result = malloc(totalStrlen);
+    if(result == NULL) {
+        DynArray_free(nodes);
+        return NULL;
+    }
+    *result = '\0';
+
+    DynArray_map(nodes, (void (*)(void *, void*)) FT_strcatAccumulate,
+                (void *) result);
+
+    DynArray_free(nodes);
+
+    return result;
+}
+
+char *FT_toStringIn(FT_T oFTree)
+{
+    char *pcResult;
+
+    assert(oFTree != NULL);
+
+    FT_lockTree(oFTree);
+    pcResult = FT_toStringUnlocked(oFTree);
+    FT_unlockWriters(oFTree);
+    return pcResult;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions take and read snapshots. A snapshot holds a
+  reference to the root that the FT had when it was taken, and so
+  shares every node with the FT until a writer copies the node away
+  (see FT_ownNode). No writer changes a node that a snapshot shares,
+  so snapshots are read without any lock or read-side critical
+  section.
+*/
+
+/* A read-only snapshot of an FT */
+struct ftSnapshot {
+    /* the FT that the snapshot was taken of */
+    FT_T oFTree;
+    /* the hierarchy as it was when the snapshot was taken: an
+       initialized FT with the root and count it had then, and no
+       filter, table, domain or transaction, which the FT's read
+       functions read as they would any other */
+    struct ft sView;
+};
+
+/* FT_snapshotIn, with oFTree's tree lock held exclusively. */
+static int FT_snapshotUnlocked(FT_T oFTree, FT_Snapshot_T *poSResult)
+{
+    FT_Snapshot_T oSNew;
+
+    assert(oFTree != NULL);
+    assert(poSResult != NULL);
+
+    /* an open transaction may yet restore nodes that a snapshot
+       would share */
+    if(!oFTree->bIsInitialized || FT_ownsTxn(oFTree))
+        return INITIALIZATION_ERROR;
+
+    oSNew = malloc(sizeof(struct ftSnapshot));
+    if(oSNew == NULL)
+        return MEMORY_ERROR;
+
+    oSNew->oFTree = oFTree;
+    oSNew->sView.bIsInitialized = TRUE;
+    oSNew->sView.oNRoot = oFTree->oNRoot;
+    oSNew->sView.ulCount = oFTree->ulCount;
+    oSNew->sView.oBFilter = NULL;
+    oSNew->sView.oITable = NULL;
+    oSNew->sView.oEReclaim = NULL;
+    oSNew->sView.psTxn = NULL;
+    oSNew->sView.oWLog = NULL;
+    oSNew->sView.oIImage = NULL;
+    oSNew->sView.pfFreeContents = NULL;
+    oSNew->sView.oCStore = NULL;
+    oSNew->sView.oLCompressor = NULL;
+    oSNew->sView.psBudget = NULL;
+    if(oFTree->oNRoot != NULL)
+        Node_retain(oFTree->oNRoot);
+
+    *poSResult = oSNew;
+    return SUCCESS;
+}
+
+int FT_snapshotIn(FT_T oFTree, FT_Snapshot_T *poSResult)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(poSResult != NULL);
+
+    /* no writer is active while the root is shared, so every writer
+       after it finds the root shared */
+    FT_lockTree(oFTree);
+    iStatus = FT_snapshotUnlocked(oFTree, poSResult);
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+void FT_releaseSnapshot(FT_Snapshot_T oSSnapshot)
+{
+    FT_T oFTree;
+
+    if(oSSnapshot == NULL)
+        return;
+
+    oFTree = oSSnapshot->oFTree;
+    if(oSSnapshot->sView.oNRoot != NULL) {
+        Node_release(oSSnapshot->sView.oNRoot, oFTree->oITable);
+        Epoch_reclaim(oFTree->oEReclaim);
+    }
+    free(oSSnapshot);
+}
+
+boolean FT_containsDirOf(FT_Snapshot_T oSSnapshot, const char *pcPath)
+{
+    assert(oSSnapshot != NULL);
+
+    return FT_containsDirUnlocked(&oSSnapshot->sView, pcPath);
+}
+
+boolean FT_containsFileOf(FT_Snapshot_T oSSnapshot, const char *pcPath)
+{
+    assert(oSSnapshot != NULL);
+
+    return FT_containsFileUnlocked(&oSSnapshot->sView, pcPath);
+}
+
+void *FT_getFileContentsOf(FT_Snapshot_T oSSnapshot, const char *pcPath)
+{
+    assert(oSSnapshot != NULL);
+
+    return FT_getFileContentsUnlocked(&oSSnapshot->sView, pcPath);
+}
+
+int FT_statOf(FT_Snapshot_T oSSnapshot, const char *pcPath,
+              boolean *pbIsFile, size_t *pulSize)
+{
+    assert(oSSnapshot != NULL);
+
+    return FT_statUnlocked(&oSSnapshot->sView, pcPath, pbIsFile,
+                           pulSize);
+}
+
+int FT_getCountOf(FT_Snapshot_T oSSnapshot, size_t *pulCount)
+{
+    assert(oSSnapshot != NULL);
+
+    return FT_getCountIn(&oSSnapshot->sView, pulCount);
+}
+
+int FT_duOf(FT_Snapshot_T oSSnapshot, const char *pcPath,
+            size_t *pulFiles, size_t *pulDirs, size_t *pulBytes)
+{
+    assert(oSSnapshot != NULL);
+
+    return FT_duUnlocked(&oSSnapshot->sView, pcPath, pulFiles, pulDirs,
+                         pulBytes);
+}
+
+int FT_topKOf(FT_Snapshot_T oSSnapshot, const char *pcPath, size_t ulK,
+              FT_RankBy_T eBy, char **ppcPaths, size_t *pulSizes,
+              size_t *pulFound)
+{
+    assert(oSSnapshot != NULL);
+
+    return FT_topKUnlocked(&oSSnapshot->sView, pcPath, ulK, eBy, ppcPaths,
+                           pulSizes, pulFound);
+}
+
+char *FT_toStringOf(FT_Snapshot_T oSSnapshot)
+{
+    assert(oSSnapshot != NULL);
+
+    return FT_toStringUnlocked(&oSSnapshot->sView);
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions save an FT to a checkpoint file and load it
+  back (see ckpt.h). A save writes a snapshot, so writers proceed
+  meanwhile, and a load builds the whole hierarchy out of readers'
+  reach, each directory's children array allocated once at its exact
+  size, and publishes it with its root.
+*/
+
+/*
+  Appends the subtree rooted at oNNode to checkpoint oCFile in
+  pre-order, each directory's children in sorted order. Returns
+  SUCCESS, or IO_ERROR if the checkpoint could not be written.
+*/
+static int FT_saveSubtree(Ckpt_T oCFile, Node_T oNNode) {
+    void *pvContents;
+    Path_T oPPath;
+    const char *pcName;
+    size_t ulChildren;
+    size_t c;
+    int iStatus;
+
+    assert(oCFile != NULL);
+    assert(oNNode != NULL);
+
+    oPPath = Node_getPath(oNNode);
+    pcName = Path_getComponent(oPPath, Path_getDepth(oPPath) - 1);
+    if(Node_isFile(oNNode)) {
+        pvContents = FT_flatContents(oNNode);
+        if(pvContents == NULL && Node_getLength(oNNode) != 0)
+            return MEMORY_ERROR;
+        return Ckpt_putFile(oCFile, pcName, pvContents,
+                            Node_getLength(oNNode));
+    }
+
+    ulChildren = Node_getNumChildren(oNNode);
+    iStatus = Ckpt_putDir(oCFile, pcName, ulChildren);
+    for(c = 0; c < ulChildren && iStatus == SUCCESS; c++) {
+        Node_T oNChild = NULL;
+        iStatus = Node_getChild(oNNode, c, &oNChild);
+        assert(iStatus == SUCCESS);
+        iStatus = FT_saveSubtree(oCFile, oNChild);
+    }
+    return iStatus;
+}
+
+int FT_saveOf(FT_Snapshot_T oSSnapshot, const char *pcFile)
+{
+    Ckpt_T oCFile;
+    int iStatus;
+
+    assert(oSSnapshot != NULL);
+    assert(pcFile != NULL);
+
+    iStatus = Ckpt_create(pcFile, oSSnapshot->sView.ulCount, &oCFile);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(oSSnapshot->sView.oNRoot != NULL)
+        iStatus = FT_saveSubtree(oCFile, oSSnapshot->sView.oNRoot);
+    if(iStatus != SUCCESS) {
+        (void) Ckpt_close(oCFile);
+        return iStatus;
+    }
+    return Ckpt_commit(oCFile);
+}
+
+int FT_saveIn(FT_T oFTree, const char *pcFile)
+{
+    FT_Snapshot_T oSSnapshot;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcFile != NULL);
+
+    iStatus = FT_snapshotIn(oFTree, &oSSnapshot);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_saveOf(oSSnapshot, pcFile);
+    FT_releaseSnapshot(oSSnapshot);
+    return iStatus;
+}
+
+/* The state of a load of a checkpoint into an FT */
+struct load {
+    /* the checkpoint being read */
+    Ckpt_T oCFile;
+    /* the FT's node ID table */
+    Node_IDTable_T oITable;
+    /* the number of nodes the checkpoint holds, and of those read */
+    size_t ulNodes;
+    size_t ulRead;
+    /* the path of the node being loaded, and its buffer's capacity */
+    char *pcPath;
+    size_t ulCapacity;
+};
+
+/*
+  Frees the contents of every file in the subtree rooted at oNNode,
+  which a load allocated.
+*/
+static void FT_freeContents(Node_T oNNode) {
+    size_t c;
+
+    assert(oNNode != NULL);
+
+    if(Node_isFile(oNNode)) {
+        free(Node_getContents(oNNode));
+        return;
+    }
+    for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+        int iStatus;
+        Node_T oNChild = NULL;
+        iStatus = Node_getChild(oNNode, c, &oNChild);
+        assert(iStatus == SUCCESS);
+        (void) iStatus;
+        FT_freeContents(oNChild);
+    }
+}
+
+/*
+  Reads the next node of the checkpoint that psLoad reads, with the
+  subtree that follows it if it is a directory, and builds it below
+  oNParent, whose path fills the first ulPrefix bytes of psLoad's
+  path (or as a root, if oNParent is NULL). Sets *poNResult to the
+  new node as soon as it is linked below oNParent, even if loading
+  its subtree then fails. Returns SUCCESS, or:
+  * IO_ERROR if the checkpoint cannot be read or does not hold a
+    hierarchy
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_loadSubtree(struct load *psLoad, Node_T oNParent,
+                          size_t ulPrefix, Node_T *poNResult) {
+    boolean bIsFile, bHasContents;
+    const char *pcName;
+    size_t ulSize, ulPathLength, c;
+    void *pvContents = NULL;
+    Path_T oPPath = NULL;
+    Node_T oNNew = NULL;
+    int iStatus;
+
+    assert(psLoad != NULL);
+    assert(poNResult != NULL);
+
+    *poNResult = NULL;
+    if(psLoad->ulRead == psLoad->ulNodes)
+        return IO_ERROR;
+    iStatus = Ckpt_getNode(psLoad->oCFile, &bIsFile, &pcName, &ulSize,
+                           &bHasContents);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    psLoad->ulRead++;
+
+    /* the root must be a directory, and no directory may have more
+       children than the nodes left to read */
+    if((oNParent == NULL && bIsFile) ||
+       (!bIsFile && ulSize > psLoad->ulNodes - psLoad->ulRead))
+        return IO_ERROR;
+
+    /* append the node's name to its parent's path */
+    ulPathLength = ulPrefix + (ulPrefix != 0) + strlen(pcName);
+    if(ulPathLength >= psLoad->ulCapacity) {
+        size_t ulCapacity = 2 * psLoad->ulCapacity;
+        char *pcNew;
+        if(ulCapacity <= ulPathLength)
+            ulCapacity = ulPathLength + 1;
+        pcNew = realloc(psLoad->pcPath, ulCapacity);
+        if(pcNew == NULL)
+            return MEMORY_ERROR;
+        psLoad->pcPath = pcNew;
+        psLoad->ulCapacity = ulCapacity;
+    }
+    if(ulPrefix != 0)
+        psLoad->pcPath[ulPrefix] = '/';
+    strcpy(psLoad->pcPath + ulPrefix + (ulPrefix != 0), pcName);
+
+    if(bHasContents) {
+        pvContents = malloc(ulSize != 0 ? ulSize : 1);
+        if(pvContents == NULL)
+            return MEMORY_ERROR;
+        iStatus = Ckpt_getContents(psLoad->oCFile, pvContents, ulSize);
+        if(iStatus != SUCCESS) {
+            free(pvContents);
+            return iStatus;
+        }
+    }
+
+    iStatus = Path_new(psLoad->pcPath, &oPPath);
+    if(iStatus == SUCCESS) {
+        iStatus = Node_new(oPPath, oNParent, psLoad->oITable, &oNNew,
+                           bIsFile, pvContents, bIsFile ? ulSize : 0,
+                           NULL);
+        Path_free(oPPath);
+    }
+    if(iStatus != SUCCESS) {
+        free(pvContents);
+        /* a node that Node_new rejects is a duplicate name */
+        return iStatus == MEMORY_ERROR ? MEMORY_ERROR : IO_ERROR;
+    }
+    *poNResult = oNNew;
+    if(bIsFile)
+        return SUCCESS;
+
+    iStatus = Node_reserveChildren(oNNew, ulSize, psLoad->oITable);
+    for(c = 0; c < ulSize && iStatus == SUCCESS; c++) {
+        Node_T oNChild;
+        iStatus = FT_loadSubtree(psLoad, oNNew, ulPathLength, &oNChild);
+    }
+    return iStatus;
+}
+
+int FT_loadIn(FT_T oFTree, const char *pcFile)
+{
+    struct load sLoad;
+    Node_T oNRoot = NULL;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcFile != NULL);
+
+    if(FT_ownsTxn(oFTree))
+        return INITIALIZATION_ERROR;
+
+    sLoad.ulRead = 0;
+    sLoad.pcPath = NULL;
+    sLoad.ulCapacity = 0;
+    iStatus = Ckpt_open(pcFile, &sLoad.oCFile, &sLoad.ulNodes);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    FT_lockTree(oFTree);
+    sLoad.oITable = oFTree->oITable;
+    /* a loaded hierarchy replaces nothing, and a log would miss it */
+    if(!oFTree->bIsInitialized || oFTree->ulCount != 0 ||
+       oFTree->oWLog != NULL)
+        iStatus = INITIALIZATION_ERROR;
+    else if(sLoad.ulNodes != 0)
+        iStatus = FT_loadSubtree(&sLoad, NULL, 0, &oNRoot);
+    if(iStatus == SUCCESS && sLoad.ulRead != sLoad.ulNodes)
+        iStatus = IO_ERROR;
+    if(Ckpt_close(sLoad.oCFile) != SUCCESS && iStatus == SUCCESS)
+        iStatus = IO_ERROR;
+    free(sLoad.pcPath);
+
+    if(iStatus == SUCCESS && oNRoot != NULL) {
+        if(oFTree->oBFilter != NULL)
+            FT_filterSubtree(oFTree->oBFilter, oNRoot, TRUE);
+        FT_storeRoot(oFTree, oNRoot);
+        __atomic_store_n(&oFTree->ulCount, sLoad.ulNodes,
+                         __ATOMIC_RELAXED);
+    }
+    else if(oNRoot != NULL) {
+        FT_freeContents(oNRoot);
+        (void) Node_free(oNRoot, oFTree->oITable);
+    }
+
+    assert(CheckerFT_isValid(oFTree->bIsInitialized, oFTree->oNRoot,
+                             oFTree->ulCount));
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions save an FT as a read-only image and open an
+  image as an FT (see image.h). Saving an image, as saving a
+  checkpoint, writes a snapshot; opening one maps it, and the FT's
+  read functions then query the mapping where it lies.
+*/
+
+/*
+  Describes node ulIndex of the breadth-first order in DynArray_T
+  pvNodes to Image_write.
+*/
+static void FT_getImageNode(void *pvNodes, size_t ulIndex,
+                            const char **ppcName, boolean *pbIsFile,
+                            size_t *pulSize, const void **ppvContents) {
+    Node_T oNNode;
+    Path_T oPPath;
+
+    assert(pvNodes != NULL);
+    assert(ppcName != NULL);
+    assert(pbIsFile != NULL);
+    assert(pulSize != NULL);
+    assert(ppvContents != NULL);
+
+    oNNode = DynArray_get((DynArray_T) pvNodes, ulIndex);
+    oPPath = Node_getPath(oNNode);
+    *ppcName = Path_getComponent(oPPath, Path_getDepth(oPPath) - 1);
+    *pbIsFile = Node_isFile(oNNode);
+    *ppvContents = NULL;
+    if(*pbIsFile) {
+        *pulSize = Node_getLength(oNNode);
+        *ppvContents = FT_flatContents(oNNode);
+    }
+    else
+        *pulSize = Node_getNumChildren(oNNode);
+}
+
+int FT_saveImageOf(FT_Snapshot_T oSSnapshot, const char *pcFile)
+{
+    DynArray_T oDNodes;
+    size_t i, c;
+    int iStatus;
+
+    assert(oSSnapshot != NULL);
+    assert(pcFile != NULL);
+
+    oDNodes = DynArray_new(0);
+    if(oDNodes == NULL)
+        return MEMORY_ERROR;
+
+    /* the array is its own queue: each directory's children are
+       appended as the directory is reached */
+    iStatus = SUCCESS;
+    if(oSSnapshot->sView.oNRoot != NULL &&
+       !DynArray_add(oDNodes, oSSnapshot->sView.oNRoot))
+        iStatus = MEMORY_ERROR;
+    for(i = 0; i < DynArray_getLength(oDNodes) && iStatus == SUCCESS;
+        i++) {
+        Node_T oNNode = DynArray_get(oDNodes, i);
+
+        /* flatten chunked contents here, where a failure is reported,
+           for FT_getImageNode to find flattened */
+        if(Node_isFile(oNNode)) {
+            if(FT_flatContents(oNNode) == NULL
+               && Node_getLength(oNNode) != 0)
+                iStatus = MEMORY_ERROR;
+            continue;
+        }
+        for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+            Node_T oNChild = NULL;
+            iStatus = Node_getChild(oNNode, c, &oNChild);
+            assert(iStatus == SUCCESS);
+            if(!DynArray_add(oDNodes, oNChild)) {
+                iStatus = MEMORY_ERROR;
+                break;
+            }
+        }
+    }
+
+    if(iStatus == SUCCESS)
+        iStatus = Image_write(pcFile, DynArray_getLength(oDNodes),
+                              FT_getImageNode, oDNodes);
+    DynArray_free(oDNodes);
+    return iStatus;
+}
+
+int FT_saveImageIn(FT_T oFTree, const char *pcFile)
+{
+    FT_Snapshot_T oSSnapshot;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcFile != NULL);
+
+    iStatus = FT_snapshotIn(oFTree, &oSSnapshot);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_saveImageOf(oSSnapshot, pcFile);
+    FT_releaseSnapshot(oSSnapshot);
+    return iStatus;
+}
+
+int FT_openImage(const char *pcFile, FT_T *poFResult)
+{
+    FT_T oFTNew;
+    int iStatus;
+
+    assert(pcFile != NULL);
+    assert(poFResult != NULL);
+
+    oFTNew = FT_new();
+    if(oFTNew == NULL)
+        return MEMORY_ERROR;
+
+    iStatus = Image_open(pcFile, &oFTNew->oIImage);
+    if(iStatus != SUCCESS) {
+        FT_free(oFTNew);
+        return iStatus;
+    }
+    oFTNew->bIsInitialized = FALSE;
+
+    *poFResult = oFTNew;
+    return SUCCESS;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions run transactions. A transaction holds the
+  FT's tree lock exclusively from FT_beginIn until it commits or
+  aborts, so the writes of its thread are the only ones meanwhile, and
+  keeps an undo log of every change they make to the hierarchy: the
+  first node of each path inserted, the root of each subtree removed,
+  which stays allocated and keeps its identifiers until the commit,
+  and the old contents of each file replaced. Committing discards the
+  log; aborting undoes its changes from the last back to the first,
+  each in the hierarchy that the change left behind, and with memory
+  reserved when the change was made, so that an abort cannot fail.
+*/
+
+int FT_beginIn(FT_T oFTree)
+{
+    DynArray_T oDUndo;
+#ifndef FT_NO_LOCKING
+    pthread_t sSelf;
+#endif
+
+    assert(oFTree != NULL);
+
+    if(FT_ownsTxn(oFTree))
+        return INITIALIZATION_ERROR;
+
+    FT_lockTree(oFTree);
+    if(!oFTree->bIsInitialized) {
+        FT_unlockWriters(oFTree);
+        return INITIALIZATION_ERROR;
+    }
+
+    oDUndo = DynArray_new(0);
+    if(oDUndo == NULL) {
+        FT_unlockWriters(oFTree);
+        return MEMORY_ERROR;
+    }
+
+#ifndef FT_NO_LOCKING
+    sSelf = pthread_self();
+    __atomic_store(&oFTree->psTxn->sOwner, &sSelf, __ATOMIC_RELAXED);
+#endif
+    __atomic_store_n(&oFTree->psTxn->oDUndo, oDUndo, __ATOMIC_RELEASE);
+    FT_appendLog(oFTree, WAL_BEGIN, NULL, NULL, 0);
+    return SUCCESS;
+}
+
+/*
+  Closes the transaction open on oFTree, whose thread must be the
+  caller, and returns its undo log. The tree lock stays held.
+*/
+static DynArray_T FT_closeTxn(FT_T oFTree) {
+    DynArray_T oDUndo;
+
+    assert(oFTree != NULL);
+    assert(FT_ownsTxn(oFTree));
+
+    oDUndo = oFTree->psTxn->oDUndo;
+    __atomic_store_n(&oFTree->psTxn->oDUndo, NULL, __ATOMIC_RELEASE);
+    return oDUndo;
+}
+
+int FT_commitIn(FT_T oFTree)
+{
+    DynArray_T oDUndo;
+    size_t i;
+
+    assert(oFTree != NULL);
+
+    if(!FT_ownsTxn(oFTree))
+        return INITIALIZATION_ERROR;
+
+    /* the removed subtrees and replaced contents were kept only for
+       an abort */
+    oDUndo = FT_closeTxn(oFTree);
+    for(i = 0; i < DynArray_getLength(oDUndo); i++) {
+        struct undoRecord *psRecord = DynArray_get(oDUndo, i);
+        if(psRecord->eKind == UNDO_REMOVE)
+            (void) Node_discard(psRecord->oNNode, psRecord->pvSpare,
+                                oFTree->oITable);
+        else if(psRecord->eKind == UNDO_REPLACE)
+            Node_releaseOwner(psRecord->oOOwner, oFTree->oITable);
+        free(psRecord);
+    }
+    DynArray_free(oDUndo);
+    FT_appendLog(oFTree, WAL_COMMIT, NULL, NULL, 0);
+
+    assert(CheckerFT_isValid(oFTree->bIsInitialized, oFTree->oNRoot,
+                             oFTree->ulCount));
+    FT_unlockWriters(oFTree);
+    return SUCCESS;
+}
+
+/*
+  Undoes the change that psRecord records in oFTree, whose hierarchy
+  must be as the change left it. Must be called with oFTree's tree
+  lock held exclusively and no transaction open.
+*/
+static void FT_undoChange(FT_T oFTree, struct undoRecord *psRecord) {
+    Node_T oNNode;
+    Node_Owner_T oOOwner;
+
+    assert(oFTree != NULL);
+    assert(psRecord != NULL);
+
+    oNNode = psRecord->oNNode;
+    switch(psRecord->eKind) {
+    case UNDO_INSERT:
+        /* with no transaction open, this frees the subtree */
+        (void) FT_removeSubtree(oFTree, oNNode);
+        break;
+    case UNDO_REMOVE:
+        if(oFTree->oBFilter != NULL)
+            FT_filterSubtree(oFTree->oBFilter, oNNode, TRUE);
+        Node_relink(oNNode, psRecord->pvSpare, oFTree->oITable);
+        if(Node_getParent(oNNode) == NULL)
+            FT_storeRoot(oFTree, oNNode);
+        (void) __atomic_add_fetch(&oFTree->ulCount, psRecord->ulLength,
+                                  __ATOMIC_RELAXED);
+        break;
+    case UNDO_REPLACE:
+        /* the contents that the replacement gave are dropped, and
+           freed if the FT took them over */
+        oOOwner = psRecord->oOOwner;
+        (void) Node_editContents(oNNode, psRecord->pvContents,
+                                 psRecord->ulLength, &oOOwner);
+        Node_releaseOwner(oOOwner, oFTree->oITable);
+        break;
+    }
+}
+
+int FT_abortIn(FT_T oFTree)
+{
+    DynArray_T oDUndo;
+    size_t i;
+
+    assert(oFTree != NULL);
+
+    if(!FT_ownsTxn(oFTree))
+        return INITIALIZATION_ERROR;
+
+    oDUndo = FT_closeTxn(oFTree);
+    for(i = DynArray_getLength(oDUndo); i > 0; i--) {
+        struct undoRecord *psRecord = DynArray_get(oDUndo, i - 1);
+        FT_undoChange(oFTree, psRecord);
+        free(psRecord);
+    }
+    DynArray_free(oDUndo);
+    FT_appendLog(oFTree, WAL_ABORT, NULL, NULL, 0);
+
+    assert(CheckerFT_isValid(oFTree->bIsInitialized, oFTree->oNRoot,
+                             oFTree->ulCount));
+    FT_unlockWriters(oFTree);
+    return SUCCESS;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions keep a write-ahead log of an FT. Every
+  change to the hierarchy is appended to the log once it is made, and
+  a transaction's changes are bracketed by records of its beginning
+  and its end, so that opening the log on an empty FT replays them
+  all and rebuilds the hierarchy that the log describes, less any
+  transaction that never ended.
+*/
+
+/* The state of a replay of a write-ahead log into an FT */
+struct replay {
+    /* the FT being rebuilt */
+    FT_T oFTree;
+    /* the copies of contents made for the FT, in the order made */
+    DynArray_T oDCopies;
+};
+
+/*
+  Applies to ((struct replay *) pvExtra)->oFTree the change of kind
+  iKind to pcPath that a log records, with a copy of pvContents of
+  ulLength bytes for kinds that set contents, or the bytes that
+  pvContents encode for a write. Returns SUCCESS,
+  MEMORY_ERROR if memory could not be allocated to complete request,
+  or IO_ERROR if the change cannot be made to the hierarchy as the
+  log has rebuilt it so far, which means the log is not one of it.
+*/
+static int FT_replayRecord(void *pvExtra, int iKind, const char *pcPath,
+                           void *pvContents, size_t ulLength) {
+    struct replay *psReplay = pvExtra;
+    FT_T oFTree;
+    void *pvCopy = NULL;
+    const void *pvBytes;
+    size_t ulOffset, ulBytes;
+    int iStatus;
+
+    assert(psReplay != NULL);
+
+    /* the copies are the client's even if the FT takes over the
+       contents it is given, so they are never handed over */
+    oFTree = psReplay->oFTree;
+    if((iKind == WAL_INSERT_FILE || iKind == WAL_REPLACE)
+       && pvContents != NULL) {
+        pvCopy = malloc(ulLength != 0 ? ulLength : 1);
+        if(pvCopy == NULL)
+            return MEMORY_ERROR;
+        memcpy(pvCopy, pvContents, ulLength);
+        if(!DynArray_add(psReplay->oDCopies, pvCopy)) {
+            free(pvCopy);
+            return MEMORY_ERROR;
+        }
+    }
+
+    switch(iKind) {
+    case WAL_INSERT_DIR:
+        iStatus = FT_insertDirIn(oFTree, pcPath);
+        break;
+    case WAL_INSERT_FILE:
+        iStatus = FT_insertFileOwnedIn(oFTree, pcPath, pvCopy, ulLength,
+                                       NULL);
+        break;
+    case WAL_REMOVE:
+        iStatus = FT_rmDirIn(oFTree, pcPath);
+        if(iStatus == NOT_A_DIRECTORY)
+            iStatus = FT_rmFileIn(oFTree, pcPath);
+        break;
+    case WAL_REPLACE:
+        iStatus = FT_replaceFileContentsOwnedIn(oFTree, pcPath, pvCopy,
+                                                ulLength, NULL);
+        break;
+    case WAL_WRITE:
+        iStatus = IO_ERROR;
+        if(Wal_decodeWrite(pvContents, ulLength, &ulOffset, &pvBytes,
+                           &ulBytes))
+            iStatus = FT_writeAtIn(oFTree, pcPath, ulOffset, pvBytes,
+                                   ulBytes);
+        break;
+    case WAL_BEGIN:
+        iStatus = FT_beginIn(oFTree);
+        break;
+    case WAL_COMMIT:
+        iStatus = FT_commitIn(oFTree);
+        break;
+    default:
+        iStatus = FT_abortIn(oFTree);
+        break;
+    }
+
+    if(iStatus != SUCCESS && iStatus != MEMORY_ERROR)
+        return IO_ERROR;
+    return iStatus;
+}
+
+/*
+  Returns <0, 0, or >0 depending upon whether the address pvFirst is
+  less than, equal to, or greater than the address pvSecond.
+*/
+static int FT_compareAddresses(const void *pvFirst,
+                               const void *pvSecond) {
+    size_t ulFirst = (size_t) pvFirst;
+    size_t ulSecond = (size_t) pvSecond;
+
+    if(ulFirst < ulSecond)
+        return -1;
+    return ulFirst > ulSecond;
+}
+
+/*
+  Frees each copy in oDCopies that is not the contents of a file in
+  oFTree: those that a replay removed, replaced or rolled back.
+  Returns SUCCESS, or MEMORY_ERROR if memory could not be allocated
+  to find them, in which case nothing is freed.
+*/
+static int FT_freeOrphans(FT_T oFTree, DynArray_T oDCopies) {
+    DynArray_T oDNodes;
+    DynArray_T oDKept;
+    size_t ulIndex;
+    size_t i;
+
+    assert(oFTree != NULL);
+    assert(oDCopies != NULL);
+
+    oDNodes = DynArray_new(oFTree->ulCount);
+    if(oDNodes == NULL)
+        return MEMORY_ERROR;
+    oDKept = DynArray_new(0);
+    if(oDKept == NULL) {
+        DynArray_free(oDNodes);
+        return MEMORY_ERROR;
+    }
+
+    (void) FT_preOrderTraversal(oFTree->oNRoot, oDNodes, 0);
+    for(i = 0; i < DynArray_getLength(oDNodes); i++) {
+        Node_T oNNode = DynArray_get(oDNodes, i);
+        if(Node_isFile(oNNode) && Node_getContents(oNNode) != NULL &&
+           !DynArray_add(oDKept, Node_getContents(oNNode))) {
+            DynArray_free(oDKept);
+            DynArray_free(oDNodes);
+            return MEMORY_ERROR;
+        }
+    }
+    DynArray_free(oDNodes);
+
+    DynArray_sort(oDKept, FT_compareAddresses);
+    for(i = 0; i < DynArray_getLength(oDCopies); i++) {
+        void *pvCopy = DynArray_get(oDCopies, i);
+        if(!DynArray_bsearch(oDKept, pvCopy, &ulIndex,
+                             FT_compareAddresses))
+            free(pvCopy);
+    }
+    DynArray_free(oDKept);
+    return SUCCESS;
+}
+
+/*
+  Undoes a failed replay into oFTree: rolls back the transaction it
+  left open, if any, removes every node it inserted, and frees every
+  copy of contents in oDCopies.
+*/
+static void FT_unreplay(FT_T oFTree, DynArray_T oDCopies) {
+    Node_T oNRoot;
+    size_t i;
+
+    assert(oFTree != NULL);
+    assert(oDCopies != NULL);
+
+    if(FT_ownsTxn(oFTree))
+        (void) FT_abortIn(oFTree);
+
+    FT_lockTree(oFTree);
+    oNRoot = oFTree->oNRoot;
+    if(oNRoot != NULL) {
+        if(oFTree->oBFilter != NULL)
+            FT_filterSubtree(oFTree->oBFilter, oNRoot, FALSE);
+        FT_storeRoot(oFTree, NULL);
+        oFTree->ulCount -= Node_free(oNRoot, oFTree->oITable);
+    }
+    FT_unlockWriters(oFTree);
+
+    for(i = 0; i < DynArray_getLength(oDCopies); i++)
+        free(DynArray_get(oDCopies, i));
+}
+
+int FT_openLogIn(FT_T oFTree, const char *pcLogPath, size_t ulGroupSize)
+{
+    struct replay sReplay;
+    Wal_T oWLog = NULL;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcLogPath != NULL);
+    assert(ulGroupSize > 0);
+
+    if(FT_ownsTxn(oFTree))
+        return INITIALIZATION_ERROR;
+
+    FT_lockTree(oFTree);
+    iStatus = SUCCESS;
+    if(!oFTree->bIsInitialized || oFTree->ulCount != 0 ||
+       oFTree->oWLog != NULL)
+        iStatus = INITIALIZATION_ERROR;
+    FT_unlockWriters(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    sReplay.oFTree = oFTree;
+    sReplay.oDCopies = DynArray_new(0);
+    if(sReplay.oDCopies == NULL)
+        return MEMORY_ERROR;
+
+    iStatus = Wal_open(pcLogPath, ulGroupSize, &oWLog);
+    if(iStatus == SUCCESS)
+        iStatus = Wal_replay(oWLog, FT_replayRecord, &sReplay);
+
+    /* a transaction that never ended is rolled back, in the log too,
+       so that the changes appended next are not taken for its own */
+    if(iStatus == SUCCESS && FT_ownsTxn(oFTree)) {
+        (void) FT_abortIn(oFTree);
+        iStatus = Wal_append(oWLog, WAL_ABORT, NULL, NULL, 0);
+        if(iStatus == SUCCESS)
+            iStatus = Wal_sync(oWLog);
+    }
+    if(iStatus == SUCCESS) {
+        FT_lockTree(oFTree);
+        iStatus = FT_freeOrphans(oFTree, sReplay.oDCopies);
+        if(iStatus == SUCCESS)
+            oFTree->oWLog = oWLog;
+        FT_unlockWriters(oFTree);
+    }
+
+    if(iStatus != SUCCESS) {
+        FT_unreplay(oFTree, sReplay.oDCopies);
+        if(oWLog != NULL)
+            (void) Wal_close(oWLog);
+    }
+    DynArray_free(sReplay.oDCopies);
+
+    assert(FT_isValidIfIdle(oFTree));
+    return iStatus;
+}
+
+int FT_syncLogIn(FT_T oFTree)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    FT_lockWriters(oFTree);
+    if(oFTree->oWLog == NULL)
+        iStatus = INITIALIZATION_ERROR;
+    else
+        iStatus = Wal_sync(oFTree->oWLog);
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+int FT_closeLogIn(FT_T oFTree)
+{
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    if(FT_ownsTxn(oFTree))
+        return INITIALIZATION_ERROR;
+
+    FT_lockTree(oFTree);
+    if(oFTree->oWLog == NULL)
+        iStatus = INITIALIZATION_ERROR;
+    else {
+        iStatus = Wal_close(oFTree->oWLog);
+        oFTree->oWLog = NULL;
+    }
+    FT_unlockWriters(oFTree);
+    return iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions operate on the default instance, sDefault,
+  so that clients of a single FT need not manage an FT_T.
+*/
+
+/* FT_init, with the default FT's tree lock held exclusively. */
+static int FT_initUnlocked(void) {
+    assert(CheckerFT_isValid(sDefault.bIsInitialized, sDefault.oNRoot,
+                             sDefault.ulCount));
+
+    if(sDefault.bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    /* the table, the domain and the transaction state outlive
+       FT_destroy, so they are made only once */
+#ifndef FT_NO_LOCKING
+    if(sDefault.oEReclaim == NULL) {
+        Epoch_T oENew = Epoch_new();
+        if(oENew == NULL)
+            return MEMORY_ERROR;
+        __atomic_store_n(&sDefault.oEReclaim, oENew, __ATOMIC_RELEASE);
+    }
+#endif
+    if(sDefault.oITable == NULL) {
+        sDefault.oITable = Node_newIDTable(sDefault.oEReclaim);
+        if(sDefault.oITable == NULL)
+            return MEMORY_ERROR;
+    }
+    if(sDefault.psTxn == NULL) {
+        struct txn *psNew = malloc(sizeof(struct txn));
+        if(psNew == NULL)
+            return MEMORY_ERROR;
+        psNew->oDUndo = NULL;
+        __atomic_store_n(&sDefault.psTxn, psNew, __ATOMIC_RELEASE);
+    }
+
+    FT_storeRoot(&sDefault, NULL);
+    sDefault.ulCount = 0;
+    sDefault.pfFreeContents = NULL;
+    __atomic_store_n(&sDefault.bIsInitialized, TRUE, __ATOMIC_RELEASE);
+
+    assert(CheckerFT_isValid(sDefault.bIsInitialized, sDefault.oNRoot,
+                             sDefault.ulCount));
+    return SUCCESS;
+}
+
+int FT_init(void)
+{
+    int iStatus;
+
+    FT_lockTree(&sDefault);
+    iStatus = FT_initUnlocked();
+    FT_unlockWriters(&sDefault);
+    return iStatus;
+}
+
+/* FT_destroy, with the default FT's tree lock held exclusively. */
+static int FT_destroyUnlocked(void) {
+    assert(CheckerFT_isValid(sDefault.bIsInitialized, sDefault.oNRoot,
+                             sDefault.ulCount));
+
+    if(!sDefault.bIsInitialized || FT_ownsTxn(&sDefault))
+        return INITIALIZATION_ERROR;
+
+    __atomic_store_n(&sDefault.bIsInitialized, FALSE, __ATOMIC_RELEASE);
+    FT_clear(&sDefault);
+
+    assert(CheckerFT_isValid(sDefault.bIsInitialized, sDefault.oNRoot,
+                             sDefault.ulCount));
+    return SUCCESS;
+}
+
+int FT_destroy(void)
+{
+    int iStatus;
+
+    FT_lockTree(&sDefault);
+    iStatus = FT_destroyUnlocked();
+    FT_unlockWriters(&sDefault);
+    return iStatus;
+}
+
+int FT_insertDir(const char *pcPath)
+{
+    return FT_insertDirIn(&sDefault, pcPath);
+}
+
+boolean FT_containsDir(const char *pcPath)
+{
+    return FT_containsDirIn(&sDefault, pcPath);
+}
+
+int FT_rmDir(const char *pcPath)
+{
+    return FT_rmDirIn(&sDefault, pcPath);
+}
+
+int FT_insertFile(const char *pcPath, void *pvContents,
+                  size_t ulLength)
+{
+    return FT_insertFileIn(&sDefault, pcPath, pvContents, ulLength);
+}
+
+int FT_insertFileOwned(const char *pcPath, void *pvContents,
+                       size_t ulLength, void (*pfFree)(void *pvContents))
+{
+    return FT_insertFileOwnedIn(&sDefault, pcPath, pvContents, ulLength,
+                                pfFree);
+}
+
+int FT_insertFileCopy(const char *pcPath, const void *pvContents,
+                      size_t ulLength)
+{
+    return FT_insertFileCopyIn(&sDefault, pcPath, pvContents, ulLength);
+}
+
+int FT_insertFileMapped(const char *pcPath, const char *pcFile,
+                        size_t ulOffset, size_t ulLength)
+{
+    return FT_insertFileMappedIn(&sDefault, pcPath, pcFile, ulOffset,
+                                 ulLength);
+}
+
+boolean FT_containsFile(const char *pcPath)
+{
+    return FT_containsFileIn(&sDefault, pcPath);
+}
+
+int FT_rmFile(const char *pcPath)
+{
+    return FT_rmFileIn(&sDefault, pcPath);
+}
+
+void *FT_getFileContents(const char *pcPath)
+{
+    return FT_getFileContentsIn(&sDefault, pcPath);
+}
+
+void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
+                             size_t ulNewLength)
+{
+    return FT_replaceFileContentsIn(&sDefault, pcPath, pvNewContents,
+                                    ulNewLength);
+}
+
+int FT_replaceFileContentsOwned(const char *pcPath, void *pvNewContents,
+                                size_t ulNewLength,
+                                void (*pfFree)(void *pvContents))
+{
+    return FT_replaceFileContentsOwnedIn(&sDefault, pcPath, pvNewContents,
+                                         ulNewLength, pfFree);
+}
+
+int FT_replaceFileContentsCopy(const char *pcPath,
+                               const void *pvNewContents,
+                               size_t ulNewLength)
+{
+    return FT_replaceFileContentsCopyIn(&sDefault, pcPath, pvNewContents,
+                                        ulNewLength);
+}
+
+int FT_readAt(const char *pcPath, size_t ulOffset, void *pvBuf,
+              size_t ulLength, size_t *pulRead)
+{
+    return FT_readAtIn(&sDefault, pcPath, ulOffset, pvBuf, ulLength,
+                       pulRead);
+}
+
+int FT_writeAt(const char *pcPath, size_t ulOffset, const void *pvBytes,
+               size_t ulLength)
+{
+    return FT_writeAtIn(&sDefault, pcPath, ulOffset, pvBytes, ulLength);
+}
+
+int FT_append(const char *pcPath, const void *pvBytes, size_t ulLength)
+{
+    return FT_appendIn(&sDefault, pcPath, pvBytes, ulLength);
+}
+
+int FT_setContentsFree(void (*pfFree)(void *pvContents))
+{
+    return FT_setContentsFreeIn(&sDefault, pfFree);
+}
+
+int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize)
+{
+    return FT_statIn(&sDefault, pcPath, pbIsFile, pulSize);
+}
+
+int FT_getCount(size_t *pulCount)
+{
+    return FT_getCountIn(&sDefault, pulCount);
+}
+
+int FT_du(const char *pcPath, size_t *pulFiles, size_t *pulDirs,
+          size_t *pulBytes)
+{
+    return FT_duIn(&sDefault, pcPath, pulFiles, pulDirs, pulBytes);
+}
+
+int FT_topK(const char *pcPath, size_t ulK, FT_RankBy_T eBy,
+            char **ppcPaths, size_t *pulSizes, size_t *pulFound)
+{
+    return FT_topKIn(&sDefault, pcPath, ulK, eBy, ppcPaths, pulSizes,
+                     pulFound);
+}
+
+char *FT_toString(void)
+{
+    return FT_toStringIn(&sDefault);
+}
+
+int FT_begin(void)
+{
+    return FT_beginIn(&sDefault);
+}
+
+int FT_commit(void)
+{
+    return FT_commitIn(&sDefault);
+}
+
+int FT_abort(void)
+{
+    return FT_abortIn(&sDefault);
+}
+
+int FT_openLog(const char *pcLogPath, size_t ulGroupSize)
+{
+    return FT_openLogIn(&sDefault, pcLogPath, ulGroupSize);
+}
+
+int FT_syncLog(void)
+{
+    return FT_syncLogIn(&sDefault);
+}
+
+int FT_closeLog(void)
+{
+    return FT_closeLogIn(&sDefault);
+}
+
+int FT_snapshot(FT_Snapshot_T *poSResult)
+{
+    return FT_snapshotIn(&sDefault, poSResult);
+}
+
+int FT_save(const char *pcFile)
+{
+    return FT_saveIn(&sDefault, pcFile);
+}
+
+int FT_load(const char *pcFile)
+{
+    return FT_loadIn(&sDefault, pcFile);
+}
+
+int FT_saveImage(const char *pcFile)
+{
+    return FT_saveImageIn(&sDefault, pcFile);
+}
+
+int FT_openDir(const char *pcPath, FT_Dir_T *poDResult)
+{
+    return FT_openDirIn(&sDefault, pcPath, poDResult);
+}
+
+int FT_lookupId(const char *pcPath, size_t *pulID)
+{
+    return FT_lookupIdIn(&sDefault, pcPath, pulID);
+}
+
+void *FT_getContentsById(size_t ulID)
+{
+    return FT_getContentsByIdIn(&sDefault, ulID);
+}
+
+int FT_statById(size_t ulID, boolean *pbIsFile, size_t *pulSize)
+{
+    return FT_statByIdIn(&sDefault, ulID, pbIsFile, pulSize);
+}
+
+void *FT_replaceContentsById(size_t ulID, void *pvNewContents,
+                             size_t ulNewLength)
+{
+    return FT_replaceContentsByIdIn(&sDefault, ulID, pvNewContents,
+                                    ulNewLength);
+}
+
+int FT_getFileContentsMany(const char **ppcPaths, size_t ulPaths,
+                           boolean bSorted, void **ppvContents,
+                           int *piStatuses)
+{
+    return FT_getFileContentsManyIn(&sDefault, ppcPaths, ulPaths,
+                                    bSorted, ppvContents, piStatuses);
+}
+
+int FT_statMany(const char **ppcPaths, size_t ulPaths, boolean bSorted,
+                boolean *pbIsFile, size_t *pulSizes, int *piStatuses)
+{
+    return FT_statManyIn(&sDefault, ppcPaths, ulPaths, bSorted,
+                         pbIsFile, pulSizes, piStatuses);
+}
+
+int FT_bulkLoad(boolean (*pfNext)(void *pvExtra, const char **ppcPath,
+                                  boolean *pbIsFile, void **ppvContents,
+                                  size_t *pulLength),
+                void *pvExtra)
+{
+    return FT_bulkLoadIn(&sDefault, pfNext, pvExtra);
+}
+
+int FT_enableFilter(size_t ulExpectedPaths, double dFalsePositiveRate,
+                    size_t ulMaxBytes)
+{
+    return FT_enableFilterIn(&sDefault, ulExpectedPaths,
+                             dFalsePositiveRate, ulMaxBytes);
+}
+
+int FT_disableFilter(void)
+{
+    return FT_disableFilterIn(&sDefault);
+}
+
+int FT_getFilterStats(size_t *pulQueries, size_t *pulMisses,
+                      size_t *pulFalsePositives, size_t *pulBytes)
+{
+    return FT_getFilterStatsIn(&sDefault, pulQueries, pulMisses,
+                               pulFalsePositives, pulBytes);
+}
+
+int FT_enableDedup(void)
+{
+    return FT_enableDedupIn(&sDefault);
+}
+
+int FT_disableDedup(void)
+{
+    return FT_disableDedupIn(&sDefault);
+}
+
+int FT_getDedupStats(size_t *pulBlobs, size_t *pulRefs,
+                     size_t *pulStoredBytes, size_t *pulBytesSaved,
+                     double *pdRatio)
+{
+    return FT_getDedupStatsIn(&sDefault, pulBlobs, pulRefs,
+                              pulStoredBytes, pulBytesSaved, pdRatio);
+}
+
+int FT_compress(size_t ulThreshold, size_t *pulCompressed)
+{
+    return FT_compressIn(&sDefault, ulThreshold, pulCompressed);
+}
+
+int FT_getCompressionStats(size_t *pulPlainBytes, size_t *pulPackedBytes,
+                           double *pdRatio, double *pdCompressSeconds,
+                           double *pdExpandSeconds, size_t *pulHits,
+                           size_t *pulMisses)
+{
+    return FT_getCompressionStatsIn(&sDefault, pulPlainBytes,
+                                    pulPackedBytes, pdRatio,
+                                    pdCompressSeconds, pdExpandSeconds,
+                                    pulHits, pulMisses);
+}
+
+int FT_enableSpill(const char *pcSpillFile, size_t ulBudget)
+{
+    return FT_enableSpillIn(&sDefault, pcSpillFile, ulBudget);
+}
+
+int FT_disableSpill(void)
+{
+    return FT_disableSpillIn(&sDefault);
+}
+
+int FT_prefetch(const char **ppcPaths, size_t ulPaths, boolean bSorted)
+{
+    return FT_prefetchIn(&sDefault, ppcPaths, ulPaths, bSorted);
+}
+
+int FT_getSpillStats(size_t *pulSpills, size_t *pulReloads,
+                     size_t *pulPrefetches, size_t *pulResidentBytes,
+                     size_t *pulSpillBytes)
+{
+    return FT_getSpillStatsIn(&sDefault, pulSpills, pulReloads,
+                              pulPrefetches, pulResidentBytes,
+                              pulSpillBytes);
 }
@@ -15,6 +15,66 @@
 #include <stddef.h>
 #include "a4def.h"
 
+/*
+  An FT_T is an independent File Tree instance. The functions without
+  an FT_T parameter operate on a single default FT; each of them has a
+  counterpart with the same name plus an "In" suffix that takes the
+  FT_T to operate on as its first parameter. Distinct instances share
+  no state, so each may be used by its own thread without locking.
+
+  Each FT (including the default one) may also be shared between
+  threads. The operations that only read it (the contains, get and
+  stat operations, and lookups by handle, identifier or batch) take no
+  lock at all, so they scale with the number of threads and never wait
+  for a writer. Writes to a single path lock their way down from the
+  root one directory at a time, holding at most two directory locks
+  at once, so writes in different subtrees proceed in parallel and
+  writes only wait where their paths meet; removing a directory first
+  waits for every write already inside it to finish. Operations on
+  the whole FT (toString, bulkLoad, enabling or disabling the filter,
+  init and destroy) exclude all writes. Memory a write unlinks is
+  reclaimed only once no concurrent read can still reach it. Each
+  read sees every write that completed before it began; a read that
+  overlaps a write may or may not see it. Building with FT_NO_LOCKING
+  defined compiles all of this out. FT_init must return before other
+  threads use the default FT, and no other operation may overlap
+  FT_free. Contents returned by a read may be replaced or removed by a
+  later write, so clients that write concurrently must coordinate
+  their use of contents.
+*/
+typedef struct ft *FT_T;
+
+/*
+  A FT_Dir_T is an open handle on a directory in the FT. Operations
+  through a handle take a name relative to the directory, and reads
+  traverse only from the directory, not from the root. A handle remains usable
+  across other operations; once its directory is removed, operations
+  through it fail with NO_SUCH_PATH, even if a directory with the same
+  path is later inserted.
+*/
+typedef struct ftDir *FT_Dir_T;
+
+/*
+  A FT_Snapshot_T is a read-only snapshot of the FT, which keeps
+  answering reads as the FT stood when the snapshot was taken however
+  the FT changes afterwards. Taking one costs the same whatever the
+  size of the FT: the snapshot shares every node with the FT, and a
+  write copies a shared node before changing it, along with the
+  directories above it up to the root, so a write costs extra only
+  for the first change along a path after a snapshot. Snapshots are
+  read without locks, and may be read by any number of threads and
+  released in any order, but each must be released only once no
+  thread is reading it.
+*/
+typedef struct ftSnapshot *FT_Snapshot_T;
+
+/*
+  What FT_topK ranks by: files by the length of their contents, or
+  directories by the total length of the files below them.
+*/
+enum rankBy { FT_BY_FILE_SIZE, FT_BY_SUBTREE_BYTES };
+typedef enum rankBy FT_RankBy_T;
+
 /*
    Inserts a new directory into the FT with absolute path pcPath.
    Returns SUCCESS if the new directory is inserted successfully.
@@ -96,11 +156,159 @@ void *FT_getFileContents(const char *pcPath);
   Replaces current contents of the file with absolute path pcPath with
   the parameter pvNewContents of size ulNewLength bytes.
   Returns the old contents if successful. (Note: contents may be NULL.)
-  Returns NULL if unable to complete the request for any reason.
+  Returns NULL if unable to complete the request for any reason, and
+  also if the FT owned the old contents (see below), which it frees.
 */
 void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
                              size_t ulNewLength);
 
+/*
+  Contents are the client's by default: the FT stores the pointer it
+  is given, and the client keeps the buffer alive for as long as the
+  FT, or a snapshot of it, holds it, and frees it afterwards. The FT
+  may instead own contents, and free them itself once it drops them:
+  when their file is removed or its contents replaced, when the FT is
+  destroyed or freed, and when a transaction that inserted them
+  aborts; but not before every snapshot that shares them is released,
+  nor while a transaction that could put them back is open. Contents
+  are freed by the function given with them, once no reader can still
+  be reaching them, which may be during a later operation on the FT,
+  in whichever thread makes it. NULL contents have nothing to free,
+  and contents are never freed if their insertion or replacement
+  fails. Contents that FT_load reads or FT_openLog replays are always
+  the client's.
+*/
+
+/*
+  Sets the function with which the FT frees the contents that
+  FT_insertFile, FT_replaceFileContents, FT_insertFileAt,
+  FT_replaceContentsById and FT_bulkLoad are given from now on to
+  pfFree, so that the FT owns them, or makes them the client's again
+  if pfFree is NULL. Contents given before are unaffected. FT_init
+  resets it to NULL. Returns SUCCESS, or INITIALIZATION_ERROR if the
+  FT is not in an initialized state.
+*/
+int FT_setContentsFree(void (*pfFree)(void *pvContents));
+
+/*
+  Behaves as FT_insertFile, but the FT owns pvContents, and frees them
+  with (*pfFree)(pvContents), or leaves them to the client if pfFree
+  is NULL, whichever function FT_setContentsFree set.
+*/
+int FT_insertFileOwned(const char *pcPath, void *pvContents,
+                       size_t ulLength, void (*pfFree)(void *pvContents));
+
+/*
+  Behaves as FT_insertFile, but inserts a copy of the ulLength bytes
+  at pvContents, in memory the FT allocates with malloc and owns, or
+  NULL contents if pvContents is NULL.
+*/
+int FT_insertFileCopy(const char *pcPath, const void *pvContents,
+                      size_t ulLength);
+
+/*
+  Behaves as FT_insertFile, but the file's contents are the ulLength
+  bytes of the file on disk named pcFile from offset ulOffset on,
+  which the FT maps read-only into memory the first time they are
+  read, rather than copying them. FT_getFileContents then returns the
+  address of the bytes in the mapping, in the page cache, valid until
+  the file is removed or its contents are replaced, either of which
+  unmaps them; and FT_stat reports ulLength. The bytes read change as
+  the file on disk does, and reading bytes that it no longer holds,
+  once truncated, raises SIGBUS. Writes with FT_writeAt and
+  FT_append copy the contents first, leaving the file on disk alone.
+  Mapped contents are neither compressed, nor deduplicated, nor
+  counted against the memory budget (see FT_enableSpill). The log
+  (see FT_openLog) records a copy of the bytes, which a replay
+  restores as a copy. Returns SUCCESS, a status as FT_insertFile
+  does, or IO_ERROR if pcFile cannot be opened, the bytes do not lie
+  within it, or, with a log open, they cannot be mapped.
+*/
+int FT_insertFileMapped(const char *pcPath, const char *pcFile,
+                        size_t ulOffset, size_t ulLength);
+
+/*
+  Replaces the contents of the file with absolute path pcPath with
+  pvNewContents of size ulNewLength bytes, which the FT owns and frees
+  with (*pfFree)(pvNewContents), or leaves to the client if pfFree is
+  NULL, whichever function FT_setContentsFree set. The old contents
+  are freed if the FT owned them, and left to the client otherwise.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcPath exists as a file
+  * NOT_A_FILE if pcPath is in the FT as a directory not a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_replaceFileContentsOwned(const char *pcPath, void *pvNewContents,
+                                size_t ulNewLength,
+                                void (*pfFree)(void *pvContents));
+
+/*
+  Behaves as FT_replaceFileContentsOwned, but replaces the contents
+  with a copy of the ulNewLength bytes at pvNewContents, in memory the
+  FT allocates with malloc and owns, or with NULL contents if
+  pvNewContents is NULL.
+*/
+int FT_replaceFileContentsCopy(const char *pcPath,
+                               const void *pvNewContents,
+                               size_t ulNewLength);
+
+/*
+  A file's contents may instead be chunked: held by the FT in chunks
+  of a few kilobytes rather than in one block, so that writing a few
+  bytes into a large file copies only the chunks they fall in, rather
+  than the whole file as FT_replaceFileContents would. The first
+  FT_writeAt or FT_append to a file copies its contents into chunks
+  that the FT owns; contents that were the client's are left to it,
+  as after FT_replaceFileContents. A file stays chunked until its
+  contents are replaced. FT_stat reports the size of chunked
+  contents as of any other, and FT_readAt reads them in place;
+  FT_getFileContents, the functions like it, FT_save and
+  FT_saveImage flatten them into one block the first time, which the
+  FT keeps, at the cost of a second copy, until the file's contents
+  next change. Snapshots and transactions keep chunked contents as
+  they keep any others, sharing the chunks they have in common.
+*/
+
+/*
+  Copies up to ulLength bytes of the contents of the file with
+  absolute path pcPath, from byte ulOffset on, into pvBuf, and sets
+  *pulRead to the number copied: fewer than ulLength if the contents
+  end first, and 0 if ulOffset is at or past their end.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcPath exists as a file
+  * NOT_A_FILE if pcPath is in the FT as a directory not a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  in which case *pulRead is unchanged.
+*/
+int FT_readAt(const char *pcPath, size_t ulOffset, void *pvBuf,
+              size_t ulLength, size_t *pulRead);
+
+/*
+  Writes the ulLength bytes at pvBytes into the contents of the file
+  with absolute path pcPath at byte ulOffset, chunking them first if
+  they are not already (see above). The contents grow as far as the
+  write reaches, and any gap between their old end and ulOffset reads
+  as zeros; a write of no bytes changes nothing but chunks them.
+  Returns the same statuses as FT_replaceFileContentsOwned, in which
+  case the contents are unchanged.
+*/
+int FT_writeAt(const char *pcPath, size_t ulOffset, const void *pvBytes,
+               size_t ulLength);
+
+/*
+  Behaves as FT_writeAt, but writes at the end of the file's contents
+  as they are when the write is made.
+*/
+int FT_append(const char *pcPath, const void *pvBytes, size_t ulLength);
+
 /*
   Returns SUCCESS if pcPath exists in the hierarchy,
   Otherwise, returns:
@@ -119,10 +327,55 @@ void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
 */
 int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize);
 
+/*
+  Sets *pulCount to the number of directories and files in the FT.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state, in which case *pulCount is unchanged. A count
+  taken during writes may reflect any state they pass through.
+*/
+int FT_getCount(size_t *pulCount);
+
+/*
+  Sets *pulFiles and *pulDirs to the numbers of files and of
+  directories in the subtree rooted at pcPath, pcPath itself included,
+  and *pulBytes to the total length of the files' contents, as FT_stat
+  reports each. Every directory keeps these totals as the hierarchy
+  below it changes, so they are found in constant time, however large
+  the subtree. Totals taken during writes may reflect any state they
+  pass through, each independently of the others. Returns SUCCESS,
+  or the status FT_stat would return for pcPath, in which case the
+  parameters are unchanged.
+*/
+int FT_du(const char *pcPath, size_t *pulFiles, size_t *pulDirs,
+          size_t *pulBytes);
+
+/*
+  Finds the ulK largest files below directory pcPath if eBy is
+  FT_BY_FILE_SIZE, or the ulK largest directories below it, by the
+  totals FT_du reports, if eBy is FT_BY_SUBTREE_BYTES, or all of them
+  if there are fewer. Sets ppcPaths[0] to the path of the largest,
+  ppcPaths[1] to the next, and so on, ties going in path order, and
+  pulSizes[i] to the size of ppcPaths[i]; each path is a new string
+  that the caller owns and must free. Sets *pulFound to the number
+  found. Every directory keeps a bound on the files below it, so the
+  search passes over a subtree that cannot hold anything larger than
+  the ulK found so far, and examines the largest subtrees first; how
+  much it skips depends on how sizes are spread, not on the size of
+  the hierarchy. Writes wait while the search runs. Returns SUCCESS,
+  or:
+  * NOT_A_DIRECTORY if pcPath is a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * otherwise the status FT_stat would return for pcPath
+  in which case the parameters are unchanged.
+*/
+int FT_topK(const char *pcPath, size_t ulK, FT_RankBy_T eBy,
+            char **ppcPaths, size_t *pulSizes, size_t *pulFound);
+
 /*
   Sets the FT data structure to an initialized state.
   The data structure is initially empty.
   Returns INITIALIZATION_ERROR if already initialized,
+  MEMORY_ERROR if memory could not be allocated to complete request,
   and SUCCESS otherwise.
 */
 int FT_init(void);
@@ -130,8 +383,8 @@ int FT_init(void);
 /*
   Removes all contents of the data structure and
   returns it to an uninitialized state.
-  Returns INITIALIZATION_ERROR if not already initialized,
-  and SUCCESS otherwise.
+  Returns INITIALIZATION_ERROR if not already initialized or if the
+  calling thread has a transaction open on it, and SUCCESS otherwise.
 */
 int FT_destroy(void);
 
@@ -149,4 +402,698 @@ int FT_destroy(void);
 */
 char *FT_toString(void);
 
+/*
+  Opens a handle on the directory with absolute path pcPath.
+  Returns SUCCESS and sets *poDResult to the new handle if successful.
+  Otherwise, sets *poDResult to NULL and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_DIRECTORY if pcPath is in the FT as a file not a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request
+
+  The handle is owned by the client, who must close it with
+  FT_closeDir, even after the directory is removed or the FT destroyed.
+*/
+int FT_openDir(const char *pcPath, FT_Dir_T *poDResult);
+
+/* Closes oDDir and frees all memory allocated for it. */
+void FT_closeDir(FT_Dir_T oDDir);
+
+/*
+  Inserts a new file into the FT with path pcName relative to oDDir's
+  directory, with file contents pvContents of size ulLength bytes.
+  Returns SUCCESS if the new file is inserted successfully.
+  Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcName does not represent a well-formatted path
+  * NO_SUCH_PATH if oDDir's directory is no longer in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcName exists as a file
+  * ALREADY_IN_TREE if pcName is already in the FT (as dir or file)
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_insertFileAt(FT_Dir_T oDDir, const char *pcName,
+                    void *pvContents, size_t ulLength);
+
+/*
+  Returns the contents of the file with path pcName relative to
+  oDDir's directory. Returns NULL if unable to complete the request
+  for any reason, as with FT_getFileContents.
+*/
+void *FT_getFileContentsAt(FT_Dir_T oDDir, const char *pcName);
+
+/*
+  Behaves as FT_stat for the path pcName relative to oDDir's
+  directory, additionally returning NO_SUCH_PATH if oDDir's directory
+  is no longer in the FT.
+*/
+int FT_statAt(FT_Dir_T oDDir, const char *pcName,
+              boolean *pbIsFile, size_t *pulSize);
+
+/*
+  Node identifiers let clients that repeatedly access the same node
+  skip the traversal from the root. An identifier is a nonzero value
+  that stays valid until its node is removed from the FT, and is never
+  reissued to another node afterwards.
+*/
+
+/*
+  Sets *pulID to the identifier of the node with absolute path pcPath.
+  Returns SUCCESS if found. Otherwise, leaves *pulID unchanged and
+  returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcPath exists as a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_lookupId(const char *pcPath, size_t *pulID);
+
+/*
+  Returns the contents of the file with identifier ulID.
+  Returns NULL if ulID is not the identifier of a file in the FT,
+  or if unable to complete the request for any other reason.
+*/
+void *FT_getContentsById(size_t ulID);
+
+/*
+  Behaves as FT_stat for the node with identifier ulID, returning
+  NO_SUCH_PATH if ulID is not the identifier of a node in the FT.
+*/
+int FT_statById(size_t ulID, boolean *pbIsFile, size_t *pulSize);
+
+/*
+  Behaves as FT_replaceFileContents for the file with identifier ulID,
+  returning NULL if ulID is not the identifier of a file in the FT.
+*/
+void *FT_replaceContentsById(size_t ulID, void *pvNewContents,
+                             size_t ulNewLength);
+
+/*
+  Looks up the contents of each of the ulPaths files whose absolute
+  paths are in ppcPaths, resolving them in one walk that reuses the
+  ancestors shared by consecutive paths. The paths are sorted first
+  unless bSorted is TRUE, in which case they must already be in
+  strcmp order for the walk to share ancestors (unsorted input is
+  still resolved correctly, only less efficiently).
+  For each index i, sets piStatuses[i] and ppvContents[i]:
+  * SUCCESS, with the file's contents (which may be NULL)
+  * BAD_PATH, CONFLICTING_PATH, NO_SUCH_PATH, NOT_A_DIRECTORY or
+    MEMORY_ERROR, as for FT_stat, with NULL contents
+  * NOT_A_FILE if ppcPaths[i] is in the FT as a directory, with NULL
+    contents
+  Returns SUCCESS if every path was looked up. Otherwise, leaves the
+  output arrays unchanged and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to sort the paths
+*/
+int FT_getFileContentsMany(const char **ppcPaths, size_t ulPaths,
+                           boolean bSorted, void **ppvContents,
+                           int *piStatuses);
+
+/*
+  Behaves as FT_stat for each of the ulPaths absolute paths in
+  ppcPaths, resolving them in one walk as FT_getFileContentsMany does.
+  For each index i, sets piStatuses[i] to the status FT_stat would
+  return, and on SUCCESS sets pbIsFile[i] and pulSizes[i] as FT_stat
+  would set *pbIsFile and *pulSize.
+  Returns SUCCESS if every path was looked up. Otherwise, leaves the
+  output arrays unchanged and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to sort the paths
+*/
+int FT_statMany(const char **ppcPaths, size_t ulPaths, boolean bSorted,
+                boolean *pbIsFile, size_t *pulSizes, int *piStatuses);
+
+/*
+  Loads records into the FT, calling (*pfNext)(pvExtra, &pcPath,
+  &bIsFile, &pvContents, &ulLength) for each record until it returns
+  FALSE. A record inserts a directory (if bIsFile is FALSE) or a file
+  with contents pvContents of size ulLength bytes (if TRUE) at
+  absolute path pcPath, as FT_insertDir or FT_insertFile would; any
+  missing ancestor directories are inserted too.
+  Records in strcmp order of pcPath are loaded in one pass, each
+  costing only the levels it does not share with the record before
+  it, with every directory's children array fitted to its final size.
+  Records out of order are still loaded, one traversal each.
+  All other writes to the FT are excluded for the whole load, so
+  pfNext must not write to the FT itself.
+  Returns SUCCESS if every record is loaded. Otherwise, stops at the
+  first record that cannot be loaded, leaving all records before it
+  in the FT, and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * any other status that FT_insertDir or FT_insertFile would return
+    for that record
+*/
+int FT_bulkLoad(boolean (*pfNext)(void *pvExtra, const char **ppcPath,
+                                  boolean *pbIsFile, void **ppvContents,
+                                  size_t *pulLength),
+                void *pvExtra);
+
+/*
+  Enables a negative-lookup filter over the pathnames in the FT, sized
+  for ulExpectedPaths paths at a false positive rate of at most
+  dFalsePositiveRate (strictly between 0 and 1), using at most
+  ulMaxBytes bytes if ulMaxBytes is nonzero. While it is enabled,
+  FT_containsDir, FT_containsFile and FT_getFileContents answer for
+  most absent paths without traversing the FT. Replaces any filter
+  already enabled, and is maintained by every insertion and removal
+  until disabled or the FT is destroyed.
+  Returns SUCCESS if the filter is enabled. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_enableFilter(size_t ulExpectedPaths, double dFalsePositiveRate,
+                    size_t ulMaxBytes);
+
+/*
+  Disables the negative-lookup filter, if any, and frees its memory.
+  Returns INITIALIZATION_ERROR if the FT is not in an initialized
+  state, and SUCCESS otherwise.
+*/
+int FT_disableFilter(void);
+
+/*
+  Stores the negative-lookup filter's counters into the non-NULL
+  parameters: the number of lookups it was consulted for, the number
+  it answered as definite misses without a traversal, the number it
+  passed on that turned out to be absent anyway (false positives),
+  and its size in bytes.
+  Returns SUCCESS if the counters are stored. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * NO_SUCH_PATH if the filter is not enabled
+*/
+int FT_getFilterStats(size_t *pulQueries, size_t *pulMisses,
+                      size_t *pulFalsePositives, size_t *pulBytes);
+
+/*
+  Enables deduplication of the contents that the FT owns: those that
+  it copies, and those that it frees itself (see FT_insertFileOwned
+  and FT_setContentsFree). While it is enabled, each such contents
+  inserted or replaced is hashed, and stored once in a content store
+  however many files hold the same bytes, shared between them and
+  freed when the last of them is removed or replaced. Contents given
+  to the FT to free are freed at once, once the file holds the stored
+  copy in their place, so FT_getFileContents returns the stored copy
+  rather than the contents given. Contents left to the client are
+  not deduplicated, nor are contents stored before deduplication was
+  enabled. Does nothing if deduplication is already enabled.
+  Returns SUCCESS if deduplication is enabled. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_enableDedup(void);
+
+/*
+  Disables deduplication, if it is enabled. Contents already stored
+  stay shared until their files drop them. Returns
+  INITIALIZATION_ERROR if the FT is not in an initialized state, and
+  SUCCESS otherwise.
+*/
+int FT_disableDedup(void);
+
+/*
+  Stores the content store's counters into the non-NULL parameters:
+  the number of distinct contents it holds, the number of times they
+  are held (by files, and by snapshots and open transactions that
+  keep contents since replaced), the number of bytes it stores, the
+  number of bytes that storing each contents once saves, and the
+  dedup ratio, the bytes held over the bytes stored (1.0 if none).
+  Returns SUCCESS if the counters are stored. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * NO_SUCH_PATH if deduplication is not enabled
+*/
+int FT_getDedupStats(size_t *pulBlobs, size_t *pulRefs,
+                     size_t *pulStoredBytes, size_t *pulBytesSaved,
+                     double *pdRatio);
+
+/*
+  Compresses the contents that the FT owns, as it finds them now:
+  those of ulThreshold bytes or more, and those not read since the
+  last call (by FT_getFileContents, the functions like it, or
+  FT_readAt), so that calling this every so often compresses contents
+  left unread for that long. Compressed contents take less memory,
+  and read the same: the first read of them decompresses them into a
+  copy that the FT keeps with them, and reads after it find that copy
+  at once, until a call finds the contents unread since the last, and
+  drops the copy. Each of these, like a change to the file's
+  contents, ends the life of contents that FT_getFileContents
+  returned for the file. Contents left to the client, chunked
+  contents (see FT_writeAt), deduplicated contents (see
+  FT_enableDedup), contents that would not shrink by an eighth, and
+  contents in a subtree that a snapshot shares are left as they are.
+  Sets *pulCompressed, unless pulCompressed is NULL, to the number of
+  files whose contents were compressed.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state, or
+    if the calling thread has a transaction open on it
+  * MEMORY_ERROR if memory could not be allocated for the compressor
+  Contents that memory could not be allocated to compress are left
+  as they are.
+*/
+int FT_compress(size_t ulThreshold, size_t *pulCompressed);
+
+/*
+  Stores the statistics of FT_compress into the non-NULL parameters:
+  the number of bytes it has compressed, the number they compressed
+  to, and the ratio of the two (1.0 if none); the CPU seconds spent
+  compressing and decompressing contents; and the number of reads of
+  compressed contents that found them already decompressed (hits)
+  and that decompressed them (misses). The counts are kept from the
+  first FT_compress until FT_destroy.
+  Returns SUCCESS if the statistics are stored. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * NO_SUCH_PATH if FT_compress has not been called
+*/
+int FT_getCompressionStats(size_t *pulPlainBytes, size_t *pulPackedBytes,
+                           double *pdRatio, double *pdCompressSeconds,
+                           double *pdExpandSeconds, size_t *pulHits,
+                           size_t *pulMisses);
+
+/*
+  Puts the FT under a memory budget of ulBudget bytes, spilling the
+  contents it owns to the spill file pcSpillFile, which is created,
+  replacing any file of that name, and removed at once, so that it never
+  outlives the process. Whenever contents added to memory since it was
+  last enforced (by FT_insertFile, FT_replaceFileContents, FT_writeAt,
+  the functions like them, and the first read of spilled contents, which
+  reads them back, of compressed contents, which decompresses them, or
+  of contents written with FT_writeAt, which flattens them) may have
+  pushed the contents in memory over the budget, the FT enforces it, on
+  the next operation that adds contents or reads them while no other
+  operation writes: if the contents take more than three quarters of it,
+  the files least recently read or written are spilled until they take
+  no more, sparing those read since the budget was last enforced.
+  Spilled contents read the same: reading them with FT_getFileContents
+  or the functions like it reads them back into a copy that the FT keeps
+  with them until they are spilled again, and FT_readAt reads them from
+  the spill file without keeping a copy. Each of these, like a change to
+  the file's contents, ends the life of contents that FT_getFileContents
+  returned for the file. Contents left to the client, deduplicated
+  contents (see FT_enableDedup), and contents in a subtree that a
+  snapshot shares are neither counted nor spilled. If spilling was
+  enabled before, only the budget changes, and pcSpillFile is ignored;
+  the spill file is kept until FT_destroy. Space that spilled contents
+  no longer need is reused by later spills before the file grows.
+  The budget is enforced once before returning. Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state, or
+    if the calling thread has a transaction open on it
+  * IO_ERROR if the spill file could not be created
+  * MEMORY_ERROR if memory could not be allocated for the budget
+  Contents that cannot be spilled stay in memory, over the budget.
+*/
+int FT_enableSpill(const char *pcSpillFile, size_t ulBudget);
+
+/*
+  Lifts the FT's memory budget, so that no more contents are spilled.
+  Contents already spilled stay so, and are read back as before.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_disableSpill(void);
+
+/*
+  Hints that the contents of the ulPaths files whose absolute paths
+  are in ppcPaths, sorted as for FT_getFileContentsMany, are about to
+  be read, so that those spilled (see FT_enableSpill) are read ahead
+  from the spill file in the background, as a later
+  FT_getFileContentsMany of the same paths would read them. Paths
+  that are not of files in the FT are ignored. Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to sort the paths
+*/
+int FT_prefetch(const char **ppcPaths, size_t ulPaths, boolean bSorted);
+
+/*
+  Stores the FT's spilling statistics into the non-NULL parameters:
+  the number of times contents were spilled, read back, and read
+  ahead by FT_prefetch; the number of bytes that the contents it
+  counts against its budget take in memory now, counted exactly; and
+  the size of the spill file in bytes. The counts are kept
+  from the first FT_enableSpill until FT_destroy. Waits for writes in
+  progress to finish. Returns SUCCESS if the statistics are stored.
+  Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * NO_SUCH_PATH if FT_enableSpill has not succeeded
+*/
+int FT_getSpillStats(size_t *pulSpills, size_t *pulReloads,
+                     size_t *pulPrefetches, size_t *pulResidentBytes,
+                     size_t *pulSpillBytes);
+
+/*
+  Begins a transaction on the FT, waiting for writes in progress to
+  finish. Until the calling thread commits or aborts it, the
+  transaction excludes the writes of every other thread, and groups
+  the writes of the calling thread, which may also read the FT, load
+  it in bulk and use its filter. An abort undoes every change to the
+  FT's hierarchy that those writes made, restoring each removed node,
+  its identifier and the handles on it, and each replaced file's
+  contents. Reads by other threads see the writes as they are made,
+  and see them undone if the transaction aborts. Returns SUCCESS if
+  the transaction begins. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state, or
+    if the calling thread already has a transaction open on it
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  A write in a transaction may also return MEMORY_ERROR if memory
+  could not be allocated to record it, in which case it is not made.
+*/
+int FT_begin(void);
+
+/*
+  Commits the transaction that the calling thread has open on the FT,
+  keeping its changes, and returns SUCCESS, or returns
+  INITIALIZATION_ERROR if the calling thread has none open.
+*/
+int FT_commit(void);
+
+/*
+  Aborts the transaction that the calling thread has open on the FT,
+  returning the FT's hierarchy to exactly the state it had when the
+  transaction began, and returns SUCCESS, or returns
+  INITIALIZATION_ERROR if the calling thread has none open. Contents
+  that the transaction's writes passed in are no longer referenced by
+  the FT afterwards.
+*/
+int FT_abort(void);
+
+/*
+  Opens the write-ahead log in the file named pcLogPath, creating it
+  if it does not exist, and rebuilds the FT, which must be empty, by
+  replaying the changes the log records, up to the first record that
+  a crash tore or corrupted, leaving out any transaction that never
+  ended. From then on, every change to the FT's hierarchy is appended
+  to the log, with a record of the beginning and end of each
+  transaction, and records are synced to disk in groups of
+  ulGroupSize, which must be positive, so that a crash loses at most
+  the changes of the last group not yet synced. No other operation
+  may overlap FT_openLog. Replayed contents are copies, in memory
+  allocated with malloc, that the client frees once it is done with
+  them as with any other. Returns SUCCESS if the log is open.
+  Otherwise, leaves the FT empty and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state, is
+    not empty or already has a log open, or if the calling thread has
+    a transaction open on it
+  * IO_ERROR if the file cannot be opened, read or written, or holds
+    records that are not of a hierarchy
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  A change that cannot be appended to the log is still made, and the
+  failure is reported by FT_syncLog and FT_closeLog.
+*/
+int FT_openLog(const char *pcLogPath, size_t ulGroupSize);
+
+/*
+  Syncs every change appended to the FT's log so far to disk. Returns
+  SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT has no log open
+  * IO_ERROR or MEMORY_ERROR if a change could not be appended to the
+    log since it was opened, in which case it holds only the changes
+    made before the first that could not
+*/
+int FT_syncLog(void);
+
+/*
+  Syncs and closes the FT's log, whose changes are then no longer
+  logged, and returns SUCCESS or a status as FT_syncLog does, except
+  that it returns INITIALIZATION_ERROR also if the calling thread has
+  a transaction open on the FT, leaving the log open. FT_destroy and
+  FT_free close the log too, ignoring any failure.
+*/
+int FT_closeLog(void);
+
+/*
+  Saves the FT to a checkpoint in the file named pcFile (see ckpt.h),
+  replacing any file of that name only once the whole checkpoint is
+  written and synced. The checkpoint holds the FT as it stood when the
+  save began, including every file's contents; writes may proceed
+  meanwhile. Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state, or
+    if the calling thread has a transaction open on it
+  * IO_ERROR if the checkpoint could not be written
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_save(const char *pcFile);
+
+/*
+  Loads the checkpoint in the file named pcFile into the FT, which
+  must be empty, rebuilding the hierarchy that was saved in a single
+  pass over the file. Loaded contents are copies, in memory allocated
+  with malloc, that the client frees once it is done with them as
+  with any other. Returns SUCCESS if the hierarchy is loaded.
+  Otherwise, leaves the FT empty and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state, is
+    not empty or has a log open, or if the calling thread has a
+    transaction open on it
+  * IO_ERROR if the file cannot be opened or read, or does not hold a
+    checkpoint of the current version
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_load(const char *pcFile);
+
+/*
+  Saves the FT to a read-only image in the file named pcFile (see
+  image.h), replacing any file of that name only once the whole image
+  is written and synced, which FT_openImage then maps and queries
+  without reading it in. The image holds the FT as it stood when the
+  save began, including every file's contents; writes may proceed
+  meanwhile. Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state, or
+    if the calling thread has a transaction open on it
+  * IO_ERROR if the image could not be written
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_saveImage(const char *pcFile);
+
+/*
+  Takes a snapshot of the FT, waiting for writes in progress to
+  finish, and sets *poSResult to it. Returns SUCCESS if the snapshot
+  is taken. Otherwise, leaves *poSResult unchanged and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state, or
+    if the calling thread has a transaction open on it
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_snapshot(FT_Snapshot_T *poSResult);
+
+/*
+  Releases oSSnapshot, freeing the nodes that only it still shares.
+  Does nothing if oSSnapshot is NULL.
+*/
+void FT_releaseSnapshot(FT_Snapshot_T oSSnapshot);
+
+/*
+  Each of the following functions behaves as the function of the same
+  name without the "Of" suffix, but on the FT as it stood when
+  oSSnapshot was taken.
+*/
+
+boolean FT_containsDirOf(FT_Snapshot_T oSSnapshot, const char *pcPath);
+
+boolean FT_containsFileOf(FT_Snapshot_T oSSnapshot, const char *pcPath);
+
+void *FT_getFileContentsOf(FT_Snapshot_T oSSnapshot, const char *pcPath);
+
+int FT_statOf(FT_Snapshot_T oSSnapshot, const char *pcPath,
+              boolean *pbIsFile, size_t *pulSize);
+
+int FT_getCountOf(FT_Snapshot_T oSSnapshot, size_t *pulCount);
+
+int FT_duOf(FT_Snapshot_T oSSnapshot, const char *pcPath,
+            size_t *pulFiles, size_t *pulDirs, size_t *pulBytes);
+
+int FT_topKOf(FT_Snapshot_T oSSnapshot, const char *pcPath, size_t ulK,
+              FT_RankBy_T eBy, char **ppcPaths, size_t *pulSizes,
+              size_t *pulFound);
+
+char *FT_toStringOf(FT_Snapshot_T oSSnapshot);
+
+int FT_saveOf(FT_Snapshot_T oSSnapshot, const char *pcFile);
+
+int FT_saveImageOf(FT_Snapshot_T oSSnapshot, const char *pcFile);
+
+/*
+  Returns a new, empty FT instance, already in an initialized state,
+  or NULL if insufficient memory is available.
+*/
+FT_T FT_new(void);
+
+/*
+  Frees oFTree and all of its contents. Does nothing if oFTree is NULL.
+  Handles opened on oFTree must not be used afterwards, other than to
+  close them, and node identifiers issued by oFTree are meaningless.
+  Every snapshot of oFTree must be released, and any transaction on
+  it committed or aborted, before it is freed.
+*/
+void FT_free(FT_T oFTree);
+
+/*
+  Maps the image in the file named pcFile, saved by FT_saveImage, and
+  sets *poFResult to a new FT instance that is a read-only view of it,
+  to be freed with FT_free. FT_containsDirIn, FT_containsFileIn,
+  FT_getFileContentsIn, FT_readAtIn, FT_statIn and FT_getCountIn
+  query the mapping in place, without reading the image in, and the
+  contents that FT_getFileContentsIn returns lie in the mapping, must not be
+  written, and are valid until the FT is freed. FT_statIn returns
+  IO_ERROR for a path along which the image is damaged. Every other
+  function treats the FT as one not in an initialized state. Returns
+  SUCCESS, or:
+  * IO_ERROR if the file cannot be opened or mapped, or does not hold
+    an image of the current version written on a machine of the same
+    word size and byte order
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_openImage(const char *pcFile, FT_T *poFResult);
+
+/*
+  Each of the following functions behaves as the function of the same
+  name without the "In" suffix, but on oFTree rather than on the
+  default FT. Handles opened with FT_openDirIn operate on oFTree, and
+  node identifiers from FT_lookupIdIn are valid only with oFTree.
+*/
+
+int FT_insertDirIn(FT_T oFTree, const char *pcPath);
+
+boolean FT_containsDirIn(FT_T oFTree, const char *pcPath);
+
+int FT_rmDirIn(FT_T oFTree, const char *pcPath);
+
+int FT_setContentsFreeIn(FT_T oFTree, void (*pfFree)(void *pvContents));
+
+int FT_insertFileOwnedIn(FT_T oFTree, const char *pcPath,
+                         void *pvContents, size_t ulLength,
+                         void (*pfFree)(void *pvContents));
+
+int FT_insertFileCopyIn(FT_T oFTree, const char *pcPath,
+                        const void *pvContents, size_t ulLength);
+
+int FT_insertFileMappedIn(FT_T oFTree, const char *pcPath,
+                          const char *pcFile, size_t ulOffset,
+                          size_t ulLength);
+
+int FT_replaceFileContentsOwnedIn(FT_T oFTree, const char *pcPath,
+                                  void *pvNewContents, size_t ulNewLength,
+                                  void (*pfFree)(void *pvContents));
+
+int FT_replaceFileContentsCopyIn(FT_T oFTree, const char *pcPath,
+                                 const void *pvNewContents,
+                                 size_t ulNewLength);
+
+int FT_readAtIn(FT_T oFTree, const char *pcPath, size_t ulOffset,
+                void *pvBuf, size_t ulLength, size_t *pulRead);
+
+int FT_writeAtIn(FT_T oFTree, const char *pcPath, size_t ulOffset,
+                 const void *pvBytes, size_t ulLength);
+
+int FT_appendIn(FT_T oFTree, const char *pcPath, const void *pvBytes,
+                size_t ulLength);
+
+int FT_insertFileIn(FT_T oFTree, const char *pcPath, void *pvContents,
+                    size_t ulLength);
+
+boolean FT_containsFileIn(FT_T oFTree, const char *pcPath);
+
+int FT_rmFileIn(FT_T oFTree, const char *pcPath);
+
+void *FT_getFileContentsIn(FT_T oFTree, const char *pcPath);
+
+void *FT_replaceFileContentsIn(FT_T oFTree, const char *pcPath,
+                               void *pvNewContents, size_t ulNewLength);
+
+int FT_statIn(FT_T oFTree, const char *pcPath, boolean *pbIsFile,
+              size_t *pulSize);
+
+int FT_getCountIn(FT_T oFTree, size_t *pulCount);
+
+int FT_duIn(FT_T oFTree, const char *pcPath, size_t *pulFiles,
+            size_t *pulDirs, size_t *pulBytes);
+
+int FT_topKIn(FT_T oFTree, const char *pcPath, size_t ulK,
+              FT_RankBy_T eBy, char **ppcPaths, size_t *pulSizes,
+              size_t *pulFound);
+
+int FT_beginIn(FT_T oFTree);
+
+int FT_commitIn(FT_T oFTree);
+
+int FT_abortIn(FT_T oFTree);
+
+int FT_openLogIn(FT_T oFTree, const char *pcLogPath, size_t ulGroupSize);
+
+int FT_syncLogIn(FT_T oFTree);
+
+int FT_closeLogIn(FT_T oFTree);
+
+int FT_saveIn(FT_T oFTree, const char *pcFile);
+
+int FT_loadIn(FT_T oFTree, const char *pcFile);
+
+int FT_saveImageIn(FT_T oFTree, const char *pcFile);
+
+int FT_snapshotIn(FT_T oFTree, FT_Snapshot_T *poSResult);
+
+char *FT_toStringIn(FT_T oFTree);
+
+int FT_openDirIn(FT_T oFTree, const char *pcPath, FT_Dir_T *poDResult);
+
+int FT_lookupIdIn(FT_T oFTree, const char *pcPath, size_t *pulID);
+
+void *FT_getContentsByIdIn(FT_T oFTree, size_t ulID);
+
+int FT_statByIdIn(FT_T oFTree, size_t ulID, boolean *pbIsFile,
+                  size_t *pulSize);
+
+void *FT_replaceContentsByIdIn(FT_T oFTree, size_t ulID,
+                               void *pvNewContents, size_t ulNewLength);
+
+int FT_getFileContentsManyIn(FT_T oFTree, const char **ppcPaths,
+                             size_t ulPaths, boolean bSorted,
+                             void **ppvContents, int *piStatuses);
+
+int FT_statManyIn(FT_T oFTree, const char **ppcPaths, size_t ulPaths,
+                  boolean bSorted, boolean *pbIsFile, size_t *pulSizes,
+                  int *piStatuses);
+
+int FT_bulkLoadIn(FT_T oFTree,
+                  boolean (*pfNext)(void *pvExtra, const char **ppcPath,
+                                    boolean *pbIsFile, void **ppvContents,
+                                    size_t *pulLength),
+                  void *pvExtra);
+
+int FT_enableFilterIn(FT_T oFTree, size_t ulExpectedPaths,
+                      double dFalsePositiveRate, size_t ulMaxBytes);
+
+int FT_disableFilterIn(FT_T oFTree);
+
+int FT_getFilterStatsIn(FT_T oFTree, size_t *pulQueries,
+                        size_t *pulMisses, size_t *pulFalsePositives,
+                        size_t *pulBytes);
+
+int FT_enableDedupIn(FT_T oFTree);
+
+int FT_disableDedupIn(FT_T oFTree);
+
+int FT_getDedupStatsIn(FT_T oFTree, size_t *pulBlobs, size_t *pulRefs,
+                       size_t *pulStoredBytes, size_t *pulBytesSaved,
+                       double *pdRatio);
+
+int FT_compressIn(FT_T oFTree, size_t ulThreshold, size_t *pulCompressed);
+
+int FT_getCompressionStatsIn(FT_T oFTree, size_t *pulPlainBytes,
+                             size_t *pulPackedBytes, double *pdRatio,
+                             double *pdCompressSeconds,
+                             double *pdExpandSeconds, size_t *pulHits,
+                             size_t *pulMisses);
+
+int FT_enableSpillIn(FT_T oFTree, const char *pcSpillFile,
+                     size_t ulBudget);
+
+int FT_disableSpillIn(FT_T oFTree);
+
+int FT_prefetchIn(FT_T oFTree, const char **ppcPaths, size_t ulPaths,
+                  boolean bSorted);
+
+int FT_getSpillStatsIn(FT_T oFTree, size_t *pulSpills, size_t *pulReloads,
+                       size_t *pulPrefetches, size_t *pulResidentBytes,
+                       size_t *pulSpillBytes);
+
 #endif
@@ -0,0 +1,2336 @@
+/*--------------------------------------------------------------------*/
+/* ft_bench.c                                                         */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ft.h"
+#include "shardft.h"
+#include "pagedft.h"
+#include "heapft.h"
+
+/* The shape of the benchmark tree: bench/dXX/dYY/fZZ */
+enum { FANOUT = 32, PATHLEN = 32 };
+
+/* The number of files in the benchmark tree */
+enum { NFILES = FANOUT * FANOUT * FANOUT };
+
+/*
+  Returns the CPU time elapsed since clkStart, in seconds.
+*/
+static double Bench_seconds(clock_t clkStart) {
+  return (double) (clock() - clkStart) / CLOCKS_PER_SEC;
+}
+
+/*
+  Returns the wall-clock time elapsed since *psStart, in seconds. CPU
+  time would sum over threads, so multi-threaded benchmarks use this.
+*/
+static double Bench_wallSeconds(const struct timespec *psStart) {
+  struct timespec sNow;
+
+  assert(psStart != NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &sNow);
+  return (double) (sNow.tv_sec - psStart->tv_sec)
+    + (double) (sNow.tv_nsec - psStart->tv_nsec) / 1e9;
+}
+
+/*
+  Returns the next value of the pseudo-random sequence whose state is
+  *pulState, so that benchmark runs are repeatable.
+*/
+static size_t Bench_random(size_t *pulState) {
+  assert(pulState != NULL);
+
+  *pulState = *pulState * 1103515245UL + 12345UL;
+  return (*pulState >> 16) & 0x7fff;
+}
+
+/*
+  Allocates and returns an array of the absolute paths of the NFILES
+  files in the benchmark tree, in sorted order. Exits on failure.
+*/
+static char **Bench_newPaths(void) {
+  char **ppcPaths;
+  size_t i, j, k;
+
+  ppcPaths = malloc(NFILES * sizeof(char *));
+  if(ppcPaths == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < FANOUT; i++)
+    for(j = 0; j < FANOUT; j++)
+      for(k = 0; k < FANOUT; k++) {
+        char *pcPath = malloc(PATHLEN);
+        if(pcPath == NULL) {
+          fprintf(stderr, "out of memory\n");
+          exit(EXIT_FAILURE);
+        }
+        sprintf(pcPath, "bench/d%02lu/d%02lu/f%02lu",
+                (unsigned long) i, (unsigned long) j,
+                (unsigned long) k);
+        ppcPaths[(i * FANOUT + j) * FANOUT + k] = pcPath;
+      }
+  return ppcPaths;
+}
+
+/* Frees the array of paths ppcPaths made by Bench_newPaths. */
+static void Bench_freePaths(char **ppcPaths) {
+  size_t i;
+
+  for(i = 0; i < NFILES; i++)
+    free(ppcPaths[i]);
+  free(ppcPaths);
+}
+
+/*
+  Returns a copy of the NFILES pointers in ppcPaths, shuffled.
+  Exits on failure.
+*/
+static const char **Bench_shuffled(char **ppcPaths) {
+  const char **ppcShuffled;
+  size_t ulState = 217;
+  size_t i;
+
+  ppcShuffled = malloc(NFILES * sizeof(char *));
+  if(ppcShuffled == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < NFILES; i++)
+    ppcShuffled[i] = ppcPaths[i];
+  for(i = NFILES - 1; i > 0; i--) {
+    size_t j = (Bench_random(&ulState) * 32768 +
+                Bench_random(&ulState)) % (i + 1);
+    const char *pcTemp = ppcShuffled[i];
+    ppcShuffled[i] = ppcShuffled[j];
+    ppcShuffled[j] = pcTemp;
+  }
+  return ppcShuffled;
+}
+
+/*
+  Inserts every file in ppcPaths into the FT, with each file's path
+  as its contents.
+*/
+static void Bench_build(const char **ppcPaths) {
+  size_t i;
+  int iStatus;
+
+  for(i = 0; i < NFILES; i++) {
+    iStatus = FT_insertFile(ppcPaths[i], (void *) ppcPaths[i],
+                            strlen(ppcPaths[i]) + 1);
+    assert(iStatus == SUCCESS);
+  }
+  (void) iStatus;
+}
+
+/*
+  Compares looking up every file in the benchmark tree one
+  FT_getFileContents call at a time against batched lookups with
+  FT_getFileContentsMany, on shuffled and on presorted input.
+*/
+static void Bench_multiGet(void) {
+  enum { ROUNDS = 5 };
+  char **ppcPaths;
+  const char **ppcShuffled;
+  void **ppvContents;
+  int *piStatuses;
+  size_t r, i;
+  clock_t clkStart;
+  double dLoop, dBatch, dSorted;
+
+  ppcPaths = Bench_newPaths();
+  ppcShuffled = Bench_shuffled(ppcPaths);
+  ppvContents = malloc(NFILES * sizeof(void *));
+  piStatuses = malloc(NFILES * sizeof(int));
+  if(ppvContents == NULL || piStatuses == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+
+  (void) FT_init();
+  Bench_build((const char **) ppcPaths);
+
+  clkStart = clock();
+  for(r = 0; r < ROUNDS; r++)
+    for(i = 0; i < NFILES; i++)
+      ppvContents[i] = FT_getFileContents(ppcShuffled[i]);
+  dLoop = Bench_seconds(clkStart);
+
+  clkStart = clock();
+  for(r = 0; r < ROUNDS; r++)
+    (void) FT_getFileContentsMany(ppcShuffled, NFILES, FALSE,
+                                  ppvContents, piStatuses);
+  dBatch = Bench_seconds(clkStart);
+  for(i = 0; i < NFILES; i++)
+    assert(piStatuses[i] == SUCCESS &&
+           !strcmp(ppvContents[i], ppcShuffled[i]));
+
+  clkStart = clock();
+  for(r = 0; r < ROUNDS; r++)
+    (void) FT_getFileContentsMany((const char **) ppcPaths, NFILES,
+                                  TRUE, ppvContents, piStatuses);
+  dSorted = Bench_seconds(clkStart);
+
+  (void) FT_destroy();
+
+  printf("multi-get: %d lookups x %d rounds\n", NFILES, ROUNDS);
+  printf("  looped FT_getFileContents   %8.1f ns/lookup\n",
+         dLoop * 1e9 / (NFILES * ROUNDS));
+  printf("  FT_getFileContentsMany      %8.1f ns/lookup\n",
+         dBatch * 1e9 / (NFILES * ROUNDS));
+  printf("  ... with presorted input    %8.1f ns/lookup\n",
+         dSorted * 1e9 / (NFILES * ROUNDS));
+
+  free(piStatuses);
+  free(ppvContents);
+  free(ppcShuffled);
+  Bench_freePaths(ppcPaths);
+}
+
+/* A stream of file records for FT_bulkLoad over an array of paths */
+struct pathStream {
+  /* the paths, each of which is also its file's contents */
+  const char **ppcPaths;
+  /* the index of the next path to produce */
+  size_t ulNext;
+};
+
+/* Produces the next file record of *psStream, if any. */
+static boolean Bench_nextRecord(struct pathStream *psStream,
+                                const char **ppcPath, boolean *pbIsFile,
+                                void **ppvContents, size_t *pulLength) {
+  const char *pcPath;
+
+  if(psStream->ulNext == NFILES)
+    return FALSE;
+
+  pcPath = psStream->ppcPaths[psStream->ulNext++];
+  *ppcPath = pcPath;
+  *pbIsFile = TRUE;
+  *ppvContents = (void *) pcPath;
+  *pulLength = strlen(pcPath) + 1;
+  return TRUE;
+}
+
+/*
+  Loads the records of *psStream into a fresh FT with FT_bulkLoad and
+  returns the CPU time taken, in seconds.
+*/
+static double Bench_timeBulkLoad(struct pathStream *psStream) {
+  clock_t clkStart;
+  double dSeconds;
+  int iStatus;
+
+  (void) FT_init();
+  clkStart = clock();
+  iStatus = FT_bulkLoad((boolean (*)(void *, const char **, boolean *,
+                                     void **, size_t *))
+                        Bench_nextRecord, psStream);
+  dSeconds = Bench_seconds(clkStart);
+  assert(iStatus == SUCCESS);
+  (void) iStatus;
+  (void) FT_destroy();
+  return dSeconds;
+}
+
+/*
+  Compares the startup time of building the benchmark tree with one
+  FT_insertFile call per file against FT_bulkLoad from a sorted
+  manifest, and from a shuffled one (which falls back to traversals).
+*/
+static void Bench_bulkLoad(void) {
+  char **ppcPaths;
+  const char **ppcShuffled;
+  struct pathStream sStream;
+  clock_t clkStart;
+  double dInsert, dInsertShuffled, dSorted, dShuffled;
+
+  ppcPaths = Bench_newPaths();
+  ppcShuffled = Bench_shuffled(ppcPaths);
+
+  (void) FT_init();
+  clkStart = clock();
+  Bench_build((const char **) ppcPaths);
+  dInsert = Bench_seconds(clkStart);
+  (void) FT_destroy();
+
+  (void) FT_init();
+  clkStart = clock();
+  Bench_build(ppcShuffled);
+  dInsertShuffled = Bench_seconds(clkStart);
+  (void) FT_destroy();
+
+  sStream.ppcPaths = (const char **) ppcPaths;
+  sStream.ulNext = 0;
+  dSorted = Bench_timeBulkLoad(&sStream);
+
+  sStream.ppcPaths = ppcShuffled;
+  sStream.ulNext = 0;
+  dShuffled = Bench_timeBulkLoad(&sStream);
+
+  printf("bulk load: %d files\n", NFILES);
+  printf("  looped FT_insertFile, sorted   %8.1f ms\n", dInsert * 1e3);
+  printf("  FT_bulkLoad, sorted            %8.1f ms\n", dSorted * 1e3);
+  printf("  looped FT_insertFile, shuffled %8.1f ms\n",
+         dInsertShuffled * 1e3);
+  printf("  FT_bulkLoad, shuffled          %8.1f ms\n", dShuffled * 1e3);
+
+  free(ppcShuffled);
+  Bench_freePaths(ppcPaths);
+}
+
+/* The paths that one thread of the instances benchmark works on */
+struct instanceWork {
+  /* the paths of the files to insert and look up, shared read-only */
+  const char **ppcPaths;
+};
+
+/*
+  Builds the benchmark tree in a private FT instance from the paths in
+  the struct instanceWork that pvWork points to, looks every file up
+  several times, and frees the instance. Returns NULL.
+*/
+static void *Bench_instanceThread(void *pvWork) {
+  enum { ROUNDS = 4 };
+  struct instanceWork *psWork = pvWork;
+  FT_T oFTree;
+  size_t r, i;
+  int iStatus;
+
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < NFILES; i++) {
+    iStatus = FT_insertFileIn(oFTree, psWork->ppcPaths[i],
+                              (void *) psWork->ppcPaths[i],
+                              strlen(psWork->ppcPaths[i]) + 1);
+    assert(iStatus == SUCCESS);
+  }
+  for(r = 0; r < ROUNDS; r++)
+    for(i = 0; i < NFILES; i++)
+      if(FT_getFileContentsIn(oFTree, psWork->ppcPaths[i]) == NULL)
+        fprintf(stderr, "lookup failed\n");
+  FT_free(oFTree);
+  (void) iStatus;
+  return NULL;
+}
+
+/*
+  Measures the aggregate throughput of N threads each inserting and
+  looking up the benchmark tree in its own FT instance, for N from 1
+  to 8. With no state shared between instances, throughput should
+  scale with N up to the number of cores.
+*/
+static void Bench_instances(void) {
+  enum { MAXTHREADS = 8, OPSPERTHREAD = NFILES * 5 };
+  pthread_t aThreads[MAXTHREADS];
+  struct instanceWork sWork;
+  char **ppcPaths;
+  const char **ppcShuffled;
+  struct timespec sStart;
+  size_t ulThreads, t;
+  double dSeconds, dBase = 0.0;
+
+  ppcPaths = Bench_newPaths();
+  ppcShuffled = Bench_shuffled(ppcPaths);
+  sWork.ppcPaths = ppcShuffled;
+
+  printf("instances: %d inserts + %d lookups per thread\n", NFILES,
+         OPSPERTHREAD - NFILES);
+  for(ulThreads = 1; ulThreads <= MAXTHREADS; ulThreads *= 2) {
+    double dOpsPerSec;
+
+    clock_gettime(CLOCK_MONOTONIC, &sStart);
+    for(t = 0; t < ulThreads; t++)
+      if(pthread_create(&aThreads[t], NULL, Bench_instanceThread,
+                        &sWork) != 0) {
+        fprintf(stderr, "cannot create thread\n");
+        exit(EXIT_FAILURE);
+      }
+    for(t = 0; t < ulThreads; t++)
+      (void) pthread_join(aThreads[t], NULL);
+    dSeconds = Bench_wallSeconds(&sStart);
+
+    dOpsPerSec = (double) OPSPERTHREAD * ulThreads / dSeconds;
+    if(ulThreads == 1)
+      dBase = dOpsPerSec;
+    printf("  %2lu thread(s)  %8.2f Mops/s  (x%.2f)\n",
+           (unsigned long) ulThreads, dOpsPerSec / 1e6,
+           dOpsPerSec / dBase);
+  }
+
+  free(ppcShuffled);
+  Bench_freePaths(ppcPaths);
+}
+
+/* The parameters of one thread of the read/write mix benchmark */
+struct mixWork {
+  /* the paths of the files in the shared FT, shared read-only */
+  const char **ppcPaths;
+  /* the path of the file that only this thread inserts and removes */
+  char acOwnPath[PATHLEN];
+  /* the percentage of operations that write */
+  size_t ulWritePercent;
+  /* the state of this thread's pseudo-random sequence */
+  size_t ulState;
+};
+
+/* The number of operations each thread of the mix benchmark runs */
+enum { MIXOPS = 20000 };
+
+/*
+  Runs MIXOPS operations on the default FT as described by the struct
+  mixWork that pvWork points to: each is a lookup of a random file,
+  or, ulWritePercent percent of the time, an insertion or removal of
+  the thread's own file. Returns NULL.
+*/
+static void *Bench_mixThread(void *pvWork) {
+  struct mixWork *psWork = pvWork;
+  boolean bOwnInserted = FALSE;
+  size_t i;
+
+  for(i = 0; i < MIXOPS; i++) {
+    if(Bench_random(&psWork->ulState) % 100 < psWork->ulWritePercent) {
+      if(bOwnInserted)
+        (void) FT_rmFile(psWork->acOwnPath);
+      else
+        (void) FT_insertFile(psWork->acOwnPath, NULL, 0);
+      bOwnInserted = !bOwnInserted;
+    }
+    else
+      (void) FT_getFileContents(
+        psWork->ppcPaths[Bench_random(&psWork->ulState) % NFILES]);
+  }
+  if(bOwnInserted)
+    (void) FT_rmFile(psWork->acOwnPath);
+  return NULL;
+}
+
+/*
+  Measures the aggregate throughput of 1 to 32 threads sharing the
+  default FT, under a read-only mix and a mix with 10% writes.
+*/
+static void Bench_rwMix(void) {
+  enum { MAXTHREADS = 32, NMIXES = 2 };
+  const size_t aulWritePercents[NMIXES] = {0, 10};
+  pthread_t aThreads[MAXTHREADS];
+  struct mixWork asWork[MAXTHREADS];
+  char **ppcPaths;
+  struct timespec sStart;
+  size_t m, ulThreads, t;
+
+  ppcPaths = Bench_newPaths();
+  (void) FT_init();
+  Bench_build((const char **) ppcPaths);
+
+  printf("rw mix: %d operations per thread on one shared FT\n", MIXOPS);
+  for(m = 0; m < NMIXES; m++) {
+    printf("  %lu%% writes\n", (unsigned long) aulWritePercents[m]);
+    for(ulThreads = 1; ulThreads <= MAXTHREADS; ulThreads *= 2) {
+      double dSeconds;
+
+      for(t = 0; t < ulThreads; t++) {
+        asWork[t].ppcPaths = (const char **) ppcPaths;
+        sprintf(asWork[t].acOwnPath, "bench/w%02lu", (unsigned long) t);
+        asWork[t].ulWritePercent = aulWritePercents[m];
+        asWork[t].ulState = t + 1;
+      }
+
+      clock_gettime(CLOCK_MONOTONIC, &sStart);
+      for(t = 0; t < ulThreads; t++)
+        if(pthread_create(&aThreads[t], NULL, Bench_mixThread,
+                          &asWork[t]) != 0) {
+          fprintf(stderr, "cannot create thread\n");
+          exit(EXIT_FAILURE);
+        }
+      for(t = 0; t < ulThreads; t++)
+        (void) pthread_join(aThreads[t], NULL);
+      dSeconds = Bench_wallSeconds(&sStart);
+
+      printf("    %2lu thread(s)  %8.2f Mops/s\n",
+             (unsigned long) ulThreads,
+             (double) MIXOPS * ulThreads / dSeconds / 1e6);
+    }
+  }
+
+  (void) FT_destroy();
+  Bench_freePaths(ppcPaths);
+}
+
+/* The parameters of one reader thread of the removal stress test */
+struct stressWork {
+  /* the paths of the files in the shared FT, shared read-only */
+  const char **ppcPaths;
+  /* the state of this thread's pseudo-random sequence */
+  size_t ulState;
+  /* the number of lookups that found their file */
+  size_t ulHits;
+  /* the number of lookups whose result was inconsistent */
+  size_t ulErrors;
+};
+
+/*
+  The subtrees of the benchmark tree that the stress test removes and
+  rebuilds, and the number of lookups each of its readers makes
+*/
+enum { HOTDIRS = 4, STRESSOPS = 50000 };
+
+/* Set once every reader of the stress test has finished */
+static int iStressDone;
+
+/*
+  Returns the index in the benchmark paths of a random file in one of
+  the HOTDIRS subtrees, using the pseudo-random sequence *pulState.
+*/
+static size_t Bench_hotFile(size_t *pulState) {
+  assert(pulState != NULL);
+
+  return Bench_random(pulState) % (HOTDIRS * FANOUT * FANOUT);
+}
+
+/*
+  Looks up random files of the subtrees being removed, as described by
+  the struct stressWork that pvWork points to: by path, by stat, and
+  through a handle on the file's parent directory. A file that is
+  found must be whole: its contents are its own path, and its size is
+  the length of that path. Returns NULL.
+*/
+static void *Bench_stressReader(void *pvWork) {
+  struct stressWork *psWork = pvWork;
+  size_t i;
+
+  for(i = 0; i < STRESSOPS; i++) {
+    const char *pcPath =
+      psWork->ppcPaths[Bench_hotFile(&psWork->ulState)];
+    const char *pcContents = NULL;
+
+    switch(i % 3) {
+    case 0:
+      pcContents = FT_getFileContents(pcPath);
+      break;
+    case 1: {
+      boolean bIsFile = FALSE;
+      size_t ulSize = 0;
+
+      if(FT_stat(pcPath, &bIsFile, &ulSize) == SUCCESS) {
+        if(!bIsFile || ulSize != strlen(pcPath) + 1)
+          psWork->ulErrors++;
+        pcContents = pcPath;
+      }
+      break;
+    }
+    default: {
+      /* the directory above the file: bench/dXX/dYY */
+      char acDir[PATHLEN];
+      FT_Dir_T oDDir = NULL;
+
+      strcpy(acDir, pcPath);
+      acDir[strlen(acDir) - 4] = '\0';
+      if(FT_openDir(acDir, &oDDir) == SUCCESS) {
+        pcContents = FT_getFileContentsAt(oDDir, pcPath + strlen(acDir)
+                                          + 1);
+        FT_closeDir(oDDir);
+      }
+      break;
+    }
+    }
+
+    if(pcContents != NULL) {
+      psWork->ulHits++;
+      if(strcmp(pcContents, pcPath) != 0)
+        psWork->ulErrors++;
+    }
+  }
+  return NULL;
+}
+
+/*
+  Removes and rebuilds the HOTDIRS subtrees, one at a time, until
+  every reader has finished. pvPaths is the array of benchmark paths.
+  Returns the number of subtrees removed, cast to a pointer.
+*/
+static void *Bench_stressWriter(void *pvPaths) {
+  const char **ppcPaths = pvPaths;
+  size_t ulRounds = 0;
+
+  while(!__atomic_load_n(&iStressDone, __ATOMIC_ACQUIRE)) {
+    size_t ulDir = ulRounds % HOTDIRS;
+    char acDir[PATHLEN];
+    size_t i;
+
+    sprintf(acDir, "bench/d%02lu", (unsigned long) ulDir);
+    if(FT_rmDir(acDir) != SUCCESS) {
+      fprintf(stderr, "cannot remove %s\n", acDir);
+      exit(EXIT_FAILURE);
+    }
+    for(i = ulDir * FANOUT * FANOUT; i < (ulDir + 1) * FANOUT * FANOUT;
+        i++)
+      (void) FT_insertFile(ppcPaths[i], (void *) ppcPaths[i],
+                           strlen(ppcPaths[i]) + 1);
+    ulRounds++;
+  }
+  return (void *) ulRounds;
+}
+
+/*
+  Inserts random files of the HOTDIRS subtrees, which the stress
+  test's other writer keeps removing, until every reader has
+  finished. pvPaths is the array of benchmark paths. Returns the
+  number of files inserted, cast to a pointer.
+*/
+static void *Bench_stressInserter(void *pvPaths) {
+  const char **ppcPaths = pvPaths;
+  size_t ulState = 12345;
+  size_t ulInserted = 0;
+
+  while(!__atomic_load_n(&iStressDone, __ATOMIC_ACQUIRE)) {
+    const char *pcPath = ppcPaths[Bench_hotFile(&ulState)];
+
+    if(FT_insertFile(pcPath, (void *) pcPath, strlen(pcPath) + 1)
+       == SUCCESS)
+      ulInserted++;
+  }
+  return (void *) ulInserted;
+}
+
+/*
+  Stress-tests the lock-free read path and the removal of subtrees
+  being written: 1 to 16 threads look up files in the default FT
+  while one writer repeatedly removes whole subtrees containing those
+  files with FT_rmDir and rebuilds them, and another inserts files
+  into the same subtrees. Every lookup must find either nothing or
+  the whole file, no node may be freed while a reader can still
+  reach it, and the FT must be whole afterwards. Exits on failure.
+*/
+static void Bench_rmStress(void) {
+  enum { MAXTHREADS = 16 };
+  pthread_t aThreads[MAXTHREADS];
+  pthread_t sWriter, sInserter;
+  struct stressWork asWork[MAXTHREADS];
+  char **ppcPaths;
+  char *pcTree, *pc;
+  size_t ulLines;
+  struct timespec sStart;
+  size_t ulThreads, t;
+
+  ppcPaths = Bench_newPaths();
+  (void) FT_init();
+  Bench_build((const char **) ppcPaths);
+
+  printf("rm stress: %d lookups per reader during FT_rmDir of %d "
+         "subtrees\n", STRESSOPS, HOTDIRS);
+  for(ulThreads = 1; ulThreads <= MAXTHREADS; ulThreads *= 2) {
+    void *pvRounds, *pvInserted;
+    size_t ulHits = 0, ulErrors = 0;
+    double dSeconds;
+
+    __atomic_store_n(&iStressDone, 0, __ATOMIC_RELEASE);
+    if(pthread_create(&sWriter, NULL, Bench_stressWriter, ppcPaths)
+       != 0 ||
+       pthread_create(&sInserter, NULL, Bench_stressInserter, ppcPaths)
+       != 0) {
+      fprintf(stderr, "cannot create thread\n");
+      exit(EXIT_FAILURE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &sStart);
+    for(t = 0; t < ulThreads; t++) {
+      asWork[t].ppcPaths = (const char **) ppcPaths;
+      asWork[t].ulState = t + 1;
+      asWork[t].ulHits = 0;
+      asWork[t].ulErrors = 0;
+      if(pthread_create(&aThreads[t], NULL, Bench_stressReader,
+                        &asWork[t]) != 0) {
+        fprintf(stderr, "cannot create thread\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    for(t = 0; t < ulThreads; t++) {
+      (void) pthread_join(aThreads[t], NULL);
+      ulHits += asWork[t].ulHits;
+      ulErrors += asWork[t].ulErrors;
+    }
+    dSeconds = Bench_wallSeconds(&sStart);
+    __atomic_store_n(&iStressDone, 1, __ATOMIC_RELEASE);
+    (void) pthread_join(sWriter, &pvRounds);
+    (void) pthread_join(sInserter, &pvInserted);
+
+    printf("  %2lu reader(s)  %8.2f Mlookups/s  %6lu rmDirs  "
+           "%7lu inserts  %5.1f%% found\n", (unsigned long) ulThreads,
+           (double) STRESSOPS * ulThreads / dSeconds / 1e6,
+           (unsigned long) (size_t) pvRounds,
+           (unsigned long) (size_t) pvInserted,
+           100.0 * ulHits / ((double) STRESSOPS * ulThreads));
+    if(ulErrors != 0) {
+      fprintf(stderr, "%lu inconsistent lookups\n",
+              (unsigned long) ulErrors);
+      exit(EXIT_FAILURE);
+    }
+
+    /* the removing writer's last act was to rebuild a whole subtree,
+       so every file must be back, and nothing else */
+    pcTree = FT_toString();
+    for(pc = pcTree, ulLines = 0; pc != NULL && *pc != '\0'; pc++)
+      if(*pc == '\n')
+        ulLines++;
+    free(pcTree);
+    for(t = 0; t < NFILES; t++)
+      if(FT_getFileContents(ppcPaths[t]) != ppcPaths[t])
+        ulLines = 0;
+    if(ulLines != 1 + FANOUT + FANOUT * FANOUT + NFILES) {
+      fprintf(stderr, "tree damaged by concurrent writers\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  (void) FT_destroy();
+  Bench_freePaths(ppcPaths);
+}
+
+/* The parameters of one writer thread of the parallel ingest */
+struct ingestWork {
+  /* the paths of the files to insert, shared read-only */
+  const char **ppcPaths;
+  /* the number of threads inserting, and this thread's index */
+  size_t ulThreads;
+  size_t ulIndex;
+  /* TRUE if each thread inserts whole subtrees of its own, or FALSE
+     if the threads interleave their files within shared directories */
+  boolean bDisjoint;
+};
+
+/*
+  Inserts this thread's share of the benchmark files into the default
+  FT, as described by the struct ingestWork that pvWork points to.
+  Exits on failure. Returns NULL.
+*/
+static void *Bench_ingestThread(void *pvWork) {
+  struct ingestWork *psWork = pvWork;
+  size_t i;
+
+  for(i = 0; i < NFILES; i++) {
+    /* a subtree bench/dXX holds FANOUT * FANOUT consecutive files */
+    size_t ulOwner = psWork->bDisjoint ? i / (FANOUT * FANOUT) : i;
+
+    if(ulOwner % psWork->ulThreads != psWork->ulIndex)
+      continue;
+    if(FT_insertFile(psWork->ppcPaths[i], (void *) psWork->ppcPaths[i],
+                     strlen(psWork->ppcPaths[i]) + 1) != SUCCESS) {
+      fprintf(stderr, "cannot insert %s\n", psWork->ppcPaths[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  return NULL;
+}
+
+/*
+  Measures parallel ingest: 1 to 16 threads together insert the
+  benchmark files into an empty default FT, either each into
+  top-level subtrees of its own, where their writes never wait for
+  each other below the root, or interleaved within the same
+  directories. Checks afterwards that every file is in the FT.
+*/
+static void Bench_ingest(void) {
+  enum { MAXTHREADS = 16 };
+  pthread_t aThreads[MAXTHREADS];
+  struct ingestWork asWork[MAXTHREADS];
+  char **ppcPaths;
+  struct timespec sStart;
+  size_t ulThreads, t, i;
+  int iDisjoint;
+
+  ppcPaths = Bench_newPaths();
+
+  printf("ingest: %d files inserted by concurrent writers\n", NFILES);
+  for(iDisjoint = 1; iDisjoint >= 0; iDisjoint--) {
+    printf("  %s\n", iDisjoint ? "disjoint subtrees"
+                                : "shared directories");
+    for(ulThreads = 1; ulThreads <= MAXTHREADS; ulThreads *= 2) {
+      double dSeconds;
+
+      (void) FT_init();
+      clock_gettime(CLOCK_MONOTONIC, &sStart);
+      for(t = 0; t < ulThreads; t++) {
+        asWork[t].ppcPaths = (const char **) ppcPaths;
+        asWork[t].ulThreads = ulThreads;
+        asWork[t].ulIndex = t;
+        asWork[t].bDisjoint = (boolean) iDisjoint;
+        if(pthread_create(&aThreads[t], NULL, Bench_ingestThread,
+                          &asWork[t]) != 0) {
+          fprintf(stderr, "cannot create thread\n");
+          exit(EXIT_FAILURE);
+        }
+      }
+      for(t = 0; t < ulThreads; t++)
+        (void) pthread_join(aThreads[t], NULL);
+      dSeconds = Bench_wallSeconds(&sStart);
+
+      for(i = 0; i < NFILES; i++)
+        if(FT_getFileContents(ppcPaths[i]) != ppcPaths[i]) {
+          fprintf(stderr, "lost %s\n", ppcPaths[i]);
+          exit(EXIT_FAILURE);
+        }
+      (void) FT_destroy();
+
+      printf("    %2lu thread(s)  %8.2f Minserts/s\n",
+             (unsigned long) ulThreads, (double) NFILES / dSeconds / 1e6);
+    }
+  }
+
+  Bench_freePaths(ppcPaths);
+}
+
+/* The parameters of one writer thread of the sharding benchmark */
+struct shardWork {
+  /* the paths of the files to insert, shared read-only */
+  const char **ppcPaths;
+  /* the number of threads inserting, and this thread's index */
+  size_t ulThreads;
+  size_t ulIndex;
+  /* the FT to insert into, or NULL to insert into oSTree */
+  FT_T oFTree;
+  ShardFT_T oSTree;
+};
+
+/*
+  Inserts the files of this thread's top-level subtrees into the FT
+  or sharded FT of the struct shardWork that pvWork points to. Exits
+  on failure. Returns NULL.
+*/
+static void *Bench_shardThread(void *pvWork) {
+  struct shardWork *psWork = pvWork;
+  size_t i;
+
+  for(i = 0; i < NFILES; i++) {
+    const char *pcPath = psWork->ppcPaths[i];
+    int iStatus;
+
+    if(i / (FANOUT * FANOUT) % psWork->ulThreads != psWork->ulIndex)
+      continue;
+    if(psWork->oFTree != NULL)
+      iStatus = FT_insertFileIn(psWork->oFTree, pcPath, (void *) pcPath,
+                                strlen(pcPath) + 1);
+    else
+      iStatus = ShardFT_insertFile(psWork->oSTree, pcPath,
+                                   (void *) pcPath, strlen(pcPath) + 1);
+    if(iStatus != SUCCESS) {
+      fprintf(stderr, "cannot insert %s\n", pcPath);
+      exit(EXIT_FAILURE);
+    }
+  }
+  return NULL;
+}
+
+/*
+  Runs ulThreads threads of Bench_shardThread inserting the files in
+  ppcPaths into oFTree, or into oSTree if oFTree is NULL. Returns the
+  wall-clock time they took, in seconds.
+*/
+static double Bench_shardIngest(char **ppcPaths, size_t ulThreads,
+                                FT_T oFTree, ShardFT_T oSTree) {
+  enum { MAXTHREADS = 16 };
+  pthread_t aThreads[MAXTHREADS];
+  struct shardWork asWork[MAXTHREADS];
+  struct timespec sStart;
+  size_t t;
+
+  assert(ulThreads <= MAXTHREADS);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(t = 0; t < ulThreads; t++) {
+    asWork[t].ppcPaths = (const char **) ppcPaths;
+    asWork[t].ulThreads = ulThreads;
+    asWork[t].ulIndex = t;
+    asWork[t].oFTree = oFTree;
+    asWork[t].oSTree = oSTree;
+    if(pthread_create(&aThreads[t], NULL, Bench_shardThread,
+                      &asWork[t]) != 0) {
+      fprintf(stderr, "cannot create thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  for(t = 0; t < ulThreads; t++)
+    (void) pthread_join(aThreads[t], NULL);
+  return Bench_wallSeconds(&sStart);
+}
+
+/*
+  Measures the scaling of a sharded FT: 1 to 16 threads insert the
+  benchmark files, each thread into top-level subtrees of its own,
+  into one FT instance, whose writers all pass through its root, and
+  into a sharded FT, whose writers share no lock unless their
+  subtrees hash to the same shard. Checks that both end up with the
+  same hierarchy.
+*/
+static void Bench_shards(void) {
+  enum { MAXTHREADS = 16, NSHARDS = 16 };
+  char **ppcPaths;
+  size_t ulThreads;
+
+  ppcPaths = Bench_newPaths();
+
+  printf("shards: %d files inserted by concurrent writers into "
+         "disjoint subtrees\n", NFILES);
+  for(ulThreads = 1; ulThreads <= MAXTHREADS; ulThreads *= 2) {
+    FT_T oFTree;
+    ShardFT_T oSTree;
+    double dSingle, dSharded;
+    char *pcSingle, *pcSharded;
+    size_t ulSingle = 0, ulSharded = 0;
+
+    oFTree = FT_new();
+    oSTree = ShardFT_new(NSHARDS);
+    if(oFTree == NULL || oSTree == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    dSingle = Bench_shardIngest(ppcPaths, ulThreads, oFTree, NULL);
+    dSharded = Bench_shardIngest(ppcPaths, ulThreads, NULL, oSTree);
+
+    pcSingle = FT_toStringIn(oFTree);
+    pcSharded = ShardFT_toString(oSTree);
+    (void) FT_getCountIn(oFTree, &ulSingle);
+    (void) ShardFT_getCount(oSTree, &ulSharded);
+    if(pcSingle == NULL || pcSharded == NULL ||
+       strcmp(pcSingle, pcSharded) != 0 || ulSingle != ulSharded) {
+      fprintf(stderr, "sharded FT differs from single FT\n");
+      exit(EXIT_FAILURE);
+    }
+    free(pcSingle);
+    free(pcSharded);
+    FT_free(oFTree);
+    ShardFT_free(oSTree);
+
+    printf("  %2lu thread(s)  %8.2f Minserts/s single  "
+           "%8.2f Minserts/s %d shards\n", (unsigned long) ulThreads,
+           (double) NFILES / dSingle / 1e6,
+           (double) NFILES / dSharded / 1e6, NSHARDS);
+  }
+
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Measures the cost of snapshots to writers: replaces the contents of
+  every benchmark file once, in shuffled order, while taking k
+  snapshots evenly spaced through the writes, so that each pins a
+  different version of the FT, and keeping them all live to the end.
+  The first write below a snapshot copies the path down from the root,
+  so the overhead falls as later writes find their paths already
+  copied. Checks that the first snapshot still holds every file's
+  original contents.
+*/
+static void Bench_snapshots(void) {
+  enum { MAXSNAPSHOTS = 16 };
+  char **ppcPaths;
+  const char **ppcShuffled;
+  FT_Snapshot_T aoSSnaps[MAXSNAPSHOTS];
+  size_t ulSnaps, s, i;
+  double dNone = 0.0;
+
+  ppcPaths = Bench_newPaths();
+  ppcShuffled = Bench_shuffled(ppcPaths);
+
+  printf("snapshots: %d shuffled content replacements with k live "
+         "snapshots\n", NFILES);
+  for(ulSnaps = 0; ulSnaps <= MAXSNAPSHOTS;
+      ulSnaps = ulSnaps == 0 ? 1 : 4 * ulSnaps) {
+    FT_T oFTree;
+    clock_t clkStart;
+    double dWrites, dSnaps = 0.0;
+
+    oFTree = FT_new();
+    if(oFTree == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    for(i = 0; i < NFILES; i++)
+      (void) FT_insertFileIn(oFTree, ppcPaths[i], (void *) ppcPaths[i],
+                             strlen(ppcPaths[i]) + 1);
+
+    /* the writes between consecutive snapshots are timed together */
+    s = 0;
+    dWrites = 0.0;
+    clkStart = clock();
+    for(i = 0; i < NFILES; i++) {
+      if(s < ulSnaps && i == s * (NFILES / ulSnaps)) {
+        dWrites += Bench_seconds(clkStart);
+        clkStart = clock();
+        if(FT_snapshotIn(oFTree, &aoSSnaps[s]) != SUCCESS) {
+          fprintf(stderr, "out of memory\n");
+          exit(EXIT_FAILURE);
+        }
+        dSnaps += Bench_seconds(clkStart);
+        s++;
+        clkStart = clock();
+      }
+      (void) FT_replaceFileContentsIn(oFTree, ppcShuffled[i], NULL, 0);
+    }
+    dWrites += Bench_seconds(clkStart);
+
+    if(ulSnaps != 0)
+      for(i = 0; i < NFILES; i++)
+        if(FT_getFileContentsOf(aoSSnaps[0], ppcPaths[i])
+           != ppcPaths[i]) {
+          fprintf(stderr, "snapshot changed by a later write\n");
+          exit(EXIT_FAILURE);
+        }
+    for(s = 0; s < ulSnaps; s++)
+      FT_releaseSnapshot(aoSSnaps[s]);
+    FT_free(oFTree);
+
+    if(ulSnaps == 0) {
+      dNone = dWrites;
+      printf("  k = %2lu  %8.1f ns/write\n", (unsigned long) ulSnaps,
+             dWrites * 1e9 / NFILES);
+    }
+    else
+      printf("  k = %2lu  %8.1f ns/write (x%.2f)  %8.1f ns/snapshot\n",
+             (unsigned long) ulSnaps, dWrites * 1e9 / NFILES,
+             dWrites / dNone, dSnaps * 1e9 / ulSnaps);
+  }
+
+  free(ppcShuffled);
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Measures the cost of a write-ahead log to writers, and how group
+  commit recovers it: inserts the first WALFILES benchmark files, each
+  with its path as contents, with no log and then logging them with
+  fsyncs batched in groups of increasing size, and reports the
+  throughput and the number of syncs of each. Then times rebuilding
+  the FT by replaying the last log, and checks the replayed contents.
+  Times are wall-clock, since most of a sync is spent waiting on the
+  disk rather than on the CPU.
+*/
+static void Bench_wal(void) {
+  enum { WALFILES = 4096, MAXGROUP = 1024 };
+  static const char *pcLog = "ftbench.wal";
+  char **ppcPaths;
+  FT_T oFTree;
+  struct timespec sStart;
+  size_t ulGroup, ulCount, i;
+  double dNone = 0.0, dSeconds;
+
+  ppcPaths = Bench_newPaths();
+
+  printf("wal: %d file insertions, logged with fsyncs in groups of g\n",
+         WALFILES);
+  for(ulGroup = 0; ulGroup <= MAXGROUP;
+      ulGroup = ulGroup == 0 ? 1 : 4 * ulGroup) {
+    (void) remove(pcLog);
+    oFTree = FT_new();
+    if(oFTree == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    if(ulGroup != 0 && FT_openLogIn(oFTree, pcLog, ulGroup) != SUCCESS) {
+      fprintf(stderr, "cannot open %s\n", pcLog);
+      exit(EXIT_FAILURE);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &sStart);
+    for(i = 0; i < WALFILES; i++)
+      (void) FT_insertFileIn(oFTree, ppcPaths[i], (void *) ppcPaths[i],
+                             strlen(ppcPaths[i]) + 1);
+    if(ulGroup != 0 && FT_syncLogIn(oFTree) != SUCCESS) {
+      fprintf(stderr, "cannot sync %s\n", pcLog);
+      exit(EXIT_FAILURE);
+    }
+    dSeconds = Bench_wallSeconds(&sStart);
+
+    if(ulGroup != 0 && FT_closeLogIn(oFTree) != SUCCESS) {
+      fprintf(stderr, "cannot close %s\n", pcLog);
+      exit(EXIT_FAILURE);
+    }
+    FT_free(oFTree);
+
+    if(ulGroup == 0) {
+      dNone = dSeconds;
+      printf("  no log    %10.0f ops/s\n", WALFILES / dSeconds);
+    }
+    else
+      printf("  g = %4lu  %10.0f ops/s (x%.2f)  %5lu syncs\n",
+             (unsigned long) ulGroup, WALFILES / dSeconds,
+             dSeconds / dNone,
+             (unsigned long) ((WALFILES + ulGroup - 1) / ulGroup));
+  }
+
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(FT_openLogIn(oFTree, pcLog, MAXGROUP) != SUCCESS) {
+    fprintf(stderr, "cannot replay %s\n", pcLog);
+    exit(EXIT_FAILURE);
+  }
+  dSeconds = Bench_wallSeconds(&sStart);
+  (void) FT_getCountIn(oFTree, &ulCount);
+  for(i = 0; i < WALFILES; i++) {
+    char *pcContents = FT_getFileContentsIn(oFTree, ppcPaths[i]);
+    if(pcContents == NULL || strcmp(pcContents, ppcPaths[i])) {
+      fprintf(stderr, "replay lost %s\n", ppcPaths[i]);
+      exit(EXIT_FAILURE);
+    }
+    free(pcContents);
+  }
+  (void) FT_closeLogIn(oFTree);
+  FT_free(oFTree);
+  (void) remove(pcLog);
+  printf("  replay    %10.0f ops/s  %5lu nodes rebuilt\n",
+         WALFILES / dSeconds, (unsigned long) ulCount);
+
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Measures checkpoints: builds the benchmark tree with CKPTBYTES bytes
+  of contents per file, saves it with FT_saveIn and loads it back into
+  an empty FT with FT_loadIn, and reports each against the time to
+  build the tree by inserting its files and to read the checkpoint
+  file sequentially, which bounds a load. Times are wall-clock, since
+  a save ends with a sync.
+*/
+static void Bench_checkpoint(void) {
+  enum { CKPTBYTES = 1024 };
+  static const char *pcCheckpoint = "ftbench.ckpt";
+  static char acContents[CKPTBYTES];
+  char **ppcPaths;
+  FT_T oFTree;
+  FILE *psFile;
+  char *pcBuffer;
+  struct timespec sStart;
+  double dBuild, dSave, dRead, dLoad, dMB;
+  size_t ulBytes, ulCount, i;
+
+  ppcPaths = Bench_newPaths();
+  pcBuffer = malloc(1 << 16);
+  oFTree = FT_new();
+  if(pcBuffer == NULL || oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++)
+    (void) FT_insertFileIn(oFTree, ppcPaths[i], acContents, CKPTBYTES);
+  dBuild = Bench_wallSeconds(&sStart);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(FT_saveIn(oFTree, pcCheckpoint) != SUCCESS) {
+    fprintf(stderr, "cannot save %s\n", pcCheckpoint);
+    exit(EXIT_FAILURE);
+  }
+  dSave = Bench_wallSeconds(&sStart);
+  FT_free(oFTree);
+
+  /* the checkpoint is in the page cache now, as it is for a load */
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  psFile = fopen(pcCheckpoint, "rb");
+  if(psFile == NULL) {
+    fprintf(stderr, "cannot read %s\n", pcCheckpoint);
+    exit(EXIT_FAILURE);
+  }
+  ulBytes = 0;
+  while((i = fread(pcBuffer, 1, 1 << 16, psFile)) > 0)
+    ulBytes += i;
+  (void) fclose(psFile);
+  dRead = Bench_wallSeconds(&sStart);
+  dMB = (double) ulBytes / (1 << 20);
+
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(FT_loadIn(oFTree, pcCheckpoint) != SUCCESS) {
+    fprintf(stderr, "cannot load %s\n", pcCheckpoint);
+    exit(EXIT_FAILURE);
+  }
+  dLoad = Bench_wallSeconds(&sStart);
+  (void) FT_getCountIn(oFTree, &ulCount);
+  for(i = 0; i < NFILES; i++)
+    free(FT_getFileContentsIn(oFTree, ppcPaths[i]));
+  FT_free(oFTree);
+  (void) remove(pcCheckpoint);
+
+  printf("checkpoint: %lu nodes, %d bytes per file, %.1f MB\n",
+         (unsigned long) ulCount, CKPTBYTES, dMB);
+  printf("  looped FT_insertFile  %8.1f ms\n", dBuild * 1e3);
+  printf("  FT_save               %8.1f ms  %8.1f MB/s\n", dSave * 1e3,
+         dMB / dSave);
+  printf("  sequential read       %8.1f ms  %8.1f MB/s\n", dRead * 1e3,
+         dMB / dRead);
+  printf("  FT_load               %8.1f ms  %8.1f MB/s\n", dLoad * 1e3,
+         dMB / dLoad);
+
+  free(pcBuffer);
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Measures images: saves the benchmark tree, with IMAGEBYTES bytes of
+  contents per file, both as a checkpoint and as an image, then
+  reports the time from nothing to an FT that answers queries, by
+  FT_loadIn and by FT_openImage, and the rate of FT_statIn over every
+  file in each. Times are wall-clock, and both files are in the page
+  cache when they are read.
+*/
+static void Bench_image(void) {
+  enum { IMAGEBYTES = 1024 };
+  static const char *pcCheckpoint = "ftbench.ckpt";
+  static const char *pcImage = "ftbench.img";
+  static char acContents[IMAGEBYTES];
+  char **ppcPaths;
+  FT_T oFTree, oFTImage;
+  boolean bIsFile;
+  struct timespec sStart;
+  double dLoad, dOpen, dLoaded, dMapped;
+  size_t ulSize, ulFound, i;
+
+  ppcPaths = Bench_newPaths();
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < NFILES; i++)
+    (void) FT_insertFileIn(oFTree, ppcPaths[i], acContents, IMAGEBYTES);
+  if(FT_saveIn(oFTree, pcCheckpoint) != SUCCESS ||
+     FT_saveImageIn(oFTree, pcImage) != SUCCESS) {
+    fprintf(stderr, "cannot save %s or %s\n", pcCheckpoint, pcImage);
+    exit(EXIT_FAILURE);
+  }
+  FT_free(oFTree);
+
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(FT_loadIn(oFTree, pcCheckpoint) != SUCCESS) {
+    fprintf(stderr, "cannot load %s\n", pcCheckpoint);
+    exit(EXIT_FAILURE);
+  }
+  dLoad = Bench_wallSeconds(&sStart);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(FT_openImage(pcImage, &oFTImage) != SUCCESS) {
+    fprintf(stderr, "cannot open %s\n", pcImage);
+    exit(EXIT_FAILURE);
+  }
+  dOpen = Bench_wallSeconds(&sStart);
+
+  ulFound = 0;
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++)
+    ulFound += FT_statIn(oFTree, ppcPaths[i], &bIsFile, &ulSize)
+               == SUCCESS;
+  dLoaded = Bench_wallSeconds(&sStart);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++)
+    ulFound += FT_statIn(oFTImage, ppcPaths[i], &bIsFile, &ulSize)
+               == SUCCESS;
+  dMapped = Bench_wallSeconds(&sStart);
+
+  for(i = 0; i < NFILES; i++)
+    free(FT_getFileContentsIn(oFTree, ppcPaths[i]));
+  FT_free(oFTree);
+  FT_free(oFTImage);
+  (void) remove(pcCheckpoint);
+  (void) remove(pcImage);
+
+  printf("image: %d files, %d bytes per file, %lu found\n", NFILES,
+         IMAGEBYTES, (unsigned long) ulFound);
+  printf("  FT_load              %10.3f ms\n", dLoad * 1e3);
+  printf("  FT_openImage         %10.3f ms\n", dOpen * 1e3);
+  printf("  FT_stat, loaded      %10.0f ops/s\n", NFILES / dLoaded);
+  printf("  FT_stat, image       %10.0f ops/s\n", NFILES / dMapped);
+
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Measures paging: saves the benchmark tree as a checkpoint and as an
+  image, then reports the time from nothing to a tree that answers
+  queries, by FT_loadIn and by PagedFT_open, and the rate of
+  PagedFT_stat over a skewed workload whose accesses go nine times in
+  ten to the files of PAGEDHOT of the top-level directories, and
+  otherwise to any file, with no more than PAGEDRESIDENT nodes
+  resident. Times are wall-clock, and both files are in the page cache
+  when they are read.
+*/
+static void Bench_paged(void) {
+  enum { PAGEDHOT = 2, PAGEDRESIDENT = 4096, PAGEDOPS = 1000000 };
+  static const char *pcCheckpoint = "ftbench.ckpt";
+  static const char *pcImage = "ftbench.img";
+  char **ppcPaths;
+  FT_T oFTree;
+  PagedFT_T oPTree;
+  boolean bIsFile;
+  struct timespec sStart;
+  double dLoad, dOpen, dStat;
+  size_t ulSize, ulFound, ulState = 217, ulLoaded, i;
+  size_t ulPageIns, ulEvictions, ulResident;
+
+  ppcPaths = Bench_newPaths();
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < NFILES; i++)
+    (void) FT_insertFileIn(oFTree, ppcPaths[i], ppcPaths[i],
+                           strlen(ppcPaths[i]) + 1);
+  if(FT_saveIn(oFTree, pcCheckpoint) != SUCCESS ||
+     FT_saveImageIn(oFTree, pcImage) != SUCCESS) {
+    fprintf(stderr, "cannot save %s or %s\n", pcCheckpoint, pcImage);
+    exit(EXIT_FAILURE);
+  }
+  FT_free(oFTree);
+
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(FT_loadIn(oFTree, pcCheckpoint) != SUCCESS) {
+    fprintf(stderr, "cannot load %s\n", pcCheckpoint);
+    exit(EXIT_FAILURE);
+  }
+  dLoad = Bench_wallSeconds(&sStart);
+  (void) FT_getCountIn(oFTree, &ulLoaded);
+  for(i = 0; i < NFILES; i++)
+    free(FT_getFileContentsIn(oFTree, ppcPaths[i]));
+  FT_free(oFTree);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(PagedFT_open(pcImage, PAGEDRESIDENT, &oPTree) != SUCCESS) {
+    fprintf(stderr, "cannot open %s\n", pcImage);
+    exit(EXIT_FAILURE);
+  }
+  dOpen = Bench_wallSeconds(&sStart);
+
+  /* the files of the first PAGEDHOT top-level directories come first
+     in ppcPaths */
+  ulFound = 0;
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < PAGEDOPS; i++) {
+    size_t ulRandom = Bench_random(&ulState) * 32768 +
+                      Bench_random(&ulState);
+    if(ulRandom % 10 != 0)
+      ulRandom %= PAGEDHOT * FANOUT * FANOUT;
+    ulFound += PagedFT_stat(oPTree, ppcPaths[ulRandom % NFILES],
+                            &bIsFile, &ulSize) == SUCCESS;
+  }
+  dStat = Bench_wallSeconds(&sStart);
+  (void) PagedFT_getPagingStats(oPTree, &ulPageIns, &ulEvictions,
+                                &ulResident);
+
+  PagedFT_free(oPTree);
+  (void) remove(pcCheckpoint);
+  (void) remove(pcImage);
+
+  printf("paged: %d files, %d hot directories, %d nodes resident at "
+         "most, %lu found\n", NFILES, PAGEDHOT, PAGEDRESIDENT,
+         (unsigned long) ulFound);
+  printf("  FT_load              %10.3f ms  %8lu nodes resident\n",
+         dLoad * 1e3, (unsigned long) ulLoaded);
+  printf("  PagedFT_open         %10.3f ms\n", dOpen * 1e3);
+  printf("  PagedFT_stat         %10.0f ops/s\n", PAGEDOPS / dStat);
+  printf("  page-ins             %10lu\n", (unsigned long) ulPageIns);
+  printf("  evictions            %10lu\n", (unsigned long) ulEvictions);
+  printf("  resident             %10lu nodes\n",
+         (unsigned long) ulResident);
+
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Measures heap trees: reports the rate of inserting every file of
+  the benchmark tree, and of replacing HEAPREPLACES files' contents at
+  random, into an FT and into a HeapFT_T, the time of the checkpoint
+  that makes the HeapFT_T durable, and the time from nothing to a tree
+  that answers queries after a restart, by FT_loadIn from a checkpoint
+  and by HeapFT_open, and to stat every file then. Times are
+  wall-clock, and the files are in the page cache when they are read.
+*/
+static void Bench_heap(void) {
+  enum { HEAPREPLACES = 1000000 };
+  static const char *pcCheckpoint = "ftbench.ckpt";
+  static const char *pcHeap = "ftbench.heap";
+  static char acContents[] = "replaced contents";
+  char **ppcPaths;
+  FT_T oFTree;
+  HeapFT_T oHTree;
+  boolean bIsFile;
+  struct timespec sStart;
+  double dInsert, dHeapInsert, dReplace, dHeapReplace, dCheckpoint;
+  double dLoad, dOpen, dStat, dHeapStat;
+  size_t ulSize, ulFound = 0, ulState, i;
+
+  ppcPaths = Bench_newPaths();
+  (void) remove(pcHeap);
+  oFTree = FT_new();
+  if(oFTree == NULL || HeapFT_open(pcHeap, &oHTree) != SUCCESS) {
+    fprintf(stderr, "cannot create %s\n", pcHeap);
+    exit(EXIT_FAILURE);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++)
+    (void) FT_insertFileIn(oFTree, ppcPaths[i], ppcPaths[i],
+                           strlen(ppcPaths[i]) + 1);
+  dInsert = Bench_wallSeconds(&sStart);
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++)
+    (void) HeapFT_insertFile(oHTree, ppcPaths[i], ppcPaths[i],
+                             strlen(ppcPaths[i]) + 1);
+  dHeapInsert = Bench_wallSeconds(&sStart);
+
+  ulState = 217;
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < HEAPREPLACES; i++)
+    (void) FT_replaceFileContentsIn(oFTree,
+      ppcPaths[(Bench_random(&ulState) * 32768 + Bench_random(&ulState))
+               % NFILES], acContents, sizeof(acContents));
+  dReplace = Bench_wallSeconds(&sStart);
+  ulState = 217;
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < HEAPREPLACES; i++)
+    (void) HeapFT_replaceFileContents(oHTree,
+      ppcPaths[(Bench_random(&ulState) * 32768 + Bench_random(&ulState))
+               % NFILES], acContents, sizeof(acContents));
+  dHeapReplace = Bench_wallSeconds(&sStart);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(HeapFT_checkpoint(oHTree) != SUCCESS) {
+    fprintf(stderr, "cannot checkpoint %s\n", pcHeap);
+    exit(EXIT_FAILURE);
+  }
+  dCheckpoint = Bench_wallSeconds(&sStart);
+  HeapFT_free(oHTree);
+  if(FT_saveIn(oFTree, pcCheckpoint) != SUCCESS) {
+    fprintf(stderr, "cannot save %s\n", pcCheckpoint);
+    exit(EXIT_FAILURE);
+  }
+  FT_free(oFTree);
+
+  /* a restart */
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(FT_loadIn(oFTree, pcCheckpoint) != SUCCESS) {
+    fprintf(stderr, "cannot load %s\n", pcCheckpoint);
+    exit(EXIT_FAILURE);
+  }
+  dLoad = Bench_wallSeconds(&sStart);
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  if(HeapFT_open(pcHeap, &oHTree) != SUCCESS) {
+    fprintf(stderr, "cannot open %s\n", pcHeap);
+    exit(EXIT_FAILURE);
+  }
+  dOpen = Bench_wallSeconds(&sStart);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++)
+    ulFound += FT_statIn(oFTree, ppcPaths[i], &bIsFile, &ulSize)
+               == SUCCESS;
+  dStat = Bench_wallSeconds(&sStart);
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++)
+    ulFound += HeapFT_stat(oHTree, ppcPaths[i], &bIsFile, &ulSize)
+               == SUCCESS;
+  dHeapStat = Bench_wallSeconds(&sStart);
+
+  for(i = 0; i < NFILES; i++)
+    free(FT_getFileContentsIn(oFTree, ppcPaths[i]));
+  FT_free(oFTree);
+  HeapFT_free(oHTree);
+  (void) remove(pcCheckpoint);
+  (void) remove(pcHeap);
+
+  printf("heap: %d files, %d replacements, %lu found\n", NFILES,
+         HEAPREPLACES, (unsigned long) ulFound);
+  printf("  FT_insertFile        %10.0f ops/s\n", NFILES / dInsert);
+  printf("  HeapFT_insertFile    %10.0f ops/s\n", NFILES / dHeapInsert);
+  printf("  FT_replace           %10.0f ops/s\n", HEAPREPLACES / dReplace);
+  printf("  HeapFT_replace       %10.0f ops/s\n",
+         HEAPREPLACES / dHeapReplace);
+  printf("  HeapFT_checkpoint    %10.3f ms\n", dCheckpoint * 1e3);
+  printf("  restart, FT_load     %10.3f ms\n", dLoad * 1e3);
+  printf("  restart, HeapFT_open %10.3f ms\n", dOpen * 1e3);
+  printf("  FT_stat, loaded      %10.0f ops/s\n", NFILES / dStat);
+  printf("  HeapFT_stat, opened  %10.0f ops/s\n", NFILES / dHeapStat);
+
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Measures owned contents: inserts every file of the benchmark tree
+  with OWNEDSIZE bytes of contents, replaces OWNEDREPLACES files'
+  contents at random, and tears the tree down, once as a client that
+  keeps its own copy of each file's contents alive beside an FT, frees
+  the old contents that each replacement returns, and walks the tree
+  to free the rest before FT_free, and once with FT_insertFileCopyIn
+  and FT_replaceFileContentsCopyIn, which the FT frees itself. Reports
+  the rate of each phase, and the total time of each way.
+*/
+static void Bench_owned(void) {
+  enum { OWNEDSIZE = 256, OWNEDREPLACES = 1000000 };
+  char **ppcPaths;
+  char acContents[OWNEDSIZE];
+  FT_T oFTree;
+  struct timespec sStart;
+  double dInsert, dReplace, dFree, dCopyInsert, dCopyReplace, dCopyFree;
+  size_t ulState, i;
+  void *pvCopy;
+
+  ppcPaths = Bench_newPaths();
+  memset(acContents, 'x', sizeof(acContents));
+
+  /* contents the client copies and frees */
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++) {
+    pvCopy = malloc(OWNEDSIZE);
+    if(pvCopy == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    memcpy(pvCopy, acContents, OWNEDSIZE);
+    if(FT_insertFileIn(oFTree, ppcPaths[i], pvCopy, OWNEDSIZE) != SUCCESS)
+      free(pvCopy);
+  }
+  dInsert = Bench_wallSeconds(&sStart);
+  ulState = 217;
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < OWNEDREPLACES; i++) {
+    pvCopy = malloc(OWNEDSIZE);
+    if(pvCopy == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    memcpy(pvCopy, acContents, OWNEDSIZE);
+    free(FT_replaceFileContentsIn(oFTree,
+      ppcPaths[(Bench_random(&ulState) * 32768 + Bench_random(&ulState))
+               % NFILES], pvCopy, OWNEDSIZE));
+  }
+  dReplace = Bench_wallSeconds(&sStart);
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++)
+    free(FT_getFileContentsIn(oFTree, ppcPaths[i]));
+  FT_free(oFTree);
+  dFree = Bench_wallSeconds(&sStart);
+
+  /* contents the FT copies and frees */
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < NFILES; i++)
+    (void) FT_insertFileCopyIn(oFTree, ppcPaths[i], acContents,
+                               OWNEDSIZE);
+  dCopyInsert = Bench_wallSeconds(&sStart);
+  ulState = 217;
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < OWNEDREPLACES; i++)
+    (void) FT_replaceFileContentsCopyIn(oFTree,
+      ppcPaths[(Bench_random(&ulState) * 32768 + Bench_random(&ulState))
+               % NFILES], acContents, OWNEDSIZE);
+  dCopyReplace = Bench_wallSeconds(&sStart);
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  FT_free(oFTree);
+  dCopyFree = Bench_wallSeconds(&sStart);
+
+  printf("owned: %d files of %d bytes, %d replacements\n", NFILES,
+         OWNEDSIZE, OWNEDREPLACES);
+  printf("  client copies, insert %10.0f ops/s\n", NFILES / dInsert);
+  printf("  client copies, replace %9.0f ops/s\n",
+         OWNEDREPLACES / dReplace);
+  printf("  client copies, free   %10.3f ms\n", dFree * 1e3);
+  printf("  client copies, total  %10.3f ms\n",
+         (dInsert + dReplace + dFree) * 1e3);
+  printf("  FT copies, insert     %10.0f ops/s\n", NFILES / dCopyInsert);
+  printf("  FT copies, replace    %10.0f ops/s\n",
+         OWNEDREPLACES / dCopyReplace);
+  printf("  FT copies, free       %10.3f ms\n", dCopyFree * 1e3);
+  printf("  FT copies, total      %10.3f ms\n",
+         (dCopyInsert + dCopyReplace + dCopyFree) * 1e3);
+
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Measures deduplication: copies DEDUPSIZE bytes of contents into
+  every file of the benchmark tree with FT_insertFileCopyIn, each file
+  holding one of DEDUPDISTINCT distinct contents, then replaces
+  DEDUPREPLACES files' contents at random with another of them, once
+  without deduplication and once with it. Reports the rate of each
+  phase both ways, and the dedup ratio and bytes saved.
+*/
+static void Bench_dedup(void) {
+  enum { DEDUPSIZE = 4096, DEDUPDISTINCT = 64, DEDUPREPLACES = 200000 };
+  char **ppcPaths;
+  static char aacContents[DEDUPDISTINCT][DEDUPSIZE];
+  FT_T oFTree;
+  struct timespec sStart;
+  double adInsert[2], adReplace[2];
+  double dRatio = 1.0;
+  size_t ulSaved = 0;
+  size_t ulState, i, j;
+  int iDedup;
+
+  ppcPaths = Bench_newPaths();
+  ulState = 217;
+  for(i = 0; i < DEDUPDISTINCT; i++)
+    for(j = 0; j < DEDUPSIZE; j++)
+      aacContents[i][j] = (char) Bench_random(&ulState);
+
+  for(iDedup = 0; iDedup < 2; iDedup++) {
+    oFTree = FT_new();
+    if(oFTree == NULL || (iDedup && FT_enableDedupIn(oFTree) != SUCCESS)) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &sStart);
+    for(i = 0; i < NFILES; i++)
+      (void) FT_insertFileCopyIn(oFTree, ppcPaths[i],
+                                 aacContents[i % DEDUPDISTINCT],
+                                 DEDUPSIZE);
+    adInsert[iDedup] = Bench_wallSeconds(&sStart);
+    ulState = 217;
+    clock_gettime(CLOCK_MONOTONIC, &sStart);
+    for(i = 0; i < DEDUPREPLACES; i++)
+      (void) FT_replaceFileContentsCopyIn(oFTree,
+        ppcPaths[(Bench_random(&ulState) * 32768 + Bench_random(&ulState))
+                 % NFILES],
+        aacContents[Bench_random(&ulState) % DEDUPDISTINCT], DEDUPSIZE);
+    adReplace[iDedup] = Bench_wallSeconds(&sStart);
+    if(iDedup)
+      (void) FT_getDedupStatsIn(oFTree, NULL, NULL, NULL, &ulSaved,
+                                &dRatio);
+    FT_free(oFTree);
+  }
+
+  printf("dedup: %d files of %d bytes, %d distinct, %d replacements\n",
+         NFILES, DEDUPSIZE, DEDUPDISTINCT, DEDUPREPLACES);
+  printf("  plain, insert         %10.0f ops/s\n", NFILES / adInsert[0]);
+  printf("  plain, replace        %10.0f ops/s\n",
+         DEDUPREPLACES / adReplace[0]);
+  printf("  dedup, insert         %10.0f ops/s\n", NFILES / adInsert[1]);
+  printf("  dedup, replace        %10.0f ops/s\n",
+         DEDUPREPLACES / adReplace[1]);
+  printf("  dedup ratio           %10.1f\n", dRatio);
+  printf("  bytes saved           %10.3f MB\n", ulSaved / 1e6);
+
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Measures small random writes into large files: ROPEFILES files of
+  ROPESIZE bytes each take ROPEWRITES writes of ROPEWRITE bytes at
+  random offsets, once by editing a copy of the whole file and
+  replacing its contents with FT_replaceFileContentsCopyIn, and once
+  with FT_writeAtIn, which copies only the chunks written. Then reads
+  as many ranges back with FT_readAtIn. Reports the rate of each.
+*/
+static void Bench_ropes(void) {
+  enum { ROPEFILES = 16, ROPESIZE = 4 << 20, ROPEWRITES = 4000,
+         ROPEWRITE = 64 };
+  static char acFile[ROPESIZE];
+  static char acPaths[ROPEFILES][32];
+  char acBytes[ROPEWRITE];
+  FT_T oFTree;
+  struct timespec sStart;
+  double dReplace, dWriteAt, dReadAt;
+  size_t ulState, ulOffset, ulRead, i;
+  int iFile;
+
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  ulState = 1013;
+  for(i = 0; i < ROPESIZE; i++)
+    acFile[i] = (char) Bench_random(&ulState);
+  for(iFile = 0; iFile < ROPEFILES; iFile++) {
+    sprintf(acPaths[iFile], "ropes/f%d", iFile);
+    if(FT_insertFileCopyIn(oFTree, acPaths[iFile], acFile, ROPESIZE)
+       != SUCCESS) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  /* every file starts as the same bytes, so one copy of them serves
+     for each replacement */
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < ROPEWRITES; i++) {
+    iFile = (int) (Bench_random(&ulState) % ROPEFILES);
+    ulOffset = (Bench_random(&ulState) * 32768 + Bench_random(&ulState))
+      % (ROPESIZE - ROPEWRITE);
+    memset(acFile + ulOffset, (int) i, ROPEWRITE);
+    (void) FT_replaceFileContentsCopyIn(oFTree, acPaths[iFile], acFile,
+                                        ROPESIZE);
+  }
+  dReplace = Bench_wallSeconds(&sStart);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < ROPEWRITES; i++) {
+    iFile = (int) (Bench_random(&ulState) % ROPEFILES);
+    ulOffset = (Bench_random(&ulState) * 32768 + Bench_random(&ulState))
+      % (ROPESIZE - ROPEWRITE);
+    memset(acBytes, (int) i, ROPEWRITE);
+    (void) FT_writeAtIn(oFTree, acPaths[iFile], ulOffset, acBytes,
+                        ROPEWRITE);
+  }
+  dWriteAt = Bench_wallSeconds(&sStart);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < ROPEWRITES; i++) {
+    iFile = (int) (Bench_random(&ulState) % ROPEFILES);
+    ulOffset = (Bench_random(&ulState) * 32768 + Bench_random(&ulState))
+      % (ROPESIZE - ROPEWRITE);
+    (void) FT_readAtIn(oFTree, acPaths[iFile], ulOffset, acBytes,
+                       ROPEWRITE, &ulRead);
+  }
+  dReadAt = Bench_wallSeconds(&sStart);
+  FT_free(oFTree);
+
+  printf("ropes: %d files of %d bytes, %d writes of %d bytes\n",
+         ROPEFILES, ROPESIZE, ROPEWRITES, ROPEWRITE);
+  printf("  whole-file replace    %10.0f ops/s\n", ROPEWRITES / dReplace);
+  printf("  chunked writeAt       %10.0f ops/s\n", ROPEWRITES / dWriteAt);
+  printf("  chunked readAt        %10.0f ops/s\n", ROPEWRITES / dReadAt);
+  printf("  speedup               %10.1fx\n", dReplace / dWriteAt);
+}
+
+/*
+  Reads the contents of the first ulFiles files of Bench_compress in
+  oFTree, and returns the seconds taken.
+*/
+static double Bench_readZipped(FT_T oFTree, size_t ulFiles) {
+  struct timespec sStart;
+  char acPath[32];
+  size_t i;
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < ulFiles; i++) {
+    sprintf(acPath, "zip/d%lu/f%lu", (unsigned long) (i % 50),
+            (unsigned long) i);
+    if(FT_getFileContentsIn(oFTree, acPath) == NULL) {
+      fprintf(stderr, "read failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return Bench_wallSeconds(&sStart);
+}
+
+/*
+  Measures compression of cold contents: copies ZIPFILES files of
+  ZIPSIZE bytes of text-like contents, words drawn at random from a
+  small vocabulary, reads them all, compresses them all with
+  FT_compressIn, and reads them all twice more, the first time
+  decompressing them and the second finding them decompressed.
+  Reports the rate of each phase and the compression statistics.
+*/
+static void Bench_compress(void) {
+  enum { ZIPFILES = 2000, ZIPSIZE = 65536, ZIPDISTINCT = 64 };
+  static const char *apcWords[] = {
+    "the ", "file ", "tree ", "node ", "path ", "of ", "and ", "a ",
+    "contents ", "directory ", "to ", "is ", "in ", "with ", "for ",
+    "root ", "child ", "parent ", "length ", "status "
+  };
+  const size_t ulVocabulary = sizeof(apcWords) / sizeof(apcWords[0]);
+  static char acContents[ZIPDISTINCT][ZIPSIZE];
+  const char *pcWord;
+  char acPath[32];
+  FT_T oFTree;
+  struct timespec sStart;
+  double dCompress, dCold, dHot, dPlain, dRatio;
+  double dCompressSeconds, dExpandSeconds;
+  size_t ulPlain, ulPacked, ulHits, ulMisses, ulCompressed;
+  size_t ulState, ulFill, i, j;
+
+  ulState = 4099;
+  for(i = 0; i < ZIPDISTINCT; i++)
+    for(ulFill = 0; ulFill < ZIPSIZE; ) {
+      pcWord = apcWords[Bench_random(&ulState) % ulVocabulary];
+      for(j = 0; pcWord[j] != '\0' && ulFill < ZIPSIZE; j++)
+        acContents[i][ulFill++] = pcWord[j];
+    }
+
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < ZIPFILES; i++) {
+    sprintf(acPath, "zip/d%lu/f%lu", (unsigned long) (i % 50),
+            (unsigned long) i);
+    if(FT_insertFileCopyIn(oFTree, acPath, acContents[i % ZIPDISTINCT],
+                           ZIPSIZE) != SUCCESS) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  dPlain = Bench_readZipped(oFTree, ZIPFILES);
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  (void) FT_compressIn(oFTree, 0, &ulCompressed);
+  dCompress = Bench_wallSeconds(&sStart);
+  dCold = Bench_readZipped(oFTree, ZIPFILES);
+  dHot = Bench_readZipped(oFTree, ZIPFILES);
+  (void) FT_getCompressionStatsIn(oFTree, &ulPlain, &ulPacked, &dRatio,
+                                  &dCompressSeconds, &dExpandSeconds,
+                                  &ulHits, &ulMisses);
+  FT_free(oFTree);
+
+  printf("compress: %d files of %d bytes of text\n", ZIPFILES, ZIPSIZE);
+  printf("  compress all          %10.0f files/s\n",
+         ulCompressed / dCompress);
+  printf("  read, plain           %10.0f ops/s\n", ZIPFILES / dPlain);
+  printf("  read, cold (miss)     %10.0f ops/s\n", ZIPFILES / dCold);
+  printf("  read, hot (hit)       %10.0f ops/s\n", ZIPFILES / dHot);
+  printf("  bytes, plain/packed   %10.3f / %.3f MB\n", ulPlain / 1e6,
+         ulPacked / 1e6);
+  printf("  compression ratio     %10.2f\n", dRatio);
+  printf("  CPU, compress/expand  %10.3f / %.3f s\n", dCompressSeconds,
+         dExpandSeconds);
+  printf("  cache hits/misses     %10lu / %lu\n", (unsigned long) ulHits,
+         (unsigned long) ulMisses);
+}
+
+/* The number of files of Bench_spill, and of files in each batch */
+enum { SPILLFILES = 2000, SPILLBATCH = 50 };
+
+/*
+  Reads the contents of ulFiles files of Bench_spill in oFTree, the
+  ith being file (i * ulStride) % ulTotal, and returns the seconds
+  taken.
+*/
+static double Bench_readSpilled(FT_T oFTree, size_t ulFiles,
+                                size_t ulStride, size_t ulTotal) {
+  struct timespec sStart;
+  char acPath[32];
+  size_t i, ulFile;
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < ulFiles; i++) {
+    ulFile = (i * ulStride) % ulTotal;
+    sprintf(acPath, "spill/d%lu/f%lu", (unsigned long) (ulFile % 50),
+            (unsigned long) ulFile);
+    if(FT_getFileContentsIn(oFTree, acPath) == NULL) {
+      fprintf(stderr, "read failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return Bench_wallSeconds(&sStart);
+}
+
+/*
+  Reads the contents of all SPILLFILES files of Bench_spill in oFTree
+  with FT_getFileContentsManyIn, in batches of SPILLBATCH files far
+  apart, so that each file is cold in turn, the batches shifted by
+  ulSkew files, hinting each batch with FT_prefetchIn first if
+  bPrefetch is TRUE. Returns the seconds taken.
+*/
+static double Bench_readBatches(FT_T oFTree, boolean bPrefetch,
+                                size_t ulSkew) {
+  static char aacBatch[SPILLBATCH][32];
+  const char *apcBatch[SPILLBATCH];
+  void *apvContents[SPILLBATCH];
+  int aiStatuses[SPILLBATCH];
+  struct timespec sStart;
+  size_t ulBatch, ulFile, i;
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(ulBatch = 0; ulBatch < SPILLFILES / SPILLBATCH; ulBatch++) {
+    for(i = 0; i < SPILLBATCH; i++) {
+      ulFile = (ulBatch + i * (SPILLFILES / SPILLBATCH) + ulSkew)
+        % SPILLFILES;
+      sprintf(aacBatch[i], "spill/d%lu/f%lu",
+              (unsigned long) (ulFile % 50), (unsigned long) ulFile);
+      apcBatch[i] = aacBatch[i];
+    }
+    if(bPrefetch)
+      (void) FT_prefetchIn(oFTree, apcBatch, SPILLBATCH, FALSE);
+    (void) FT_getFileContentsManyIn(oFTree, apcBatch, SPILLBATCH, FALSE,
+                                    apvContents, aiStatuses);
+  }
+  return Bench_wallSeconds(&sStart);
+}
+
+/*
+  Measures spilling under a memory budget: copies SPILLFILES files of
+  SPILLSIZE bytes into an FT whose budget holds a quarter of them,
+  then reads every file once, spilled files being read back, reads a
+  hot set that fits in the budget over and over, and reads batches of
+  cold files, once plain and once hinted with FT_prefetchIn first.
+  Reports the rate of each phase and the spilling statistics.
+*/
+static void Bench_spill(void) {
+  enum { SPILLSIZE = 65536, SPILLHOT = 100 };
+  static char acContents[SPILLSIZE];
+  char acPath[32];
+  FT_T oFTree;
+  struct timespec sStart;
+  double dIngest, dCold, dHot, dBatch, dPrefetched;
+  size_t ulSpills, ulReloads, ulPrefetches, ulResident, ulSpillBytes;
+  size_t ulState, i;
+
+  ulState = 8191;
+  for(i = 0; i < SPILLSIZE; i++)
+    acContents[i] = (char) Bench_random(&ulState);
+
+  oFTree = FT_new();
+  if(oFTree == NULL
+     || FT_enableSpillIn(oFTree, "ftbench.spill",
+                         (size_t) SPILLFILES / 4 * SPILLSIZE) != SUCCESS) {
+    fprintf(stderr, "cannot enable spilling\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < SPILLFILES; i++) {
+    sprintf(acPath, "spill/d%lu/f%lu", (unsigned long) (i % 50),
+            (unsigned long) i);
+    if(FT_insertFileCopyIn(oFTree, acPath, acContents, SPILLSIZE)
+       != SUCCESS) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  dIngest = Bench_wallSeconds(&sStart);
+
+  dCold = Bench_readSpilled(oFTree, SPILLFILES, 1, SPILLFILES);
+  dHot = Bench_readSpilled(oFTree, SPILLFILES, 1, SPILLHOT);
+
+  dBatch = Bench_readBatches(oFTree, FALSE, 0);
+  dPrefetched = Bench_readBatches(oFTree, TRUE, 7);
+  (void) FT_getSpillStatsIn(oFTree, &ulSpills, &ulReloads, &ulPrefetches,
+                            &ulResident, &ulSpillBytes);
+  FT_free(oFTree);
+
+  printf("spill: %d files of %d bytes, budget of %d files\n",
+         SPILLFILES, SPILLSIZE, SPILLFILES / 4);
+  printf("  insert under budget   %10.0f ops/s\n", SPILLFILES / dIngest);
+  printf("  read, cold            %10.0f ops/s\n", SPILLFILES / dCold);
+  printf("  read, hot set         %10.0f ops/s\n", SPILLFILES / dHot);
+  printf("  batch read            %10.0f ops/s\n", SPILLFILES / dBatch);
+  printf("  batch read, prefetch  %10.0f ops/s\n",
+         SPILLFILES / dPrefetched);
+  printf("  spills/reloads        %10lu / %lu\n", (unsigned long) ulSpills,
+         (unsigned long) ulReloads);
+  printf("  prefetches            %10lu\n", (unsigned long) ulPrefetches);
+  printf("  resident/spilled      %10.3f / %.3f MB\n", ulResident / 1e6,
+         ulSpillBytes / 1e6);
+}
+
+/*
+  Touches one byte of each page of the ulLength bytes at pvContents,
+  and returns the sum of the bytes touched, so that the reads are kept.
+*/
+static size_t Bench_touch(const void *pvContents, size_t ulLength) {
+  const unsigned char *puc = pvContents;
+  size_t ulSum = 0, i;
+
+  for(i = 0; i < ulLength; i += 4096)
+    ulSum += puc[i];
+  return ulSum;
+}
+
+/*
+  Measures mapped files: writes MAPREGIONS regions of MAPSIZE bytes to
+  a file, then puts each region in an FT as a file twice over, once
+  read into a buffer and copied in with FT_insertFileCopyIn, and once
+  mapped with FT_insertFileMappedIn, and reads every file's contents,
+  touching each page. Reports the rate of each phase both ways, and
+  the heap bytes that mapping avoids.
+*/
+static void Bench_mapped(void) {
+  enum { MAPREGIONS = 256, MAPSIZE = 262144 };
+  static char acRegion[MAPSIZE];
+  char acPath[32];
+  FILE *psFile;
+  FT_T oFTree;
+  struct timespec sStart;
+  double dCopyInsert, dCopyRead, dMapInsert, dMapRead;
+  size_t ulSum = 0, ulState, i;
+  void *pvContents;
+
+  ulState = 4093;
+  psFile = fopen("ftbench.map", "wb");
+  if(psFile == NULL) {
+    fprintf(stderr, "cannot create ftbench.map\n");
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < MAPREGIONS; i++) {
+    size_t j;
+    for(j = 0; j < MAPSIZE; j++)
+      acRegion[j] = (char) Bench_random(&ulState);
+    if(fwrite(acRegion, 1, MAPSIZE, psFile) != MAPSIZE) {
+      fprintf(stderr, "cannot write ftbench.map\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if(fclose(psFile) != 0) {
+    fprintf(stderr, "cannot write ftbench.map\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* regions read into a buffer, then copied into the FT */
+  oFTree = FT_new();
+  psFile = fopen("ftbench.map", "rb");
+  if(oFTree == NULL || psFile == NULL) {
+    fprintf(stderr, "cannot read ftbench.map\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < MAPREGIONS; i++) {
+    sprintf(acPath, "map/f%lu", (unsigned long) i);
+    if(fseek(psFile, (long) (i * MAPSIZE), SEEK_SET) != 0
+       || fread(acRegion, 1, MAPSIZE, psFile) != MAPSIZE
+       || FT_insertFileCopyIn(oFTree, acPath, acRegion, MAPSIZE)
+          != SUCCESS) {
+      fprintf(stderr, "copy failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  dCopyInsert = Bench_wallSeconds(&sStart);
+  (void) fclose(psFile);
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < MAPREGIONS; i++) {
+    sprintf(acPath, "map/f%lu", (unsigned long) i);
+    pvContents = FT_getFileContentsIn(oFTree, acPath);
+    if(pvContents != NULL)
+      ulSum += Bench_touch(pvContents, MAPSIZE);
+  }
+  dCopyRead = Bench_wallSeconds(&sStart);
+  FT_free(oFTree);
+
+  /* regions mapped, read from the page cache */
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < MAPREGIONS; i++) {
+    sprintf(acPath, "map/f%lu", (unsigned long) i);
+    if(FT_insertFileMappedIn(oFTree, acPath, "ftbench.map",
+                             i * MAPSIZE, MAPSIZE) != SUCCESS) {
+      fprintf(stderr, "map failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  dMapInsert = Bench_wallSeconds(&sStart);
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < MAPREGIONS; i++) {
+    sprintf(acPath, "map/f%lu", (unsigned long) i);
+    pvContents = FT_getFileContentsIn(oFTree, acPath);
+    if(pvContents != NULL)
+      ulSum += Bench_touch(pvContents, MAPSIZE);
+  }
+  dMapRead = Bench_wallSeconds(&sStart);
+  FT_free(oFTree);
+  (void) remove("ftbench.map");
+
+  printf("mapped: %d regions of %d bytes (checksum %lu)\n", MAPREGIONS,
+         MAPSIZE, (unsigned long) ulSum);
+  printf("  read+copy, insert     %10.0f ops/s\n",
+         MAPREGIONS / dCopyInsert);
+  printf("  read+copy, read       %10.0f ops/s\n", MAPREGIONS / dCopyRead);
+  printf("  mapped, insert        %10.0f ops/s\n", MAPREGIONS / dMapInsert);
+  printf("  mapped, read          %10.0f ops/s\n", MAPREGIONS / dMapRead);
+  printf("  heap bytes avoided    %10.3f MB\n",
+         (double) MAPREGIONS * MAPSIZE / 1e6);
+}
+
+/*
+  Sums the sizes of the files below pcPrefix in oFTree the way a
+  client without FT_duIn would: lists the whole hierarchy with
+  FT_toStringIn and stats each path below pcPrefix. Sets *pulFiles and
+  *pulBytes to the number of files found and their total size.
+*/
+static void Bench_walkDu(FT_T oFTree, const char *pcPrefix,
+                         size_t *pulFiles, size_t *pulBytes) {
+  char *pcTree, *pcLine, *pcEnd;
+  size_t ulPrefix = strlen(pcPrefix), ulSize;
+  boolean bIsFile;
+
+  *pulFiles = 0;
+  *pulBytes = 0;
+  pcTree = FT_toStringIn(oFTree);
+  if(pcTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for(pcLine = pcTree; *pcLine != '\0'; pcLine = pcEnd + 1) {
+    pcEnd = strchr(pcLine, '\n');
+    *pcEnd = '\0';
+    if(strncmp(pcLine, pcPrefix, ulPrefix) == 0 &&
+       FT_statIn(oFTree, pcLine, &bIsFile, &ulSize) == SUCCESS &&
+       bIsFile) {
+      (*pulFiles)++;
+      *pulBytes += ulSize;
+    }
+  }
+  free(pcTree);
+}
+
+/*
+  Measures FT_duIn: asks for the totals of each top-level directory of
+  the benchmark tree, once by listing and statting its files and over
+  and over with FT_duIn, which answers from the totals each directory
+  keeps. Reports the rate of each way and checks that they agree.
+*/
+static void Bench_du(void) {
+  enum { DUROUNDS = 100000 };
+  char **ppcPaths;
+  char acPrefix[PATHLEN];
+  FT_T oFTree;
+  struct timespec sStart;
+  double dWalk, dDu;
+  size_t ulFiles, ulDirs, ulBytes, ulWalkFiles, ulWalkBytes, i;
+
+  ppcPaths = Bench_newPaths();
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < NFILES; i++)
+    (void) FT_insertFileIn(oFTree, ppcPaths[i], ppcPaths[i],
+                           strlen(ppcPaths[i]) + 1);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < FANOUT; i++) {
+    sprintf(acPrefix, "bench/d%02lu/", (unsigned long) i);
+    Bench_walkDu(oFTree, acPrefix, &ulWalkFiles, &ulWalkBytes);
+  }
+  dWalk = Bench_wallSeconds(&sStart);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < DUROUNDS; i++) {
+    sprintf(acPrefix, "bench/d%02lu", (unsigned long) (i % FANOUT));
+    (void) FT_duIn(oFTree, acPrefix, &ulFiles, &ulDirs, &ulBytes);
+  }
+  dDu = Bench_wallSeconds(&sStart);
+  if(ulFiles != ulWalkFiles || ulBytes != ulWalkBytes) {
+    fprintf(stderr, "du disagrees with the walk\n");
+    exit(EXIT_FAILURE);
+  }
+  FT_free(oFTree);
+
+  printf("du: %d files, totals of %d directories of %lu files\n",
+         NFILES, FANOUT, (unsigned long) ulFiles);
+  printf("  toString + stat       %10.0f ops/s\n", FANOUT / dWalk);
+  printf("  FT_duIn               %10.0f ops/s\n", DUROUNDS / dDu);
+
+  Bench_freePaths(ppcPaths);
+}
+
+/*
+  Stores the ulK largest of the file sizes seen so far, largest first,
+  in aulBest, which holds *pulBest of them, and offers it ulSize.
+*/
+static void Bench_offerSize(size_t *aulBest, size_t *pulBest, size_t ulK,
+                            size_t ulSize) {
+  size_t i;
+
+  if(*pulBest == ulK && ulSize <= aulBest[ulK - 1])
+    return;
+  if(*pulBest < ulK)
+    (*pulBest)++;
+  for(i = *pulBest - 1; i > 0 && aulBest[i - 1] < ulSize; i--)
+    aulBest[i] = aulBest[i - 1];
+  aulBest[i] = ulSize;
+}
+
+/*
+  Measures FT_topKIn: finds the largest files of a tree of TOPKFANOUT
+  cubed files, most of them small and a few large, once by statting
+  every file and over and over with FT_topKIn, which passes over the
+  directories whose bounds show they hold nothing large enough, then
+  finds the largest directories by their totals. Reports the rate of
+  each way and checks that they agree.
+*/
+static void Bench_topK(void) {
+  enum { TOPKFANOUT = 64, TOPK = 10, TOPKROUNDS = 1000 };
+  enum { TOPKFILES = TOPKFANOUT * TOPKFANOUT * TOPKFANOUT };
+  enum { BIGLENGTH = 1 << 20 };
+  static char acBlob[BIGLENGTH];
+  char acPath[PATHLEN];
+  char *apcTop[TOPK];
+  size_t aulTop[TOPK], aulScan[TOPK];
+  size_t ulState = 1, ulScan = 0, ulFound = 0, ulSize, i, j;
+  boolean bIsFile;
+  FT_T oFTree;
+  struct timespec sStart;
+  double dScan, dFiles, dDirs;
+
+  oFTree = FT_new();
+  if(oFTree == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  /* one file in 4096 is large, the rest at most a few kilobytes */
+  for(i = 0; i < TOPKFILES; i++) {
+    sprintf(acPath, "topk/d%02lu/d%02lu/f%02lu",
+            (unsigned long) (i / (TOPKFANOUT * TOPKFANOUT)),
+            (unsigned long) (i / TOPKFANOUT % TOPKFANOUT),
+            (unsigned long) (i % TOPKFANOUT));
+    ulSize = Bench_random(&ulState) % 4096;
+    if(Bench_random(&ulState) % 4096 == 0)
+      ulSize = BIGLENGTH - Bench_random(&ulState) * 16;
+    if(FT_insertFileIn(oFTree, acPath, acBlob, ulSize) != SUCCESS) {
+      fprintf(stderr, "could not build the tree\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < TOPKFILES; i++) {
+    sprintf(acPath, "topk/d%02lu/d%02lu/f%02lu",
+            (unsigned long) (i / (TOPKFANOUT * TOPKFANOUT)),
+            (unsigned long) (i / TOPKFANOUT % TOPKFANOUT),
+            (unsigned long) (i % TOPKFANOUT));
+    if(FT_statIn(oFTree, acPath, &bIsFile, &ulSize) == SUCCESS)
+      Bench_offerSize(aulScan, &ulScan, TOPK, ulSize);
+  }
+  dScan = Bench_wallSeconds(&sStart);
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < TOPKROUNDS; i++) {
+    if(FT_topKIn(oFTree, "topk", TOPK, FT_BY_FILE_SIZE, apcTop, aulTop,
+                 &ulFound) != SUCCESS) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    for(j = 0; j < ulFound; j++)
+      free(apcTop[j]);
+  }
+  dFiles = Bench_wallSeconds(&sStart);
+  if(ulFound != ulScan) {
+    fprintf(stderr, "top-k disagrees with the scan\n");
+    exit(EXIT_FAILURE);
+  }
+  for(j = 0; j < ulFound; j++)
+    if(aulTop[j] != aulScan[j]) {
+      fprintf(stderr, "top-k disagrees with the scan\n");
+      exit(EXIT_FAILURE);
+    }
+
+  clock_gettime(CLOCK_MONOTONIC, &sStart);
+  for(i = 0; i < TOPKROUNDS; i++) {
+    if(FT_topKIn(oFTree, "topk", TOPK, FT_BY_SUBTREE_BYTES, apcTop, aulTop,
+                 &ulFound) != SUCCESS) {
+      fprintf(stderr, "out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    for(j = 0; j < ulFound; j++)
+      free(apcTop[j]);
+  }
+  dDirs = Bench_wallSeconds(&sStart);
+  FT_free(oFTree);
+
+  printf("topk: %d largest of %d files in %d directories\n", TOPK,
+         TOPKFILES, TOPKFANOUT * TOPKFANOUT + TOPKFANOUT + 1);
+  printf("  stat every file       %10.2f ops/s\n", 1 / dScan);
+  printf("  FT_topKIn, files      %10.2f ops/s\n", TOPKROUNDS / dFiles);
+  printf("  FT_topKIn, subtrees   %10.2f ops/s\n", TOPKROUNDS / dDirs);
+}
+
+/* A benchmark and the name that selects it on the command line */
+struct benchmark {
+  /* the name of the benchmark */
+  const char *pcName;
+  /* the function that runs the benchmark */
+  void (*pfRun)(void);
+};
+
+/* All benchmarks, in the order they run by default */
+static const struct benchmark asBenchmarks[] = {
+  {"multiget", Bench_multiGet},
+  {"bulkload", Bench_bulkLoad},
+  {"instances", Bench_instances},
+  {"rwmix", Bench_rwMix},
+  {"rmstress", Bench_rmStress},
+  {"ingest", Bench_ingest},
+  {"shards", Bench_shards},
+  {"snapshots", Bench_snapshots},
+  {"wal", Bench_wal},
+  {"checkpoint", Bench_checkpoint},
+  {"image", Bench_image},
+  {"paged", Bench_paged},
+  {"heap", Bench_heap},
+  {"owned", Bench_owned},
+  {"dedup", Bench_dedup},
+  {"ropes", Bench_ropes},
+  {"compress", Bench_compress},
+  {"spill", Bench_spill},
+  {"mapped", Bench_mapped},
+  {"du", Bench_du},
+  {"topk", Bench_topK}
+};
+
+/*
+  Runs the benchmarks named in argv, or all of them if none are named.
+  Returns 0, or EXIT_FAILURE if a name is not recognized.
+*/
+int main(int argc, char *argv[]) {
+  const size_t ulBenchmarks =
+    sizeof(asBenchmarks) / sizeof(asBenchmarks[0]);
+  size_t b;
+  int i;
+
+  if(argc == 1) {
+    for(b = 0; b < ulBenchmarks; b++)
+      (*asBenchmarks[b].pfRun)();
+    return 0;
+  }
+
+  for(i = 1; i < argc; i++) {
+    for(b = 0; b < ulBenchmarks; b++)
+      if(!strcmp(argv[i], asBenchmarks[b].pcName))
+        break;
+    if(b == ulBenchmarks) {
+      fprintf(stderr, "%s: unknown benchmark %s\n", argv[0], argv[i]);
+      return EXIT_FAILURE;
+    }
+    (*asBenchmarks[b].pfRun)();
+  }
+  return 0;
+}
@@ -9,17 +9,138 @@
 #include <stdio.h>
 #include <string.h>
 #include "ft.h"
+#include "shardft.h"
+#include "pagedft.h"
+#include "heapft.h"
+
+/* A record for FT_bulkLoad */
+struct record {
+  /* the absolute path of the record */
+  const char *pcPath;
+  /* whether the record is a file */
+  boolean bIsFile;
+  /* the file's contents, as a string */
+  char *pcContents;
+};
+
+/* A stream of records for FT_bulkLoad */
+struct recordStream {
+  /* the records */
+  const struct record *psRecords;
+  /* the number of records */
+  size_t ulCount;
+  /* the index of the next record to produce */
+  size_t ulNext;
+};
+
+/* Produces the next record of *psStream for FT_bulkLoad, if any. */
+static boolean nextRecord(struct recordStream *psStream,
+                          const char **ppcPath, boolean *pbIsFile,
+                          void **ppvContents, size_t *pulLength) {
+  const struct record *psRecord;
+
+  if(psStream->ulNext == psStream->ulCount)
+    return FALSE;
+
+  psRecord = &psStream->psRecords[psStream->ulNext++];
+  *ppcPath = psRecord->pcPath;
+  *pbIsFile = psRecord->bIsFile;
+  *ppvContents = psRecord->pcContents;
+  *pulLength = 0;
+  if(psRecord->pcContents != NULL)
+    *pulLength = strlen(psRecord->pcContents) + 1;
+  return TRUE;
+}
+
+/* The number of contents that freeCounted has freed */
+static size_t ulFreed = 0;
+
+/* Frees pvContents for an FT that owns them, counting it. */
+static void freeCounted(void *pvContents) {
+  ulFreed++;
+  free(pvContents);
+}
+
+/* Returns a copy of pcString in memory allocated with malloc. */
+static char *copyString(const char *pcString) {
+  char *pcCopy = malloc(strlen(pcString) + 1);
+  assert(pcCopy != NULL);
+  return strcpy(pcCopy, pcString);
+}
 
 /* Tests the FT implementation with an assortment of checks.
    Prints the status of the data structure along the way to stderr.
    Returns 0. */
 int main(void) {
-  enum {ARRLEN = 1000};
+  enum {ARRLEN = 1000, BATCHLEN = 8};
+  const char *apcBatch[BATCHLEN] = {
+    "1root/y/CHILD1DIR/A", "1root/y/CHILD1DIR", "1root/y/CHILD1FILE",
+    "1root/y/nope", "1root/y/CHILD1FILE/nope", "1otherroot/y",
+    "1root//y", "1root/y/CHILD1DIR/A"
+  };
+  void *apvContents[BATCHLEN];
+  int aiStatuses[BATCHLEN];
+  boolean abIsFile[BATCHLEN];
+  size_t aulSizes[BATCHLEN];
+  size_t i;
+  static char acKnuth[] = "Knuth", acBackus[] = "Backus",
+    acHoare[] = "Hoare", acKay[] = "Kay";
+  const struct record asRecords[] = {
+    {"1root/b", FALSE, NULL},
+    {"1root/b/c/d", TRUE, acKnuth},
+    {"1root/b/c/e", TRUE, acBackus},
+    {"1root/b/f", FALSE, acKay},
+    {"1root/b/g", TRUE, NULL},
+    {"1root/a", FALSE, NULL},
+    {"1root/y/CHILD3DIR/h", TRUE, acHoare},
+    {"1root/b/i", TRUE, acKay}
+  };
+  const struct record asBadRecords[] = {
+    {"1root/k/l", TRUE, NULL},
+    {"1root/k/m", FALSE, NULL},
+    {"1root/k/l/n", TRUE, NULL},
+    {"1root/k/o", TRUE, NULL}
+  };
+  struct recordStream sStream;
   char* temp;
   boolean bIsFile;
   size_t l;
   char arr[ARRLEN];
+  char acPath[16];
+  FT_Dir_T oDDir = NULL;
+  FT_Dir_T oDDir2 = NULL;
+  size_t ulID, ulDirID;
+  size_t ulQueries, ulMisses, ulFalsePos, ulBytes;
+  FT_T oFTree, oFTree2;
+  ShardFT_T oSTree;
+  PagedFT_T oPTree;
+  HeapFT_T oHTree;
+  size_t ulPageIns, ulEvictions, ulResident;
+  size_t ulCount;
+  size_t ulBlobs, ulRefs, ulStored, ulSaved;
+  size_t ulPlain, ulPacked, ulHits;
+  size_t ulSpills, ulReloads, ulPrefetches;
+  size_t ulFiles, ulDirs;
+  char *apcTop[8];
+  size_t aulTop[8];
+  size_t ulFound;
+  FILE *psFile;
+  double dRatio;
+  char *temp2;
+  FT_Snapshot_T oSSnap, oSSnap2;
+  const struct record asSnapRecords[] = {
+    {"5root/a/I", TRUE, acKay},
+    {"5root/c", FALSE, NULL}
+  };
+  const char *apcShardPaths[] = {
+    "3root/b/x", "3root/a", "3root/f", "3root/c/d/e", "3root/e",
+    "3root/b/y/z", "3root/g", "3root/d", "3root/b/y", "3root/h/i"
+  };
+  const char *apcPrefetch[] = {"18root/C", "18root/nope", "18root/D"};
   arr[0] = '\0';
+  sStream.psRecords = asRecords;
+  sStream.ulCount = sizeof(asRecords) / sizeof(asRecords[0]);
+  sStream.ulNext = 0;
 
   /* Before the data structure is initialized:
      * insert*, rm*, and destroy should all return INITIALIZATION_ERROR
@@ -34,6 +155,7 @@ int main(void) {
   assert(FT_containsFile("1root/2child/3gkid/4ggk") == FALSE);
   assert(FT_rmFile("1root/2child/3gkid/4ggk") == INITIALIZATION_ERROR);
   assert((temp = FT_toString()) == NULL);
+  assert(FT_getCount(&l) == INITIALIZATION_ERROR);
   assert(FT_destroy() == INITIALIZATION_ERROR);
 
   /* After initialization, the data structure is empty, so
@@ -43,6 +165,7 @@ int main(void) {
   assert(FT_init() == SUCCESS);
   assert(FT_containsDir("1root/2child/3gkid") == FALSE);
   assert(FT_containsFile("1root/2child/3gkid/4ggk") == FALSE);
+  assert(FT_getCount(&l) == SUCCESS && l == 0);
   assert((temp = FT_toString()) != NULL);
   assert(!strcmp(temp,""));
   free(temp);
@@ -235,10 +358,1221 @@ int main(void) {
   fprintf(stderr, "Checkpoint 4.5:\n%s\n", temp);
   free(temp);
 
+  /* operations through a directory handle are relative to that
+     directory, and the handle stops working once it is removed */
+  assert(FT_openDir("1root/x/C", &oDDir) == NOT_A_DIRECTORY);
+  assert(oDDir == NULL);
+  assert(FT_openDir("1root/nope", &oDDir) == NO_SUCH_PATH);
+  assert(FT_openDir("1root/y/CHILD2DIR", &oDDir) == SUCCESS);
+  assert(FT_insertFileAt(oDDir, "F", "Lovelace",
+                         strlen("Lovelace")+1) == SUCCESS);
+  assert(FT_insertFileAt(oDDir, "F", NULL, 0) == ALREADY_IN_TREE);
+  assert(FT_insertFileAt(oDDir, "F/G", NULL, 0) == NOT_A_DIRECTORY);
+  assert(FT_insertFileAt(oDDir, "/F", NULL, 0) == BAD_PATH);
+  assert(FT_insertFileAt(oDDir, "", NULL, 0) == BAD_PATH);
+  assert(FT_insertFileAt(oDDir, "NEWDIR/H", NULL, 0) == SUCCESS);
+  assert(FT_containsFile("1root/y/CHILD2DIR/F") == TRUE);
+  assert(FT_containsDir("1root/y/CHILD2DIR/NEWDIR") == TRUE);
+  assert(FT_containsFile("1root/y/CHILD2DIR/NEWDIR/H") == TRUE);
+  assert(!strcmp(FT_getFileContentsAt(oDDir, "F"), "Lovelace"));
+  assert(FT_getFileContentsAt(oDDir, "CHILD4DIR") == NULL);
+  assert(FT_statAt(oDDir, "F", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE);
+  assert(l == strlen("Lovelace")+1);
+  assert(FT_statAt(oDDir, "CHILD4DIR", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == FALSE);
+  assert(FT_statAt(oDDir, "nope", &bIsFile, &l) == NO_SUCH_PATH);
+  assert(FT_rmDir("1root/x") == SUCCESS);
+  assert(!strcmp(FT_getFileContentsAt(oDDir, "F"), "Lovelace"));
+  assert(FT_rmDir("1root/y/CHILD2DIR") == SUCCESS);
+  assert(FT_statAt(oDDir, "F", &bIsFile, &l) == NO_SUCH_PATH);
+  assert(FT_getFileContentsAt(oDDir, "F") == NULL);
+  assert(FT_insertFileAt(oDDir, "F", NULL, 0) == NO_SUCH_PATH);
+  assert(FT_containsDir("1root/y/CHILD2DIR") == FALSE);
+  assert(FT_insertDir("1root/y/CHILD2DIR") == SUCCESS);
+  assert(FT_statAt(oDDir, "F", &bIsFile, &l) == NO_SUCH_PATH);
+  assert(FT_rmDir("1root/y/CHILD2DIR") == SUCCESS);
+  assert((temp = FT_toString()) != NULL);
+  fprintf(stderr, "Checkpoint 5:\n%s\n", temp);
+  free(temp);
+
+  /* identifiers reach nodes without traversal until they are removed,
+     and are not reissued to nodes inserted later at the same path */
+  assert(FT_lookupId("1root/nope", &ulID) == NO_SUCH_PATH);
+  assert(FT_insertFile("1root/y/ID", "Hopper",
+                       strlen("Hopper")+1) == SUCCESS);
+  assert(FT_lookupId("1root/y/ID", &ulID) == SUCCESS);
+  assert(ulID != 0);
+  assert(FT_lookupId("1root/y", &ulDirID) == SUCCESS);
+  assert(ulDirID != ulID);
+  assert(!strcmp(FT_getContentsById(ulID), "Hopper"));
+  assert(FT_getContentsById(ulDirID) == NULL);
+  assert(FT_statById(ulID, &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE);
+  assert(l == strlen("Hopper")+1);
+  assert(FT_statById(ulDirID, &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == FALSE);
+  assert(!strcmp(FT_replaceContentsById(ulID, "Liskov",
+                                        strlen("Liskov")+1), "Hopper"));
+  assert(!strcmp(FT_getFileContents("1root/y/ID"), "Liskov"));
+  assert(FT_replaceContentsById(ulDirID, NULL, 0) == NULL);
+  assert(FT_rmFile("1root/y/ID") == SUCCESS);
+  assert(FT_getContentsById(ulID) == NULL);
+  assert(FT_statById(ulID, &bIsFile, &l) == NO_SUCH_PATH);
+  assert(FT_insertFile("1root/y/ID", NULL, 0) == SUCCESS);
+  assert(FT_statById(ulID, &bIsFile, &l) == NO_SUCH_PATH);
+  assert(FT_lookupId("1root/y/ID", &l) == SUCCESS);
+  assert(l != ulID);
+  assert(FT_statById(0, &bIsFile, &l) == NO_SUCH_PATH);
+
+  /* the negative-lookup filter never changes an answer, but absent
+     paths it rules out are answered without a traversal */
+  assert(FT_getFilterStats(&ulQueries, NULL, NULL, NULL) ==
+         NO_SUCH_PATH);
+  assert(FT_enableFilter(64, 0.01, 0) == SUCCESS);
+  assert(FT_getFilterStats(&ulQueries, &ulMisses, &ulFalsePos,
+                           &ulBytes) == SUCCESS);
+  assert(ulQueries == 0 && ulMisses == 0 && ulFalsePos == 0);
+  assert(ulBytes > 0);
+  assert(FT_containsDir("1root/y") == TRUE);
+  assert(FT_containsFile("1root/y/ID") == TRUE);
+  assert(FT_containsFile("1root/y/CHILD1FILE") == TRUE);
+  assert(FT_containsDir("1root/y/CHILD1FILE") == FALSE);
+  assert(FT_containsFile("1root/y/absent") == FALSE);
+  assert(FT_insertFile("1root/z/F", "Dijkstra",
+                       strlen("Dijkstra")+1) == SUCCESS);
+  assert(FT_containsDir("1root/z") == TRUE);
+  assert(!strcmp(FT_getFileContents("1root/z/F"), "Dijkstra"));
+  assert(FT_openDir("1root/z", &oDDir2) == SUCCESS);
+  assert(FT_insertFileAt(oDDir2, "G", NULL, 0) == SUCCESS);
+  FT_closeDir(oDDir2);
+  assert(FT_containsFile("1root/z/G") == TRUE);
+  assert(FT_rmDir("1root/z") == SUCCESS);
+  assert(FT_containsDir("1root/z") == FALSE);
+  assert(FT_containsFile("1root/z/F") == FALSE);
+  assert(FT_getFileContents("1root/z/G") == NULL);
+  assert(FT_rmFile("1root/y/ID") == SUCCESS);
+  assert(FT_containsFile("1root/y/ID") == FALSE);
+  assert(FT_getFilterStats(&ulQueries, &ulMisses, &ulFalsePos,
+                           &ulBytes) == SUCCESS);
+  assert(ulQueries == 12);
+  assert(ulMisses + ulFalsePos == 5);
+  assert(FT_disableFilter() == SUCCESS);
+  assert(FT_containsDir("1root/y") == TRUE);
+  assert(FT_getFilterStats(&ulQueries, NULL, NULL, NULL) ==
+         NO_SUCH_PATH);
+  assert(FT_enableFilter(1, 0.5, 8) == SUCCESS);
+  assert(FT_containsDir("1root/y/CHILD3DIR") == TRUE);
+
+  /* batch lookups report, per path, what single lookups would */
+  assert(FT_insertFile("1root/y/CHILD1DIR/A", "Turing",
+                       strlen("Turing")+1) == SUCCESS);
+  assert(FT_getFileContentsMany(apcBatch, BATCHLEN, FALSE,
+                                apvContents, aiStatuses) == SUCCESS);
+  assert(aiStatuses[0] == SUCCESS);
+  assert(!strcmp(apvContents[0], "Turing"));
+  assert(aiStatuses[1] == NOT_A_FILE && apvContents[1] == NULL);
+  assert(aiStatuses[2] == SUCCESS && apvContents[2] == NULL);
+  assert(aiStatuses[3] == NO_SUCH_PATH && apvContents[3] == NULL);
+  assert(aiStatuses[4] == NOT_A_DIRECTORY);
+  assert(aiStatuses[5] == CONFLICTING_PATH);
+  assert(aiStatuses[6] == BAD_PATH);
+  assert(aiStatuses[7] == SUCCESS);
+  assert(!strcmp(apvContents[7], "Turing"));
+  assert(FT_statMany(apcBatch, BATCHLEN, FALSE, abIsFile, aulSizes,
+                     aiStatuses) == SUCCESS);
+  for(i = 0; i < BATCHLEN; i++) {
+    int iStatus = FT_stat(apcBatch[i], &bIsFile, &l);
+    assert(aiStatuses[i] == iStatus);
+    if(iStatus == SUCCESS) {
+      assert(abIsFile[i] == bIsFile);
+      if(bIsFile)
+        assert(aulSizes[i] == l);
+    }
+  }
+  assert(FT_statMany(apcBatch, BATCHLEN, TRUE, abIsFile, aulSizes,
+                     aiStatuses) == SUCCESS);
+  assert(aiStatuses[0] == SUCCESS && abIsFile[0] == TRUE);
+  assert(aiStatuses[1] == SUCCESS && abIsFile[1] == FALSE);
+  assert(aiStatuses[3] == NO_SUCH_PATH);
+  assert(FT_rmFile("1root/y/CHILD1DIR/A") == SUCCESS);
+
+  /* a bulk load inserts what the equivalent inserts would, whether or
+     not its records are in order, and stops at the first failure */
+  assert(FT_bulkLoad((boolean (*)(void *, const char **, boolean *,
+                                  void **, size_t *)) nextRecord,
+                     &sStream) == SUCCESS);
+  assert(sStream.ulNext == sizeof(asRecords) / sizeof(asRecords[0]));
+  assert(FT_containsDir("1root/b") == TRUE);
+  assert(FT_containsDir("1root/b/c") == TRUE);
+  assert(!strcmp(FT_getFileContents("1root/b/c/d"), "Knuth"));
+  assert(!strcmp(FT_getFileContents("1root/b/c/e"), "Backus"));
+  assert(FT_containsDir("1root/b/f") == TRUE);
+  assert(FT_getFileContents("1root/b/g") == NULL);
+  assert(FT_containsFile("1root/b/g") == TRUE);
+  assert(FT_containsDir("1root/a") == TRUE);
+  assert(!strcmp(FT_getFileContents("1root/y/CHILD3DIR/h"), "Hoare"));
+  assert(!strcmp(FT_getFileContents("1root/b/i"), "Kay"));
+  assert((temp = FT_toString()) != NULL);
+  fprintf(stderr, "Checkpoint 6:\n%s\n", temp);
+  free(temp);
+  sStream.ulNext = 1;
+  assert(FT_bulkLoad((boolean (*)(void *, const char **, boolean *,
+                                  void **, size_t *)) nextRecord,
+                     &sStream) == ALREADY_IN_TREE);
+  assert(sStream.ulNext == 2);
+  sStream.psRecords = asBadRecords;
+  sStream.ulCount = sizeof(asBadRecords) / sizeof(asBadRecords[0]);
+  sStream.ulNext = 0;
+  assert(FT_bulkLoad((boolean (*)(void *, const char **, boolean *,
+                                  void **, size_t *)) nextRecord,
+                     &sStream) == NOT_A_DIRECTORY);
+  assert(sStream.ulNext == 3);
+  assert(FT_containsFile("1root/k/l") == TRUE);
+  assert(FT_containsDir("1root/k/m") == TRUE);
+  assert(FT_containsFile("1root/k/o") == FALSE);
+  assert(FT_rmDir("1root/b") == SUCCESS);
+  assert(FT_rmDir("1root/a") == SUCCESS);
+  assert(FT_rmDir("1root/k") == SUCCESS);
+  assert(FT_rmFile("1root/y/CHILD3DIR/h") == SUCCESS);
+
+  /* instances are independent of each other and of the default FT */
+  assert((oFTree = FT_new()) != NULL);
+  assert((oFTree2 = FT_new()) != NULL);
+  assert(FT_containsDirIn(oFTree, "1root") == FALSE);
+  assert(FT_insertDirIn(oFTree, "2root/a") == SUCCESS);
+  assert(FT_insertFileIn(oFTree2, "1root/y", "Lovelace",
+                         strlen("Lovelace")+1) == SUCCESS);
+  assert(FT_containsFileIn(oFTree2, "1root/y") == TRUE);
+  assert(FT_containsDir("1root/y") == TRUE);
+  assert(FT_containsDirIn(oFTree, "2root/a") == TRUE);
+  assert(FT_containsDir("2root/a") == FALSE);
+  assert(FT_insertDirIn(oFTree2, "2root") == CONFLICTING_PATH);
+  assert(FT_statIn(oFTree2, "1root/y", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == strlen("Lovelace")+1);
+  assert(FT_openDirIn(oFTree, "2root/a", &oDDir2) == SUCCESS);
+  assert(FT_insertFileAt(oDDir2, "F", "Hopper",
+                         strlen("Hopper")+1) == SUCCESS);
+  FT_closeDir(oDDir2);
+  assert(!strcmp(FT_getFileContentsIn(oFTree, "2root/a/F"), "Hopper"));
+  assert(FT_lookupIdIn(oFTree, "2root/a/F", &ulID) == SUCCESS);
+  assert(!strcmp(FT_getContentsByIdIn(oFTree, ulID), "Hopper"));
+  assert(FT_enableFilterIn(oFTree2, 16, 0.01, 0) == SUCCESS);
+  assert(FT_containsFileIn(oFTree2, "1root/x") == FALSE);
+  assert(FT_getFilterStatsIn(oFTree2, &ulQueries, NULL, NULL,
+                             NULL) == SUCCESS);
+  assert(ulQueries == 1);
+  assert((temp = FT_toStringIn(oFTree)) != NULL);
+  assert(!strcmp(temp, "2root\n2root/a\n2root/a/F\n"));
+  free(temp);
+  assert(FT_rmDirIn(oFTree, "2root/a") == SUCCESS);
+  assert(FT_getContentsByIdIn(oFTree, ulID) == NULL);
+  FT_free(oFTree);
+  FT_free(oFTree2);
+  FT_free(NULL);
+  assert(FT_containsDir("1root/y") == TRUE);
+
+  /* a sharded FT answers as a single FT holding the same hierarchy,
+     and counts and prints the root only once */
+  assert((oFTree = FT_new()) != NULL);
+  assert((oSTree = ShardFT_new(4)) != NULL);
+  assert(ShardFT_insertFile(oSTree, "3root", NULL, 0) == CONFLICTING_PATH);
+  assert(ShardFT_insertDir(oSTree, "3root/") == BAD_PATH);
+  assert(ShardFT_containsDir(oSTree, "3root") == FALSE);
+  assert((temp = ShardFT_toString(oSTree)) != NULL);
+  assert(!strcmp(temp, ""));
+  free(temp);
+  for(i = 0; i < sizeof(apcShardPaths) / sizeof(apcShardPaths[0]); i++)
+    if(i % 2 == 0)
+      assert(ShardFT_insertFile(oSTree, apcShardPaths[i],
+                                (void *) apcShardPaths[i], i) ==
+             FT_insertFileIn(oFTree, apcShardPaths[i],
+                             (void *) apcShardPaths[i], i));
+    else
+      assert(ShardFT_insertDir(oSTree, apcShardPaths[i]) ==
+             FT_insertDirIn(oFTree, apcShardPaths[i]));
+  assert(ShardFT_insertDir(oSTree, "3root") == ALREADY_IN_TREE);
+  assert(ShardFT_insertDir(oSTree, "4root/a") == CONFLICTING_PATH);
+  assert(ShardFT_insertFile(oSTree, "3root/b/x/w", NULL, 0) ==
+         NOT_A_DIRECTORY);
+  assert((temp = ShardFT_toString(oSTree)) != NULL);
+  assert((temp2 = FT_toStringIn(oFTree)) != NULL);
+  assert(!strcmp(temp, temp2));
+  free(temp);
+  free(temp2);
+  assert(ShardFT_getCount(oSTree, &ulCount) == SUCCESS);
+  assert(FT_getCountIn(oFTree, &l) == SUCCESS);
+  assert(ulCount == l && ulCount == 15);
+  assert(ShardFT_containsDir(oSTree, "3root") == TRUE);
+  assert(ShardFT_containsDir(oSTree, "3root/b/y") == TRUE);
+  assert(ShardFT_containsDir(oSTree, "3root/c/d/e") == TRUE);
+  assert(ShardFT_getFileContents(oSTree, "3root/g") == apcShardPaths[6]);
+  assert(ShardFT_replaceFileContents(oSTree, "3root/g", NULL, 0) ==
+         apcShardPaths[6]);
+  assert(ShardFT_stat(oSTree, "3root/g", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 0);
+  assert(ShardFT_rmFile(oSTree, "3root/b") == NOT_A_FILE);
+  assert(ShardFT_rmDir(oSTree, "3root/b") == SUCCESS);
+  assert(ShardFT_containsFile(oSTree, "3root/b/x") == FALSE);
+  assert(ShardFT_rmFile(oSTree, "3root/g") == SUCCESS);
+  assert(ShardFT_rmDir(oSTree, "4root") == CONFLICTING_PATH);
+  assert(ShardFT_rmDir(oSTree, "3root") == SUCCESS);
+  assert(ShardFT_getCount(oSTree, &ulCount) == SUCCESS);
+  assert(ulCount == 0);
+  assert(ShardFT_containsFile(oSTree, "3root/a") == FALSE);
+  assert(ShardFT_insertFile(oSTree, "4root/x/y", NULL, 0) == SUCCESS);
+  assert((temp = ShardFT_toString(oSTree)) != NULL);
+  assert(!strcmp(temp, "4root\n4root/x\n4root/x/y\n"));
+  free(temp);
+  ShardFT_free(oSTree);
+  ShardFT_free(NULL);
+  FT_free(oFTree);
+
+  /* a snapshot keeps answering as the FT stood when it was taken,
+     while the FT's own identifiers and handles keep working */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_insertFileIn(oFTree, "5root/a/F", acKnuth, 6) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "5root/a/G", acHoare, 6) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "5root/b/x") == SUCCESS);
+  assert(FT_lookupIdIn(oFTree, "5root/a/F", &ulID) == SUCCESS);
+  assert(FT_openDirIn(oFTree, "5root/a", &oDDir2) == SUCCESS);
+  assert((temp2 = FT_toStringIn(oFTree)) != NULL);
+  assert(FT_snapshotIn(oFTree, &oSSnap) == SUCCESS);
+  assert(FT_replaceFileContentsIn(oFTree, "5root/a/F", acBackus, 7) ==
+         acKnuth);
+  assert(FT_insertFileAt(oDDir2, "H", NULL, 0) == SUCCESS);
+  assert(FT_rmDirIn(oFTree, "5root/b") == SUCCESS);
+  sStream.psRecords = asSnapRecords;
+  sStream.ulCount = sizeof(asSnapRecords) / sizeof(asSnapRecords[0]);
+  sStream.ulNext = 0;
+  assert(FT_bulkLoadIn(oFTree, (boolean (*)(void *, const char **,
+                                            boolean *, void **,
+                                            size_t *)) nextRecord,
+                       &sStream) == SUCCESS);
+  assert(FT_getFileContentsOf(oSSnap, "5root/a/F") == acKnuth);
+  assert(FT_getFileContentsIn(oFTree, "5root/a/F") == acBackus);
+  assert(FT_getContentsByIdIn(oFTree, ulID) == acBackus);
+  assert(FT_statOf(oSSnap, "5root/a/F", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 6);
+  assert(FT_containsFileOf(oSSnap, "5root/a/H") == FALSE);
+  assert(FT_containsFileIn(oFTree, "5root/a/H") == TRUE);
+  assert(FT_containsDirOf(oSSnap, "5root/b/x") == TRUE);
+  assert(FT_containsDirIn(oFTree, "5root/b/x") == FALSE);
+  assert(FT_containsDirOf(oSSnap, "5root/c") == FALSE);
+  assert(FT_getCountOf(oSSnap, &ulCount) == SUCCESS);
+  assert(ulCount == 6);
+  assert((temp = FT_toStringOf(oSSnap)) != NULL);
+  assert(!strcmp(temp, temp2));
+  free(temp);
+  free(temp2);
+  assert(FT_snapshotIn(oFTree, &oSSnap2) == SUCCESS);
+  assert((temp2 = FT_toStringIn(oFTree)) != NULL);
+  assert(!strcmp(temp2, "5root\n5root/a\n5root/a/F\n5root/a/G\n"
+                        "5root/a/H\n5root/a/I\n5root/c\n"));
+  assert(FT_rmDirIn(oFTree, "5root") == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "6root") == SUCCESS);
+  FT_releaseSnapshot(oSSnap);
+  assert((temp = FT_toStringOf(oSSnap2)) != NULL);
+  assert(!strcmp(temp, temp2));
+  free(temp);
+  free(temp2);
+  assert(FT_getFileContentsOf(oSSnap2, "5root/a/I") == acKay);
+  FT_releaseSnapshot(oSSnap2);
+  FT_releaseSnapshot(NULL);
+  assert(FT_getContentsByIdIn(oFTree, ulID) == NULL);
+  assert(FT_insertFileAt(oDDir2, "J", NULL, 0) == NO_SUCH_PATH);
+  FT_closeDir(oDDir2);
+  FT_free(oFTree);
+
+  /* an aborted transaction leaves the FT exactly as it began, down to
+     identifiers, handles and filter, and a committed one keeps its
+     changes */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_insertFileIn(oFTree, "7root/a/F", acKnuth, 6) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "7root/b/x") == SUCCESS);
+  assert(FT_enableFilterIn(oFTree, 64, 0.01, 0) == SUCCESS);
+  assert(FT_lookupIdIn(oFTree, "7root/a/F", &ulID) == SUCCESS);
+  assert(FT_openDirIn(oFTree, "7root/b", &oDDir2) == SUCCESS);
+  assert(FT_snapshotIn(oFTree, &oSSnap) == SUCCESS);
+  assert((temp2 = FT_toStringIn(oFTree)) != NULL);
+  assert(FT_commitIn(oFTree) == INITIALIZATION_ERROR);
+  assert(FT_abortIn(oFTree) == INITIALIZATION_ERROR);
+  assert(FT_beginIn(oFTree) == SUCCESS);
+  assert(FT_beginIn(oFTree) == INITIALIZATION_ERROR);
+  assert(FT_snapshotIn(oFTree, &oSSnap2) == INITIALIZATION_ERROR);
+  assert(FT_insertFileIn(oFTree, "7root/a/G", acHoare, 6) == SUCCESS);
+  assert(FT_replaceFileContentsIn(oFTree, "7root/a/F", acBackus, 7) ==
+         acKnuth);
+  assert(FT_replaceContentsByIdIn(oFTree, ulID, acKay, 4) == acBackus);
+  assert(FT_insertFileAt(oDDir2, "z", NULL, 0) == SUCCESS);
+  assert(FT_rmDirIn(oFTree, "7root/b") == SUCCESS);
+  assert(FT_insertFileAt(oDDir2, "z", NULL, 0) == NO_SUCH_PATH);
+  assert(FT_insertDirIn(oFTree, "7root/b/w") == SUCCESS);
+  assert(FT_rmFileIn(oFTree, "7root/a/G") == SUCCESS);
+  assert(FT_getCountIn(oFTree, &ulCount) == SUCCESS);
+  assert(ulCount == 5);
+  assert(FT_rmDirIn(oFTree, "7root") == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "8root") == SUCCESS);
+  assert((temp = FT_toStringIn(oFTree)) != NULL);
+  assert(!strcmp(temp, "8root\n"));
+  free(temp);
+  assert(FT_abortIn(oFTree) == SUCCESS);
+  assert(FT_abortIn(oFTree) == INITIALIZATION_ERROR);
+  assert((temp = FT_toStringIn(oFTree)) != NULL);
+  assert(!strcmp(temp, temp2));
+  free(temp);
+  free(temp2);
+  assert(FT_getCountIn(oFTree, &ulCount) == SUCCESS);
+  assert(ulCount == 5);
+  assert(FT_getContentsByIdIn(oFTree, ulID) == acKnuth);
+  assert(FT_statAt(oDDir2, "x", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == FALSE);
+  assert(FT_containsDirIn(oFTree, "7root/b/x") == TRUE);
+  assert(FT_containsFileIn(oFTree, "7root/a/G") == FALSE);
+  assert(FT_containsDirIn(oFTree, "8root") == FALSE);
+  assert(FT_beginIn(oFTree) == SUCCESS);
+  assert(FT_rmDirIn(oFTree, "7root/b") == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "7root/c", acHoare, 6) == SUCCESS);
+  assert(FT_commitIn(oFTree) == SUCCESS);
+  assert(FT_statAt(oDDir2, "x", &bIsFile, &l) == NO_SUCH_PATH);
+  assert(FT_getFileContentsIn(oFTree, "7root/c") == acHoare);
+  assert(FT_getCountIn(oFTree, &ulCount) == SUCCESS);
+  assert(ulCount == 4);
+  assert(FT_getFileContentsOf(oSSnap, "7root/a/F") == acKnuth);
+  assert(FT_containsDirOf(oSSnap, "7root/b/x") == TRUE);
+  FT_releaseSnapshot(oSSnap);
+  FT_closeDir(oDDir2);
+  FT_free(oFTree);
+
+  /* replaying a write-ahead log rebuilds the hierarchy it recorded,
+     less aborted transactions and a torn tail, in copied contents */
+  (void) remove("ft_client.wal");
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_syncLogIn(oFTree) == INITIALIZATION_ERROR);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 2) == SUCCESS);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 2) ==
+         INITIALIZATION_ERROR);
+  assert(FT_insertFileIn(oFTree, "9root/a/F", acKnuth, 6) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "9root/b/x") == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "9root/b/G", acHoare, 6) == SUCCESS);
+  assert(FT_replaceFileContentsIn(oFTree, "9root/a/F", acBackus, 7) ==
+         acKnuth);
+  assert(FT_rmDirIn(oFTree, "9root/b/x") == SUCCESS);
+  assert(FT_rmFileIn(oFTree, "9root/b/G") == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "9root/b/G", NULL, 0) == SUCCESS);
+  assert(FT_beginIn(oFTree) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "9root/c") == SUCCESS);
+  assert(FT_replaceFileContentsIn(oFTree, "9root/a/F", acKay, 4) ==
+         acBackus);
+  assert(FT_rmDirIn(oFTree, "9root/b") == SUCCESS);
+  assert(FT_closeLogIn(oFTree) == INITIALIZATION_ERROR);
+  assert(FT_abortIn(oFTree) == SUCCESS);
+  assert(FT_beginIn(oFTree) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "9root/d", acKay, 4) == SUCCESS);
+  assert(FT_commitIn(oFTree) == SUCCESS);
+  assert((temp2 = FT_toStringIn(oFTree)) != NULL);
+  assert(FT_syncLogIn(oFTree) == SUCCESS);
+  assert(FT_closeLogIn(oFTree) == SUCCESS);
+  assert(FT_closeLogIn(oFTree) == INITIALIZATION_ERROR);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 2) ==
+         INITIALIZATION_ERROR);
+  FT_free(oFTree);
+  assert((psFile = fopen("ft_client.wal", "ab")) != NULL);
+  assert(fputs("torn", psFile) != EOF);
+  assert(fclose(psFile) == 0);
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 1) == SUCCESS);
+  assert((temp = FT_toStringIn(oFTree)) != NULL);
+  assert(!strcmp(temp, temp2));
+  free(temp);
+  assert((temp = FT_getFileContentsIn(oFTree, "9root/a/F")) != NULL);
+  assert(temp != acBackus && !memcmp(temp, acBackus, 7));
+  assert(FT_getFileContentsIn(oFTree, "9root/b/G") == NULL);
+  assert(FT_insertDirIn(oFTree, "9root/e") == SUCCESS);
+  assert(FT_closeLogIn(oFTree) == SUCCESS);
+  free(FT_getFileContentsIn(oFTree, "9root/a/F"));
+  free(FT_getFileContentsIn(oFTree, "9root/d"));
+  FT_free(oFTree);
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 1) == SUCCESS);
+  assert(FT_containsDirIn(oFTree, "9root/e") == TRUE);
+  assert((temp = FT_getFileContentsIn(oFTree, "9root/d")) != NULL);
+  assert(!memcmp(temp, acKay, 4));
+  free(temp);
+  free(FT_getFileContentsIn(oFTree, "9root/a/F"));
+  FT_free(oFTree);
+  free(temp2);
+  assert((psFile = fopen("ft_client.wal", "wb")) != NULL);
+  assert(fputs("not a log", psFile) != EOF);
+  assert(fclose(psFile) == 0);
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 1) == IO_ERROR);
+  assert(FT_getCountIn(oFTree, &ulCount) == SUCCESS);
+  assert(ulCount == 0);
+  FT_free(oFTree);
+  assert(remove("ft_client.wal") == 0);
+
+  /* a checkpoint holds every node's type and contents, so loading it
+     rebuilds the hierarchy saved, and loading a damaged one fails
+     leaving the FT empty */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_insertFileIn(oFTree, "10root/a/F", acKnuth, 6) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "10root/a/E", NULL, 0) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "10root/G", acHoare, 0) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "10root/b/c/d") == SUCCESS);
+  assert(FT_snapshotIn(oFTree, &oSSnap) == SUCCESS);
+  assert(FT_rmDirIn(oFTree, "10root/b") == SUCCESS);
+  assert(FT_saveOf(oSSnap, "ft_client.ckpt") == SUCCESS);
+  FT_releaseSnapshot(oSSnap);
+  assert((temp2 = FT_toStringIn(oFTree)) != NULL);
+  assert(FT_loadIn(oFTree, "ft_client.ckpt") == INITIALIZATION_ERROR);
+  assert((oFTree2 = FT_new()) != NULL);
+  assert(FT_loadIn(oFTree2, "ft_client.ckpt") == SUCCESS);
+  assert(FT_getCountIn(oFTree2, &ulCount) == SUCCESS);
+  assert(ulCount == 8);
+  assert(FT_rmDirIn(oFTree2, "10root/b") == SUCCESS);
+  assert((temp = FT_toStringIn(oFTree2)) != NULL);
+  assert(!strcmp(temp, temp2));
+  free(temp);
+  free(temp2);
+  assert((temp = FT_getFileContentsIn(oFTree2, "10root/a/F")) != NULL);
+  assert(temp != acKnuth && !strcmp(temp, acKnuth));
+  free(temp);
+  assert(FT_getFileContentsIn(oFTree2, "10root/a/E") == NULL);
+  assert(FT_statIn(oFTree2, "10root/G", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 0);
+  assert((temp = FT_getFileContentsIn(oFTree2, "10root/G")) != NULL);
+  free(temp);
+  FT_free(oFTree2);
+  assert((psFile = fopen("ft_client.ckpt", "r+b")) != NULL);
+  assert(fseek(psFile, -3L, SEEK_END) == 0);
+  assert(fputs("/", psFile) != EOF);
+  assert(fclose(psFile) == 0);
+  assert((oFTree2 = FT_new()) != NULL);
+  assert(FT_loadIn(oFTree2, "ft_client.ckpt") == IO_ERROR);
+  assert(FT_getCountIn(oFTree2, &ulCount) == SUCCESS);
+  assert(ulCount == 0);
+  assert(FT_loadIn(oFTree2, "ft_client.missing") == IO_ERROR);
+  FT_free(oFTree2);
+  FT_free(oFTree);
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_saveIn(oFTree, "ft_client.ckpt") == SUCCESS);
+  assert(FT_loadIn(oFTree, "ft_client.ckpt") == SUCCESS);
+  assert(FT_getCountIn(oFTree, &ulCount) == SUCCESS);
+  assert(ulCount == 0);
+  FT_free(oFTree);
+  assert(remove("ft_client.ckpt") == 0);
+
+  /* an image is queried where it lies: lookups answer as on the FT
+     saved, contents point into the mapping, and writes fail */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_insertFileIn(oFTree, "11root/a/F", acKnuth, 6) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "11root/a/E", NULL, 0) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "11root/G", acHoare, 0) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "11root/b/c/d") == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "11root/b/a") == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "11root/b/e") == SUCCESS);
+  assert(FT_saveImageIn(oFTree, "ft_client.img") == SUCCESS);
+  assert(FT_rmDirIn(oFTree, "11root/b") == SUCCESS);
+  assert(FT_openImage("ft_client.img", &oFTree2) == SUCCESS);
+  assert(FT_getCountIn(oFTree2, &ulCount) == SUCCESS);
+  assert(ulCount == 10);
+  assert(FT_containsDirIn(oFTree2, "11root") == TRUE);
+  assert(FT_containsDirIn(oFTree2, "11root/b/c/d") == TRUE);
+  assert(FT_containsDirIn(oFTree2, "11root/b/a") == TRUE);
+  assert(FT_containsDirIn(oFTree2, "11root/b/e") == TRUE);
+  assert(FT_containsDirIn(oFTree2, "11root/b/b") == FALSE);
+  assert(FT_containsDirIn(oFTree2, "11root/a/F") == FALSE);
+  assert(FT_containsFileIn(oFTree2, "11root/a/F") == TRUE);
+  assert(FT_containsFileIn(oFTree2, "11root/a/E") == TRUE);
+  assert(FT_containsFileIn(oFTree2, "11root/a") == FALSE);
+  assert((temp = FT_getFileContentsIn(oFTree2, "11root/a/F")) != NULL);
+  assert(temp != acKnuth && !strcmp(temp, acKnuth));
+  assert(FT_getFileContentsIn(oFTree2, "11root/a/E") == NULL);
+  assert(FT_getFileContentsIn(oFTree2, "11root/a") == NULL);
+  assert(FT_statIn(oFTree2, "11root/a/F", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 6);
+  assert(FT_statIn(oFTree2, "11root/G", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 0);
+  assert(FT_statIn(oFTree2, "11root/b", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == FALSE);
+  assert(FT_statIn(oFTree2, "11root/a/F/x", &bIsFile, &l)
+         == NOT_A_DIRECTORY);
+  assert(FT_statIn(oFTree2, "11root/a/x", &bIsFile, &l)
+         == NO_SUCH_PATH);
+  assert(FT_statIn(oFTree2, "11roo", &bIsFile, &l) == CONFLICTING_PATH);
+  assert(FT_statIn(oFTree2, "11root//a", &bIsFile, &l) == BAD_PATH);
+  assert(FT_statIn(oFTree2, "11root/", &bIsFile, &l) == BAD_PATH);
+  assert(FT_insertDirIn(oFTree2, "11root/x") == INITIALIZATION_ERROR);
+  assert(FT_rmFileIn(oFTree2, "11root/a/F") == INITIALIZATION_ERROR);
+  assert(FT_toStringIn(oFTree2) == NULL);
+  FT_free(oFTree2);
+  FT_free(oFTree);
+  assert((psFile = fopen("ft_client.img", "r+b")) != NULL);
+  assert(fputs("X", psFile) != EOF);
+  assert(fclose(psFile) == 0);
+  assert(FT_openImage("ft_client.img", &oFTree2) == IO_ERROR);
+  assert(FT_openImage("ft_client.missing", &oFTree2) == IO_ERROR);
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_saveImageIn(oFTree, "ft_client.img") == SUCCESS);
+  FT_free(oFTree);
+  assert(FT_openImage("ft_client.img", &oFTree) == SUCCESS);
+  assert(FT_getCountIn(oFTree, &ulCount) == SUCCESS);
+  assert(ulCount == 0);
+  assert(FT_containsDirIn(oFTree, "11root") == FALSE);
+  FT_free(oFTree);
+  assert(remove("ft_client.img") == 0);
+
+  /* a paged tree opens with only its root resident, pages in the
+     directories along each path used, and evicts the least recently
+     used clean ones beyond its limit, keeping changed ones */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_insertFileIn(oFTree, "12root/a/F", acKnuth, 6) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "12root/a/E", NULL, 0) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "12root/b/c/d") == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "12root/b/c/H", acHoare, 6) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "12root/b/e") == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "12root/G", acKay, 4) == SUCCESS);
+  assert(FT_saveImageIn(oFTree, "ft_client.img") == SUCCESS);
+  assert(PagedFT_open("ft_client.img", 4, &oPTree) == SUCCESS);
+  assert(PagedFT_getCount(oPTree, &ulCount) == SUCCESS);
+  assert(ulCount == 10);
+  assert(PagedFT_getPagingStats(oPTree, &ulPageIns, &ulEvictions,
+                                &ulResident) == SUCCESS);
+  assert(ulPageIns == 0 && ulEvictions == 0 && ulResident == 1);
+  assert(PagedFT_stat(oPTree, "12root/a/F", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 6);
+  assert(PagedFT_getPagingStats(oPTree, &ulPageIns, &ulEvictions,
+                                &ulResident) == SUCCESS);
+  assert(ulPageIns == 2 && ulEvictions == 1 && ulResident == 4);
+  assert((temp = PagedFT_getFileContents(oPTree, "12root/a/F")) != NULL);
+  assert(temp != acKnuth && !strcmp(temp, acKnuth));
+  assert(PagedFT_containsDir(oPTree, "12root/b/c/d") == TRUE);
+  assert(PagedFT_containsDir(oPTree, "12root/b/c/H") == FALSE);
+  assert(PagedFT_containsFile(oPTree, "12root/b/c/H") == TRUE);
+  assert(PagedFT_stat(oPTree, "12root/G/x", &bIsFile, &l)
+         == NOT_A_DIRECTORY);
+  assert(PagedFT_stat(oPTree, "12roo", &bIsFile, &l) == CONFLICTING_PATH);
+  assert(PagedFT_stat(oPTree, "12root//a", &bIsFile, &l) == BAD_PATH);
+  assert(PagedFT_getPagingStats(oPTree, &ulPageIns, &ulEvictions,
+                                &ulResident) == SUCCESS);
+  assert(ulEvictions > 1 && ulResident <= 4);
+  assert(PagedFT_insertFile(oPTree, "12root/b/c/N", NULL, 0) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "12root/b/c/N", NULL, 0) == SUCCESS);
+  assert(PagedFT_insertFile(oPTree, "12root/b/c/N", NULL, 0)
+         == ALREADY_IN_TREE);
+  assert((temp = PagedFT_replaceFileContents(oPTree, "12root/G", acKay,
+                                             4)) != NULL);
+  assert(temp != acKay && !strcmp(temp, acKay));
+  assert(PagedFT_getPagingStats(oPTree, &ulPageIns, &ulEvictions,
+                                &ulResident) == SUCCESS);
+  assert(ulResident > 4);
+  assert(PagedFT_containsDir(oPTree, "12root/a") == TRUE);
+  assert(PagedFT_rmDir(oPTree, "12root/a") == SUCCESS);
+  assert(FT_rmDirIn(oFTree, "12root/a") == SUCCESS);
+  assert(PagedFT_containsFile(oPTree, "12root/a/F") == FALSE);
+  assert(PagedFT_rmFile(oPTree, "12root/b/c/H") == SUCCESS);
+  assert(FT_rmFileIn(oFTree, "12root/b/c/H") == SUCCESS);
+  assert(PagedFT_getCount(oPTree, &ulCount) == SUCCESS);
+  assert(ulCount == 7);
+  assert((temp = PagedFT_toString(oPTree)) != NULL);
+  assert((temp2 = FT_toStringIn(oFTree)) != NULL);
+  assert(!strcmp(temp, temp2));
+  free(temp);
+  free(temp2);
+  PagedFT_free(oPTree);
+  FT_free(oFTree);
+  assert(PagedFT_open("ft_client.missing", 4, &oPTree) == IO_ERROR);
+  assert(remove("ft_client.img") == 0);
+
+  /* a heap tree lives in its file: a reopening finds it as of its
+     last checkpoint, with contents copied in */
+  (void) remove("ft_client.heap");
+  assert(HeapFT_open("ft_client.heap", &oHTree) == SUCCESS);
+  assert(HeapFT_getCount(oHTree, &ulCount) == SUCCESS);
+  assert(ulCount == 0);
+  assert(HeapFT_stat(oHTree, "13root", &bIsFile, &l) == NO_SUCH_PATH);
+  assert(HeapFT_insertFile(oHTree, "13root", acKnuth, 6)
+         == CONFLICTING_PATH);
+  assert(HeapFT_insertFile(oHTree, "13root/a/F", acKnuth, 6) == SUCCESS);
+  assert(HeapFT_insertFile(oHTree, "13root/a/E", NULL, 4) == SUCCESS);
+  assert(HeapFT_insertDir(oHTree, "13root/b/c") == SUCCESS);
+  assert(HeapFT_insertFile(oHTree, "13root/G", acHoare, 6) == SUCCESS);
+  assert(HeapFT_insertDir(oHTree, "13root/b") == ALREADY_IN_TREE);
+  assert(HeapFT_insertDir(oHTree, "13root/a/F/x") == NOT_A_DIRECTORY);
+  assert(HeapFT_insertDir(oHTree, "13roo/b") == CONFLICTING_PATH);
+  assert(HeapFT_insertDir(oHTree, "13root//b") == BAD_PATH);
+  assert(HeapFT_rmDir(oHTree, "13root/G") == NOT_A_DIRECTORY);
+  assert(HeapFT_rmFile(oHTree, "13root/b") == NOT_A_FILE);
+  assert(HeapFT_rmFile(oHTree, "13root/x") == NO_SUCH_PATH);
+  assert(HeapFT_containsDir(oHTree, "13root/b/c") == TRUE);
+  assert(HeapFT_containsFile(oHTree, "13root/b/c") == FALSE);
+  assert(HeapFT_containsFile(oHTree, "13root/a/F") == TRUE);
+  assert((temp = HeapFT_getFileContents(oHTree, "13root/a/F")) != NULL);
+  assert(temp != acKnuth && !strcmp(temp, acKnuth));
+  assert(HeapFT_getFileContents(oHTree, "13root/a/E") == NULL);
+  assert(HeapFT_stat(oHTree, "13root/a/E", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 4);
+  assert((temp = HeapFT_replaceFileContents(oHTree, "13root/G", acKay,
+                                            4)) != NULL);
+  assert(!strcmp(temp, acHoare));
+  assert(HeapFT_checkpoint(oHTree) == SUCCESS);
+  assert(HeapFT_rmDir(oHTree, "13root/a") == SUCCESS);
+  assert(HeapFT_getCount(oHTree, &ulCount) == SUCCESS);
+  assert(ulCount == 4);
+  HeapFT_free(oHTree);
+  assert(HeapFT_open("ft_client.heap", &oHTree) == SUCCESS);
+  assert(HeapFT_getCount(oHTree, &ulCount) == SUCCESS);
+  assert(ulCount == 7);
+  assert((temp = HeapFT_getFileContents(oHTree, "13root/G")) != NULL);
+  assert(!strcmp(temp, acKay));
+  assert(HeapFT_rmFile(oHTree, "13root/a/E") == SUCCESS);
+  assert(HeapFT_checkpoint(oHTree) == SUCCESS);
+  HeapFT_free(oHTree);
+  assert(HeapFT_open("ft_client.heap", &oHTree) == SUCCESS);
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_insertFileIn(oFTree, "13root/a/F", NULL, 0) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "13root/b/c") == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "13root/G", NULL, 0) == SUCCESS);
+  assert((temp = HeapFT_toString(oHTree)) != NULL);
+  assert((temp2 = FT_toStringIn(oFTree)) != NULL);
+  assert(!strcmp(temp, temp2));
+  free(temp);
+  free(temp2);
+  FT_free(oFTree);
+  assert(HeapFT_rmDir(oHTree, "13root") == SUCCESS);
+  assert(HeapFT_getCount(oHTree, &ulCount) == SUCCESS);
+  assert(ulCount == 0);
+  HeapFT_free(oHTree);
+  assert((psFile = fopen("ft_client.heap", "r+b")) != NULL);
+  assert(fputs("X", psFile) != EOF);
+  assert(fclose(psFile) == 0);
+  assert(HeapFT_open("ft_client.heap", &oHTree) == IO_ERROR);
+  assert(remove("ft_client.heap") == 0);
+
+  /* an FT that owns contents frees them once it drops them, but not
+     while a snapshot or an open transaction still needs them */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_insertFileOwnedIn(oFTree, "14root/a/F", copyString(acKnuth),
+                              6, freeCounted) == SUCCESS);
+  assert(FT_insertFileOwnedIn(oFTree, "14x/F", temp = copyString(acKay),
+                              4, freeCounted) == CONFLICTING_PATH);
+  assert(FT_insertFileOwnedIn(oFTree, "14root/a/F", temp, 4, freeCounted)
+         == ALREADY_IN_TREE);
+  free(temp);
+  assert(FT_insertFileCopyIn(oFTree, "14root/a/G", acHoare, 6)
+         == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "14root/a/E", NULL, 0) == SUCCESS);
+  assert((temp = FT_getFileContentsIn(oFTree, "14root/a/G")) != acHoare);
+  assert(!strcmp(temp, acHoare));
+  assert(FT_getFileContentsIn(oFTree, "14root/a/E") == NULL);
+  assert(FT_snapshotIn(oFTree, &oSSnap) == SUCCESS);
+  assert(FT_replaceFileContentsOwnedIn(oFTree, "14root/a/F",
+                                       copyString(acKay), 4, freeCounted)
+         == SUCCESS);
+  assert(FT_replaceFileContentsCopyIn(oFTree, "14root/a", acKay, 4)
+         == NOT_A_FILE);
+  assert(FT_replaceFileContentsCopyIn(oFTree, "14root/a/x", acKay, 4)
+         == NO_SUCH_PATH);
+  assert(FT_replaceFileContentsCopyIn(oFTree, "14root/a/G/x", acKay, 4)
+         == NOT_A_DIRECTORY);
+  assert(FT_rmDirIn(oFTree, "14root/a") == SUCCESS);
+  assert((temp = FT_getFileContentsOf(oSSnap, "14root/a/F")) != NULL);
+  assert(!strcmp(temp, acKnuth));
+  assert((temp = FT_getFileContentsOf(oSSnap, "14root/a/G")) != NULL);
+  assert(!strcmp(temp, acHoare));
+  FT_releaseSnapshot(oSSnap);
+  assert(FT_insertFileCopyIn(oFTree, "14root/G", acHoare, 6) == SUCCESS);
+  assert(FT_beginIn(oFTree) == SUCCESS);
+  assert(FT_replaceFileContentsCopyIn(oFTree, "14root/G", acBackus, 7)
+         == SUCCESS);
+  assert(FT_rmFileIn(oFTree, "14root/G") == SUCCESS);
+  assert(FT_insertFileOwnedIn(oFTree, "14root/H", copyString(acKay), 4,
+                              freeCounted) == SUCCESS);
+  assert(FT_abortIn(oFTree) == SUCCESS);
+  assert((temp = FT_getFileContentsIn(oFTree, "14root/G")) != NULL);
+  assert(!strcmp(temp, acHoare));
+  assert(FT_containsFileIn(oFTree, "14root/H") == FALSE);
+  assert(FT_setContentsFreeIn(oFTree, freeCounted) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "14root/I", copyString(acKnuth), 6)
+         == SUCCESS);
+  assert(FT_replaceFileContentsIn(oFTree, "14root/I", copyString(acKay),
+                                  4) == NULL);
+  assert(FT_insertFileOwnedIn(oFTree, "14root/J", acKay, 4, NULL)
+         == SUCCESS);
+  assert(FT_replaceFileContentsIn(oFTree, "14root/J", copyString(acKay),
+                                  4) == acKay);
+  assert(FT_setContentsFreeIn(oFTree, NULL) == SUCCESS);
+  assert(FT_replaceFileContentsIn(oFTree, "14root/J", acKay, 4) == NULL);
+  assert(FT_getCountIn(oFTree, &ulCount) == SUCCESS);
+  assert(ulCount == 4);
+  FT_free(oFTree);
+  assert(ulFreed == 6);
+
+  /* with deduplication, the files that the FT owns with the same
+     contents share one stored copy of them */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_getDedupStatsIn(oFTree, NULL, NULL, NULL, NULL, NULL)
+         == NO_SUCH_PATH);
+  assert(FT_enableDedupIn(oFTree) == SUCCESS);
+  assert(FT_enableDedupIn(oFTree) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "15root/A", acKnuth, 6) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "15root/B", acKnuth, 6) == SUCCESS);
+  assert(FT_insertFileOwnedIn(oFTree, "15root/C", copyString(acKnuth),
+                              6, freeCounted) == SUCCESS);
+  assert(ulFreed == 7);
+  assert((temp = FT_getFileContentsIn(oFTree, "15root/A")) != acKnuth);
+  assert(!strcmp(temp, acKnuth));
+  assert(FT_getFileContentsIn(oFTree, "15root/B") == temp);
+  assert(FT_getFileContentsIn(oFTree, "15root/C") == temp);
+  assert(FT_insertFileIn(oFTree, "15root/D", acKnuth, 6) == SUCCESS);
+  assert(FT_getFileContentsIn(oFTree, "15root/D") == acKnuth);
+  assert(FT_insertFileCopyIn(oFTree, "15root/E", acKay, 4) == SUCCESS);
+  assert(FT_insertFileOwnedIn(oFTree, "15root/A/x",
+                              temp = copyString(acKay), 4, freeCounted)
+         == NOT_A_DIRECTORY);
+  free(temp);
+  assert(ulFreed == 7);
+  assert(FT_getDedupStatsIn(oFTree, &ulBlobs, &ulRefs, &ulStored,
+                            &ulSaved, &dRatio) == SUCCESS);
+  assert(ulBlobs == 2 && ulRefs == 4);
+  assert(ulStored == 10 && ulSaved == 12);
+  assert(dRatio > 2.19 && dRatio < 2.21);
+  assert(FT_replaceFileContentsCopyIn(oFTree, "15root/A", acKay, 4)
+         == SUCCESS);
+  assert(FT_getFileContentsIn(oFTree, "15root/A")
+         == FT_getFileContentsIn(oFTree, "15root/E"));
+  /* the old contents are released only once no reader can hold them */
+  assert(FT_getDedupStatsIn(oFTree, &ulBlobs, NULL, &ulStored, NULL,
+                            NULL) == SUCCESS);
+  assert(ulBlobs == 2 && ulStored == 10);
+  assert(FT_disableDedupIn(oFTree) == SUCCESS);
+  assert(FT_getDedupStatsIn(oFTree, NULL, NULL, NULL, NULL, NULL)
+         == NO_SUCH_PATH);
+  assert(FT_insertFileCopyIn(oFTree, "15root/F", acKay, 4) == SUCCESS);
+  assert(FT_getFileContentsIn(oFTree, "15root/F")
+         != FT_getFileContentsIn(oFTree, "15root/E"));
+  assert(FT_rmDirIn(oFTree, "15root") == SUCCESS);
+  FT_free(oFTree);
+  assert(ulFreed == 7);
+
+  /* positional writes chunk a file's contents and touch only the
+     bytes they reach, past the end too; positional reads read them
+     in place, and snapshots, transactions and the log keep up */
+  (void) remove("ft_client.wal");
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 2) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "16root/F", acBackus, 6) == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "16root/d") == SUCCESS);
+  assert(FT_readAtIn(oFTree, "16root/F", 2, arr, 10, &l) == SUCCESS);
+  assert(l == 4 && !memcmp(arr, "ckus", 4));
+  assert(FT_readAtIn(oFTree, "16root/F", 6, arr, 10, &l) == SUCCESS);
+  assert(l == 0);
+  assert(FT_readAtIn(oFTree, "16root/d", 0, arr, 10, &l) == NOT_A_FILE);
+  assert(FT_writeAtIn(oFTree, "16root/d", 0, acKay, 3) == NOT_A_FILE);
+  assert(FT_appendIn(oFTree, "16root/G", acKay, 3) == NO_SUCH_PATH);
+  assert(FT_snapshotIn(oFTree, &oSSnap) == SUCCESS);
+  assert(FT_writeAtIn(oFTree, "16root/F", 0, "b", 1) == SUCCESS);
+  assert(!memcmp(acBackus, "Backus", 6));
+  assert((temp = FT_getFileContentsIn(oFTree, "16root/F")) != acBackus);
+  assert(!memcmp(temp, "backus", 6));
+  assert(FT_getFileContentsIn(oFTree, "16root/F") == temp);
+  assert(FT_writeAtIn(oFTree, "16root/F", 4094, acKay, 4) == SUCCESS);
+  assert(FT_statIn(oFTree, "16root/F", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 4098);
+  assert(FT_readAtIn(oFTree, "16root/F", 4090, arr, 16, &l) == SUCCESS);
+  assert(l == 8 && !memcmp(arr, "\0\0\0\0Kay", 8));
+  assert(FT_appendIn(oFTree, "16root/F", acKnuth, 6) == SUCCESS);
+  assert(FT_readAtIn(oFTree, "16root/F", 4094, arr, 16, &l) == SUCCESS);
+  assert(l == 10 && !memcmp(arr, "Kay\0Knuth", 10));
+  assert((temp = FT_getFileContentsIn(oFTree, "16root/F")) != NULL);
+  assert(!memcmp(temp, "backus\0", 7) && !memcmp(temp + 4094, arr, 10));
+  assert(FT_getFileContentsOf(oSSnap, "16root/F") == acBackus);
+  FT_releaseSnapshot(oSSnap);
+  assert(FT_beginIn(oFTree) == SUCCESS);
+  assert(FT_appendIn(oFTree, "16root/F", acHoare, 6) == SUCCESS);
+  assert(FT_statIn(oFTree, "16root/F", &bIsFile, &l) == SUCCESS);
+  assert(l == 4110);
+  assert(FT_abortIn(oFTree) == SUCCESS);
+  assert(FT_statIn(oFTree, "16root/F", &bIsFile, &l) == SUCCESS);
+  assert(l == 4104);
+  assert((temp2 = FT_toStringIn(oFTree)) != NULL);
+  assert(FT_closeLogIn(oFTree) == SUCCESS);
+  assert(FT_replaceFileContentsIn(oFTree, "16root/F", acKay, 4) == NULL);
+  assert(FT_readAtIn(oFTree, "16root/F", 1, arr, 16, &l) == SUCCESS);
+  assert(l == 3 && !memcmp(arr, "ay", 3));
+  FT_free(oFTree);
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 1) == SUCCESS);
+  assert((temp = FT_toStringIn(oFTree)) != NULL);
+  assert(!strcmp(temp, temp2));
+  free(temp);
+  free(temp2);
+  assert(FT_statIn(oFTree, "16root/F", &bIsFile, &l) == SUCCESS);
+  assert(l == 4104);
+  assert(FT_readAtIn(oFTree, "16root/F", 4094, arr, 16, &l) == SUCCESS);
+  assert(l == 10 && !memcmp(arr, "Kay\0Knuth", 10));
+  assert((temp = FT_getFileContentsIn(oFTree, "16root/F")) != NULL);
+  assert(!memcmp(temp, "backus\0", 7));
+  assert(FT_closeLogIn(oFTree) == SUCCESS);
+  FT_free(oFTree);
+  assert(remove("ft_client.wal") == 0);
+
+  /* compression shrinks the contents that the FT owns, large or left
+     unread, which then read as they were, decompressed once into a
+     copy kept until they are left unread again */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_getCompressionStatsIn(oFTree, NULL, NULL, NULL, NULL, NULL,
+                                  NULL, NULL) == NO_SUCH_PATH);
+  for(i = 0; i < ARRLEN; i++)
+    arr[i] = (char) ('a' + i % 7);
+  assert(FT_insertFileCopyIn(oFTree, "17root/A", arr, ARRLEN) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "17root/B", acKnuth, 6) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "17root/C", arr, ARRLEN) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "17root/D", arr, ARRLEN) == SUCCESS);
+  assert(FT_getFileContentsIn(oFTree, "17root/D") != NULL);
+  assert(FT_compressIn(oFTree, ARRLEN + 1, &ulCount) == SUCCESS);
+  assert(ulCount == 1);
+  assert(FT_getCompressionStatsIn(oFTree, &ulPlain, &ulPacked, &dRatio,
+                                  NULL, NULL, &ulHits, &ulMisses)
+         == SUCCESS);
+  assert(ulPlain == ARRLEN && ulPacked < ARRLEN / 8 && dRatio > 8.0);
+  assert(ulHits == 0 && ulMisses == 0);
+  assert(FT_statIn(oFTree, "17root/A", &bIsFile, &l) == SUCCESS);
+  assert(l == ARRLEN);
+  assert((temp = FT_getFileContentsIn(oFTree, "17root/A")) != NULL);
+  assert(temp != arr && !memcmp(temp, arr, ARRLEN));
+  assert(FT_getFileContentsIn(oFTree, "17root/A") == temp);
+  assert(FT_getCompressionStatsIn(oFTree, NULL, NULL, NULL, NULL, NULL,
+                                  &ulHits, &ulMisses) == SUCCESS);
+  assert(ulHits == 1 && ulMisses == 1);
+  assert(FT_compressIn(oFTree, ARRLEN + 1, &ulCount) == SUCCESS);
+  assert(ulCount == 1);
+  assert(FT_compressIn(oFTree, ARRLEN + 1, &ulCount) == SUCCESS);
+  assert(ulCount == 0);
+  assert(FT_readAtIn(oFTree, "17root/A", ARRLEN - 5, arr, 10, &l)
+         == SUCCESS);
+  assert(l == 5 && !memcmp(arr, "bcdef", 5));
+  assert(FT_getCompressionStatsIn(oFTree, NULL, NULL, NULL, NULL, NULL,
+                                  &ulHits, &ulMisses) == SUCCESS);
+  assert(ulHits == 1 && ulMisses == 2);
+  for(i = 0; i < ARRLEN; i++)
+    arr[i] = (char) ('a' + i % 7);
+  assert(FT_getFileContentsIn(oFTree, "17root/B") != acKnuth);
+  assert(FT_getFileContentsIn(oFTree, "17root/C") == arr);
+  assert(FT_writeAtIn(oFTree, "17root/D", 0, "Z", 1) == SUCCESS);
+  assert(FT_readAtIn(oFTree, "17root/D", 0, arr, 2, &l) == SUCCESS);
+  assert(l == 2 && !memcmp(arr, "Zb", 2));
+  assert(FT_beginIn(oFTree) == SUCCESS);
+  assert(FT_compressIn(oFTree, 0, &ulCount) == INITIALIZATION_ERROR);
+  assert(FT_commitIn(oFTree) == SUCCESS);
+  FT_free(oFTree);
+
+  /* under a memory budget, the contents that the FT owns and that were
+     read least recently are spilled to disk, and read the same,
+     spilled contents being read back once into a copy kept until they
+     are spilled again */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_getSpillStatsIn(oFTree, NULL, NULL, NULL, NULL, NULL)
+         == NO_SUCH_PATH);
+  for(i = 0; i < ARRLEN; i++)
+    arr[i] = (char) ('a' + i % 7);
+  assert(FT_insertFileCopyIn(oFTree, "18root/A", arr, ARRLEN) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "18root/B", arr, ARRLEN) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "18root/C", arr, ARRLEN) == SUCCESS);
+  assert(FT_insertFileIn(oFTree, "18root/D", arr, ARRLEN) == SUCCESS);
+  assert(FT_getFileContentsIn(oFTree, "18root/A") != NULL);
+  assert(FT_enableSpillIn(oFTree, "ft_client.spill", 2 * ARRLEN + 500)
+         == SUCCESS);
+  assert(FT_getSpillStatsIn(oFTree, &ulSpills, &ulReloads, &ulPrefetches,
+                            &ulResident, &ulBytes) == SUCCESS);
+  assert(ulSpills == 2 && ulReloads == 0 && ulPrefetches == 0);
+  assert(ulResident == ARRLEN && ulBytes == 2 * ARRLEN);
+  assert(FT_readAtIn(oFTree, "18root/C", ARRLEN - 5, arr, 10, &l)
+         == SUCCESS);
+  assert(l == 5 && !memcmp(arr, "bcdef", 5));
+  for(i = 0; i < ARRLEN; i++)
+    arr[i] = (char) ('a' + i % 7);
+  assert((temp = FT_getFileContentsIn(oFTree, "18root/B")) != NULL);
+  assert(!memcmp(temp, arr, ARRLEN));
+  assert(FT_getFileContentsIn(oFTree, "18root/B") == temp);
+  assert(FT_prefetchIn(oFTree, apcPrefetch, 3, FALSE) == SUCCESS);
+  assert(FT_getSpillStatsIn(oFTree, &ulSpills, &ulReloads, &ulPrefetches,
+                            &ulResident, NULL) == SUCCESS);
+  assert(ulSpills == 2 && ulReloads == 1 && ulPrefetches == 1);
+  assert(ulResident == 2 * ARRLEN);
+  assert(FT_insertFileCopyIn(oFTree, "18root/E", arr, ARRLEN) == SUCCESS);
+  assert(FT_getSpillStatsIn(oFTree, &ulSpills, NULL, NULL, &ulResident,
+                            &ulBytes) == SUCCESS);
+  assert(ulSpills == 4 && ulResident == ARRLEN && ulBytes == 4 * ARRLEN);
+  assert(FT_getFileContentsIn(oFTree, "18root/B") == temp);
+  assert(FT_getFileContentsIn(oFTree, "18root/D") == arr);
+  assert(FT_writeAtIn(oFTree, "18root/A", 0, "Z", 1) == SUCCESS);
+  assert(FT_readAtIn(oFTree, "18root/A", 0, arr, 2, &l) == SUCCESS);
+  assert(l == 2 && !memcmp(arr, "Zb", 2));
+  assert(FT_statIn(oFTree, "18root/E", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == ARRLEN);
+  assert(FT_snapshotIn(oFTree, &oSSnap) == SUCCESS);
+  assert((temp = FT_getFileContentsOf(oSSnap, "18root/E")) != NULL);
+  assert(!memcmp(temp, "abcdefgab", 9));
+  FT_releaseSnapshot(oSSnap);
+  assert(FT_rmFileIn(oFTree, "18root/C") == SUCCESS);
+  assert(FT_beginIn(oFTree) == SUCCESS);
+  assert(FT_enableSpillIn(oFTree, "ft_client.spill", 0)
+         == INITIALIZATION_ERROR);
+  assert(FT_commitIn(oFTree) == SUCCESS);
+  assert(FT_disableSpillIn(oFTree) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "18root/F", arr, ARRLEN) == SUCCESS);
+  assert(FT_getSpillStatsIn(oFTree, &ulSpills, &ulReloads, &ulPrefetches,
+                            &ulResident, &ulBytes) == SUCCESS);
+  assert(ulSpills == 4 && ulReloads == 3 && ulPrefetches == 1);
+  /* the spilled bytes of files removed or written over leave holes,
+     and those at the end of the spill file are given back */
+  assert(ulResident == 4 * ARRLEN && ulBytes == 3 * ARRLEN);
+  /* files read or written since the budget was last enforced are
+     spared even when it is zero */
+  assert(FT_enableSpillIn(oFTree, "ignored.spill", 0) == SUCCESS);
+  assert(FT_getSpillStatsIn(oFTree, &ulSpills, NULL, NULL, &ulResident,
+                            &ulBytes) == SUCCESS);
+  assert(ulSpills == 5 && ulResident == 2 * ARRLEN);
+  /* later spills fill the holes before the file grows */
+  assert(ulBytes == 3 * ARRLEN);
+  assert(FT_readAtIn(oFTree, "18root/F", 1, arr, 2, &l) == SUCCESS);
+  assert(l == 2 && !memcmp(arr, "bc", 2));
+  FT_free(oFTree);
+  assert(remove("ignored.spill") != 0);
+  assert(remove("ft_client.spill") != 0);
+
+  /* decompressing contents to read them adds to memory as reading
+     spilled contents back does, so reads alone enforce the budget */
+  assert((oFTree = FT_new()) != NULL);
+  for(i = 0; i < 8; i++) {
+    sprintf(acPath, "18root/Z%lu", (unsigned long) i);
+    assert(FT_insertFileCopyIn(oFTree, acPath, arr, ARRLEN) == SUCCESS);
+  }
+  assert(FT_compressIn(oFTree, 0, &ulCount) == SUCCESS);
+  assert(ulCount == 8);
+  assert(FT_enableSpillIn(oFTree, "ft_client.spill", 2 * ARRLEN + 500)
+         == SUCCESS);
+  assert(FT_getSpillStatsIn(oFTree, &ulSpills, NULL, NULL, NULL, NULL)
+         == SUCCESS);
+  assert(ulSpills == 0);
+  for(i = 0; i < 8; i++) {
+    sprintf(acPath, "18root/Z%lu", (unsigned long) i);
+    assert((temp = FT_getFileContentsIn(oFTree, acPath)) != NULL);
+    assert(!memcmp(temp, arr, ARRLEN));
+  }
+  assert(FT_getSpillStatsIn(oFTree, &ulSpills, NULL, NULL, &ulResident,
+                            NULL) == SUCCESS);
+  assert(ulSpills > 0 && ulResident < 8 * ARRLEN);
+  FT_free(oFTree);
+
+  /* replacing spilled files over and over reuses the space their old
+     contents took in the spill file, which stays the same size */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_enableSpillIn(oFTree, "ft_client.spill", ARRLEN) == SUCCESS);
+  for(l = 0; l < 50; l++)
+    for(i = 0; i < 4; i++) {
+      sprintf(acPath, "18root/R%lu", (unsigned long) i);
+      if(l == 0)
+        assert(FT_insertFileCopyIn(oFTree, acPath, arr, ARRLEN)
+               == SUCCESS);
+      else
+        assert(FT_replaceFileContentsCopyIn(oFTree, acPath, arr, ARRLEN)
+               == SUCCESS);
+    }
+  assert(FT_getSpillStatsIn(oFTree, &ulSpills, NULL, NULL, NULL, &ulBytes)
+         == SUCCESS);
+  assert(ulSpills >= 100 && ulBytes <= 8 * ARRLEN);
+  FT_free(oFTree);
+
+  /* mapped files read a region of a file on disk in place, mapped on
+     the first read, until they are removed or written */
+  assert((psFile = fopen("ft_client.map", "w")) != NULL);
+  assert(fputs("0123456789abcdefghij", psFile) >= 0);
+  assert(fclose(psFile) == 0);
+  (void) remove("ft_client.wal");
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 1) == SUCCESS);
+  assert(FT_insertFileMappedIn(oFTree, "19root/M", "ft_client.map", 5, 10)
+         == SUCCESS);
+  assert(FT_insertFileMappedIn(oFTree, "19root/E", "ft_client.map", 20,
+                               0) == SUCCESS);
+  assert(FT_insertFileMappedIn(oFTree, "19root/X", "ft_client.map", 15,
+                               6) == IO_ERROR);
+  assert(FT_insertFileMappedIn(oFTree, "19root/X", "ft_client.nope", 0,
+                               0) == IO_ERROR);
+  assert(FT_insertFileMappedIn(oFTree, "19root/M", "ft_client.map", 0, 1)
+         == ALREADY_IN_TREE);
+  assert(FT_closeLogIn(oFTree) == SUCCESS);
+  assert(FT_insertFileMappedIn(oFTree, "19root/N", "ft_client.map", 0, 4)
+         == SUCCESS);
+  assert(FT_statIn(oFTree, "19root/M", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 10);
+  assert(FT_statIn(oFTree, "19root/E", &bIsFile, &l) == SUCCESS);
+  assert(l == 0 && FT_getFileContentsIn(oFTree, "19root/E") != NULL);
+  assert((temp = FT_getFileContentsIn(oFTree, "19root/M")) != NULL);
+  assert(!memcmp(temp, "56789abcde", 10));
+  assert(FT_getFileContentsIn(oFTree, "19root/M") == temp);
+  assert(FT_readAtIn(oFTree, "19root/N", 2, arr, 10, &l) == SUCCESS);
+  assert(l == 2 && !memcmp(arr, "23", 2));
+  assert(FT_compressIn(oFTree, 0, &ulCount) == SUCCESS);
+  assert(ulCount == 0);
+  assert(FT_writeAtIn(oFTree, "19root/M", 0, "Z", 1) == SUCCESS);
+  assert(FT_readAtIn(oFTree, "19root/M", 0, arr, 3, &l) == SUCCESS);
+  assert(l == 3 && !memcmp(arr, "Z67", 3));
+  assert(FT_rmFileIn(oFTree, "19root/N") == SUCCESS);
+  FT_free(oFTree);
+  assert((psFile = fopen("ft_client.map", "r")) != NULL);
+  assert(fgets(arr, ARRLEN, psFile) != NULL);
+  assert(fclose(psFile) == 0);
+  assert(!strcmp(arr, "0123456789abcdefghij"));
+  assert(remove("ft_client.map") == 0);
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_openLogIn(oFTree, "ft_client.wal", 1) == SUCCESS);
+  assert((temp = FT_getFileContentsIn(oFTree, "19root/M")) != NULL);
+  assert(!memcmp(temp, "56789abcde", 10));
+  assert(FT_statIn(oFTree, "19root/E", &bIsFile, &l) == SUCCESS);
+  assert(l == 0);
+  assert((temp2 = FT_getFileContentsIn(oFTree, "19root/E")) != NULL);
+  assert(FT_closeLogIn(oFTree) == SUCCESS);
+  FT_free(oFTree);
+  /* the replayed copies are the client's to free */
+  free(temp);
+  free(temp2);
+  assert(remove("ft_client.wal") == 0);
+
+  /* every directory keeps the totals of its subtree as it changes */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_duIn(oFTree, "20root", &ulFiles, &ulDirs, &ulBytes)
+         == NO_SUCH_PATH);
+  assert(FT_insertFileCopyIn(oFTree, "20root/a/b/F", acKnuth, 5)
+         == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "20root/a/G", acBackus, 6)
+         == SUCCESS);
+  assert(FT_insertDirIn(oFTree, "20root/c") == SUCCESS);
+  assert(FT_duIn(oFTree, "20root", &ulFiles, &ulDirs, &ulBytes)
+         == SUCCESS);
+  assert(ulFiles == 2 && ulDirs == 4 && ulBytes == 11);
+  assert(FT_getCountIn(oFTree, &ulCount) == SUCCESS);
+  assert(ulCount == ulFiles + ulDirs);
+  assert(FT_duIn(oFTree, "20root/a/b", &ulFiles, &ulDirs, &ulBytes)
+         == SUCCESS);
+  assert(ulFiles == 1 && ulDirs == 1 && ulBytes == 5);
+  assert(FT_duIn(oFTree, "20root/a/G", &ulFiles, &ulDirs, &ulBytes)
+         == SUCCESS);
+  assert(ulFiles == 1 && ulDirs == 0 && ulBytes == 6);
+  assert(FT_duIn(oFTree, "20root/a/G/H", &ulFiles, &ulDirs, &ulBytes)
+         == NOT_A_DIRECTORY);
+  /* replacements and writes change the bytes along the way up */
+  assert(FT_replaceFileContentsCopyIn(oFTree, "20root/a/b/F", arr, 100)
+         == SUCCESS);
+  assert(FT_appendIn(oFTree, "20root/a/G", "xyz", 3) == SUCCESS);
+  assert(FT_writeAtIn(oFTree, "20root/c/W", 10, "w", 1) == NO_SUCH_PATH);
+  assert(FT_duIn(oFTree, "20root", &ulFiles, &ulDirs, &ulBytes)
+         == SUCCESS);
+  assert(ulFiles == 2 && ulDirs == 4 && ulBytes == 109);
+  /* a snapshot keeps the totals it was taken with */
+  assert(FT_snapshotIn(oFTree, &oSSnap) == SUCCESS);
+  assert(FT_rmFileIn(oFTree, "20root/a/G") == SUCCESS);
+  assert(FT_duIn(oFTree, "20root/a", &ulFiles, &ulDirs, &ulBytes)
+         == SUCCESS);
+  assert(ulFiles == 1 && ulDirs == 2 && ulBytes == 100);
+  assert(FT_duOf(oSSnap, "20root/a", &ulFiles, &ulDirs, &ulBytes)
+         == SUCCESS);
+  assert(ulFiles == 2 && ulDirs == 2 && ulBytes == 109);
+  FT_releaseSnapshot(oSSnap);
+  /* an aborted removal gives its totals back */
+  assert(FT_beginIn(oFTree) == SUCCESS);
+  assert(FT_rmDirIn(oFTree, "20root/a") == SUCCESS);
+  assert(FT_replaceFileContentsCopyIn(oFTree, "20root/a/b/F", arr, 1)
+         == NO_SUCH_PATH);
+  assert(FT_insertFileCopyIn(oFTree, "20root/c/K", arr, 7) == SUCCESS);
+  assert(FT_duIn(oFTree, "20root", &ulFiles, &ulDirs, &ulBytes)
+         == SUCCESS);
+  assert(ulFiles == 1 && ulDirs == 2 && ulBytes == 7);
+  assert(FT_abortIn(oFTree) == SUCCESS);
+  assert(FT_duIn(oFTree, "20root", &ulFiles, &ulDirs, &ulBytes)
+         == SUCCESS);
+  assert(ulFiles == 1 && ulDirs == 4 && ulBytes == 100);
+  assert(FT_rmDirIn(oFTree, "20root/a") == SUCCESS);
+  assert(FT_duIn(oFTree, "20root", &ulFiles, &ulDirs, &ulBytes)
+         == SUCCESS);
+  assert(ulFiles == 0 && ulDirs == 2 && ulBytes == 0);
+  FT_free(oFTree);
+
+  /* the largest files or subtrees, largest first, ties in path order */
+  assert((oFTree = FT_new()) != NULL);
+  assert(FT_topKIn(oFTree, "21root", 3, FT_BY_FILE_SIZE, apcTop, aulTop,
+                   &ulFound) == NO_SUCH_PATH);
+  assert(FT_insertFileCopyIn(oFTree, "21root/a/F", arr, 5) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "21root/a/b/G", arr, 40) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "21root/c/I", arr, 30) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "21root/c/H", arr, 30) == SUCCESS);
+  assert(FT_insertFileCopyIn(oFTree, "21root/J", arr, 10) == SUCCESS);
+  assert(FT_topKIn(oFTree, "21root", 3, FT_BY_FILE_SIZE, apcTop, aulTop,
+                   &ulFound) == SUCCESS);
+  assert(ulFound == 3);
+  assert(!strcmp(apcTop[0], "21root/a/b/G") && aulTop[0] == 40);
+  assert(!strcmp(apcTop[1], "21root/c/H") && aulTop[1] == 30);
+  assert(!strcmp(apcTop[2], "21root/c/I") && aulTop[2] == 30);
+  for(l = 0; l < ulFound; l++)
+    free(apcTop[l]);
+  assert(FT_topKIn(oFTree, "21root", 2, FT_BY_SUBTREE_BYTES, apcTop,
+                   aulTop, &ulFound) == SUCCESS);
+  assert(ulFound == 2);
+  assert(!strcmp(apcTop[0], "21root/c") && aulTop[0] == 60);
+  assert(!strcmp(apcTop[1], "21root/a") && aulTop[1] == 45);
+  for(l = 0; l < ulFound; l++)
+    free(apcTop[l]);
+  /* asking for more than there are finds them all */
+  assert(FT_topKIn(oFTree, "21root/a", 8, FT_BY_SUBTREE_BYTES, apcTop,
+                   aulTop, &ulFound) == SUCCESS);
+  assert(ulFound == 1);
+  assert(!strcmp(apcTop[0], "21root/a/b") && aulTop[0] == 40);
+  free(apcTop[0]);
+  assert(FT_topKIn(oFTree, "21root", 0, FT_BY_FILE_SIZE, apcTop, aulTop,
+                   &ulFound) == SUCCESS);
+  assert(ulFound == 0);
+  assert(FT_topKIn(oFTree, "21root/J", 3, FT_BY_FILE_SIZE, apcTop, aulTop,
+                   &ulFound) == NOT_A_DIRECTORY);
+  /* a bound left high by a removal costs time, not correctness */
+  assert(FT_rmFileIn(oFTree, "21root/a/b/G") == SUCCESS);
+  assert(FT_topKIn(oFTree, "21root", 1, FT_BY_FILE_SIZE, apcTop, aulTop,
+                   &ulFound) == SUCCESS);
+  assert(ulFound == 1);
+  assert(!strcmp(apcTop[0], "21root/c/H") && aulTop[0] == 30);
+  free(apcTop[0]);
+  /* a snapshot ranks what it was taken with */
+  assert(FT_snapshotIn(oFTree, &oSSnap) == SUCCESS);
+  assert(FT_appendIn(oFTree, "21root/a/F", arr, 95) == SUCCESS);
+  assert(FT_topKIn(oFTree, "21root", 1, FT_BY_FILE_SIZE, apcTop, aulTop,
+                   &ulFound) == SUCCESS);
+  assert(!strcmp(apcTop[0], "21root/a/F") && aulTop[0] == 100);
+  free(apcTop[0]);
+  assert(FT_topKOf(oSSnap, "21root", 1, FT_BY_FILE_SIZE, apcTop, aulTop,
+                   &ulFound) == SUCCESS);
+  assert(!strcmp(apcTop[0], "21root/c/H") && aulTop[0] == 30);
+  free(apcTop[0]);
+  FT_releaseSnapshot(oSSnap);
+  FT_free(oFTree);
+
+  assert(FT_begin() == SUCCESS);
+  assert(FT_destroy() == INITIALIZATION_ERROR);
+  assert(FT_abort() == SUCCESS);
+  assert(FT_commit() == INITIALIZATION_ERROR);
+
   assert(FT_destroy() == SUCCESS);
+  assert(FT_insertFileAt(oDDir, "F", NULL, 0) == INITIALIZATION_ERROR);
+  assert(FT_statById(ulDirID, &bIsFile, &l) == INITIALIZATION_ERROR);
+  FT_closeDir(oDDir);
   assert(FT_destroy() == INITIALIZATION_ERROR);
   assert(FT_containsDir("1root") == FALSE);
   assert(FT_containsFile("1root") == FALSE);
+  assert(FT_du("1root", &ulFiles, &ulDirs, &ulBytes)
+         == INITIALIZATION_ERROR);
+  assert(FT_topK("1root", 3, FT_BY_FILE_SIZE, apcTop, aulTop, &ulFound)
+         == INITIALIZATION_ERROR);
   assert((temp = FT_toString()) == NULL);
 
   return 0;
@@ -0,0 +1,1406 @@
+/*--------------------------------------------------------------------*/
+/* heapft.c                                                           */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for mmap, msync, ftruncate, fsync and sysconf */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifndef FT_NO_LOCKING
+#include <pthread.h>
+#endif
+#include "heapft.h"
+
+/*
+  The layout of a heap file: a header, then the blocks allocated from
+  the heap, up to the header's ulUsed, then room for the heap to grow
+  into. A block is a word holding its size class, c for a block of
+  2^c bytes, followed by its payload, and a block is referred to by
+  the offset of its payload from the start of the file, 0 standing
+  for none. A free block's payload starts with the offset of the next
+  free block of its class. A node is a block holding a struct
+  heapNode followed by the node's name and its '\0'. A directory's
+  children are an array of their offsets, sorted by name, in a block
+  of their own, as are a file's contents.
+
+  The layout of a journal: a struct journalHeader, then for each page
+  it holds the page's index in the heap file, as a word, and the
+  page's bytes.
+*/
+
+/* The smallest size class, and the number of size classes */
+enum { MIN_CLASS = 5, CLASSES = sizeof(size_t) * 8 };
+
+/* The size of a new heap file, before it grows */
+enum { INITIAL_BYTES = 65536 };
+
+/* The flags of a node */
+enum { FLAG_FILE = 1 };
+
+/* The header of a heap file */
+struct heapHeader {
+   /* the name of the format and its version */
+   char acMagic[8];
+   /* HEAP_MARKER, as written by the machine that wrote the heap */
+   size_t ulMarker;
+   /* the offset of the end of the last block allocated */
+   size_t ulUsed;
+   /* the root, or 0 if the tree is empty */
+   size_t ulRoot;
+   /* the number of nodes in the tree */
+   size_t ulCount;
+   /* the first free block of each size class, or 0 */
+   size_t aulFree[CLASSES];
+};
+
+/* A node in a heap file, followed by its name */
+struct heapNode {
+   /* the node's flags */
+   size_t ulFlags;
+   /* a directory's array of children, or a file's contents, or 0 */
+   size_t ulData;
+   /* a directory's number of children, or a file's length */
+   size_t ulSize;
+   /* the capacity of a directory's array of children */
+   size_t ulCapacity;
+};
+
+/* The header of a journal */
+struct journalHeader {
+   /* the name of the format and its version */
+   char acMagic[8];
+   /* HEAP_MARKER, as written by the machine that wrote the journal */
+   size_t ulMarker;
+   /* the size of the journal's pages, and their number */
+   size_t ulPageSize;
+   size_t ulPages;
+   /* the size of the heap file once the journal is applied */
+   size_t ulFileSize;
+   /* the CRC-32 of the whole journal, with this field 0 */
+   size_t ulCrc;
+};
+
+/* The formats and versions of heap files and of journals */
+static const char acHeapMagic[8] = "FTHEAP\0\1";
+static const char acJournalMagic[8] = "FTJRNL\0\1";
+
+/* A word whose value depends on the word size and the byte order */
+#define HEAP_MARKER ((size_t) 0x46540000UL | sizeof(size_t))
+
+/* The suffix of the journal of a heap file */
+static const char acJournalSuffix[] = ".journal";
+
+/* A File Tree in a heap file */
+struct heapFT {
+   /* the name of the journal */
+   char *pcJournal;
+   /* the heap file */
+   int iFd;
+   /* the private mapping of the whole heap file, and its length, a
+      multiple of the page size */
+   char *pcBase;
+   size_t ulLength;
+   /* the page size */
+   size_t ulPageSize;
+   /* for each page of the mapping, whether it has been changed since
+      the last checkpoint */
+   unsigned char *pucDirty;
+   /* old contents that HeapFT_replaceFileContents returned, to be
+      freed by the next write, or 0 */
+   size_t ulDeferred;
+   /* the table for computing CRC-32s */
+   unsigned long aulCrcTable[256];
+#ifndef FT_NO_LOCKING
+   /* the lock that reads hold shared, and writes exclusively */
+   pthread_rwlock_t sLock;
+#endif
+};
+
+/* Where a walk toward a path stopped */
+struct heapWalk {
+   /* the deepest node along the path, or 0 if the tree is empty */
+   size_t ulNode;
+   /* its parent, or 0 if it is the root, and its index among its
+      parent's children */
+   size_t ulParent;
+   size_t ulIndex;
+   /* the index among ulNode's children at which the first of pcRest
+      would be inserted */
+   size_t ulInsert;
+   /* the components of the path below ulNode, or NULL if ulNode is
+      the path's node */
+   const char *pcRest;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Acquires oHTree's lock shared. */
+static void HeapFT_lockShared(HeapFT_T oHTree) {
+   assert(oHTree != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_rdlock(&oHTree->sLock);
+#else
+   (void) oHTree;
+#endif
+}
+
+/* Acquires oHTree's lock exclusively. */
+static void HeapFT_lockExclusive(HeapFT_T oHTree) {
+   assert(oHTree != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_wrlock(&oHTree->sLock);
+#else
+   (void) oHTree;
+#endif
+}
+
+/* Releases oHTree's lock. */
+static void HeapFT_unlock(HeapFT_T oHTree) {
+   assert(oHTree != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_unlock(&oHTree->sLock);
+#else
+   (void) oHTree;
+#endif
+}
+
+/* Fills oHTree's table for computing CRC-32s. */
+static void HeapFT_initCrc(HeapFT_T oHTree) {
+   unsigned long ulByte;
+
+   assert(oHTree != NULL);
+
+   for(ulByte = 0; ulByte < 256; ulByte++) {
+      unsigned long ulCrc = ulByte;
+      int iBit;
+
+      for(iBit = 0; iBit < 8; iBit++)
+         ulCrc = (ulCrc & 1) ? (ulCrc >> 1) ^ 0xEDB88320UL : ulCrc >> 1;
+      oHTree->aulCrcTable[ulByte] = ulCrc;
+   }
+}
+
+/*
+  Returns the running CRC-32 ulCrc extended by the ulBytes bytes at
+  pv. A CRC starts at 0xFFFFFFFF and ends XORed with 0xFFFFFFFF.
+*/
+static unsigned long HeapFT_crc(HeapFT_T oHTree, unsigned long ulCrc,
+                                const void *pv, size_t ulBytes) {
+   const unsigned char *puc = pv;
+   size_t i;
+
+   assert(oHTree != NULL);
+
+   for(i = 0; i < ulBytes; i++)
+      ulCrc = oHTree->aulCrcTable[(ulCrc ^ puc[i]) & 0xFF] ^ (ulCrc >> 8);
+   return ulCrc & 0xFFFFFFFFUL;
+}
+
+/*
+  Writes the ulBytes bytes at pc to file descriptor iFd. Returns
+  SUCCESS, or IO_ERROR if they could not all be written.
+*/
+static int HeapFT_writeAll(int iFd, const char *pc, size_t ulBytes) {
+   assert(pc != NULL || ulBytes == 0);
+
+   while(ulBytes > 0) {
+      ssize_t lWritten = write(iFd, pc, ulBytes);
+      if(lWritten < 0) {
+         if(errno == EINTR)
+            continue;
+         return IO_ERROR;
+      }
+      pc += lWritten;
+      ulBytes -= (size_t) lWritten;
+   }
+   return SUCCESS;
+}
+
+/*
+  Reads ulBytes bytes from file descriptor iFd into pc. Returns
+  SUCCESS, or IO_ERROR if they could not all be read.
+*/
+static int HeapFT_readAll(int iFd, char *pc, size_t ulBytes) {
+   assert(pc != NULL || ulBytes == 0);
+
+   while(ulBytes > 0) {
+      ssize_t lRead = read(iFd, pc, ulBytes);
+      if(lRead < 0 && errno == EINTR)
+         continue;
+      if(lRead <= 0)
+         return IO_ERROR;
+      pc += lRead;
+      ulBytes -= (size_t) lRead;
+   }
+   return SUCCESS;
+}
+
+/*
+  Copies the ulPages pages of ulPageSize bytes at each index in
+  pulIndices from the ones at ppcPages into the file iFd, of
+  ulFileSize bytes, through a shared mapping, and waits for them to
+  reach the disk. Returns SUCCESS, or IO_ERROR if they could not be
+  written.
+*/
+static int HeapFT_writeBack(int iFd, size_t ulFileSize,
+                            size_t ulPageSize, size_t ulPages,
+                            const size_t *pulIndices,
+                            const char *const *ppcPages) {
+   char *pcShared;
+   size_t i;
+   int iStatus = SUCCESS;
+
+   assert(pulIndices != NULL || ulPages == 0);
+   assert(ppcPages != NULL || ulPages == 0);
+
+   pcShared = mmap(NULL, ulFileSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   iFd, 0);
+   if(pcShared == MAP_FAILED)
+      return IO_ERROR;
+   for(i = 0; i < ulPages; i++)
+      memcpy(pcShared + pulIndices[i] * ulPageSize, ppcPages[i],
+             ulPageSize);
+   if(msync(pcShared, ulFileSize, MS_SYNC) != 0)
+      iStatus = IO_ERROR;
+   (void) munmap(pcShared, ulFileSize);
+   return iStatus;
+}
+
+/*
+  Completes the checkpoint whose journal, named oHTree->pcJournal, was
+  synced before a crash interrupted it, by copying the journal's
+  pages into oHTree's file, and removes the journal. A journal that is
+  incomplete or damaged was never synced, and is only removed.
+  Returns SUCCESS, or:
+  * IO_ERROR if the journal or the file could not be read or written
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int HeapFT_recover(HeapFT_T oHTree) {
+   struct journalHeader sHeader;
+   struct stat sStat;
+   char *pcJournal = NULL;
+   size_t *pulIndices = NULL;
+   const char **ppcPages = NULL;
+   size_t ulRecord, ulCrc, i;
+   int iFd, iStatus = SUCCESS;
+   boolean bValid = FALSE;
+
+   assert(oHTree != NULL);
+
+   iFd = open(oHTree->pcJournal, O_RDONLY);
+   if(iFd < 0)
+      return errno == ENOENT ? SUCCESS : IO_ERROR;
+   if(fstat(iFd, &sStat) != 0) {
+      (void) close(iFd);
+      return IO_ERROR;
+   }
+
+   /* a journal is complete if its length and CRC agree with its
+      header */
+   if((size_t) sStat.st_size >= sizeof(struct journalHeader)) {
+      pcJournal = malloc((size_t) sStat.st_size);
+      if(pcJournal == NULL) {
+         (void) close(iFd);
+         return MEMORY_ERROR;
+      }
+      if(HeapFT_readAll(iFd, pcJournal, (size_t) sStat.st_size)
+         != SUCCESS) {
+         free(pcJournal);
+         (void) close(iFd);
+         return IO_ERROR;
+      }
+      memcpy(&sHeader, pcJournal, sizeof(struct journalHeader));
+      ulRecord = sizeof(size_t) + sHeader.ulPageSize;
+      ulCrc = sHeader.ulCrc;
+      ((struct journalHeader *) pcJournal)->ulCrc = 0;
+      bValid = (boolean) (
+         memcmp(sHeader.acMagic, acJournalMagic, 8) == 0 &&
+         sHeader.ulMarker == HEAP_MARKER && sHeader.ulPageSize != 0 &&
+         sHeader.ulPageSize < (size_t) sStat.st_size &&
+         sHeader.ulFileSize % sHeader.ulPageSize == 0 &&
+         sHeader.ulPages <= ((size_t) sStat.st_size -
+                             sizeof(struct journalHeader)) / ulRecord &&
+         sizeof(struct journalHeader) + sHeader.ulPages * ulRecord
+            == (size_t) sStat.st_size &&
+         (HeapFT_crc(oHTree, 0xFFFFFFFFUL, pcJournal,
+                     (size_t) sStat.st_size) ^ 0xFFFFFFFFUL) == ulCrc);
+   }
+   (void) close(iFd);
+
+   if(bValid) {
+      pulIndices = malloc(sHeader.ulPages * sizeof(size_t) + 1);
+      ppcPages = malloc(sHeader.ulPages * sizeof(char *) + 1);
+      if(pulIndices == NULL || ppcPages == NULL)
+         iStatus = MEMORY_ERROR;
+      for(i = 0; i < sHeader.ulPages && iStatus == SUCCESS; i++) {
+         const char *pcRecord = pcJournal + sizeof(struct journalHeader)
+                                + i * ulRecord;
+
+         memcpy(&pulIndices[i], pcRecord, sizeof(size_t));
+         ppcPages[i] = pcRecord + sizeof(size_t);
+         if(pulIndices[i] >= sHeader.ulFileSize / sHeader.ulPageSize)
+            bValid = FALSE;
+      }
+   }
+   if(bValid && iStatus == SUCCESS) {
+      if(fstat(oHTree->iFd, &sStat) != 0 ||
+         ((size_t) sStat.st_size < sHeader.ulFileSize &&
+          ftruncate(oHTree->iFd, (off_t) sHeader.ulFileSize) != 0))
+         iStatus = IO_ERROR;
+      else
+         iStatus = HeapFT_writeBack(oHTree->iFd, sHeader.ulFileSize,
+                                    sHeader.ulPageSize, sHeader.ulPages,
+                                    pulIndices, ppcPages);
+   }
+   free(pulIndices);
+   free(ppcPages);
+   free(pcJournal);
+
+   if(iStatus == SUCCESS && remove(oHTree->pcJournal) != 0)
+      iStatus = IO_ERROR;
+   return iStatus;
+}
+
+/* Returns oHTree's header, for reading. */
+static const struct heapHeader *HeapFT_header(HeapFT_T oHTree) {
+   assert(oHTree != NULL);
+
+   return (const struct heapHeader *) oHTree->pcBase;
+}
+
+/* Returns the node at offset ulNode of oHTree's heap, for reading. */
+static const struct heapNode *HeapFT_node(HeapFT_T oHTree, size_t ulNode) {
+   assert(oHTree != NULL);
+   assert(ulNode != 0);
+
+   return (const struct heapNode *) (oHTree->pcBase + ulNode);
+}
+
+/* Returns the name of node psNode. */
+static const char *HeapFT_name(const struct heapNode *psNode) {
+   assert(psNode != NULL);
+
+   return (const char *) (psNode + 1);
+}
+
+/*
+  Returns the array of children of directory psNode in oHTree's heap,
+  for reading.
+*/
+static const size_t *HeapFT_children(HeapFT_T oHTree,
+                                     const struct heapNode *psNode) {
+   assert(oHTree != NULL);
+   assert(psNode != NULL);
+   assert(!(psNode->ulFlags & FLAG_FILE));
+
+   return (const size_t *) (oHTree->pcBase + psNode->ulData);
+}
+
+/*
+  Marks the pages holding the ulLength bytes at offset ulOffset of
+  oHTree's heap changed, and returns a pointer to them, for writing.
+*/
+static void *HeapFT_touch(HeapFT_T oHTree, size_t ulOffset,
+                          size_t ulLength) {
+   size_t ulPage;
+
+   assert(oHTree != NULL);
+   assert(ulOffset <= oHTree->ulLength);
+   assert(ulLength <= oHTree->ulLength - ulOffset);
+
+   if(ulLength != 0)
+      for(ulPage = ulOffset / oHTree->ulPageSize;
+          ulPage <= (ulOffset + ulLength - 1) / oHTree->ulPageSize;
+          ulPage++)
+         oHTree->pucDirty[ulPage] = 1;
+   return oHTree->pcBase + ulOffset;
+}
+
+/*
+  Grows oHTree's heap file, and its mapping, to at least ulNeeded
+  bytes, doubling its length. Moves the mapping, so every pointer into
+  it must be fetched again afterwards. Returns SUCCESS, or
+  MEMORY_ERROR if the file could not be grown or mapped, in which case
+  the heap is unchanged.
+*/
+static int HeapFT_grow(HeapFT_T oHTree, size_t ulNeeded) {
+   size_t ulLength, ulPages, i;
+   unsigned char *pucDirty;
+   char *pcBase;
+
+   assert(oHTree != NULL);
+
+   ulLength = oHTree->ulLength;
+   while(ulLength < ulNeeded) {
+      if(ulLength > (size_t) -1 / 2)
+         return MEMORY_ERROR;
+      ulLength *= 2;
+   }
+
+   ulPages = oHTree->ulLength / oHTree->ulPageSize;
+   pucDirty = realloc(oHTree->pucDirty, ulLength / oHTree->ulPageSize);
+   if(pucDirty == NULL)
+      return MEMORY_ERROR;
+   oHTree->pucDirty = pucDirty;
+   memset(pucDirty + ulPages, 0, ulLength / oHTree->ulPageSize - ulPages);
+
+   /* the pages changed in the old private mapping are carried over
+      to the new one, which sees the rest from the file */
+   if(ftruncate(oHTree->iFd, (off_t) ulLength) != 0)
+      return MEMORY_ERROR;
+   pcBase = mmap(NULL, ulLength, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                 oHTree->iFd, 0);
+   if(pcBase == MAP_FAILED)
+      return MEMORY_ERROR;
+   for(i = 0; i < ulPages; i++)
+      if(pucDirty[i])
+         memcpy(pcBase + i * oHTree->ulPageSize,
+                oHTree->pcBase + i * oHTree->ulPageSize,
+                oHTree->ulPageSize);
+   (void) munmap(oHTree->pcBase, oHTree->ulLength);
+   oHTree->pcBase = pcBase;
+   oHTree->ulLength = ulLength;
+   return SUCCESS;
+}
+
+/*
+  Allocates a block of at least ulBytes bytes from oHTree's heap, and
+  sets *pulOffset to its offset. May move the heap's mapping, as
+  HeapFT_grow does. Returns SUCCESS, or MEMORY_ERROR if the heap could
+  not be grown.
+*/
+static int HeapFT_alloc(HeapFT_T oHTree, size_t ulBytes,
+                        size_t *pulOffset) {
+   struct heapHeader *psHeader;
+   size_t ulClass = MIN_CLASS;
+   size_t ulBlock, ulBlockSize;
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pulOffset != NULL);
+
+   while(((size_t) 1 << ulClass) - sizeof(size_t) < ulBytes)
+      if(++ulClass == CLASSES)
+         return MEMORY_ERROR;
+   ulBlockSize = (size_t) 1 << ulClass;
+
+   /* a free block of the class is reused before the heap grows */
+   if(HeapFT_header(oHTree)->aulFree[ulClass] != 0) {
+      psHeader = HeapFT_touch(oHTree, 0, sizeof(struct heapHeader));
+      *pulOffset = psHeader->aulFree[ulClass];
+      psHeader->aulFree[ulClass] =
+         *(const size_t *) (oHTree->pcBase + *pulOffset);
+      return SUCCESS;
+   }
+
+   ulBlock = HeapFT_header(oHTree)->ulUsed;
+   if(ulBlockSize > (size_t) -1 - ulBlock)
+      return MEMORY_ERROR;
+   if(ulBlock + ulBlockSize > oHTree->ulLength) {
+      iStatus = HeapFT_grow(oHTree, ulBlock + ulBlockSize);
+      if(iStatus != SUCCESS)
+         return iStatus;
+   }
+   psHeader = HeapFT_touch(oHTree, 0, sizeof(struct heapHeader));
+   psHeader->ulUsed += ulBlockSize;
+   *(size_t *) HeapFT_touch(oHTree, ulBlock, sizeof(size_t)) = ulClass;
+   *pulOffset = ulBlock + sizeof(size_t);
+   return SUCCESS;
+}
+
+/*
+  Frees the block at offset ulOffset of oHTree's heap, if ulOffset is
+  not 0.
+*/
+static void HeapFT_release(HeapFT_T oHTree, size_t ulOffset) {
+   struct heapHeader *psHeader;
+   size_t ulClass;
+
+   assert(oHTree != NULL);
+
+   if(ulOffset == 0)
+      return;
+   ulClass = *(const size_t *) (oHTree->pcBase + ulOffset
+                                - sizeof(size_t));
+   psHeader = HeapFT_touch(oHTree, 0, sizeof(struct heapHeader));
+   *(size_t *) HeapFT_touch(oHTree, ulOffset, sizeof(size_t)) =
+      psHeader->aulFree[ulClass];
+   psHeader->aulFree[ulClass] = ulOffset;
+}
+
+/* Frees the old contents that oHTree holds for its next write. */
+static void HeapFT_releaseDeferred(HeapFT_T oHTree) {
+   assert(oHTree != NULL);
+
+   HeapFT_release(oHTree, oHTree->ulDeferred);
+   oHTree->ulDeferred = 0;
+}
+
+/*
+  Allocates a node from oHTree's heap named by the ulNameLength
+  characters at pcName: a file with a copy of the ulLength bytes at
+  pvContents, or NULL contents of that length if pvContents is NULL,
+  if bIsFile is TRUE, or else a directory with room for ulCapacity
+  children. Sets *pulNode to its offset. May move the heap's mapping,
+  as HeapFT_grow does. Returns SUCCESS, or MEMORY_ERROR if the heap
+  could not be grown.
+*/
+static int HeapFT_newNode(HeapFT_T oHTree, const char *pcName,
+                          size_t ulNameLength, boolean bIsFile,
+                          const void *pvContents, size_t ulLength,
+                          size_t ulCapacity, size_t *pulNode) {
+   struct heapNode *psNode;
+   size_t ulData = 0;
+   size_t ulNode;
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pcName != NULL);
+   assert(pulNode != NULL);
+
+   if(bIsFile && pvContents != NULL && ulLength != 0) {
+      iStatus = HeapFT_alloc(oHTree, ulLength, &ulData);
+      if(iStatus != SUCCESS)
+         return iStatus;
+      memcpy(HeapFT_touch(oHTree, ulData, ulLength), pvContents,
+             ulLength);
+   }
+   else if(!bIsFile && ulCapacity != 0) {
+      if(ulCapacity > (size_t) -1 / sizeof(size_t))
+         return MEMORY_ERROR;
+      iStatus = HeapFT_alloc(oHTree, ulCapacity * sizeof(size_t),
+                             &ulData);
+      if(iStatus != SUCCESS)
+         return iStatus;
+   }
+
+   iStatus = HeapFT_alloc(oHTree, sizeof(struct heapNode) + ulNameLength
+                          + 1, &ulNode);
+   if(iStatus != SUCCESS) {
+      HeapFT_release(oHTree, ulData);
+      return iStatus;
+   }
+   psNode = HeapFT_touch(oHTree, ulNode, sizeof(struct heapNode)
+                         + ulNameLength + 1);
+   psNode->ulFlags = bIsFile ? FLAG_FILE : 0;
+   psNode->ulData = ulData;
+   psNode->ulSize = bIsFile ? ulLength : 0;
+   psNode->ulCapacity = bIsFile ? 0 : ulCapacity;
+   memcpy(psNode + 1, pcName, ulNameLength);
+   ((char *) (psNode + 1))[ulNameLength] = '\0';
+
+   *pulNode = ulNode;
+   return SUCCESS;
+}
+
+/*
+  Frees node ulNode of oHTree's heap and every node below it. Returns
+  the number of nodes freed.
+*/
+static size_t HeapFT_releaseSubtree(HeapFT_T oHTree, size_t ulNode) {
+   const struct heapNode *psNode;
+   size_t ulCount = 1;
+   size_t c;
+
+   assert(oHTree != NULL);
+
+   psNode = HeapFT_node(oHTree, ulNode);
+   if(!(psNode->ulFlags & FLAG_FILE))
+      for(c = 0; c < psNode->ulSize; c++)
+         ulCount += HeapFT_releaseSubtree(oHTree,
+                                          HeapFT_children(oHTree,
+                                                          psNode)[c]);
+   HeapFT_release(oHTree, psNode->ulData);
+   HeapFT_release(oHTree, ulNode);
+   return ulCount;
+}
+
+/*
+  Makes room for one more child in directory ulDir of oHTree's heap.
+  May move the heap's mapping, as HeapFT_grow does. Returns SUCCESS,
+  or MEMORY_ERROR if the heap could not be grown.
+*/
+static int HeapFT_reserveChild(HeapFT_T oHTree, size_t ulDir) {
+   const struct heapNode *psDir;
+   struct heapNode *psNewDir;
+   size_t ulCapacity, ulData;
+   int iStatus;
+
+   assert(oHTree != NULL);
+
+   psDir = HeapFT_node(oHTree, ulDir);
+   if(psDir->ulSize < psDir->ulCapacity)
+      return SUCCESS;
+
+   ulCapacity = psDir->ulCapacity != 0 ? psDir->ulCapacity * 2 : 4;
+   if(ulCapacity > (size_t) -1 / sizeof(size_t))
+      return MEMORY_ERROR;
+   iStatus = HeapFT_alloc(oHTree, ulCapacity * sizeof(size_t), &ulData);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   psNewDir = HeapFT_touch(oHTree, ulDir, sizeof(struct heapNode));
+   memcpy(HeapFT_touch(oHTree, ulData, psNewDir->ulSize * sizeof(size_t)),
+          oHTree->pcBase + psNewDir->ulData,
+          psNewDir->ulSize * sizeof(size_t));
+   HeapFT_release(oHTree, psNewDir->ulData);
+   psNewDir->ulData = ulData;
+   psNewDir->ulCapacity = ulCapacity;
+   return SUCCESS;
+}
+
+/*
+  Compares the name of node ulNode of oHTree's heap with the
+  ulLength characters at pcName, as strcmp would compare them as
+  strings.
+*/
+static int HeapFT_compareName(HeapFT_T oHTree, size_t ulNode,
+                              const char *pcName, size_t ulLength) {
+   const char *pcNodeName;
+   int iCompare;
+
+   assert(oHTree != NULL);
+   assert(pcName != NULL);
+
+   pcNodeName = HeapFT_name(HeapFT_node(oHTree, ulNode));
+   iCompare = strncmp(pcNodeName, pcName, ulLength);
+   if(iCompare != 0)
+      return iCompare;
+   return pcNodeName[ulLength] != '\0';
+}
+
+/*
+  Searches directory ulDir of oHTree's heap for the child named by the
+  ulLength characters at pcName. Returns TRUE and sets *pulIndex to
+  the child's index if it is found, or returns FALSE and sets
+  *pulIndex to the index at which it would be inserted.
+*/
+static boolean HeapFT_findChild(HeapFT_T oHTree, size_t ulDir,
+                                const char *pcName, size_t ulLength,
+                                size_t *pulIndex) {
+   const struct heapNode *psDir;
+   size_t ulLow = 0, ulHigh;
+
+   assert(oHTree != NULL);
+   assert(pcName != NULL);
+   assert(pulIndex != NULL);
+
+   psDir = HeapFT_node(oHTree, ulDir);
+   ulHigh = psDir->ulSize;
+   while(ulLow < ulHigh) {
+      size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+      int iCompare = HeapFT_compareName(oHTree,
+                                        HeapFT_children(oHTree,
+                                                        psDir)[ulMid],
+                                        pcName, ulLength);
+      if(iCompare == 0) {
+         *pulIndex = ulMid;
+         return TRUE;
+      }
+      if(iCompare < 0)
+         ulLow = ulMid + 1;
+      else
+         ulHigh = ulMid;
+   }
+   *pulIndex = ulLow;
+   return FALSE;
+}
+
+/*
+  Walks oHTree's tree from the root toward pcPath as far as it exists,
+  and describes where it stopped in *psWalk. Returns SUCCESS, or:
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcPath
+  * NOT_A_DIRECTORY if a proper prefix of pcPath exists as a file
+*/
+static int HeapFT_walk(HeapFT_T oHTree, const char *pcPath,
+                       struct heapWalk *psWalk) {
+   const char *pcComponent = pcPath;
+   size_t ulLength;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+   assert(psWalk != NULL);
+
+   /* a well-formatted path is non-empty components separated by
+      single '/' delimiters, as for Path_new */
+   ulLength = strlen(pcPath);
+   if(ulLength == 0 || pcPath[0] == '/' || pcPath[ulLength - 1] == '/'
+      || strstr(pcPath, "//") != NULL)
+      return BAD_PATH;
+
+   psWalk->ulNode = HeapFT_header(oHTree)->ulRoot;
+   psWalk->ulParent = 0;
+   psWalk->ulIndex = 0;
+   psWalk->ulInsert = 0;
+   psWalk->pcRest = pcPath;
+   if(psWalk->ulNode == 0)
+      return SUCCESS;
+
+   ulLength = strcspn(pcComponent, "/");
+   if(HeapFT_compareName(oHTree, psWalk->ulNode, pcComponent, ulLength)
+      != 0)
+      return CONFLICTING_PATH;
+
+   /* walk down one component at a time */
+   for(;;) {
+      const struct heapNode *psNode;
+      size_t ulIndex;
+
+      pcComponent += ulLength;
+      if(*pcComponent == '\0') {
+         psWalk->pcRest = NULL;
+         return SUCCESS;
+      }
+      pcComponent++;
+      psWalk->pcRest = pcComponent;
+
+      psNode = HeapFT_node(oHTree, psWalk->ulNode);
+      if(psNode->ulFlags & FLAG_FILE)
+         return NOT_A_DIRECTORY;
+      ulLength = strcspn(pcComponent, "/");
+      if(!HeapFT_findChild(oHTree, psWalk->ulNode, pcComponent, ulLength,
+                           &ulIndex)) {
+         psWalk->ulInsert = ulIndex;
+         return SUCCESS;
+      }
+      psWalk->ulParent = psWalk->ulNode;
+      psWalk->ulIndex = ulIndex;
+      psWalk->ulNode = HeapFT_children(oHTree, psNode)[ulIndex];
+   }
+}
+
+/*
+  Sets *pulNode to the node of oHTree's tree with path pcPath. Returns
+  SUCCESS, or the status of HeapFT_walk, or NO_SUCH_PATH if there is
+  no such node.
+*/
+static int HeapFT_find(HeapFT_T oHTree, const char *pcPath,
+                       size_t *pulNode) {
+   struct heapWalk sWalk;
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+   assert(pulNode != NULL);
+
+   iStatus = HeapFT_walk(oHTree, pcPath, &sWalk);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(sWalk.ulNode == 0 || sWalk.pcRest != NULL)
+      return NO_SUCH_PATH;
+   *pulNode = sWalk.ulNode;
+   return SUCCESS;
+}
+
+/*
+  Makes the file of oHTree's heap hold its tree as it stands, as
+  HeapFT_checkpoint does. Must be called with oHTree's lock held
+  exclusively, if at all.
+*/
+static int HeapFT_checkpointUnlocked(HeapFT_T oHTree) {
+   struct journalHeader sHeader;
+   size_t *pulIndices;
+   const char **ppcPages;
+   size_t ulPages, ulDirty = 0, i;
+   unsigned long ulCrc;
+   int iFd, iStatus = SUCCESS;
+
+   assert(oHTree != NULL);
+
+   HeapFT_releaseDeferred(oHTree);
+   ulPages = oHTree->ulLength / oHTree->ulPageSize;
+   for(i = 0; i < ulPages; i++)
+      ulDirty += oHTree->pucDirty[i];
+   if(ulDirty == 0)
+      return SUCCESS;
+
+   pulIndices = malloc(ulDirty * sizeof(size_t));
+   ppcPages = malloc(ulDirty * sizeof(char *));
+   if(pulIndices == NULL || ppcPages == NULL) {
+      free(pulIndices);
+      free(ppcPages);
+      return MEMORY_ERROR;
+   }
+   ulDirty = 0;
+   for(i = 0; i < ulPages; i++)
+      if(oHTree->pucDirty[i]) {
+         pulIndices[ulDirty] = i;
+         ppcPages[ulDirty++] = oHTree->pcBase + i * oHTree->ulPageSize;
+      }
+
+   /* the journal is written and synced, with its CRC last, before the
+      file is touched */
+   memset(&sHeader, 0, sizeof(struct journalHeader));
+   memcpy(sHeader.acMagic, acJournalMagic, 8);
+   sHeader.ulMarker = HEAP_MARKER;
+   sHeader.ulPageSize = oHTree->ulPageSize;
+   sHeader.ulPages = ulDirty;
+   sHeader.ulFileSize = oHTree->ulLength;
+   sHeader.ulCrc = 0;
+   ulCrc = HeapFT_crc(oHTree, 0xFFFFFFFFUL, &sHeader,
+                      sizeof(struct journalHeader));
+   iFd = open(oHTree->pcJournal, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if(iFd < 0 || HeapFT_writeAll(iFd, (const char *) &sHeader,
+                                 sizeof(struct journalHeader)) != SUCCESS)
+      iStatus = IO_ERROR;
+   for(i = 0; i < ulDirty && iStatus == SUCCESS; i++) {
+      ulCrc = HeapFT_crc(oHTree, ulCrc, &pulIndices[i], sizeof(size_t));
+      ulCrc = HeapFT_crc(oHTree, ulCrc, ppcPages[i], oHTree->ulPageSize);
+      if(HeapFT_writeAll(iFd, (const char *) &pulIndices[i],
+                         sizeof(size_t)) != SUCCESS ||
+         HeapFT_writeAll(iFd, ppcPages[i], oHTree->ulPageSize) != SUCCESS)
+         iStatus = IO_ERROR;
+   }
+   if(iStatus == SUCCESS) {
+      sHeader.ulCrc = ulCrc ^ 0xFFFFFFFFUL;
+      if(lseek(iFd, 0, SEEK_SET) != 0 ||
+         HeapFT_writeAll(iFd, (const char *) &sHeader,
+                         sizeof(struct journalHeader)) != SUCCESS ||
+         fsync(iFd) != 0)
+         iStatus = IO_ERROR;
+   }
+   if(iFd >= 0 && close(iFd) != 0)
+      iStatus = IO_ERROR;
+
+   /* once the file holds the pages, the journal is not needed; a
+      crash before it is removed only has a reopening copy them
+      again */
+   if(iStatus == SUCCESS)
+      iStatus = HeapFT_writeBack(oHTree->iFd, oHTree->ulLength,
+                                 oHTree->ulPageSize, ulDirty, pulIndices,
+                                 ppcPages);
+   if(iStatus == SUCCESS && remove(oHTree->pcJournal) != 0)
+      iStatus = IO_ERROR;
+   if(iStatus == SUCCESS)
+      memset(oHTree->pucDirty, 0, ulPages);
+
+   free(pulIndices);
+   free(ppcPages);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+int HeapFT_open(const char *pcFile, HeapFT_T *poHResult) {
+   static const char acZeros[8] = {0};
+   HeapFT_T oHNew;
+   const struct heapHeader *psHeader;
+   struct stat sStat;
+   size_t ulLength;
+   long lPageSize;
+   int iStatus;
+
+   assert(pcFile != NULL);
+   assert(poHResult != NULL);
+
+   oHNew = malloc(sizeof(struct heapFT));
+   if(oHNew == NULL)
+      return MEMORY_ERROR;
+   oHNew->pcJournal = malloc(strlen(pcFile) + sizeof(acJournalSuffix));
+   if(oHNew->pcJournal == NULL) {
+      free(oHNew);
+      return MEMORY_ERROR;
+   }
+   strcpy(oHNew->pcJournal, pcFile);
+   strcat(oHNew->pcJournal, acJournalSuffix);
+#ifndef FT_NO_LOCKING
+   if(pthread_rwlock_init(&oHNew->sLock, NULL) != 0) {
+      free(oHNew->pcJournal);
+      free(oHNew);
+      return MEMORY_ERROR;
+   }
+#endif
+   HeapFT_initCrc(oHNew);
+   oHNew->pcBase = NULL;
+   oHNew->pucDirty = NULL;
+   oHNew->ulLength = 0;
+   oHNew->ulDeferred = 0;
+   lPageSize = sysconf(_SC_PAGESIZE);
+   oHNew->ulPageSize = lPageSize > 0 ? (size_t) lPageSize : 4096;
+
+   /* the file is mapped once any interrupted checkpoint is completed,
+      rounded up to whole pages and to at least INITIAL_BYTES */
+   oHNew->iFd = open(pcFile, O_RDWR | O_CREAT, 0666);
+   iStatus = oHNew->iFd < 0 ? IO_ERROR : HeapFT_recover(oHNew);
+   if(iStatus == SUCCESS && fstat(oHNew->iFd, &sStat) != 0)
+      iStatus = IO_ERROR;
+   if(iStatus == SUCCESS) {
+      ulLength = (size_t) sStat.st_size;
+      if(ulLength < INITIAL_BYTES)
+         ulLength = INITIAL_BYTES;
+      ulLength = (ulLength + oHNew->ulPageSize - 1) / oHNew->ulPageSize
+                 * oHNew->ulPageSize;
+      if(ulLength != (size_t) sStat.st_size &&
+         ftruncate(oHNew->iFd, (off_t) ulLength) != 0)
+         iStatus = IO_ERROR;
+   }
+   if(iStatus == SUCCESS) {
+      oHNew->pucDirty = calloc(ulLength / oHNew->ulPageSize, 1);
+      if(oHNew->pucDirty == NULL)
+         iStatus = MEMORY_ERROR;
+   }
+   if(iStatus == SUCCESS) {
+      oHNew->pcBase = mmap(NULL, ulLength, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE, oHNew->iFd, 0);
+      if(oHNew->pcBase == MAP_FAILED) {
+         oHNew->pcBase = NULL;
+         iStatus = IO_ERROR;
+      }
+      else
+         oHNew->ulLength = ulLength;
+   }
+
+   /* a new file, or one whose creation a crash interrupted, has no
+      header yet, and is given one at a first checkpoint */
+   if(iStatus == SUCCESS) {
+      psHeader = HeapFT_header(oHNew);
+      if(memcmp(psHeader->acMagic, acZeros, 8) == 0) {
+         struct heapHeader *psNewHeader =
+            HeapFT_touch(oHNew, 0, sizeof(struct heapHeader));
+
+         memcpy(psNewHeader->acMagic, acHeapMagic, 8);
+         psNewHeader->ulMarker = HEAP_MARKER;
+         psNewHeader->ulUsed = sizeof(struct heapHeader);
+         iStatus = HeapFT_checkpointUnlocked(oHNew);
+      }
+      else if(memcmp(psHeader->acMagic, acHeapMagic, 8) != 0 ||
+              psHeader->ulMarker != HEAP_MARKER ||
+              psHeader->ulUsed < sizeof(struct heapHeader) ||
+              psHeader->ulUsed > ulLength ||
+              psHeader->ulRoot >= psHeader->ulUsed)
+         iStatus = IO_ERROR;
+   }
+
+   if(iStatus != SUCCESS) {
+      HeapFT_free(oHNew);
+      return iStatus;
+   }
+   *poHResult = oHNew;
+   return SUCCESS;
+}
+
+void HeapFT_free(HeapFT_T oHTree) {
+   if(oHTree == NULL)
+      return;
+
+   if(oHTree->pcBase != NULL)
+      (void) munmap(oHTree->pcBase, oHTree->ulLength);
+   if(oHTree->iFd >= 0)
+      (void) close(oHTree->iFd);
+   free(oHTree->pucDirty);
+   free(oHTree->pcJournal);
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_destroy(&oHTree->sLock);
+#endif
+   free(oHTree);
+}
+
+int HeapFT_checkpoint(HeapFT_T oHTree) {
+   int iStatus;
+
+   assert(oHTree != NULL);
+
+   HeapFT_lockExclusive(oHTree);
+   iStatus = HeapFT_checkpointUnlocked(oHTree);
+   HeapFT_unlock(oHTree);
+   return iStatus;
+}
+
+/*
+  Inserts a directory (if bIsFile is FALSE) or a file with a copy of
+  the ulLength bytes at pvContents (if bIsFile is TRUE) into oHTree
+  with absolute path pcPath, along with any missing directories above
+  it. Must be called with oHTree's lock held exclusively. Returns the
+  same statuses as HeapFT_insertDir or HeapFT_insertFile.
+*/
+static int HeapFT_insert(HeapFT_T oHTree, const char *pcPath,
+                         boolean bIsFile, const void *pvContents,
+                         size_t ulLength) {
+   struct heapWalk sWalk;
+   size_t ulFirst = 0, ulLast = 0, ulNew = 0;
+   const char *pcComponent;
+   size_t *pulChildren;
+   struct heapNode *psNode;
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   HeapFT_releaseDeferred(oHTree);
+   iStatus = HeapFT_walk(oHTree, pcPath, &sWalk);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(sWalk.pcRest == NULL)
+      return ALREADY_IN_TREE;
+   if(sWalk.ulNode == 0 && bIsFile && strchr(pcPath, '/') == NULL)
+      return CONFLICTING_PATH;
+
+   /* room is made in the parent first, and the new nodes are built as
+      a chain hanging from the first, which is linked into the tree
+      only once nothing more can fail */
+   if(sWalk.ulNode != 0) {
+      iStatus = HeapFT_reserveChild(oHTree, sWalk.ulNode);
+      if(iStatus != SUCCESS)
+         return iStatus;
+   }
+   pcComponent = sWalk.pcRest;
+   for(;;) {
+      size_t ulComponent = strcspn(pcComponent, "/");
+      boolean bLast = (boolean) (pcComponent[ulComponent] == '\0');
+      size_t ulNode;
+
+      iStatus = HeapFT_newNode(oHTree, pcComponent, ulComponent,
+                               (boolean) (bLast && bIsFile), pvContents,
+                               ulLength, bLast ? 0 : 1, &ulNode);
+      if(iStatus != SUCCESS) {
+         if(ulFirst != 0)
+            (void) HeapFT_releaseSubtree(oHTree, ulFirst);
+         return iStatus;
+      }
+      ulNew++;
+      if(ulFirst == 0)
+         ulFirst = ulNode;
+      else {
+         psNode = HeapFT_touch(oHTree, ulLast, sizeof(struct heapNode));
+         *(size_t *) HeapFT_touch(oHTree, psNode->ulData,
+                                  sizeof(size_t)) = ulNode;
+         psNode->ulSize = 1;
+      }
+      ulLast = ulNode;
+      if(bLast)
+         break;
+      pcComponent += ulComponent + 1;
+   }
+
+   if(sWalk.ulNode == 0)
+      ((struct heapHeader *) HeapFT_touch(oHTree, 0,
+         sizeof(struct heapHeader)))->ulRoot = ulFirst;
+   else {
+      psNode = HeapFT_touch(oHTree, sWalk.ulNode, sizeof(struct heapNode));
+      pulChildren = HeapFT_touch(oHTree, psNode->ulData,
+                                 (psNode->ulSize + 1) * sizeof(size_t));
+      memmove(&pulChildren[sWalk.ulInsert + 1],
+              &pulChildren[sWalk.ulInsert],
+              (psNode->ulSize - sWalk.ulInsert) * sizeof(size_t));
+      pulChildren[sWalk.ulInsert] = ulFirst;
+      psNode->ulSize++;
+   }
+   ((struct heapHeader *) HeapFT_touch(oHTree, 0,
+      sizeof(struct heapHeader)))->ulCount += ulNew;
+   return SUCCESS;
+}
+
+/*
+  Removes the file (if bIsFile is TRUE) or the subtree of the
+  directory (if bIsFile is FALSE) with absolute path pcPath from
+  oHTree. Must be called with oHTree's lock held exclusively. Returns
+  the same statuses as HeapFT_rmFile or HeapFT_rmDir.
+*/
+static int HeapFT_remove(HeapFT_T oHTree, const char *pcPath,
+                         boolean bIsFile) {
+   struct heapWalk sWalk;
+   struct heapNode *psParent;
+   size_t *pulChildren;
+   size_t ulRemoved;
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   HeapFT_releaseDeferred(oHTree);
+   iStatus = HeapFT_walk(oHTree, pcPath, &sWalk);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(sWalk.ulNode == 0 || sWalk.pcRest != NULL)
+      return NO_SUCH_PATH;
+   if((HeapFT_node(oHTree, sWalk.ulNode)->ulFlags & FLAG_FILE) &&
+      !bIsFile)
+      return NOT_A_DIRECTORY;
+   if(!(HeapFT_node(oHTree, sWalk.ulNode)->ulFlags & FLAG_FILE) &&
+      bIsFile)
+      return NOT_A_FILE;
+
+   if(sWalk.ulParent == 0)
+      ((struct heapHeader *) HeapFT_touch(oHTree, 0,
+         sizeof(struct heapHeader)))->ulRoot = 0;
+   else {
+      psParent = HeapFT_touch(oHTree, sWalk.ulParent,
+                              sizeof(struct heapNode));
+      pulChildren = HeapFT_touch(oHTree, psParent->ulData,
+                                 psParent->ulSize * sizeof(size_t));
+      memmove(&pulChildren[sWalk.ulIndex], &pulChildren[sWalk.ulIndex + 1],
+              (psParent->ulSize - sWalk.ulIndex - 1) * sizeof(size_t));
+      psParent->ulSize--;
+   }
+   ulRemoved = HeapFT_releaseSubtree(oHTree, sWalk.ulNode);
+   ((struct heapHeader *) HeapFT_touch(oHTree, 0,
+      sizeof(struct heapHeader)))->ulCount -= ulRemoved;
+   return SUCCESS;
+}
+
+int HeapFT_insertDir(HeapFT_T oHTree, const char *pcPath) {
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   HeapFT_lockExclusive(oHTree);
+   iStatus = HeapFT_insert(oHTree, pcPath, FALSE, NULL, 0);
+   HeapFT_unlock(oHTree);
+   return iStatus;
+}
+
+int HeapFT_insertFile(HeapFT_T oHTree, const char *pcPath,
+                      const void *pvContents, size_t ulLength) {
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   HeapFT_lockExclusive(oHTree);
+   iStatus = HeapFT_insert(oHTree, pcPath, TRUE, pvContents, ulLength);
+   HeapFT_unlock(oHTree);
+   return iStatus;
+}
+
+int HeapFT_rmDir(HeapFT_T oHTree, const char *pcPath) {
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   HeapFT_lockExclusive(oHTree);
+   iStatus = HeapFT_remove(oHTree, pcPath, FALSE);
+   HeapFT_unlock(oHTree);
+   return iStatus;
+}
+
+int HeapFT_rmFile(HeapFT_T oHTree, const char *pcPath) {
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   HeapFT_lockExclusive(oHTree);
+   iStatus = HeapFT_remove(oHTree, pcPath, TRUE);
+   HeapFT_unlock(oHTree);
+   return iStatus;
+}
+
+boolean HeapFT_containsDir(HeapFT_T oHTree, const char *pcPath) {
+   boolean bResult;
+   size_t ulNode;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   HeapFT_lockShared(oHTree);
+   bResult = (boolean) (HeapFT_find(oHTree, pcPath, &ulNode) == SUCCESS &&
+                        !(HeapFT_node(oHTree, ulNode)->ulFlags
+                          & FLAG_FILE));
+   HeapFT_unlock(oHTree);
+   return bResult;
+}
+
+boolean HeapFT_containsFile(HeapFT_T oHTree, const char *pcPath) {
+   boolean bResult;
+   size_t ulNode;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   HeapFT_lockShared(oHTree);
+   bResult = (boolean) (HeapFT_find(oHTree, pcPath, &ulNode) == SUCCESS &&
+                        (HeapFT_node(oHTree, ulNode)->ulFlags
+                         & FLAG_FILE));
+   HeapFT_unlock(oHTree);
+   return bResult;
+}
+
+void *HeapFT_getFileContents(HeapFT_T oHTree, const char *pcPath) {
+   const struct heapNode *psNode;
+   void *pvResult = NULL;
+   size_t ulNode;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   HeapFT_lockShared(oHTree);
+   if(HeapFT_find(oHTree, pcPath, &ulNode) == SUCCESS) {
+      psNode = HeapFT_node(oHTree, ulNode);
+      if((psNode->ulFlags & FLAG_FILE) && psNode->ulData != 0)
+         pvResult = oHTree->pcBase + psNode->ulData;
+   }
+   HeapFT_unlock(oHTree);
+   return pvResult;
+}
+
+void *HeapFT_replaceFileContents(HeapFT_T oHTree, const char *pcPath,
+                                 const void *pvNewContents,
+                                 size_t ulNewLength) {
+   struct heapNode *psNode;
+   void *pvResult = NULL;
+   size_t ulNode, ulData = 0;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+
+   /* the old contents are freed only by the next write, so that the
+      pointer returned stays valid until then */
+   HeapFT_lockExclusive(oHTree);
+   HeapFT_releaseDeferred(oHTree);
+   if(HeapFT_find(oHTree, pcPath, &ulNode) == SUCCESS &&
+      (HeapFT_node(oHTree, ulNode)->ulFlags & FLAG_FILE) &&
+      (pvNewContents == NULL || ulNewLength == 0 ||
+       HeapFT_alloc(oHTree, ulNewLength, &ulData) == SUCCESS)) {
+      if(ulData != 0)
+         memcpy(HeapFT_touch(oHTree, ulData, ulNewLength), pvNewContents,
+                ulNewLength);
+      psNode = HeapFT_touch(oHTree, ulNode, sizeof(struct heapNode));
+      oHTree->ulDeferred = psNode->ulData;
+      if(psNode->ulData != 0)
+         pvResult = oHTree->pcBase + psNode->ulData;
+      psNode->ulData = ulData;
+      psNode->ulSize = ulNewLength;
+   }
+   HeapFT_unlock(oHTree);
+   return pvResult;
+}
+
+int HeapFT_stat(HeapFT_T oHTree, const char *pcPath, boolean *pbIsFile,
+                size_t *pulSize) {
+   const struct heapNode *psNode;
+   size_t ulNode;
+   int iStatus;
+
+   assert(oHTree != NULL);
+   assert(pcPath != NULL);
+   assert(pbIsFile != NULL);
+   assert(pulSize != NULL);
+
+   HeapFT_lockShared(oHTree);
+   iStatus = HeapFT_find(oHTree, pcPath, &ulNode);
+   if(iStatus == SUCCESS) {
+      psNode = HeapFT_node(oHTree, ulNode);
+      *pbIsFile = (boolean) ((psNode->ulFlags & FLAG_FILE) != 0);
+      if(*pbIsFile)
+         *pulSize = psNode->ulSize;
+   }
+   HeapFT_unlock(oHTree);
+   return iStatus;
+}
+
+int HeapFT_getCount(HeapFT_T oHTree, size_t *pulCount) {
+   assert(oHTree != NULL);
+   assert(pulCount != NULL);
+
+   HeapFT_lockShared(oHTree);
+   *pulCount = HeapFT_header(oHTree)->ulCount;
+   HeapFT_unlock(oHTree);
+   return SUCCESS;
+}
+
+/*
+  Returns the number of bytes that HeapFT_appendTree writes for the
+  subtree of node ulNode of oHTree's heap, whose parent's path is
+  ulParentLength characters long, or 0 if it is the root.
+*/
+static size_t HeapFT_measureTree(HeapFT_T oHTree, size_t ulNode,
+                                 size_t ulParentLength) {
+   const struct heapNode *psNode;
+   size_t ulPathLength, ulTotal, c;
+
+   assert(oHTree != NULL);
+
+   psNode = HeapFT_node(oHTree, ulNode);
+   ulPathLength = (ulParentLength != 0 ? ulParentLength + 1 : 0)
+                  + strlen(HeapFT_name(psNode));
+   ulTotal = ulPathLength + 1;
+   if(!(psNode->ulFlags & FLAG_FILE))
+      for(c = 0; c < psNode->ulSize; c++)
+         ulTotal += HeapFT_measureTree(oHTree,
+                                       HeapFT_children(oHTree, psNode)[c],
+                                       ulPathLength);
+   return ulTotal;
+}
+
+/*
+  Writes the paths of the subtree of node ulNode of oHTree's heap to
+  pcOut, each followed by a newline, in the order of FT_toString: a
+  directory, then its files, then the subtrees of its directories.
+  pcParent is the path of the node's parent, ulParentLength
+  characters long, or NULL if it is the root. Returns the end of what
+  was written.
+*/
+static char *HeapFT_appendTree(HeapFT_T oHTree, size_t ulNode,
+                               const char *pcParent,
+                               size_t ulParentLength, char *pcOut) {
+   const struct heapNode *psNode;
+   const char *pcName;
+   char *pcPath = pcOut;
+   size_t ulPathLength, c;
+   int iPass;
+
+   assert(oHTree != NULL);
+   assert(pcOut != NULL);
+
+   psNode = HeapFT_node(oHTree, ulNode);
+   pcName = HeapFT_name(psNode);
+   if(pcParent != NULL) {
+      memcpy(pcOut, pcParent, ulParentLength);
+      pcOut += ulParentLength;
+      *pcOut++ = '/';
+   }
+   strcpy(pcOut, pcName);
+   pcOut += strlen(pcName);
+   ulPathLength = (size_t) (pcOut - pcPath);
+   *pcOut++ = '\n';
+
+   if(!(psNode->ulFlags & FLAG_FILE))
+      for(iPass = 0; iPass < 2; iPass++)
+         for(c = 0; c < psNode->ulSize; c++) {
+            size_t ulChild = HeapFT_children(oHTree, psNode)[c];
+            boolean bIsFile = (boolean)
+               ((HeapFT_node(oHTree, ulChild)->ulFlags & FLAG_FILE) != 0);
+
+            if(bIsFile == (iPass == 0))
+               pcOut = HeapFT_appendTree(oHTree, ulChild, pcPath,
+                                         ulPathLength, pcOut);
+         }
+   return pcOut;
+}
+
+char *HeapFT_toString(HeapFT_T oHTree) {
+   char *pcResult;
+   size_t ulRoot, ulTotal = 1;
+
+   assert(oHTree != NULL);
+
+   HeapFT_lockShared(oHTree);
+   ulRoot = HeapFT_header(oHTree)->ulRoot;
+   if(ulRoot != 0)
+      ulTotal += HeapFT_measureTree(oHTree, ulRoot, 0);
+   pcResult = malloc(ulTotal);
+   if(pcResult != NULL) {
+      char *pcEnd = pcResult;
+
+      if(ulRoot != 0)
+         pcEnd = HeapFT_appendTree(oHTree, ulRoot, NULL, 0, pcResult);
+      *pcEnd = '\0';
+   }
+   HeapFT_unlock(oHTree);
+   return pcResult;
+}
@@ -0,0 +1,107 @@
+/*--------------------------------------------------------------------*/
+/* heapft.h                                                           */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef HEAPFT_INCLUDED
+#define HEAPFT_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A HeapFT_T is a File Tree that lives in a file: its nodes, their
+  names, child arrays and the contents of its files are allocated from
+  a heap in a memory-mapped file, and refer to each other by their
+  offsets in the file rather than by pointers, so the tree is used
+  where it lies and a process that opens the file again finds the
+  tree as it was, with no step that reads it in. Contents are copied
+  into the heap on insertion.
+
+  Changes are made to a private mapping of the file and reach the
+  file only at a checkpoint, which first writes the pages changed
+  since the last checkpoint to a journal beside the file and syncs
+  it, then copies them into the file and msyncs them, so a crash at
+  any point leaves the file as of one checkpoint or the next: opening
+  the file completes a checkpoint whose journal was synced, and
+  discards one whose journal was not. Changes since the last
+  checkpoint are lost if the process exits or the HeapFT_T is freed
+  without another.
+
+  Heap files hold native words, so a heap is opened only on machines
+  of the same word size and byte order as the one that wrote it, and
+  must not be changed but by HeapFT_T. A HeapFT_T may be shared
+  between threads: operations that only read run concurrently, and
+  all others one at a time.
+*/
+typedef struct heapFT *HeapFT_T;
+
+/*
+  Opens the heap in the file named pcFile as a new HeapFT_T, creating
+  the file with an empty tree if it does not exist, and sets
+  *poHResult to it. Completes a checkpoint interrupted by a crash
+  first. Returns SUCCESS, or:
+  * IO_ERROR if the file cannot be created, opened, or mapped, or
+    does not hold a heap of this machine's word size and byte order
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int HeapFT_open(const char *pcFile, HeapFT_T *poHResult);
+
+/*
+  Frees oHTree and unmaps its heap, discarding any changes since its
+  last checkpoint. Does nothing if oHTree is NULL. No other operation
+  may overlap HeapFT_free.
+*/
+void HeapFT_free(HeapFT_T oHTree);
+
+/*
+  Makes the file of oHTree's heap hold oHTree's tree as it stands, as
+  described above, so that it survives a crash. Returns SUCCESS, or:
+  * IO_ERROR if the journal or the file could not be written, in
+    which case the file still holds the tree as of the last
+    checkpoint, or the journal what a reopening completes it with
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int HeapFT_checkpoint(HeapFT_T oHTree);
+
+/*
+  Each of the following functions behaves as the FT function of the
+  same name, but on oHTree, except that:
+  * contents are copied into the heap: HeapFT_insertFile and
+    HeapFT_replaceFileContents copy the ulLength bytes at pvContents,
+    or store NULL contents of that length if pvContents is NULL
+  * HeapFT_getFileContents and HeapFT_replaceFileContents return
+    pointers into the heap, to the file's contents and to its old
+    contents, which must not be written or freed, and are valid until
+    the next operation on oHTree that writes it, or checkpoints it
+  * MEMORY_ERROR is also returned if the heap's file could not be
+    grown
+*/
+
+int HeapFT_insertDir(HeapFT_T oHTree, const char *pcPath);
+
+boolean HeapFT_containsDir(HeapFT_T oHTree, const char *pcPath);
+
+int HeapFT_rmDir(HeapFT_T oHTree, const char *pcPath);
+
+int HeapFT_insertFile(HeapFT_T oHTree, const char *pcPath,
+                      const void *pvContents, size_t ulLength);
+
+boolean HeapFT_containsFile(HeapFT_T oHTree, const char *pcPath);
+
+int HeapFT_rmFile(HeapFT_T oHTree, const char *pcPath);
+
+void *HeapFT_getFileContents(HeapFT_T oHTree, const char *pcPath);
+
+void *HeapFT_replaceFileContents(HeapFT_T oHTree, const char *pcPath,
+                                 const void *pvNewContents,
+                                 size_t ulNewLength);
+
+int HeapFT_stat(HeapFT_T oHTree, const char *pcPath, boolean *pbIsFile,
+                size_t *pulSize);
+
+int HeapFT_getCount(HeapFT_T oHTree, size_t *pulCount);
+
+char *HeapFT_toString(HeapFT_T oHTree);
+
+#endif
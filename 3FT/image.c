@@ -0,0 +1,506 @@
+/*--------------------------------------------------------------------*/
+/* image.c                                                            */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for mmap, fstat, fileno and fsync */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "image.h"
+
+/*
+  The layout of an image file: a header, the node records in
+  breadth-first order, the names of the nodes in the same order, each
+  followed by a '\0', then the contents of the files, each starting at
+  a multiple of the word size. A directory's record holds the index
+  of its first child's record, its children's records being
+  contiguous and sorted by name; a file's record holds the offset of
+  its contents. Offsets are from the start of the file.
+*/
+
+/* The flags of a node record */
+enum { FLAG_FILE = 1, FLAG_CONTENTS = 2 };
+
+/* The header of an image file */
+struct imageHeader {
+   /* the name of the format and its version */
+   char acMagic[8];
+   /* IMAGE_MARKER, as written by the machine that wrote the image */
+   size_t ulMarker;
+   /* the number of nodes */
+   size_t ulNodes;
+   /* the size of the file */
+   size_t ulFileSize;
+};
+
+/* A node record in an image file */
+struct imageNode {
+   /* the node's flags */
+   size_t ulFlags;
+   /* the offset and length of the node's name */
+   size_t ulNameOffset;
+   size_t ulNameLength;
+   /* the number of children of a directory, or the length of the
+      contents of a file */
+   size_t ulSize;
+   /* the index of the first child of a directory, or the offset of
+      the contents of a file */
+   size_t ulData;
+};
+
+/* The format and version of an image file */
+static const char acImageMagic[8] = "FTIMG\0\0\1";
+
+/* A word whose value depends on the word size and the byte order */
+#define IMAGE_MARKER ((size_t) 0x46540000UL | sizeof(size_t))
+
+/* The suffix of the temporary file that an image is written to */
+static const char acTempSuffix[] = ".tmp";
+
+/* A mapped image */
+struct image {
+   /* the mapping of the whole file */
+   const char *pcBase;
+   /* the size of the file */
+   size_t ulSize;
+   /* the node records, and their number */
+   const struct imageNode *psNodes;
+   size_t ulNodes;
+};
+
+/* Returns ulOffset rounded up to a multiple of the word size. */
+static size_t Image_align(size_t ulOffset) {
+   return (ulOffset + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+}
+
+/*
+  Writes ulBytes zero bytes to psFile. Returns SUCCESS, or IO_ERROR if
+  they could not be written.
+*/
+static int Image_pad(FILE *psFile, size_t ulBytes) {
+   assert(psFile != NULL);
+
+   while(ulBytes-- > 0)
+      if(putc(0, psFile) == EOF)
+         return IO_ERROR;
+   return SUCCESS;
+}
+
+/*
+  Writes the image of Image_write to psFile. Returns SUCCESS, or
+  IO_ERROR if it could not be written.
+*/
+static int Image_writeTo(FILE *psFile, size_t ulNodes,
+                         void (*pfGetNode)(void *pvExtra, size_t ulIndex,
+                                           const char **ppcName,
+                                           boolean *pbIsFile,
+                                           size_t *pulSize,
+                                           const void **ppvContents),
+                         void *pvExtra) {
+   struct imageHeader sHeader;
+   struct imageNode sNode;
+   const char *pcName;
+   boolean bIsFile;
+   size_t ulSize;
+   const void *pvContents;
+   size_t ulNames, ulOffset, ulNextChild;
+   size_t i;
+
+   assert(psFile != NULL);
+   assert(pfGetNode != NULL);
+
+   /* the first pass sizes the names and contents */
+   ulNames = sizeof(struct imageHeader) + ulNodes * sizeof(sNode);
+   ulOffset = ulNames;
+   for(i = 0; i < ulNodes; i++) {
+      (*pfGetNode)(pvExtra, i, &pcName, &bIsFile, &ulSize, &pvContents);
+      ulOffset += strlen(pcName) + 1;
+   }
+   ulOffset = Image_align(ulOffset);
+   for(i = 0; i < ulNodes; i++) {
+      (*pfGetNode)(pvExtra, i, &pcName, &bIsFile, &ulSize, &pvContents);
+      if(bIsFile && pvContents != NULL)
+         ulOffset = Image_align(ulOffset + ulSize);
+   }
+
+   memset(&sHeader, 0, sizeof(sHeader));
+   memcpy(sHeader.acMagic, acImageMagic, sizeof(acImageMagic));
+   sHeader.ulMarker = IMAGE_MARKER;
+   sHeader.ulNodes = ulNodes;
+   sHeader.ulFileSize = ulOffset;
+   if(fwrite(&sHeader, sizeof(sHeader), 1, psFile) != 1)
+      return IO_ERROR;
+
+   /* the second pass writes the records, then the names, then the
+      contents, each in the same order */
+   ulOffset = ulNames;
+   for(i = 0; i < ulNodes; i++) {
+      (*pfGetNode)(pvExtra, i, &pcName, &bIsFile, &ulSize, &pvContents);
+      ulOffset += strlen(pcName) + 1;
+   }
+   ulOffset = Image_align(ulOffset);
+
+   ulNextChild = 1;
+   for(i = 0; i < ulNodes; i++) {
+      (*pfGetNode)(pvExtra, i, &pcName, &bIsFile, &ulSize, &pvContents);
+      sNode.ulFlags = 0;
+      sNode.ulNameOffset = ulNames;
+      sNode.ulNameLength = strlen(pcName);
+      sNode.ulSize = ulSize;
+      ulNames += sNode.ulNameLength + 1;
+      if(!bIsFile) {
+         sNode.ulData = ulNextChild;
+         ulNextChild += ulSize;
+      }
+      else {
+         sNode.ulFlags |= FLAG_FILE;
+         sNode.ulData = 0;
+         if(pvContents != NULL) {
+            sNode.ulFlags |= FLAG_CONTENTS;
+            sNode.ulData = ulOffset;
+            ulOffset = Image_align(ulOffset + ulSize);
+         }
+         else
+            sNode.ulSize = 0;
+      }
+      if(fwrite(&sNode, sizeof(sNode), 1, psFile) != 1)
+         return IO_ERROR;
+   }
+   assert(ulNodes == 0 || ulNextChild == ulNodes);
+
+   for(i = 0; i < ulNodes; i++) {
+      (*pfGetNode)(pvExtra, i, &pcName, &bIsFile, &ulSize, &pvContents);
+      if(fwrite(pcName, 1, strlen(pcName) + 1, psFile)
+         != strlen(pcName) + 1)
+         return IO_ERROR;
+   }
+   if(Image_pad(psFile, Image_align(ulNames) - ulNames) != SUCCESS)
+      return IO_ERROR;
+
+   for(i = 0; i < ulNodes; i++) {
+      (*pfGetNode)(pvExtra, i, &pcName, &bIsFile, &ulSize, &pvContents);
+      if(!bIsFile || pvContents == NULL)
+         continue;
+      if(fwrite(pvContents, 1, ulSize, psFile) != ulSize ||
+         Image_pad(psFile, Image_align(ulSize) - ulSize) != SUCCESS)
+         return IO_ERROR;
+   }
+   return SUCCESS;
+}
+
+int Image_write(const char *pcFile, size_t ulNodes,
+                void (*pfGetNode)(void *pvExtra, size_t ulIndex,
+                                  const char **ppcName,
+                                  boolean *pbIsFile, size_t *pulSize,
+                                  const void **ppvContents),
+                void *pvExtra) {
+   char *pcTemp;
+   FILE *psFile;
+   int iStatus;
+
+   assert(pcFile != NULL);
+   assert(pfGetNode != NULL);
+
+   pcTemp = malloc(strlen(pcFile) + sizeof(acTempSuffix));
+   if(pcTemp == NULL)
+      return MEMORY_ERROR;
+   strcpy(pcTemp, pcFile);
+   strcat(pcTemp, acTempSuffix);
+
+   psFile = fopen(pcTemp, "wb");
+   if(psFile == NULL) {
+      free(pcTemp);
+      return IO_ERROR;
+   }
+
+   iStatus = Image_writeTo(psFile, ulNodes, pfGetNode, pvExtra);
+   if(iStatus == SUCCESS &&
+      (fflush(psFile) != 0 || fsync(fileno(psFile)) != 0))
+      iStatus = IO_ERROR;
+   if(fclose(psFile) != 0)
+      iStatus = IO_ERROR;
+   if(iStatus == SUCCESS && rename(pcTemp, pcFile) != 0)
+      iStatus = IO_ERROR;
+   if(iStatus != SUCCESS)
+      (void) remove(pcTemp);
+
+   free(pcTemp);
+   return iStatus;
+}
+
+int Image_open(const char *pcFile, Image_T *poIResult) {
+   Image_T oINew;
+   struct imageHeader sHeader;
+   struct stat sStat;
+   void *pvBase;
+   int iFd;
+
+   assert(pcFile != NULL);
+   assert(poIResult != NULL);
+
+   iFd = open(pcFile, O_RDONLY);
+   if(iFd < 0)
+      return IO_ERROR;
+   if(fstat(iFd, &sStat) != 0 ||
+      (size_t) sStat.st_size < sizeof(struct imageHeader)) {
+      (void) close(iFd);
+      return IO_ERROR;
+   }
+
+   /* the mapping outlives the descriptor */
+   pvBase = mmap(NULL, (size_t) sStat.st_size, PROT_READ, MAP_SHARED,
+                 iFd, 0);
+   (void) close(iFd);
+   if(pvBase == MAP_FAILED)
+      return IO_ERROR;
+
+   memcpy(&sHeader, pvBase, sizeof(sHeader));
+   if(memcmp(sHeader.acMagic, acImageMagic, sizeof(acImageMagic)) ||
+      sHeader.ulMarker != IMAGE_MARKER ||
+      sHeader.ulFileSize != (size_t) sStat.st_size ||
+      sHeader.ulNodes > (sHeader.ulFileSize - sizeof(sHeader))
+                        / sizeof(struct imageNode)) {
+      (void) munmap(pvBase, (size_t) sStat.st_size);
+      return IO_ERROR;
+   }
+
+   oINew = malloc(sizeof(struct image));
+   if(oINew == NULL) {
+      (void) munmap(pvBase, (size_t) sStat.st_size);
+      return MEMORY_ERROR;
+   }
+   oINew->pcBase = pvBase;
+   oINew->ulSize = sHeader.ulFileSize;
+   oINew->psNodes = (const struct imageNode *)
+      (oINew->pcBase + sizeof(struct imageHeader));
+   oINew->ulNodes = sHeader.ulNodes;
+
+   *poIResult = oINew;
+   return SUCCESS;
+}
+
+/*
+  Returns TRUE if the ulLength bytes at offset ulOffset lie within
+  oIImage's file, and FALSE if not.
+*/
+static boolean Image_isInside(Image_T oIImage, size_t ulOffset,
+                              size_t ulLength) {
+   assert(oIImage != NULL);
+
+   return (boolean) (ulOffset <= oIImage->ulSize &&
+                     ulLength <= oIImage->ulSize - ulOffset);
+}
+
+/*
+  Compares the name of psNode in oIImage with the ulLength bytes at
+  pcName, as strcmp would compare them as strings. Sets *piCompare to
+  <0, 0, or >0 if the name is less than, equal to, or greater than
+  them, respectively. Returns SUCCESS, or IO_ERROR if the name is not
+  within the file.
+*/
+static int Image_compareName(Image_T oIImage,
+                             const struct imageNode *psNode,
+                             const char *pcName, size_t ulLength,
+                             int *piCompare) {
+   size_t ulMin;
+   int iCompare;
+
+   assert(oIImage != NULL);
+   assert(psNode != NULL);
+   assert(pcName != NULL);
+   assert(piCompare != NULL);
+
+   if(!Image_isInside(oIImage, psNode->ulNameOffset,
+                      psNode->ulNameLength))
+      return IO_ERROR;
+
+   ulMin = psNode->ulNameLength < ulLength ? psNode->ulNameLength
+                                           : ulLength;
+   iCompare = memcmp(oIImage->pcBase + psNode->ulNameOffset, pcName,
+                     ulMin);
+   if(iCompare == 0)
+      iCompare = psNode->ulNameLength < ulLength ? -1
+                 : psNode->ulNameLength > ulLength;
+   *piCompare = iCompare;
+   return SUCCESS;
+}
+
+/*
+  Searches the children of directory psDir in oIImage for the one
+  named by the ulLength bytes at pcName. Sets *ppsResult to it, or to
+  NULL if there is none. Returns SUCCESS, or IO_ERROR if the image is
+  damaged.
+*/
+static int Image_findChild(Image_T oIImage, const struct imageNode *psDir,
+                           const char *pcName, size_t ulLength,
+                           const struct imageNode **ppsResult) {
+   size_t ulLow, ulHigh;
+
+   assert(oIImage != NULL);
+   assert(psDir != NULL);
+   assert(ppsResult != NULL);
+
+   *ppsResult = NULL;
+   if(psDir->ulData > oIImage->ulNodes ||
+      psDir->ulSize > oIImage->ulNodes - psDir->ulData)
+      return IO_ERROR;
+
+   ulLow = psDir->ulData;
+   ulHigh = psDir->ulData + psDir->ulSize;
+   while(ulLow < ulHigh) {
+      size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+      int iCompare;
+
+      if(Image_compareName(oIImage, &oIImage->psNodes[ulMid], pcName,
+                           ulLength, &iCompare) != SUCCESS)
+         return IO_ERROR;
+      if(iCompare == 0) {
+         *ppsResult = &oIImage->psNodes[ulMid];
+         return SUCCESS;
+      }
+      if(iCompare < 0)
+         ulLow = ulMid + 1;
+      else
+         ulHigh = ulMid;
+   }
+   return SUCCESS;
+}
+
+int Image_find(Image_T oIImage, const char *pcPath, size_t *pulLength,
+               void **ppvContents) {
+   const struct imageNode *psNode = NULL;
+   const char *pcComponent;
+   size_t ulLength;
+   int iCompare;
+
+   assert(oIImage != NULL);
+   assert(pcPath != NULL);
+   assert(pulLength != NULL);
+   assert(ppvContents != NULL);
+
+   /* a well-formatted path is non-empty components separated by
+      single '/' delimiters, as for Path_new */
+   ulLength = strlen(pcPath);
+   if(ulLength == 0 || pcPath[0] == '/' || pcPath[ulLength - 1] == '/'
+      || strstr(pcPath, "//") != NULL)
+      return BAD_PATH;
+   if(oIImage->ulNodes == 0)
+      return NO_SUCH_PATH;
+
+   /* walk down from the root one component at a time */
+   pcComponent = pcPath;
+   for(;;) {
+      const char *pcEnd = strchr(pcComponent, '/');
+      ulLength = pcEnd != NULL ? (size_t) (pcEnd - pcComponent)
+                               : strlen(pcComponent);
+
+      if(psNode == NULL) {
+         psNode = &oIImage->psNodes[0];
+         if(Image_compareName(oIImage, psNode, pcComponent, ulLength,
+                              &iCompare) != SUCCESS)
+            return IO_ERROR;
+         if(iCompare != 0)
+            return CONFLICTING_PATH;
+      }
+      else {
+         if(psNode->ulFlags & FLAG_FILE)
+            return NOT_A_DIRECTORY;
+         if(Image_findChild(oIImage, psNode, pcComponent, ulLength,
+                            &psNode) != SUCCESS)
+            return IO_ERROR;
+         if(psNode == NULL)
+            return NO_SUCH_PATH;
+      }
+
+      if(pcEnd == NULL)
+         break;
+      pcComponent = pcEnd + 1;
+   }
+
+   if(!(psNode->ulFlags & FLAG_FILE))
+      return IS_DIRECTORY;
+
+   *pulLength = 0;
+   *ppvContents = NULL;
+   if(psNode->ulFlags & FLAG_CONTENTS) {
+      if(!Image_isInside(oIImage, psNode->ulData, psNode->ulSize))
+         return IO_ERROR;
+      *pulLength = psNode->ulSize;
+      *ppvContents = (void *) (oIImage->pcBase + psNode->ulData);
+   }
+   return IS_FILE;
+}
+
+int Image_getNode(Image_T oIImage, size_t ulIndex, const char **ppcName,
+                  boolean *pbIsFile, size_t *pulSize, size_t *pulFirst,
+                  void **ppvContents) {
+   const struct imageNode *psNode;
+   const char *pcName;
+   size_t ulLength;
+
+   assert(oIImage != NULL);
+   assert(ppcName != NULL);
+   assert(pbIsFile != NULL);
+   assert(pulSize != NULL);
+   assert(pulFirst != NULL);
+   assert(ppvContents != NULL);
+
+   if(ulIndex >= oIImage->ulNodes)
+      return IO_ERROR;
+   psNode = &oIImage->psNodes[ulIndex];
+
+   /* the name must be a single component, followed by its '\0' */
+   ulLength = psNode->ulNameLength;
+   if(ulLength == 0 || ulLength >= oIImage->ulSize ||
+      !Image_isInside(oIImage, psNode->ulNameOffset, ulLength + 1))
+      return IO_ERROR;
+   pcName = oIImage->pcBase + psNode->ulNameOffset;
+   if(pcName[ulLength] != '\0' || memchr(pcName, '\0', ulLength) != NULL
+      || memchr(pcName, '/', ulLength) != NULL)
+      return IO_ERROR;
+
+   *ppcName = pcName;
+   *pbIsFile = (boolean) ((psNode->ulFlags & FLAG_FILE) != 0);
+   *pulSize = 0;
+   *pulFirst = 0;
+   *ppvContents = NULL;
+   if(!*pbIsFile) {
+      /* children follow their parent, so every walk down the image
+         ends, however it is damaged */
+      if(psNode->ulSize != 0 &&
+         (psNode->ulData <= ulIndex || psNode->ulData > oIImage->ulNodes
+          || psNode->ulSize > oIImage->ulNodes - psNode->ulData))
+         return IO_ERROR;
+      *pulSize = psNode->ulSize;
+      *pulFirst = psNode->ulData;
+   }
+   else if(psNode->ulFlags & FLAG_CONTENTS) {
+      if(!Image_isInside(oIImage, psNode->ulData, psNode->ulSize))
+         return IO_ERROR;
+      *pulSize = psNode->ulSize;
+      *ppvContents = (void *) (oIImage->pcBase + psNode->ulData);
+   }
+   return SUCCESS;
+}
+
+size_t Image_getCount(Image_T oIImage) {
+   assert(oIImage != NULL);
+
+   return oIImage->ulNodes;
+}
+
+void Image_close(Image_T oIImage) {
+   if(oIImage == NULL)
+      return;
+
+   (void) munmap((void *) oIImage->pcBase, oIImage->ulSize);
+   free(oIImage);
+}
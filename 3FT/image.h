@@ -0,0 +1,97 @@
+/*--------------------------------------------------------------------*/
+/* image.h                                                            */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef IMAGE_INCLUDED
+#define IMAGE_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  An Image_T is a read-only image of a File Tree in a file, which is
+  mapped into memory and queried where it lies, with no step that
+  reads it in: opening an image costs the same whatever its size, and
+  processes that map the same image share its pages. An image holds
+  its nodes in breadth-first order, each directory's children
+  contiguous and sorted by name, so a lookup binary searches each
+  directory it passes through, and refers to names, children and
+  contents by their offsets in the file rather than by pointers.
+
+  Images hold native words, so an image is read only on machines of
+  the same word size and byte order as the one that wrote it. Every
+  offset is checked before it is followed, so a damaged image yields
+  wrong answers or errors, but is never read outside its bounds. Any
+  number of threads may query an image concurrently.
+*/
+typedef struct image *Image_T;
+
+/*
+  Writes an image of a tree of ulNodes nodes to the file named pcFile,
+  replacing any file of that name only once the whole image is written
+  and synced. Calls (*pfGetNode)(pvExtra, ulIndex, &pcName, &bIsFile,
+  &ulSize, &pvContents) to describe the node of each index ulIndex
+  below ulNodes, perhaps several times. The nodes must be in
+  breadth-first order from the root, each directory's children in
+  sorted order. Each node is described by its name relative to its
+  parent, whether it is a file, and its number of children, if it is
+  a directory, or the length of its contents and its contents (or
+  NULL, if it has none), if it is a file. Returns SUCCESS, or:
+  * IO_ERROR if the image could not be written
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Image_write(const char *pcFile, size_t ulNodes,
+                void (*pfGetNode)(void *pvExtra, size_t ulIndex,
+                                  const char **ppcName,
+                                  boolean *pbIsFile, size_t *pulSize,
+                                  const void **ppvContents),
+                void *pvExtra);
+
+/*
+  Maps the image in the file named pcFile and sets *poIResult to it.
+  Returns SUCCESS, or:
+  * IO_ERROR if the file cannot be opened or mapped, or is not an
+    image of the current version written on a machine like this one
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Image_open(const char *pcFile, Image_T *poIResult);
+
+/*
+  Looks up absolute path pcPath in oIImage. If it names a file, sets
+  *pulLength and *ppvContents to the length of its contents and its
+  contents, which lie in the mapping, must not be written, and are
+  valid until oIImage is closed (or NULL, if it has none). Returns
+  IS_FILE or IS_DIRECTORY if pcPath is in oIImage. Otherwise,
+  returns:
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if no node with pcPath exists in the image
+  * NOT_A_DIRECTORY if a proper prefix of pcPath names a file
+  * IO_ERROR if the image is damaged along pcPath
+*/
+int Image_find(Image_T oIImage, const char *pcPath, size_t *pulLength,
+               void **ppvContents);
+
+/*
+  Describes the node at index ulIndex of oIImage's breadth-first
+  order, where the root is at index 0: sets *ppcName to its name
+  relative to its parent, *pbIsFile to whether it is a file, and
+  *pulSize to its number of children, if it is a directory, or to the
+  length of its contents, if it is a file. Sets *pulFirst to the index
+  of a directory's first child, the rest following it in sorted
+  order, or *ppvContents to a file's contents (or NULL, if it has
+  none), as Image_find does. Returns SUCCESS, or IO_ERROR if ulIndex
+  is not below Image_getCount(oIImage) or the node is damaged.
+*/
+int Image_getNode(Image_T oIImage, size_t ulIndex, const char **ppcName,
+                  boolean *pbIsFile, size_t *pulSize, size_t *pulFirst,
+                  void **ppvContents);
+
+/* Returns the number of nodes in oIImage. */
+size_t Image_getCount(Image_T oIImage);
+
+/* Unmaps oIImage and frees it. Does nothing if oIImage is NULL. */
+void Image_close(Image_T oIImage);
+
+#endif
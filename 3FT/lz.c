@@ -0,0 +1,445 @@
+/*--------------------------------------------------------------------*/
+/* lz.c                                                               */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lz.h"
+
+/*
+  The coding: a sequence of runs, each a token byte, then the run's
+  literal bytes, then, unless the run ends the input, the little-endian
+  2-byte distance back to the start of a match and the match's length.
+  The token's high nibble holds the number of literals and its low
+  nibble the match length less MIN_MATCH, each 15 meaning that bytes
+  of 255 and a final byte under 255 follow, whose sum it adds to.
+*/
+enum { MIN_MATCH = 4, MAX_DISTANCE = 65535 };
+
+/* The number of bits in a hash of MIN_MATCH bytes */
+enum { HASH_BITS = 13 };
+
+/* The multiplier of the hash, an odd 32-bit prime */
+#define PRIME 2654435761UL
+
+/* The mask keeping the low 32 bits of an unsigned long */
+#define MASK32 0xffffffffUL
+
+/* A compressor */
+struct lz {
+   /* the number of holds on the compressor: one per block, and one
+      until it is closed */
+   size_t ulRefs;
+   /* the number of bytes compressed, and the number they took */
+   size_t ulPlainBytes;
+   size_t ulPackedBytes;
+   /* the CPU microseconds spent compressing and decompressing */
+   size_t ulCompressMicros;
+   size_t ulExpandMicros;
+   /* the number of cache hits and misses of Lz_expand */
+   size_t ulHits;
+   size_t ulMisses;
+};
+
+/* A block, the header of the memory that also holds its bytes */
+struct lzBlock {
+   /* the compressor that made the block */
+   Lz_T oLCompressor;
+   /* the number of bytes the block holds, decompressed */
+   size_t ulLength;
+   /* the number of compressed bytes, which follow the header */
+   size_t ulPacked;
+   /* the decompressed copy, or NULL until Lz_expand makes it */
+   void *pvPlain;
+};
+
+/* Adds the atomic counter at pulCounter ulAmount. */
+static void Lz_count(size_t *pulCounter, size_t ulAmount) {
+   assert(pulCounter != NULL);
+
+   (void) __atomic_add_fetch(pulCounter, ulAmount, __ATOMIC_RELAXED);
+}
+
+/*
+  Drops a hold on oLCompressor, freeing it if that was the last.
+*/
+static void Lz_drop(Lz_T oLCompressor) {
+   assert(oLCompressor != NULL);
+
+   if(__atomic_sub_fetch(&oLCompressor->ulRefs, 1, __ATOMIC_ACQ_REL) == 0)
+      free(oLCompressor);
+}
+
+/* Returns the CPU time of the calling thread, in microseconds. */
+static size_t Lz_cpuMicros(void) {
+   struct timespec sNow;
+
+   if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &sNow) != 0)
+      return 0;
+   return (size_t) sNow.tv_sec * 1000000 + (size_t) sNow.tv_nsec / 1000;
+}
+
+/* Returns the hash of the MIN_MATCH bytes at pucBytes. */
+static size_t Lz_hash(const unsigned char *pucBytes) {
+   unsigned long ulWord;
+
+   ulWord = (unsigned long) pucBytes[0]
+      | (unsigned long) pucBytes[1] << 8
+      | (unsigned long) pucBytes[2] << 16
+      | (unsigned long) pucBytes[3] << 24;
+   return (size_t) (((ulWord * PRIME) & MASK32) >> (32 - HASH_BITS));
+}
+
+/*
+  Appends the count ulCount, less the 15 that the token holds, to the
+  output at *ppucOut, ending at pucEnd, as the coding extends a
+  nibble. Returns FALSE if the output has no room for it.
+*/
+static boolean Lz_putCount(unsigned char **ppucOut,
+                           const unsigned char *pucEnd, size_t ulCount) {
+   ulCount -= 15;
+   while(ulCount >= 255) {
+      if(*ppucOut == pucEnd)
+         return FALSE;
+      *(*ppucOut)++ = 255;
+      ulCount -= 255;
+   }
+   if(*ppucOut == pucEnd)
+      return FALSE;
+   *(*ppucOut)++ = (unsigned char) ulCount;
+   return TRUE;
+}
+
+/*
+  Appends a run of the ulLiterals bytes at pucLiterals followed by a
+  match of ulMatch bytes at distance ulDistance, or by none if ulMatch
+  is 0, to the output at *ppucOut, ending at pucEnd. Returns FALSE if
+  the output has no room for it.
+*/
+static boolean Lz_putRun(unsigned char **ppucOut,
+                         const unsigned char *pucEnd,
+                         const unsigned char *pucLiterals,
+                         size_t ulLiterals, size_t ulDistance,
+                         size_t ulMatch) {
+   unsigned char *pucToken;
+   size_t ulExtra;
+
+   if(*ppucOut == pucEnd)
+      return FALSE;
+   pucToken = (*ppucOut)++;
+   ulExtra = ulMatch == 0 ? 0 : ulMatch - MIN_MATCH;
+   *pucToken = (unsigned char) ((ulLiterals < 15 ? ulLiterals : 15) << 4
+                                | (ulExtra < 15 ? ulExtra : 15));
+
+   if(ulLiterals >= 15 && !Lz_putCount(ppucOut, pucEnd, ulLiterals))
+      return FALSE;
+   if((size_t) (pucEnd - *ppucOut) < ulLiterals)
+      return FALSE;
+   memcpy(*ppucOut, pucLiterals, ulLiterals);
+   *ppucOut += ulLiterals;
+   if(ulMatch == 0)
+      return TRUE;
+
+   if(pucEnd - *ppucOut < 2)
+      return FALSE;
+   *(*ppucOut)++ = (unsigned char) (ulDistance & 0xff);
+   *(*ppucOut)++ = (unsigned char) (ulDistance >> 8);
+   return (boolean) (ulExtra < 15
+                     || Lz_putCount(ppucOut, pucEnd, ulExtra));
+}
+
+/*
+  Compresses the ulLength bytes at pucIn into the ulRoom bytes at
+  pucOut, finding matches greedily through a table of the last
+  position of each hash. Returns the number of bytes written, or 0 if
+  they do not fit or insufficient memory is available.
+*/
+static size_t Lz_deflate(const unsigned char *pucIn, size_t ulLength,
+                         unsigned char *pucOut, size_t ulRoom) {
+   size_t *pulTable;
+   unsigned char *pucNext = pucOut;
+   const unsigned char *pucEnd = pucOut + ulRoom;
+   size_t ulLiteral = 0;
+   size_t ulPosition = 0;
+   size_t ulCandidate, ulMatch, ulHash;
+
+   /* positions are stored plus one, so that 0 means none */
+   pulTable = calloc((size_t) 1 << HASH_BITS, sizeof(size_t));
+   if(pulTable == NULL)
+      return 0;
+
+   while(ulLength >= MIN_MATCH && ulPosition <= ulLength - MIN_MATCH) {
+      ulHash = Lz_hash(pucIn + ulPosition);
+      ulCandidate = pulTable[ulHash];
+      pulTable[ulHash] = ulPosition + 1;
+      if(ulCandidate == 0 || ulPosition - (ulCandidate - 1) > MAX_DISTANCE
+         || memcmp(pucIn + ulCandidate - 1, pucIn + ulPosition,
+                   MIN_MATCH) != 0) {
+         ulPosition++;
+         continue;
+      }
+
+      ulCandidate--;
+      ulMatch = MIN_MATCH;
+      while(ulPosition + ulMatch < ulLength
+            && pucIn[ulCandidate + ulMatch] == pucIn[ulPosition + ulMatch])
+         ulMatch++;
+      if(!Lz_putRun(&pucNext, pucEnd, pucIn + ulLiteral,
+                    ulPosition - ulLiteral, ulPosition - ulCandidate,
+                    ulMatch)) {
+         free(pulTable);
+         return 0;
+      }
+      ulPosition += ulMatch;
+      ulLiteral = ulPosition;
+   }
+   free(pulTable);
+
+   if(!Lz_putRun(&pucNext, pucEnd, pucIn + ulLiteral,
+                 ulLength - ulLiteral, 0, 0))
+      return 0;
+   return (size_t) (pucNext - pucOut);
+}
+
+/*
+  Reads a count extending a nibble from the ulPacked bytes at pucIn,
+  from *pulNext on, adding it to *pulCount. Returns FALSE if the
+  bytes end first.
+*/
+static boolean Lz_getCount(const unsigned char *pucIn, size_t ulPacked,
+                           size_t *pulNext, size_t *pulCount) {
+   unsigned char ucByte;
+
+   do {
+      if(*pulNext == ulPacked)
+         return FALSE;
+      ucByte = pucIn[(*pulNext)++];
+      *pulCount += ucByte;
+   } while(ucByte == 255);
+   return TRUE;
+}
+
+/*
+  Decompresses the ulPacked bytes at pucIn into the ulLength bytes at
+  pucOut. Returns TRUE if they decode to exactly ulLength bytes, and
+  FALSE otherwise.
+*/
+static boolean Lz_inflate(const unsigned char *pucIn, size_t ulPacked,
+                          unsigned char *pucOut, size_t ulLength) {
+   size_t ulNext = 0;
+   size_t ulDone = 0;
+   size_t ulLiterals, ulMatch, ulDistance;
+   unsigned char ucToken;
+
+   while(ulNext < ulPacked) {
+      ucToken = pucIn[ulNext++];
+      ulLiterals = ucToken >> 4;
+      if(ulLiterals == 15
+         && !Lz_getCount(pucIn, ulPacked, &ulNext, &ulLiterals))
+         return FALSE;
+      if(ulLiterals > ulPacked - ulNext || ulLiterals > ulLength - ulDone)
+         return FALSE;
+      memcpy(pucOut + ulDone, pucIn + ulNext, ulLiterals);
+      ulNext += ulLiterals;
+      ulDone += ulLiterals;
+      if(ulNext == ulPacked)
+         break;
+
+      if(ulPacked - ulNext < 2)
+         return FALSE;
+      ulDistance = (size_t) pucIn[ulNext] | (size_t) pucIn[ulNext + 1] << 8;
+      ulNext += 2;
+      ulMatch = ucToken & 15;
+      if(ulMatch == 15 && !Lz_getCount(pucIn, ulPacked, &ulNext, &ulMatch))
+         return FALSE;
+      ulMatch += MIN_MATCH;
+      if(ulDistance == 0 || ulDistance > ulDone
+         || ulMatch > ulLength - ulDone)
+         return FALSE;
+
+      /* a match may overlap the bytes it produces, and then is
+         copied a byte at a time */
+      if(ulDistance >= ulMatch) {
+         memcpy(pucOut + ulDone, pucOut + ulDone - ulDistance, ulMatch);
+         ulDone += ulMatch;
+      }
+      else
+         for(; ulMatch > 0; ulMatch--, ulDone++)
+            pucOut[ulDone] = pucOut[ulDone - ulDistance];
+   }
+   return (boolean) (ulDone == ulLength);
+}
+
+Lz_T Lz_new(void) {
+   Lz_T oLNew;
+
+   oLNew = calloc(1, sizeof(struct lz));
+   if(oLNew == NULL)
+      return NULL;
+   oLNew->ulRefs = 1;
+   return oLNew;
+}
+
+void Lz_close(Lz_T oLCompressor) {
+   if(oLCompressor != NULL)
+      Lz_drop(oLCompressor);
+}
+
+/* Returns a new block of oLCompressor with room for ulPacked bytes. */
+static Lz_Block_T Lz_newBlock(Lz_T oLCompressor, size_t ulLength,
+                              size_t ulPacked) {
+   Lz_Block_T oLNew;
+
+   assert(oLCompressor != NULL);
+
+   oLNew = malloc(sizeof(struct lzBlock) + ulPacked);
+   if(oLNew == NULL)
+      return NULL;
+   oLNew->oLCompressor = oLCompressor;
+   oLNew->ulLength = ulLength;
+   oLNew->ulPacked = ulPacked;
+   oLNew->pvPlain = NULL;
+   Lz_count(&oLCompressor->ulRefs, 1);
+   return oLNew;
+}
+
+Lz_Block_T Lz_compress(Lz_T oLCompressor, const void *pvBytes,
+                       size_t ulLength) {
+   Lz_Block_T oLNew;
+   unsigned char *pucOut;
+   size_t ulStart;
+   size_t ulPacked;
+
+   assert(oLCompressor != NULL);
+   assert(pvBytes != NULL || ulLength == 0);
+
+   ulStart = Lz_cpuMicros();
+   pucOut = malloc(ulLength - ulLength / 8 + 1);
+   if(pucOut == NULL)
+      return NULL;
+   ulPacked = Lz_deflate(pvBytes, ulLength, pucOut,
+                         ulLength - ulLength / 8);
+
+   oLNew = NULL;
+   if(ulPacked != 0)
+      oLNew = Lz_newBlock(oLCompressor, ulLength, ulPacked);
+   if(oLNew != NULL) {
+      memcpy(oLNew + 1, pucOut, ulPacked);
+      Lz_count(&oLCompressor->ulPlainBytes, ulLength);
+      Lz_count(&oLCompressor->ulPackedBytes, ulPacked);
+   }
+   free(pucOut);
+   Lz_count(&oLCompressor->ulCompressMicros, Lz_cpuMicros() - ulStart);
+   return oLNew;
+}
+
+Lz_Block_T Lz_repack(Lz_Block_T oLBlock) {
+   Lz_Block_T oLNew;
+
+   assert(oLBlock != NULL);
+
+   oLNew = Lz_newBlock(oLBlock->oLCompressor, oLBlock->ulLength,
+                       oLBlock->ulPacked);
+   if(oLNew != NULL)
+      memcpy(oLNew + 1, oLBlock + 1, oLBlock->ulPacked);
+   return oLNew;
+}
+
+void Lz_free(void *pvBlock) {
+   Lz_Block_T oLBlock = pvBlock;
+
+   assert(oLBlock != NULL);
+
+   Lz_drop(oLBlock->oLCompressor);
+   free(oLBlock->pvPlain);
+   free(oLBlock);
+}
+
+size_t Lz_getLength(Lz_Block_T oLBlock) {
+   assert(oLBlock != NULL);
+
+   return oLBlock->ulLength;
+}
+
+size_t Lz_getFootprint(Lz_Block_T oLBlock) {
+   assert(oLBlock != NULL);
+
+   return oLBlock->ulPacked
+      + (Lz_isExpanded(oLBlock) ? oLBlock->ulLength : 0);
+}
+
+boolean Lz_isExpanded(Lz_Block_T oLBlock) {
+   assert(oLBlock != NULL);
+
+   return (boolean) (__atomic_load_n(&oLBlock->pvPlain, __ATOMIC_ACQUIRE)
+                     != NULL);
+}
+
+void *Lz_expand(Lz_Block_T oLBlock) {
+   Lz_T oLCompressor;
+   void *pvPlain;
+   void *pvExpected = NULL;
+   size_t ulStart;
+   boolean bDecoded;
+
+   assert(oLBlock != NULL);
+
+   oLCompressor = oLBlock->oLCompressor;
+   pvPlain = __atomic_load_n(&oLBlock->pvPlain, __ATOMIC_ACQUIRE);
+   if(pvPlain != NULL) {
+      Lz_count(&oLCompressor->ulHits, 1);
+      return pvPlain;
+   }
+
+   ulStart = Lz_cpuMicros();
+   pvPlain = malloc(oLBlock->ulLength != 0 ? oLBlock->ulLength : 1);
+   if(pvPlain == NULL)
+      return NULL;
+   bDecoded = Lz_inflate((const unsigned char *) (oLBlock + 1),
+                         oLBlock->ulPacked, pvPlain, oLBlock->ulLength);
+   assert(bDecoded);
+   (void) bDecoded;
+   Lz_count(&oLCompressor->ulExpandMicros, Lz_cpuMicros() - ulStart);
+   Lz_count(&oLCompressor->ulMisses, 1);
+
+   /* of threads expanding the block at once, the first to publish
+      its copy wins */
+   if(!__atomic_compare_exchange_n(&oLBlock->pvPlain, &pvExpected,
+                                   pvPlain, 0, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+      free(pvPlain);
+      return pvExpected;
+   }
+   return pvPlain;
+}
+
+void Lz_getStats(Lz_T oLCompressor, size_t *pulPlainBytes,
+                 size_t *pulPackedBytes, double *pdCompressSeconds,
+                 double *pdExpandSeconds, size_t *pulHits,
+                 size_t *pulMisses) {
+   assert(oLCompressor != NULL);
+
+   if(pulPlainBytes != NULL)
+      *pulPlainBytes = __atomic_load_n(&oLCompressor->ulPlainBytes,
+                                       __ATOMIC_RELAXED);
+   if(pulPackedBytes != NULL)
+      *pulPackedBytes = __atomic_load_n(&oLCompressor->ulPackedBytes,
+                                        __ATOMIC_RELAXED);
+   if(pdCompressSeconds != NULL)
+      *pdCompressSeconds = __atomic_load_n(&oLCompressor->ulCompressMicros,
+                                           __ATOMIC_RELAXED) / 1e6;
+   if(pdExpandSeconds != NULL)
+      *pdExpandSeconds = __atomic_load_n(&oLCompressor->ulExpandMicros,
+                                         __ATOMIC_RELAXED) / 1e6;
+   if(pulHits != NULL)
+      *pulHits = __atomic_load_n(&oLCompressor->ulHits, __ATOMIC_RELAXED);
+   if(pulMisses != NULL)
+      *pulMisses = __atomic_load_n(&oLCompressor->ulMisses,
+                                   __ATOMIC_RELAXED);
+}
@@ -0,0 +1,93 @@
+/*--------------------------------------------------------------------*/
+/* lz.h                                                               */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef LZ_INCLUDED
+#define LZ_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  An Lz_T is a compressor: it packs byte strings into blocks with a
+  byte-oriented LZ77 coding, and keeps statistics of the work done on
+  them. A block holds its bytes compressed, and their decompressed
+  copy once someone has asked for it, kept with the block until the
+  block is freed. Blocks are never changed but for that copy, and may
+  be expanded, read and freed by different threads at once.
+*/
+typedef struct lz *Lz_T;
+
+/* A block of compressed bytes (see Lz_T) */
+typedef struct lzBlock *Lz_Block_T;
+
+/*
+  Returns a new compressor with all of its statistics zero, or NULL if
+  insufficient memory is available.
+*/
+Lz_T Lz_new(void);
+
+/*
+  Closes oLCompressor to further compression, and frees it once the
+  last of its blocks is freed, at once if it has none. Does nothing if
+  oLCompressor is NULL.
+*/
+void Lz_close(Lz_T oLCompressor);
+
+/*
+  Returns a new block of oLCompressor holding the ulLength bytes at
+  pvBytes compressed, without a decompressed copy, or NULL if they do
+  not compress to at most seven eighths of their length or
+  insufficient memory is available. oLCompressor must not be closed.
+*/
+Lz_Block_T Lz_compress(Lz_T oLCompressor, const void *pvBytes,
+                       size_t ulLength);
+
+/*
+  Returns a new block of the same compressor holding the same
+  compressed bytes as oLBlock, but no decompressed copy, or NULL if
+  insufficient memory is available. oLBlock is unchanged.
+*/
+Lz_Block_T Lz_repack(Lz_Block_T oLBlock);
+
+/*
+  Frees the block pvBlock, an Lz_Block_T, and its decompressed copy.
+  Has the signature of a function that frees contents, so that blocks
+  can be given owners (see Node_newOwner).
+*/
+void Lz_free(void *pvBlock);
+
+/* Returns the number of bytes that oLBlock holds, decompressed. */
+size_t Lz_getLength(Lz_Block_T oLBlock);
+
+/*
+  Returns the number of bytes of memory that oLBlock's contents take:
+  its compressed bytes, and its decompressed copy if it has one.
+*/
+size_t Lz_getFootprint(Lz_Block_T oLBlock);
+
+/* Returns TRUE if oLBlock has its decompressed copy, FALSE if not. */
+boolean Lz_isExpanded(Lz_Block_T oLBlock);
+
+/*
+  Returns the decompressed copy of oLBlock's bytes, valid until
+  oLBlock is freed, or NULL if insufficient memory is available. The
+  first call makes the copy, and counts a cache miss; every later one
+  returns it, and counts a hit.
+*/
+void *Lz_expand(Lz_Block_T oLBlock);
+
+/*
+  Stores oLCompressor's statistics into the non-NULL parameters: the
+  number of bytes it has compressed and the number they compressed
+  to, both counting only blocks made by Lz_compress; the CPU seconds
+  it has spent compressing and decompressing; and the numbers of
+  cache hits and misses that Lz_expand has counted.
+*/
+void Lz_getStats(Lz_T oLCompressor, size_t *pulPlainBytes,
+                 size_t *pulPackedBytes, double *pdCompressSeconds,
+                 double *pdExpandSeconds, size_t *pulHits,
+                 size_t *pulMisses);
+
+#endif
@@ -0,0 +1,132 @@
+/*--------------------------------------------------------------------*/
+/* map.c                                                              */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for mmap, munmap, fstat and sysconf */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "map.h"
+
+/* A region of a file */
+struct map {
+   /* the file's descriptor */
+   int iFd;
+   /* the offset of the region in the file */
+   size_t ulOffset;
+   /* the number of bytes in the region */
+   size_t ulLength;
+   /* the start of the mapping, at the page boundary at or before the
+      region, or NULL until Map_load makes it */
+   void *pvBase;
+};
+
+/* The address that an empty region loads to, having nothing to map */
+static char cEmpty;
+
+/*
+  Returns the number of bytes of oMRegion's mapping before the
+  region, which starts at the page boundary at or before it.
+*/
+static size_t Map_getSlack(Map_T oMRegion) {
+   long lPage;
+
+   assert(oMRegion != NULL);
+
+   lPage = sysconf(_SC_PAGESIZE);
+   if(lPage <= 0)
+      lPage = 4096;
+   return oMRegion->ulOffset % (size_t) lPage;
+}
+
+int Map_open(const char *pcFile, size_t ulOffset, size_t ulLength,
+             Map_T *poMResult) {
+   Map_T oMNew;
+   struct stat sStat;
+
+   assert(pcFile != NULL);
+   assert(poMResult != NULL);
+
+   oMNew = malloc(sizeof(struct map));
+   if(oMNew == NULL)
+      return MEMORY_ERROR;
+   oMNew->iFd = open(pcFile, O_RDONLY);
+   if(oMNew->iFd < 0) {
+      free(oMNew);
+      return IO_ERROR;
+   }
+   /* the region must lie within the file as it stands now */
+   if(fstat(oMNew->iFd, &sStat) != 0 || !S_ISREG(sStat.st_mode)
+      || ulOffset > (size_t) sStat.st_size
+      || ulLength > (size_t) sStat.st_size - ulOffset) {
+      (void) close(oMNew->iFd);
+      free(oMNew);
+      return IO_ERROR;
+   }
+   oMNew->ulOffset = ulOffset;
+   oMNew->ulLength = ulLength;
+   oMNew->pvBase = NULL;
+
+   *poMResult = oMNew;
+   return SUCCESS;
+}
+
+void Map_free(void *pvMap) {
+   Map_T oMRegion = pvMap;
+
+   assert(oMRegion != NULL);
+
+   if(oMRegion->pvBase != NULL && oMRegion->pvBase != &cEmpty)
+      (void) munmap(oMRegion->pvBase,
+                    Map_getSlack(oMRegion) + oMRegion->ulLength);
+   (void) close(oMRegion->iFd);
+   free(oMRegion);
+}
+
+size_t Map_getLength(Map_T oMRegion) {
+   assert(oMRegion != NULL);
+
+   return oMRegion->ulLength;
+}
+
+void *Map_load(Map_T oMRegion) {
+   void *pvBase;
+   void *pvExpected = NULL;
+   size_t ulSlack;
+
+   assert(oMRegion != NULL);
+
+   pvBase = __atomic_load_n(&oMRegion->pvBase, __ATOMIC_ACQUIRE);
+   if(pvBase == &cEmpty)
+      return pvBase;
+   ulSlack = Map_getSlack(oMRegion);
+   if(pvBase != NULL)
+      return (char *) pvBase + ulSlack;
+
+   if(oMRegion->ulLength == 0)
+      pvBase = &cEmpty;
+   else {
+      pvBase = mmap(NULL, ulSlack + oMRegion->ulLength, PROT_READ,
+                    MAP_SHARED, oMRegion->iFd,
+                    (off_t) (oMRegion->ulOffset - ulSlack));
+      if(pvBase == MAP_FAILED)
+         return NULL;
+   }
+
+   /* of threads mapping the region at once, the first to publish its
+      mapping wins */
+   if(!__atomic_compare_exchange_n(&oMRegion->pvBase, &pvExpected,
+                                   pvBase, 0, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+      if(pvBase != &cEmpty)
+         (void) munmap(pvBase, ulSlack + oMRegion->ulLength);
+      pvBase = pvExpected;
+   }
+   return pvBase == &cEmpty ? pvBase : (char *) pvBase + ulSlack;
+}
@@ -0,0 +1,51 @@
+/*--------------------------------------------------------------------*/
+/* map.h                                                              */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef MAP_INCLUDED
+#define MAP_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Map_T is a region of a file on disk, mapped read-only into memory
+  the first time someone asks for its bytes, so that they are read
+  from the page cache rather than copied. The file is held open from
+  the time the region is made until it is freed, and the mapping kept
+  until then too. Regions may be loaded and freed by different
+  threads at once.
+*/
+typedef struct map *Map_T;
+
+/*
+  Makes the region of the ulLength bytes of file pcFile from offset
+  ulOffset on, not mapped, and sets *poMResult to it. Returns SUCCESS,
+  MEMORY_ERROR if insufficient memory is available, or IO_ERROR if the
+  file could not be opened or the region does not lie within it, in
+  which case *poMResult is unchanged.
+*/
+int Map_open(const char *pcFile, size_t ulOffset, size_t ulLength,
+             Map_T *poMResult);
+
+/*
+  Frees the region pvMap, a Map_T, unmapping it and closing its file.
+  Has the signature of a function that frees contents, so that
+  regions can be given owners (see Node_newOwner).
+*/
+void Map_free(void *pvMap);
+
+/* Returns the number of bytes in oMRegion. */
+size_t Map_getLength(Map_T oMRegion);
+
+/*
+  Returns the address of oMRegion's bytes in memory, valid until
+  oMRegion is freed, or NULL if the region could not be mapped. The
+  first call maps the region; every later one returns the same
+  address. The bytes change as the file does, and reading bytes that
+  the file no longer holds raises SIGBUS.
+*/
+void *Map_load(Map_T oMRegion);
+
+#endif
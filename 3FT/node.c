@@ -3,13 +3,39 @@
 /* Authors: Will Grimes, David Wang                                   */
 /*--------------------------------------------------------------------*/
 
+/* for pthread_mutex_t */
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
-#include "dynarray.h"
+#ifndef FT_NO_LOCKING
+#include <pthread.h>
+#endif
 #include "node.h"
 #include "a4def.h"
 #include "checkerFT.h"
+#include "epoch.h"
+
+/* The capacity of a directory's first children array */
+enum { MIN_CHILDREN = 2 };
+
+/*
+  A directory's children, sorted by path. Readers search a children
+  array without any lock while a writer changes it, so the writer
+  only ever appends to a published array: it stores the new child
+  past the end and then publishes it by advancing ulLength. Any other
+  change builds a new array, which replaces the old one in a single
+  atomic store, and the old one is retired.
+*/
+struct childArray {
+   /* the number of children published to readers */
+   size_t ulLength;
+   /* the number of children the array has room for */
+   size_t ulCapacity;
+   /* the children, allocated with the array */
+   Node_T *poNChildren;
+};
 
 /* A node in a FT */
 struct node {
@@ -17,80 +43,794 @@ struct node {
    Path_T oPPath;
    /* boolean of whether or not node is a file. */
    boolean bIsFile;
-   /* this node's parent */
+   /* this node's parent in the FT's current hierarchy, which may have
+      been copied since a snapshot that still shares this node */
    Node_T oNParent;
-   /* the object containing links to this node's children */
-   DynArray_T oDChildren;
+   /* this node's children, or NULL if the node is a file */
+   struct childArray *psChildren;
    /* this node's contents */
    void *pvContents;
    /* length of node's contents */
    size_t ulLength;
+   /* the owner of this node's contents, or NULL if they are the
+      client's */
+   struct nodeOwner *psOwner;
+   /* the number of times the contents have been edited, doubled, and
+      odd while an edit is in progress, so that readers can tell
+      whether the contents, length and owner they read belong
+      together */
+   size_t ulEdits;
+   /* TRUE if the contents were read since Node_takeRead last asked */
+   boolean bRead;
+   /* the latest time at which the contents were read */
+   size_t ulReadTime;
+   /* for a directory, the numbers of files and of directories in the
+      subtree rooted at it, itself included, and the total length of
+      the files' contents, which every change below it adds to or
+      subtracts from on its way up */
+   size_t ulFiles;
+   size_t ulDirs;
+   size_t ulBytes;
+   /* for a directory, a bound on the length of every file in the
+      subtree rooted at it, raised as files grow but never lowered */
+   size_t ulMaxLength;
+   /* this node's identifier in the node ID table */
+   size_t ulID;
+   /* the number of children arrays, roots and snapshots that
+      reference this node: 1 unless a snapshot shares it */
+   size_t ulRefs;
+};
+
+/* The owner of contents that the nodes holding it free */
+struct nodeOwner {
+   /* the contents owned */
+   void *pvContents;
+   /* the function that frees them, or NULL if they are a copy
+      allocated with the owner */
+   void (*pfFree)(void *pvContents);
+   /* the number of holds on the owner: one per node whose contents
+      they are, and one per caller yet to give or release its own */
+   size_t ulRefs;
+};
+
+/*
+  The header of a copy allocated with its owner, which the copy
+  follows, aligned for any type that the contents may hold
+*/
+union ownedCopy {
+   struct nodeOwner sOwner;
+   long double ldAlign;
+   void *pvAlign;
+};
+
+#ifndef FT_NO_LOCKING
+/*
+  A directory node, allocated with the lock that writers hold while
+  they change its children or the contents of its files. Only
+  directories have locks, so file nodes are allocated as a bare
+  struct node.
+*/
+struct dirNode {
+   /* the node itself, first so that a Node_T can point to it */
+   struct node sNode;
+   /* the directory's lock */
+   pthread_mutex_t sLock;
+};
+#endif
+
+/*
+  A node ID table maps node identifiers to live nodes. An identifier
+  packs a slot index into its low half and that slot's generation into
+  its high half. A slot's generation advances each time its node is
+  freed, so identifiers of freed nodes never validate again, even
+  after the slot is reused. Generations start at 1, so 0 is never a
+  valid identifier.
+*/
+
+/* An entry in a node ID table */
+struct idSlot {
+   /* the node occupying this slot, or NULL if the slot is free */
+   Node_T oNNode;
+   /* the generation of the slot's current or next occupant */
+   size_t ulGeneration;
+   /* index of the next free slot, if this slot is free */
+   size_t ulNextFree;
 };
 
+/* The number of bits of an identifier used for the slot index */
+#define NODE_ID_INDEX_BITS (sizeof(size_t) * 4)
+/* The mask selecting the slot index of an identifier */
+#define NODE_ID_INDEX_MASK (((size_t) 1 << NODE_ID_INDEX_BITS) - 1)
+
+/* A node ID table */
+struct nodeIDTable {
+   /* the slots of the table */
+   struct idSlot *psSlots;
+   /* the number of slots in use or on the free list */
+   size_t ulSlotCount;
+   /* the number of slots allocated in psSlots */
+   size_t ulSlotCapacity;
+   /* index of the first free slot, or ulSlotCount if there is none */
+   size_t ulFreeHead;
+   /* the domain through which replaced slot arrays and freed nodes
+      are reclaimed */
+   Epoch_T oEReclaim;
+#ifndef FT_NO_LOCKING
+   /* the lock serializing writers that assign and release slots */
+   pthread_mutex_t sLock;
+#endif
+};
+
+/* Acquires oITable's lock, for a writer assigning or releasing slots. */
+static void Node_lockTable(Node_IDTable_T oITable) {
+   assert(oITable != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_mutex_lock(&oITable->sLock);
+#else
+   (void) oITable;
+#endif
+}
+
+/* Releases oITable's lock. */
+static void Node_unlockTable(Node_IDTable_T oITable) {
+   assert(oITable != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_mutex_unlock(&oITable->sLock);
+#else
+   (void) oITable;
+#endif
+}
+
+/*
+  Assigns oNNode a slot in node ID table oITable and stores its
+  identifier in oNNode->ulID. Returns SUCCESS, or MEMORY_ERROR if the
+  table could not grow to hold another slot. Must be called with
+  oITable's lock held.
+*/
+static int Node_assignIDLocked(Node_T oNNode, Node_IDTable_T oITable) {
+   size_t ulIndex;
+
+   assert(oNNode != NULL);
+   assert(oITable != NULL);
+
+   if(oITable->ulFreeHead < oITable->ulSlotCount) {
+      ulIndex = oITable->ulFreeHead;
+      oITable->ulFreeHead = oITable->psSlots[ulIndex].ulNextFree;
+   }
+   else {
+      if(oITable->ulSlotCount == NODE_ID_INDEX_MASK)
+         return MEMORY_ERROR;
+      if(oITable->ulSlotCount == oITable->ulSlotCapacity) {
+         struct idSlot *psNewSlots;
+         size_t ulNewCapacity = 2 * oITable->ulSlotCapacity;
+
+         if(ulNewCapacity == 0)
+            ulNewCapacity = 64;
+         /* readers may be looking up identifiers in the old slots, so
+            they are copied rather than reallocated in place */
+         psNewSlots = malloc(ulNewCapacity * sizeof(struct idSlot));
+         if(psNewSlots == NULL)
+            return MEMORY_ERROR;
+         if(oITable->ulSlotCount != 0)
+            memcpy(psNewSlots, oITable->psSlots,
+                   oITable->ulSlotCount * sizeof(struct idSlot));
+         if(oITable->psSlots != NULL)
+            Epoch_retire(oITable->oEReclaim, oITable->psSlots, free);
+         __atomic_store_n(&oITable->psSlots, psNewSlots,
+                          __ATOMIC_RELEASE);
+         oITable->ulSlotCapacity = ulNewCapacity;
+      }
+      ulIndex = oITable->ulSlotCount;
+      oITable->psSlots[ulIndex].oNNode = NULL;
+      oITable->psSlots[ulIndex].ulGeneration = 1;
+      __atomic_store_n(&oITable->ulSlotCount, ulIndex + 1,
+                       __ATOMIC_RELEASE);
+      oITable->ulFreeHead = oITable->ulSlotCount;
+   }
+
+   oNNode->ulID = (oITable->psSlots[ulIndex].ulGeneration
+                   << NODE_ID_INDEX_BITS) | ulIndex;
+   __atomic_store_n(&oITable->psSlots[ulIndex].oNNode, oNNode,
+                    __ATOMIC_RELEASE);
+   return SUCCESS;
+}
+
+/* Node_assignIDLocked, acquiring oITable's lock for the call. */
+static int Node_assignID(Node_T oNNode, Node_IDTable_T oITable) {
+   int iStatus;
+
+   Node_lockTable(oITable);
+   iStatus = Node_assignIDLocked(oNNode, oITable);
+   Node_unlockTable(oITable);
+   return iStatus;
+}
+
+/*
+  Returns oNNode's slot to node ID table oITable, advancing the slot's
+  generation so that oNNode's identifier no longer validates. Must be
+  called with oITable's lock held.
+*/
+static void Node_releaseID(Node_T oNNode, Node_IDTable_T oITable) {
+   size_t ulIndex;
+   size_t ulGeneration;
+
+   assert(oNNode != NULL);
+   assert(oITable != NULL);
+
+   ulIndex = oNNode->ulID & NODE_ID_INDEX_MASK;
+   assert(ulIndex < oITable->ulSlotCount);
+   assert(oITable->psSlots[ulIndex].oNNode == oNNode);
+
+   /* generations wrap within their half of the identifier,
+      skipping 0, which would allow an identifier of 0. the generation
+      advances before the slot empties, so a reader that still finds
+      oNNode in the slot sees the new generation (see Node_fromID) */
+   ulGeneration = (oITable->psSlots[ulIndex].ulGeneration + 1)
+                  & NODE_ID_INDEX_MASK;
+   if(ulGeneration == 0)
+      ulGeneration = 1;
+   __atomic_store_n(&oITable->psSlots[ulIndex].ulGeneration,
+                    ulGeneration, __ATOMIC_RELEASE);
+   __atomic_store_n(&oITable->psSlots[ulIndex].oNNode, NULL,
+                    __ATOMIC_RELEASE);
+   oITable->psSlots[ulIndex].ulNextFree = oITable->ulFreeHead;
+   oITable->ulFreeHead = ulIndex;
+}
+
+Node_IDTable_T Node_newIDTable(Epoch_T oEReclaim) {
+   Node_IDTable_T oINew;
+
+   oINew = malloc(sizeof(struct nodeIDTable));
+   if(oINew == NULL)
+      return NULL;
+
+   oINew->psSlots = NULL;
+   oINew->ulSlotCount = 0;
+   oINew->ulSlotCapacity = 0;
+   oINew->ulFreeHead = 0;
+   oINew->oEReclaim = oEReclaim;
+#ifndef FT_NO_LOCKING
+   if(pthread_mutex_init(&oINew->sLock, NULL) != 0) {
+      free(oINew);
+      return NULL;
+   }
+#endif
+   return oINew;
+}
+
+void Node_freeIDTable(Node_IDTable_T oITable) {
+   if(oITable == NULL)
+      return;
+
+   free(oITable->psSlots);
+#ifndef FT_NO_LOCKING
+   (void) pthread_mutex_destroy(&oITable->sLock);
+#endif
+   free(oITable);
+}
+
 boolean Node_isFile(Node_T oNNode) {
     return oNNode->bIsFile;
 }
 
 void *Node_getContents(Node_T oNNode) {
-    return oNNode->pvContents;
+    return __atomic_load_n(&oNNode->pvContents, __ATOMIC_ACQUIRE);
 }
 
 size_t Node_getLength(Node_T oNNode) {
-    return oNNode->ulLength;
+    return __atomic_load_n(&oNNode->ulLength, __ATOMIC_RELAXED);
+}
+
+void *Node_readContents(Node_T oNNode, size_t *pulLength,
+                        void (**ppfFree)(void *pvContents)) {
+    struct nodeOwner *psOwner;
+    void *pvContents;
+    size_t ulEdits;
+
+    assert(oNNode != NULL);
+    assert(pulLength != NULL);
+    assert(ppfFree != NULL);
+
+    /* retry while an edit is in progress or overlapped the reads */
+    do {
+        ulEdits = __atomic_load_n(&oNNode->ulEdits, __ATOMIC_ACQUIRE);
+        psOwner = __atomic_load_n(&oNNode->psOwner, __ATOMIC_RELAXED);
+        *pulLength = __atomic_load_n(&oNNode->ulLength, __ATOMIC_RELAXED);
+        pvContents = __atomic_load_n(&oNNode->pvContents,
+                                     __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while((ulEdits & 1) != 0 ||
+            __atomic_load_n(&oNNode->ulEdits, __ATOMIC_RELAXED) != ulEdits);
+
+    /* an owner is reclaimed only once no reader can still reach it */
+    *ppfFree = psOwner == NULL ? NULL : psOwner->pfFree;
+    return pvContents;
+}
+
+boolean Node_hasOwner(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    return (boolean) (oNNode->psOwner != NULL);
+}
+
+void Node_markRead(Node_T oNNode, size_t ulNow) {
+    assert(oNNode != NULL);
+
+    /* readers store only when the flag is clear or the time is new,
+       so that a file read often is not written by every read; of
+       readers racing with different times, a later one may lose, and
+       the file only looks colder than it is */
+    if(!__atomic_load_n(&oNNode->bRead, __ATOMIC_RELAXED))
+        __atomic_store_n(&oNNode->bRead, TRUE, __ATOMIC_RELAXED);
+    if(__atomic_load_n(&oNNode->ulReadTime, __ATOMIC_RELAXED) < ulNow)
+        __atomic_store_n(&oNNode->ulReadTime, ulNow, __ATOMIC_RELAXED);
+}
+
+size_t Node_getReadTime(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    return __atomic_load_n(&oNNode->ulReadTime, __ATOMIC_RELAXED);
+}
+
+boolean Node_takeRead(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    return (boolean) __atomic_exchange_n(&oNNode->bRead, FALSE,
+                                         __ATOMIC_RELAXED);
 }
 
 boolean Node_childrenIsNull(Node_T oNNode) {
-    return (boolean) (oNNode->oDChildren == NULL);
+    return (boolean) (oNNode->psChildren == NULL);
+}
+
+void Node_getTotals(Node_T oNNode, size_t *pulFiles, size_t *pulDirs,
+                    size_t *pulBytes) {
+    assert(oNNode != NULL);
+    assert(pulFiles != NULL);
+    assert(pulDirs != NULL);
+    assert(pulBytes != NULL);
+
+    if(oNNode->bIsFile) {
+        *pulFiles = 1;
+        *pulDirs = 0;
+        *pulBytes = Node_getLength(oNNode);
+        return;
+    }
+    *pulFiles = __atomic_load_n(&oNNode->ulFiles, __ATOMIC_RELAXED);
+    *pulDirs = __atomic_load_n(&oNNode->ulDirs, __ATOMIC_RELAXED);
+    *pulBytes = __atomic_load_n(&oNNode->ulBytes, __ATOMIC_RELAXED);
+}
+
+/*
+  Adds ulFiles files, ulDirs directories and ulBytes bytes to the
+  totals of directory oNDir and of each of its ancestors if bAdd is
+  TRUE, or subtracts them if bAdd is FALSE. Writers in different
+  subtrees share their ancestors, so each total changes atomically.
+  Does nothing if oNDir is NULL.
+*/
+static void Node_addTotals(Node_T oNDir, size_t ulFiles, size_t ulDirs,
+                           size_t ulBytes, boolean bAdd) {
+    for(; oNDir != NULL; oNDir = oNDir->oNParent) {
+        assert(!oNDir->bIsFile);
+        if(bAdd) {
+            (void) __atomic_add_fetch(&oNDir->ulFiles, ulFiles,
+                                      __ATOMIC_RELAXED);
+            (void) __atomic_add_fetch(&oNDir->ulDirs, ulDirs,
+                                      __ATOMIC_RELAXED);
+            (void) __atomic_add_fetch(&oNDir->ulBytes, ulBytes,
+                                      __ATOMIC_RELAXED);
+        }
+        else {
+            (void) __atomic_sub_fetch(&oNDir->ulFiles, ulFiles,
+                                      __ATOMIC_RELAXED);
+            (void) __atomic_sub_fetch(&oNDir->ulDirs, ulDirs,
+                                      __ATOMIC_RELAXED);
+            (void) __atomic_sub_fetch(&oNDir->ulBytes, ulBytes,
+                                      __ATOMIC_RELAXED);
+        }
+    }
+}
+
+size_t Node_getMaxLength(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    if(oNNode->bIsFile)
+        return Node_getLength(oNNode);
+    return __atomic_load_n(&oNNode->ulMaxLength, __ATOMIC_RELAXED);
+}
+
+/*
+  Raises the bound on file lengths of directory oNDir and of each of
+  its ancestors to ulLength, where it is lower. Stops at the first
+  that is at least ulLength already: a bound is raised before its
+  parent's, so that the ancestors above it are too, or will be once
+  the writer raising it is done. Does nothing if oNDir is NULL.
+*/
+static void Node_raiseMaxLength(Node_T oNDir, size_t ulLength) {
+    size_t ulOld;
+
+    for(; oNDir != NULL; oNDir = oNDir->oNParent) {
+        assert(!oNDir->bIsFile);
+        ulOld = __atomic_load_n(&oNDir->ulMaxLength, __ATOMIC_RELAXED);
+        do {
+            if(ulOld >= ulLength)
+                return;
+        } while(!__atomic_compare_exchange_n(&oNDir->ulMaxLength, &ulOld,
+                                             ulLength, 0, __ATOMIC_RELAXED,
+                                             __ATOMIC_RELAXED));
+    }
+}
+
+/*
+  Adds the totals of the subtree rooted at oNNode to those of its
+  ancestors if bAdd is TRUE, as when it is linked below its parent, or
+  subtracts them if bAdd is FALSE, as when it is unlinked.
+*/
+static void Node_carryTotals(Node_T oNNode, boolean bAdd) {
+    size_t ulFiles, ulDirs, ulBytes;
+
+    assert(oNNode != NULL);
+
+    Node_getTotals(oNNode, &ulFiles, &ulDirs, &ulBytes);
+    Node_addTotals(oNNode->oNParent, ulFiles, ulDirs, ulBytes, bAdd);
+    if(bAdd)
+        Node_raiseMaxLength(oNNode->oNParent, Node_getMaxLength(oNNode));
+}
+
+Node_Owner_T Node_newOwner(void *pvContents,
+                           void (*pfFree)(void *pvContents)) {
+    struct nodeOwner *psNew;
+
+    assert(pfFree != NULL);
+
+    psNew = malloc(sizeof(struct nodeOwner));
+    if(psNew == NULL)
+        return NULL;
+    psNew->pvContents = pvContents;
+    psNew->pfFree = pfFree;
+    psNew->ulRefs = 1;
+    return psNew;
+}
+
+Node_Owner_T Node_newCopy(const void *pvContents, size_t ulLength,
+                          void **ppvCopy) {
+    union ownedCopy *puNew;
+
+    assert(pvContents != NULL);
+    assert(ppvCopy != NULL);
+
+    puNew = malloc(sizeof(union ownedCopy) + ulLength);
+    if(puNew == NULL)
+        return NULL;
+    *ppvCopy = puNew + 1;
+    memcpy(*ppvCopy, pvContents, ulLength);
+    puNew->sOwner.pvContents = *ppvCopy;
+    puNew->sOwner.pfFree = NULL;
+    puNew->sOwner.ulRefs = 1;
+    return &puNew->sOwner;
+}
+
+void Node_freeOwner(Node_Owner_T oOOwner) {
+    assert(oOOwner == NULL || oOOwner->ulRefs == 1);
+
+    free(oOOwner);
+}
+
+/*
+  Drops one hold on pvOwner, an owner whose holder no longer reaches
+  its contents. The last hold dropped frees the contents and pvOwner.
+*/
+static void Node_dropOwner(void *pvOwner) {
+    struct nodeOwner *psOwner = pvOwner;
+
+    assert(psOwner != NULL);
+
+    if(__atomic_sub_fetch(&psOwner->ulRefs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+    if(psOwner->pfFree != NULL)
+        (*psOwner->pfFree)(psOwner->pvContents);
+    free(psOwner);
+}
+
+void Node_releaseOwner(Node_Owner_T oOOwner, Node_IDTable_T oITable) {
+    assert(oITable != NULL);
+
+    /* readers may still hold the contents that they found before the
+       hold was given up, so they are freed only once they are done */
+    if(oOOwner != NULL)
+        Epoch_retire(oITable->oEReclaim, oOOwner, Node_dropOwner);
 }
 
 void *Node_editContents(Node_T oNNode, void *pvNewContents, 
-        size_t ulNewLength) {
+        size_t ulNewLength, Node_Owner_T *poOOwner) {
     void *pvOldContents;
+    struct nodeOwner *psOldOwner;
 
     assert(oNNode != NULL);
+    assert(poOOwner != NULL);
+    assert(*poOOwner == NULL || (*poOOwner)->pvContents == pvNewContents);
     assert(Node_isFile(oNNode));
     assert(CheckerFT_Node_isValid(oNNode));
 
     pvOldContents = oNNode->pvContents;
-    oNNode->pvContents = pvNewContents;
-    oNNode->ulLength = ulNewLength;
+    psOldOwner = oNNode->psOwner;
+    if(ulNewLength >= oNNode->ulLength) {
+        Node_addTotals(oNNode->oNParent, 0, 0,
+                       ulNewLength - oNNode->ulLength, TRUE);
+        Node_raiseMaxLength(oNNode->oNParent, ulNewLength);
+    }
+    else
+        Node_addTotals(oNNode->oNParent, 0, 0,
+                       oNNode->ulLength - ulNewLength, FALSE);
+    __atomic_store_n(&oNNode->ulEdits, oNNode->ulEdits + 1,
+                     __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&oNNode->psOwner, *poOOwner, __ATOMIC_RELAXED);
+    *poOOwner = psOldOwner;
+    __atomic_store_n(&oNNode->ulLength, ulNewLength, __ATOMIC_RELAXED);
+    __atomic_store_n(&oNNode->pvContents, pvNewContents,
+                     __ATOMIC_RELEASE);
+    __atomic_store_n(&oNNode->ulEdits, oNNode->ulEdits + 1,
+                     __ATOMIC_RELEASE);
     
     assert(CheckerFT_Node_isValid(oNNode));
     return pvOldContents;
 }
+/*
+  Compares the string representation of oNfirst with a string
+  pcSecond representing a node's path.
+  Returns <0, 0, or >0 if oNFirst is "less than", "equal to", or
+  "greater than" pcSecond, respectively.
+*/
+static int Node_compareString(const Node_T oNFirst,
+                                 const char *pcSecond) {
+   assert(oNFirst != NULL);
+   assert(pcSecond != NULL);
+
+   return Path_compareString(oNFirst->oPPath, pcSecond);
+}
+
+/*
+  Returns a new children array with room for ulCapacity children and
+  none published, or NULL if insufficient memory is available.
+*/
+static struct childArray *Node_newChildren(size_t ulCapacity) {
+   struct childArray *psNew;
+
+   psNew = malloc(sizeof(struct childArray)
+                  + ulCapacity * sizeof(Node_T));
+   if(psNew == NULL)
+      return NULL;
+
+   psNew->ulLength = 0;
+   psNew->ulCapacity = ulCapacity;
+   psNew->poNChildren = (Node_T *) (psNew + 1);
+   return psNew;
+}
+
+/* Returns the child at index ulIndex of psChildren. */
+static Node_T Node_loadChild(struct childArray *psChildren,
+                             size_t ulIndex) {
+   assert(psChildren != NULL);
+
+   return __atomic_load_n(&psChildren->poNChildren[ulIndex],
+                          __ATOMIC_ACQUIRE);
+}
+
+/* Stores oNChild at index ulIndex of psChildren. */
+static void Node_storeChild(struct childArray *psChildren,
+                            size_t ulIndex, Node_T oNChild) {
+   assert(psChildren != NULL);
+   assert(ulIndex < psChildren->ulCapacity);
+
+   __atomic_store_n(&psChildren->poNChildren[ulIndex], oNChild,
+                    __ATOMIC_RELEASE);
+}
+
+/*
+  Replaces oNParent's children array with psNew, retiring the old one
+  through oITable's reclamation domain.
+*/
+static void Node_publishChildren(Node_T oNParent,
+                                 struct childArray *psNew,
+                                 Node_IDTable_T oITable) {
+   struct childArray *psOld;
+
+   assert(oNParent != NULL);
+   assert(psNew != NULL);
+   assert(oITable != NULL);
+
+   psOld = oNParent->psChildren;
+   __atomic_store_n(&oNParent->psChildren, psNew, __ATOMIC_RELEASE);
+   Epoch_retire(oITable->oEReclaim, psOld, free);
+}
+
+/*
+  Searches the first ulLength children of psChildren for the one with
+  path pcPath. Returns TRUE and stores its index in *pulIndex if it is
+  found. Otherwise, returns FALSE and stores in *pulIndex the index at
+  which such a child would be inserted.
+*/
+static boolean Node_searchChildren(struct childArray *psChildren,
+                                   size_t ulLength, const char *pcPath,
+                                   size_t *pulIndex) {
+   size_t ulLow = 0;
+   size_t ulHigh = ulLength;
+
+   assert(psChildren != NULL);
+   assert(pcPath != NULL);
+   assert(pulIndex != NULL);
+
+   while(ulLow < ulHigh) {
+      size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+      int iCompare = Node_compareString(
+         Node_loadChild(psChildren, ulMid), pcPath);
+
+      if(iCompare == 0) {
+         *pulIndex = ulMid;
+         return TRUE;
+      }
+      if(iCompare < 0)
+         ulLow = ulMid + 1;
+      else
+         ulHigh = ulMid;
+   }
+   *pulIndex = ulLow;
+   return FALSE;
+}
+
 /*
   Links new child oNChild into oNParent's children array at index
-  ulIndex. Returns SUCCESS if the new child was added successfully,
-  or  MEMORY_ERROR if allocation fails adding oNChild to the array.
+  ulIndex, retiring any array it replaces through oITable's
+  reclamation domain. Returns SUCCESS if the new child was added
+  successfully, or MEMORY_ERROR if allocation fails adding oNChild to
+  the array.
 */
 static int Node_addChild(Node_T oNParent, Node_T oNChild,
-                         size_t ulIndex) {
+                         size_t ulIndex, Node_IDTable_T oITable) {
+   struct childArray *psChildren;
+   struct childArray *psNew;
+   size_t ulLength, ulCapacity;
+
    assert(oNParent != NULL);
    assert(!oNParent->bIsFile);
    assert(oNChild != NULL);
 
-   if(DynArray_addAt(oNParent->oDChildren, ulIndex, oNChild))
+   psChildren = oNParent->psChildren;
+   ulLength = psChildren->ulLength;
+   assert(ulIndex <= ulLength);
+
+   /* append in place, publishing the child only once it is stored */
+   if(ulIndex == ulLength && ulLength < psChildren->ulCapacity) {
+      Node_storeChild(psChildren, ulIndex, oNChild);
+      __atomic_store_n(&psChildren->ulLength, ulLength + 1,
+                       __ATOMIC_RELEASE);
       return SUCCESS;
-   else
+   }
+
+   ulCapacity = psChildren->ulCapacity;
+   if(ulLength == ulCapacity)
+      ulCapacity = ulLength < MIN_CHILDREN ? MIN_CHILDREN : 2 * ulLength;
+   psNew = Node_newChildren(ulCapacity);
+   if(psNew == NULL)
       return MEMORY_ERROR;
+
+   memcpy(psNew->poNChildren, psChildren->poNChildren,
+          ulIndex * sizeof(Node_T));
+   psNew->poNChildren[ulIndex] = oNChild;
+   memcpy(psNew->poNChildren + ulIndex + 1,
+          psChildren->poNChildren + ulIndex,
+          (ulLength - ulIndex) * sizeof(Node_T));
+   psNew->ulLength = ulLength + 1;
+
+   Node_publishChildren(oNParent, psNew, oITable);
+   return SUCCESS;
 }
 
 /*
-  Compares the string representation of oNfirst with a string
-  pcSecond representing a node's path.
-  Returns <0, 0, or >0 if oNFirst is "less than", "equal to", or
-  "greater than" pcSecond, respectively.
+  Unlinks the child at index ulIndex from oNParent's children array,
+  retiring the array it replaces through oITable's reclamation
+  domain. If no memory is available for a new array, closes the gap
+  in place instead, so that a concurrent reader may briefly miss one
+  of oNChild's siblings.
 */
-static int Node_compareString(const Node_T oNFirst,
-                                 const char *pcSecond) {
-   assert(oNFirst != NULL);
-   assert(pcSecond != NULL);
+static void Node_removeChild(Node_T oNParent, size_t ulIndex,
+                             Node_IDTable_T oITable) {
+   struct childArray *psChildren;
+   struct childArray *psNew;
+   size_t ulLength, i;
 
-   return Path_compareString(oNFirst->oPPath, pcSecond);
+   assert(oNParent != NULL);
+   assert(!oNParent->bIsFile);
+
+   psChildren = oNParent->psChildren;
+   ulLength = psChildren->ulLength;
+   assert(ulIndex < ulLength);
+
+   psNew = Node_newChildren(psChildren->ulCapacity);
+   if(psNew == NULL) {
+      for(i = ulIndex; i + 1 < ulLength; i++)
+         Node_storeChild(psChildren, i, psChildren->poNChildren[i + 1]);
+      __atomic_store_n(&psChildren->ulLength, ulLength - 1,
+                       __ATOMIC_RELEASE);
+      return;
+   }
+
+   memcpy(psNew->poNChildren, psChildren->poNChildren,
+          ulIndex * sizeof(Node_T));
+   memcpy(psNew->poNChildren + ulIndex,
+          psChildren->poNChildren + ulIndex + 1,
+          (ulLength - ulIndex - 1) * sizeof(Node_T));
+   psNew->ulLength = ulLength - 1;
+
+   Node_publishChildren(oNParent, psNew, oITable);
 }
 
-int Node_new(Path_T oPPath, Node_T oNParent, Node_T *poNResult, 
-    boolean bIsFile, void *pvContents, size_t ulLength) {
+/*
+  Releases the identifiers of every node in the subtree rooted at
+  oNNode back to node ID table oITable, whose lock must be held.
+  Returns the number of nodes in the subtree.
+*/
+static size_t Node_releaseSubtree(Node_T oNNode, Node_IDTable_T oITable) {
+   size_t ulCount = 1;
+   size_t i;
+
+   assert(oNNode != NULL);
+   assert(oITable != NULL);
+
+   if(oNNode->psChildren != NULL)
+      for(i = 0; i < oNNode->psChildren->ulLength; i++)
+         ulCount += Node_releaseSubtree(
+            oNNode->psChildren->poNChildren[i], oITable);
+   Node_releaseID(oNNode, oITable);
+   return ulCount;
+}
+
+/*
+  Frees oNNode, a node whose path, children array and (for a
+  directory) lock are all initialized, but not its children.
+*/
+static void Node_destroy(Node_T oNNode) {
+   assert(oNNode != NULL);
+
+   if(oNNode->psChildren != NULL) {
+      free(oNNode->psChildren);
+#ifndef FT_NO_LOCKING
+      (void) pthread_mutex_destroy(&((struct dirNode *) oNNode)->sLock);
+#endif
+   }
+   if(oNNode->psOwner != NULL)
+      Node_dropOwner(oNNode->psOwner);
+   Path_free(oNNode->oPPath);
+   free(oNNode);
+}
+
+/*
+  Drops one reference to pvNode, a node that its referrer unlinked
+  before the grace period that has just elapsed. Once no reference
+  remains, frees it and drops its references to its children in turn:
+  every referrer of a node has then been unlinked for a full grace
+  period, so no reader can still reach it.
+*/
+static void Node_dropRef(void *pvNode) {
+   Node_T oNNode = pvNode;
+   size_t i;
+
+   assert(oNNode != NULL);
+
+   if(__atomic_sub_fetch(&oNNode->ulRefs, 1, __ATOMIC_ACQ_REL) != 0)
+      return;
+   if(oNNode->psChildren != NULL)
+      for(i = 0; i < oNNode->psChildren->ulLength; i++)
+         Node_dropRef(oNNode->psChildren->poNChildren[i]);
+   Node_destroy(oNNode);
+}
+
+int Node_new(Path_T oPPath, Node_T oNParent, Node_IDTable_T oITable,
+    Node_T *poNResult, boolean bIsFile, void *pvContents,
+    size_t ulLength, Node_Owner_T oOOwner) {
     struct node *psNew;
     Path_T oPParentPath = NULL;
     Path_T oPNewPath = NULL;
@@ -99,11 +839,19 @@ int Node_new(Path_T oPPath, Node_T oNParent, Node_T *poNResult,
     int iStatus;
 
     assert(oPPath != NULL);
+    assert(oITable != NULL);
     assert(oNParent == NULL || CheckerFT_Node_isValid(oNParent));
     if (oNParent != NULL) assert(!oNParent->bIsFile);
+    assert(oOOwner == NULL ||
+           (bIsFile && oOOwner->pvContents == pvContents));
 
-    /* allocate space for a new node */
-    psNew = malloc(sizeof(struct node));
+    /* allocate space for a new node, and for a directory's lock */
+#ifndef FT_NO_LOCKING
+    if(!bIsFile)
+        psNew = malloc(sizeof(struct dirNode));
+    else
+#endif
+        psNew = malloc(sizeof(struct node));
     if(psNew == NULL) {
         *poNResult = NULL;
         return MEMORY_ERROR;
@@ -142,8 +890,15 @@ int Node_new(Path_T oPPath, Node_T oNParent, Node_T *poNResult,
             return NO_SUCH_PATH;
         }
 
-        /* parent must not already have child with this path */
-        if(Node_hasChild(oNParent, oPPath, &ulIndex)) {
+        /* parent must not already have child with this path.
+           a child that sorts after all existing children is
+           appended without searching, so children inserted in
+           sorted order cost O(1) each */
+        ulIndex = oNParent->psChildren->ulLength;
+        if(ulIndex != 0 &&
+           Node_compare(oNParent->psChildren->poNChildren[ulIndex-1],
+                        psNew) >= 0 &&
+           Node_hasChild(oNParent, oPPath, &ulIndex)) {
             Path_free(psNew->oPPath);
             free(psNew);
             *poNResult = NULL;
@@ -164,33 +919,67 @@ int Node_new(Path_T oPPath, Node_T oNParent, Node_T *poNResult,
 
     /* initialize the new node */
     psNew->bIsFile = bIsFile;
+    psNew->ulRefs = 1;
+    psNew->psOwner = NULL;
+    psNew->ulEdits = 0;
+    psNew->bRead = FALSE;
+    psNew->ulReadTime = 0;
+    psNew->ulFiles = 0;
+    psNew->ulDirs = bIsFile ? 0 : 1;
+    psNew->ulBytes = 0;
+    psNew->ulMaxLength = 0;
     if (bIsFile) {
-        psNew->oDChildren = NULL;
+        psNew->psChildren = NULL;
         psNew->pvContents = pvContents;
         psNew->ulLength = ulLength;
     }
     else {
-        psNew->oDChildren = DynArray_new(0);
+        psNew->psChildren = Node_newChildren(MIN_CHILDREN);
         psNew->pvContents = NULL;
         psNew->ulLength = 0;
 
-        if(psNew->oDChildren == NULL) {
+        if(psNew->psChildren == NULL) {
             Path_free(psNew->oPPath);
             free(psNew);
             *poNResult = NULL;
             return MEMORY_ERROR;
         }
+#ifndef FT_NO_LOCKING
+        if(pthread_mutex_init(&((struct dirNode *) psNew)->sLock,
+                              NULL) != 0) {
+            free(psNew->psChildren);
+            Path_free(psNew->oPPath);
+            free(psNew);
+            *poNResult = NULL;
+            return MEMORY_ERROR;
+        }
+#endif
     }
 
-    /* Link into parent's children list */
+    /* Make the new node reachable by identifier */
+    iStatus = Node_assignID(psNew, oITable);
+    if(iStatus != SUCCESS) {
+        Node_destroy(psNew);
+        *poNResult = NULL;
+        return iStatus;
+    }
+
+    /* Link into parent's children list, which publishes the new node
+       to concurrent readers, with its owner already set so that they
+       never see its contents without it */
+    psNew->psOwner = oOOwner;
     if(oNParent != NULL) {
-        iStatus = Node_addChild(oNParent, psNew, ulIndex);
+        iStatus = Node_addChild(oNParent, psNew, ulIndex, oITable);
         if(iStatus != SUCCESS) {
-            Path_free(psNew->oPPath);
-            free(psNew);
+            psNew->psOwner = NULL;
+            Node_lockTable(oITable);
+            Node_releaseID(psNew, oITable);
+            Node_unlockTable(oITable);
+            Node_destroy(psNew);
             *poNResult = NULL;
             return iStatus;
         }
+        Node_carryTotals(psNew, TRUE);
     }
 
     *poNResult = psNew;
@@ -201,41 +990,295 @@ int Node_new(Path_T oPPath, Node_T oNParent, Node_T *poNResult,
     return SUCCESS;
 }
 
-size_t Node_free(Node_T oNNode) {
+/*
+  Unlinks oNNode from its parent's children array, if it has a parent,
+  retiring the array replaced through oITable's reclamation domain.
+*/
+static void Node_unlinkFromParent(Node_T oNNode, Node_IDTable_T oITable) {
     size_t ulIndex;
-    size_t ulCount = 0;
 
     assert(oNNode != NULL);
+    assert(oITable != NULL);
+
+    if(oNNode->oNParent != NULL) {
+        Node_T oNParent = oNNode->oNParent;
+
+        if(Node_searchChildren(oNParent->psChildren,
+                               oNParent->psChildren->ulLength,
+                               Path_getPathname(oNNode->oPPath),
+                               &ulIndex)) {
+            Node_removeChild(oNParent, ulIndex, oITable);
+            Node_carryTotals(oNNode, FALSE);
+        }
+    }
+}
+
+size_t Node_free(Node_T oNNode, Node_IDTable_T oITable) {
+    assert(oNNode != NULL);
+    assert(oITable != NULL);
     assert(CheckerFT_Node_isValid(oNNode));
 
-    /* remove from parent's list */
+    Node_unlinkFromParent(oNNode, oITable);
+    return Node_discard(oNNode, NULL, oITable);
+}
+
+int Node_unlink(Node_T oNNode, Node_IDTable_T oITable, void **ppvSpare) {
+    struct childArray *psSpare = NULL;
+
+    assert(oNNode != NULL);
+    assert(oITable != NULL);
+    assert(ppvSpare != NULL);
+    assert(CheckerFT_Node_isValid(oNNode));
+
+    /* relinking puts the parent's children back as they are now, so
+       an array of their current number is all it needs */
     if(oNNode->oNParent != NULL) {
-        if(DynArray_bsearch(
-            oNNode->oNParent->oDChildren,
-            oNNode, &ulIndex,
-            (int (*)(const void *, const void *)) Node_compare)
-        )
-            (void) DynArray_removeAt(oNNode->oNParent->oDChildren,
-                                    ulIndex);
+        psSpare = Node_newChildren(oNNode->oNParent->psChildren->ulLength);
+        if(psSpare == NULL)
+            return MEMORY_ERROR;
     }
 
-    if (oNNode->oDChildren) {
-        /* recursively remove children */
-        while(DynArray_getLength(oNNode->oDChildren) != 0) {
-            ulCount += Node_free(DynArray_get(oNNode->oDChildren, 0));
-        }
-        DynArray_free(oNNode->oDChildren);
+    Node_unlinkFromParent(oNNode, oITable);
+    *ppvSpare = psSpare;
+    return SUCCESS;
+}
+
+void Node_relink(Node_T oNNode, void *pvSpare, Node_IDTable_T oITable) {
+    struct childArray *psSpare = pvSpare;
+    struct childArray *psChildren;
+    Node_T oNParent;
+    size_t ulIndex;
+    boolean bFound;
+
+    assert(oNNode != NULL);
+    assert(oITable != NULL);
+
+    oNParent = oNNode->oNParent;
+    if(oNParent == NULL) {
+        assert(psSpare == NULL);
+        return;
     }
-    
-    /* remove path */
-    Path_free(oNNode->oPPath);
+    assert(psSpare != NULL);
+
+    psChildren = oNParent->psChildren;
+    assert(psChildren->ulLength < psSpare->ulCapacity);
+    bFound = Node_searchChildren(psChildren, psChildren->ulLength,
+                                 Path_getPathname(oNNode->oPPath),
+                                 &ulIndex);
+    assert(!bFound);
+    (void) bFound;
+
+    memcpy(psSpare->poNChildren, psChildren->poNChildren,
+           ulIndex * sizeof(Node_T));
+    psSpare->poNChildren[ulIndex] = oNNode;
+    memcpy(psSpare->poNChildren + ulIndex + 1,
+           psChildren->poNChildren + ulIndex,
+           (psChildren->ulLength - ulIndex) * sizeof(Node_T));
+    psSpare->ulLength = psChildren->ulLength + 1;
+    Node_publishChildren(oNParent, psSpare, oITable);
+    Node_carryTotals(oNNode, TRUE);
+}
 
-    /* finally, free the struct node */
-    free(oNNode);
-    ulCount++;
+size_t Node_discard(Node_T oNNode, void *pvSpare, Node_IDTable_T oITable) {
+    size_t ulCount;
+
+    assert(oNNode != NULL);
+    assert(oITable != NULL);
+
+    free(pvSpare);
+
+    /* the subtree is now unreachable from its parent, so its
+       identifiers can be reissued at once, but concurrent readers may
+       still be inside it, so the memory is freed only once they are
+       done with it */
+    Node_lockTable(oITable);
+    ulCount = Node_releaseSubtree(oNNode, oITable);
+    Node_unlockTable(oITable);
+    Node_release(oNNode, oITable);
     return ulCount;
 }
 
+boolean Node_isShared(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    return (boolean) (__atomic_load_n(&oNNode->ulRefs, __ATOMIC_ACQUIRE)
+                      > 1);
+}
+
+void Node_retain(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    (void) __atomic_add_fetch(&oNNode->ulRefs, 1, __ATOMIC_RELAXED);
+}
+
+void Node_release(Node_T oNNode, Node_IDTable_T oITable) {
+    assert(oNNode != NULL);
+    assert(oITable != NULL);
+
+    /* the reference is dropped only once readers that found the node
+       through it are done, so a node is never freed under a reader */
+    Epoch_retire(oITable->oEReclaim, oNNode, Node_dropRef);
+}
+
+int Node_copy(Node_T oNNode, Node_IDTable_T oITable, Node_T *poNResult) {
+    struct node *psNew;
+    size_t ulIndex;
+    size_t i;
+    int iStatus;
+
+    assert(oNNode != NULL);
+    assert(oITable != NULL);
+    assert(poNResult != NULL);
+    assert(CheckerFT_Node_isValid(oNNode));
+
+    *poNResult = NULL;
+
+#ifndef FT_NO_LOCKING
+    if(!oNNode->bIsFile)
+        psNew = malloc(sizeof(struct dirNode));
+    else
+#endif
+        psNew = malloc(sizeof(struct node));
+    if(psNew == NULL)
+        return MEMORY_ERROR;
+
+    iStatus = Path_dup(oNNode->oPPath, &psNew->oPPath);
+    if(iStatus != SUCCESS) {
+        free(psNew);
+        return iStatus;
+    }
+    psNew->bIsFile = oNNode->bIsFile;
+    psNew->oNParent = oNNode->oNParent;
+    psNew->pvContents = oNNode->pvContents;
+    psNew->ulLength = oNNode->ulLength;
+    psNew->psOwner = NULL;
+    psNew->ulEdits = 0;
+    psNew->bRead = FALSE;
+    psNew->ulReadTime = Node_getReadTime(oNNode);
+    Node_getTotals(oNNode, &psNew->ulFiles, &psNew->ulDirs,
+                   &psNew->ulBytes);
+    psNew->ulMaxLength = Node_getMaxLength(oNNode);
+    psNew->ulID = oNNode->ulID;
+    psNew->ulRefs = 1;
+    psNew->psChildren = NULL;
+
+    if(!oNNode->bIsFile) {
+        size_t ulLength = oNNode->psChildren->ulLength;
+
+        psNew->psChildren = Node_newChildren(
+            ulLength < MIN_CHILDREN ? MIN_CHILDREN : ulLength);
+        if(psNew->psChildren == NULL) {
+            Path_free(psNew->oPPath);
+            free(psNew);
+            return MEMORY_ERROR;
+        }
+#ifndef FT_NO_LOCKING
+        if(pthread_mutex_init(&((struct dirNode *) psNew)->sLock,
+                              NULL) != 0) {
+            free(psNew->psChildren);
+            Path_free(psNew->oPPath);
+            free(psNew);
+            return MEMORY_ERROR;
+        }
+#endif
+        /* the children are now shared by both copies. no writer is
+           inside the subtree, and readers never follow parent
+           pointers, so the children can be moved to the new copy */
+        memcpy(psNew->psChildren->poNChildren,
+               oNNode->psChildren->poNChildren,
+               ulLength * sizeof(Node_T));
+        psNew->psChildren->ulLength = ulLength;
+        for(i = 0; i < ulLength; i++) {
+            Node_retain(psNew->psChildren->poNChildren[i]);
+            psNew->psChildren->poNChildren[i]->oNParent = psNew;
+        }
+    }
+
+    /* the copy holds the owner of the contents it shares too, so
+       that they outlive whichever of the two drops them first */
+    if(oNNode->psOwner != NULL) {
+        (void) __atomic_add_fetch(&oNNode->psOwner->ulRefs, 1,
+                                  __ATOMIC_RELAXED);
+        psNew->psOwner = oNNode->psOwner;
+    }
+
+    /* the copy takes over the node's identifier and its place in its
+       parent, which are published to readers in single stores */
+    Node_lockTable(oITable);
+    __atomic_store_n(&oITable->psSlots[oNNode->ulID & NODE_ID_INDEX_MASK]
+                         .oNNode, psNew, __ATOMIC_RELEASE);
+    Node_unlockTable(oITable);
+    if(oNNode->oNParent != NULL) {
+        struct childArray *psSiblings = oNNode->oNParent->psChildren;
+
+        if(Node_searchChildren(psSiblings, psSiblings->ulLength,
+                               Path_getPathname(oNNode->oPPath),
+                               &ulIndex))
+            Node_storeChild(psSiblings, ulIndex, psNew);
+    }
+    Node_release(oNNode, oITable);
+
+    *poNResult = psNew;
+
+    assert(CheckerFT_Node_isValid(*poNResult));
+    return SUCCESS;
+}
+
+size_t Node_getID(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    return oNNode->ulID;
+}
+
+Node_T Node_fromID(Node_IDTable_T oITable, size_t ulID) {
+    size_t ulIndex = ulID & NODE_ID_INDEX_MASK;
+    struct idSlot *psSlots;
+    Node_T oNFound;
+
+    assert(oITable != NULL);
+
+    /* the count is read before the slots, so that the slots read are
+       at least as new as the count */
+    if(ulIndex >= __atomic_load_n(&oITable->ulSlotCount,
+                                  __ATOMIC_ACQUIRE))
+        return NULL;
+    psSlots = __atomic_load_n(&oITable->psSlots, __ATOMIC_ACQUIRE);
+
+    /* the node is read before the generation: a slot's generation
+       advances before its node is released, and a new node is stored
+       only after that, so a stale or reissued slot fails the check */
+    oNFound = __atomic_load_n(&psSlots[ulIndex].oNNode, __ATOMIC_ACQUIRE);
+    if(oNFound == NULL)
+        return NULL;
+    if(__atomic_load_n(&psSlots[ulIndex].ulGeneration, __ATOMIC_ACQUIRE)
+       != ulID >> NODE_ID_INDEX_BITS)
+        return NULL;
+
+    return oNFound;
+}
+
+void Node_lock(Node_T oNDir) {
+    assert(oNDir != NULL);
+    assert(!oNDir->bIsFile);
+
+#ifndef FT_NO_LOCKING
+    (void) pthread_mutex_lock(&((struct dirNode *) oNDir)->sLock);
+#else
+    (void) oNDir;
+#endif
+}
+
+void Node_unlock(Node_T oNDir) {
+    assert(oNDir != NULL);
+    assert(!oNDir->bIsFile);
+
+#ifndef FT_NO_LOCKING
+    (void) pthread_mutex_unlock(&((struct dirNode *) oNDir)->sLock);
+#else
+    (void) oNDir;
+#endif
+}
+
 Path_T Node_getPath(Node_T oNNode) {
     assert(oNNode != NULL);
 
@@ -249,17 +1292,76 @@ boolean Node_hasChild(Node_T oNParent, Path_T oPPath,
     assert(pulChildID != NULL);
     assert(!oNParent->bIsFile);
 
-    /* *pulChildID is the index into oNParent->oDChildren */
-    return DynArray_bsearch(oNParent->oDChildren,
-            (char*) Path_getPathname(oPPath), pulChildID,
-            (int (*)(const void*,const void*)) Node_compareString);
+    /* *pulChildID is the index into oNParent->psChildren */
+    return Node_searchChildren(oNParent->psChildren,
+                               oNParent->psChildren->ulLength,
+                               Path_getPathname(oPPath), pulChildID);
+}
+
+boolean Node_findChild(Node_T oNParent, Path_T oPPath,
+                       Node_T *poNResult) {
+    struct childArray *psChildren;
+    size_t ulLength;
+    size_t ulIndex;
+
+    assert(oNParent != NULL);
+    assert(oPPath != NULL);
+    assert(poNResult != NULL);
+    assert(!oNParent->bIsFile);
+
+    /* search one snapshot of the children, however a writer may
+       change them meanwhile */
+    psChildren = __atomic_load_n(&oNParent->psChildren, __ATOMIC_ACQUIRE);
+    ulLength = __atomic_load_n(&psChildren->ulLength, __ATOMIC_ACQUIRE);
+    if(!Node_searchChildren(psChildren, ulLength,
+                            Path_getPathname(oPPath), &ulIndex)) {
+        *poNResult = NULL;
+        return FALSE;
+    }
+
+    *poNResult = Node_loadChild(psChildren, ulIndex);
+    return TRUE;
+}
+
+int Node_reserveChildren(Node_T oNParent, size_t ulCapacity,
+                         Node_IDTable_T oITable) {
+    struct childArray *psNew;
+    size_t ulLength;
+
+    assert(oNParent != NULL);
+    assert(!oNParent->bIsFile);
+    assert(oITable != NULL);
+
+    ulLength = oNParent->psChildren->ulLength;
+    assert(ulCapacity >= ulLength);
+    if(ulCapacity == oNParent->psChildren->ulCapacity)
+        return SUCCESS;
+    psNew = Node_newChildren(ulCapacity);
+    if(psNew == NULL)
+        return MEMORY_ERROR;
+
+    memcpy(psNew->poNChildren, oNParent->psChildren->poNChildren,
+           ulLength * sizeof(Node_T));
+    psNew->ulLength = ulLength;
+    Node_publishChildren(oNParent, psNew, oITable);
+
+    return SUCCESS;
+}
+
+int Node_fitChildren(Node_T oNParent, Node_IDTable_T oITable) {
+    assert(oNParent != NULL);
+    assert(!oNParent->bIsFile);
+
+    return Node_reserveChildren(oNParent,
+                                oNParent->psChildren->ulLength, oITable);
 }
 
 size_t Node_getNumChildren(Node_T oNParent) {
     assert(oNParent != NULL);
     if (oNParent->bIsFile) return 0;
 
-    return DynArray_getLength(oNParent->oDChildren);
+    return __atomic_load_n(&oNParent->psChildren->ulLength,
+                           __ATOMIC_ACQUIRE);
 }
 
 int  Node_getChild(Node_T oNParent, size_t ulChildID,
@@ -268,13 +1370,13 @@ int  Node_getChild(Node_T oNParent, size_t ulChildID,
     assert(poNResult != NULL);
     assert(!oNParent->bIsFile);
 
-    /* ulChildID is the index into oNParent->oDChildren */
+    /* ulChildID is the index into oNParent->psChildren */
     if(ulChildID >= Node_getNumChildren(oNParent)) {
         *poNResult = NULL;
         return NO_SUCH_PATH;
     }
     else {
-        *poNResult = DynArray_get(oNParent->oDChildren, ulChildID);
+        *poNResult = Node_loadChild(oNParent->psChildren, ulChildID);
         return SUCCESS;
     }
 }
@@ -9,11 +9,50 @@
 #include <stddef.h>
 #include "a4def.h"
 #include "path.h"
+#include "epoch.h"
 
 
 /* A Node_T is a node in a File Tree. */
 typedef struct node *Node_T;
 
+/*
+  A Node_IDTable_T maps the identifiers of the nodes of one File Tree
+  to those nodes. Each File Tree has its own table, so identifiers
+  are meaningful only within the tree whose nodes they were issued to.
+
+  The table also carries the tree's reclamation domain. Nodes are
+  read without locks, so every node and children array that a change
+  to the tree unlinks is retired through that domain rather than
+  freed, and freed only once no reader can still hold it. Node_getPath,
+  Node_isFile, Node_getContents, Node_getLength, Node_getID,
+  Node_findChild and Node_fromID may run inside a read-side critical
+  section concurrently with changes to the tree.
+
+  Changes to different directories may run concurrently: a writer
+  that adds children to a directory, removes them, or edits the
+  contents of its files must hold that directory's lock (see
+  Node_lock), and the table serializes its own updates.
+
+  Nodes are reference counted, so that snapshots of a tree can share
+  its nodes (see Node_retain). A writer must change only nodes that
+  no snapshot shares, taking over shared ones with Node_copy on its
+  way down from the root.
+*/
+typedef struct nodeIDTable *Node_IDTable_T;
+
+/*
+  Returns a new, empty node ID table whose nodes are reclaimed through
+  domain oEReclaim (or freed at once, if oEReclaim is NULL), or NULL if
+  insufficient memory is available.
+*/
+Node_IDTable_T Node_newIDTable(Epoch_T oEReclaim);
+
+/*
+  Frees oITable. Any nodes still registered in it must not be used
+  with it afterwards.
+*/
+void Node_freeIDTable(Node_IDTable_T oITable);
+
 /* Returns TRUE if oNNode is a file and FALSE if it is a directory */
 boolean Node_isFile(Node_T oNNode);
 
@@ -23,20 +62,123 @@ void *Node_getContents(Node_T oNNode);
 /* Returns the length of oNNode's contents or 0 if it has none. */
 size_t Node_getLength(Node_T oNNode);
 
+/*
+  Returns the contents of oNNode as Node_getContents does, and sets
+  *pulLength to their length and *ppfFree to the function with which
+  their owner frees them, or to NULL if they have none or are a copy
+  made by Node_newCopy, all read as of one moment, even while a
+  writer edits them. Must be called inside a read-side critical
+  section on oNNode's node ID table's domain, or by a writer.
+*/
+void *Node_readContents(Node_T oNNode, size_t *pulLength,
+                        void (**ppfFree)(void *pvContents));
+
+/*
+  Returns TRUE if oNNode's contents have an owner, and FALSE if they
+  are the client's. Must be called by a writer.
+*/
+boolean Node_hasOwner(Node_T oNNode);
+
+/*
+  Records that oNNode's contents have been read at time ulNow, a
+  count that the caller advances as it sees fit. May be called by
+  readers and writers alike.
+*/
+void Node_markRead(Node_T oNNode, size_t ulNow);
+
+/*
+  Returns the latest time at which oNNode's contents have been read
+  (see Node_markRead), or 0 if they never have been.
+*/
+size_t Node_getReadTime(Node_T oNNode);
+
+/*
+  Returns TRUE if oNNode's contents have been read (see Node_markRead)
+  since the last call for it, and FALSE if not.
+*/
+boolean Node_takeRead(Node_T oNNode);
+
 /* returns TRUE if oNNode's children DynArray_T is NULL 
 and FALSE otherwise */
 boolean Node_childrenIsNull(Node_T oNNode);
 
+/*
+  Sets *pulFiles and *pulDirs to the numbers of files and of
+  directories in the subtree rooted at oNNode, oNNode included, and
+  *pulBytes to the total length of the files' contents. A directory
+  keeps its totals as each change below it is made, so they are found
+  in constant time, whatever the size of the subtree. Totals read
+  while writers change the subtree may reflect any state they pass
+  through, each independently of the others.
+*/
+void Node_getTotals(Node_T oNNode, size_t *pulFiles, size_t *pulDirs,
+                    size_t *pulBytes);
+
+/*
+  Returns the length of oNNode's contents, if it is a file, or, if it
+  is a directory, a bound on the length of every file in the subtree
+  rooted at it: at least the largest, but perhaps more, since a bound
+  is raised as files grow and left as it is when they shrink or go.
+*/
+size_t Node_getMaxLength(Node_T oNNode);
+
+/*
+  A Node_Owner_T owns contents on behalf of the nodes that hold them,
+  and frees them once the last hold on it is dropped. Copies of a
+  node (see Node_copy) share their original's owner, so that contents
+  a snapshot still shares outlive their replacement or removal in the
+  tree. Contents with no owner are the client's.
+*/
+typedef struct nodeOwner *Node_Owner_T;
+
+/*
+  Returns a new owner of pvContents, held once by its caller, that
+  frees them by calling (*pfFree)(pvContents), or NULL if
+  insufficient memory is available.
+*/
+Node_Owner_T Node_newOwner(void *pvContents,
+                           void (*pfFree)(void *pvContents));
+
+/*
+  Returns a new owner of a copy of the ulLength bytes at pvContents,
+  allocated with the owner in a single block and freed with it, held
+  once by its caller, and sets *ppvCopy to the copy. Returns NULL if
+  insufficient memory is available.
+*/
+Node_Owner_T Node_newCopy(const void *pvContents, size_t ulLength,
+                          void **ppvCopy);
+
+/*
+  Frees oOOwner, held only by its caller, for contents that were
+  never given to a node after all: frees a copy that Node_newCopy
+  made, but not other contents. Does nothing if oOOwner is NULL.
+*/
+void Node_freeOwner(Node_Owner_T oOOwner);
+
+/*
+  Drops the caller's hold on oOOwner once no reader in node ID table
+  oITable's reclamation domain can still reach its contents. The last
+  hold dropped frees the contents and oOOwner. Does nothing if oOOwner
+  is NULL.
+*/
+void Node_releaseOwner(Node_Owner_T oOOwner, Node_IDTable_T oITable);
+
 /* Replaces oNNode's contents with pvNewContents and content length with
-ulNewLength, returning the old contents. */
+ulNewLength, returning the old contents. oNNode takes over the
+caller's hold on *poOOwner, the owner of pvNewContents or NULL, and
+*poOOwner is set to oNNode's hold on the owner of the old contents,
+or NULL if they had none. */
 void *Node_editContents(Node_T oNNode, void *pvNewContents, 
-  size_t ulNewLength);
+  size_t ulNewLength, Node_Owner_T *poOOwner);
 
 /*
   Creates a new node in the Directory Tree, with path oPPath,
   parent oNParent, file boolean bIsFile, contents pvContents, and
-  size of contents ulLength. Sets oDChildren to NULL if bIsFile,
+  size of contents ulLength, and registers it in node ID table
+  oITable. Sets oDChildren to NULL if bIsFile,
   and sets pvContents/ulLength fields to NULL if !bIsFile.
+  The new node takes over the caller's hold on oOOwner, the owner of
+  pvContents, or NULL if they are the client's, only if it is made.
   Returns an int SUCCESS status and sets *poNResult to be the new 
   node if successful. Otherwise, sets *poNResult to NULL and returns 
   status:
@@ -47,15 +189,107 @@ void *Node_editContents(Node_T oNNode, void *pvNewContents,
                  or oNParent is NULL but oPPath is not of depth 1
   * ALREADY_IN_TREE if oNParent already has a child with this path
 */
-int Node_new(Path_T oPPath, Node_T oNParent, Node_T *poNResult, 
-    boolean bIsFile, void *pvContents, size_t ulLength);
+int Node_new(Path_T oPPath, Node_T oNParent, Node_IDTable_T oITable,
+    Node_T *poNResult, boolean bIsFile, void *pvContents,
+    size_t ulLength, Node_Owner_T oOOwner);
+
+/*
+  Destroys the subtree rooted at oNNode, i.e., deletes oNNode and all
+  its descendents: unlinks oNNode from its parent and releases the
+  identifiers in node ID table oITable at once, and drops the
+  parent's reference to oNNode with Node_release, so that the subtree
+  is freed once neither readers nor snapshots can reach it.
+  Returns the number of nodes deleted.
+*/
+size_t Node_free(Node_T oNNode, Node_IDTable_T oITable);
+
+/*
+  Unlinks oNNode from its parent's children array, as Node_free does,
+  but keeps the subtree rooted at oNNode, identifiers and all, so that
+  the change can be undone: the caller takes over the array's
+  reference to oNNode, and must later pass oNNode and the memory
+  stored in *ppvSpare to either Node_relink or Node_discard. The spare
+  memory is what relinking oNNode will need, so that undoing the
+  change cannot fail. Must be called with the same locks held as
+  Node_free. Returns SUCCESS, or MEMORY_ERROR if the spare memory
+  could not be allocated, in which case oNNode is still linked.
+*/
+int Node_unlink(Node_T oNNode, Node_IDTable_T oITable, void **ppvSpare);
+
+/*
+  Links oNNode, unlinked by Node_unlink with spare memory pvSpare,
+  back into its parent's children array, where it must be absent. The
+  parent's children must be the ones it had after the unlinking. If
+  oNNode is a root, the caller must publish it again instead.
+*/
+void Node_relink(Node_T oNNode, void *pvSpare, Node_IDTable_T oITable);
+
+/*
+  Frees spare memory pvSpare (if not NULL) and destroys the subtree
+  rooted at oNNode, already unlinked from its parent, as Node_free
+  does. Returns the number of nodes deleted.
+*/
+size_t Node_discard(Node_T oNNode, void *pvSpare, Node_IDTable_T oITable);
+
+/*
+  Returns TRUE if oNNode is referenced by more than one children
+  array, root or snapshot, so that it must be copied (see Node_copy)
+  before it is changed, or FALSE if not.
+*/
+boolean Node_isShared(Node_T oNNode);
+
+/*
+  Adds a reference to oNNode, for a snapshot that shares the subtree
+  rooted at it. Each reference must be dropped with Node_release.
+*/
+void Node_retain(Node_T oNNode);
 
 /*
-  Destroys and frees all memory allocated for the subtree rooted at
-  oNNode, i.e., deletes oNNode and all its descendents. Returns the
-  number of nodes deleted.
+  Drops a reference to oNNode once no reader in node ID table
+  oITable's reclamation domain can still reach it through that
+  reference. The last reference dropped frees oNNode and drops its
+  references to its children. Does not release identifiers.
 */
-size_t Node_free(Node_T oNNode);
+void Node_release(Node_T oNNode, Node_IDTable_T oITable);
+
+/*
+  Replaces shared node oNNode with a copy that shares its children,
+  taking over its identifier in node ID table oITable and its place
+  in its parent's children array, and drops that array's reference
+  to it. If oNNode is a root, the caller must publish the copy in its
+  place. Must be called with the lock of oNNode's parent (and, if it
+  is a directory, its own) held, and no writer inside its subtree;
+  the parent itself must not be shared. Returns SUCCESS and sets
+  *poNResult to the copy, or sets *poNResult to NULL and returns
+  MEMORY_ERROR, leaving oNNode in place.
+*/
+int Node_copy(Node_T oNNode, Node_IDTable_T oITable, Node_T *poNResult);
+
+/*
+  Returns oNNode's identifier: a nonzero value that Node_fromID maps
+  back to oNNode in constant time through oNNode's node ID table until
+  oNNode is freed, and that the table does not reissue to another node
+  after oNNode is freed.
+*/
+size_t Node_getID(Node_T oNNode);
+
+/*
+  Returns the node with identifier ulID in node ID table oITable, or
+  NULL if that node has been freed or oITable never issued ulID.
+*/
+Node_T Node_fromID(Node_IDTable_T oITable, size_t ulID);
+
+/*
+  Acquires directory oNDir's lock, blocking until no other writer
+  holds it. A writer holding the lock of a directory may lock one of
+  its subdirectories, but never the reverse, so that writers
+  descending the tree never deadlock. Does nothing if built with
+  FT_NO_LOCKING defined.
+*/
+void Node_lock(Node_T oNDir);
+
+/* Releases directory oNDir's lock. */
+void Node_unlock(Node_T oNDir);
 
 /* Returns the path object representing oNNode's absolute path. */
 Path_T Node_getPath(Node_T oNNode);
@@ -72,6 +306,37 @@ Path_T Node_getPath(Node_T oNNode);
 boolean Node_hasChild(Node_T oNParent, Path_T oPPath,
                          size_t *pulChildID);
 
+/*
+  Returns TRUE and sets *poNResult to oNParent's child with path
+  oPPath, if it has one. Otherwise, sets *poNResult to NULL and
+  returns FALSE. Unlike Node_hasChild followed by Node_getChild, looks
+  the child up in a single snapshot of oNParent's children, so it is
+  safe inside a read-side critical section.
+*/
+boolean Node_findChild(Node_T oNParent, Path_T oPPath,
+                       Node_T *poNResult);
+
+/*
+  Reallocates directory oNParent's children array to hold exactly its
+  current children, releasing the slack left by growing it one child
+  at a time, and retires the old array through node ID table
+  oITable's reclamation domain. Returns SUCCESS, or MEMORY_ERROR if
+  the new array could not be allocated, in which case oNParent is
+  unchanged.
+*/
+int Node_fitChildren(Node_T oNParent, Node_IDTable_T oITable);
+
+/*
+  Reallocates directory oNParent's children array to hold exactly
+  ulCapacity children, which must be at least as many as it has, so
+  that a directory whose children are known in advance is allocated
+  once for all of them, and retires the old array as
+  Node_fitChildren does. Returns SUCCESS, or MEMORY_ERROR if the new
+  array could not be allocated, in which case oNParent is unchanged.
+*/
+int Node_reserveChildren(Node_T oNParent, size_t ulCapacity,
+                         Node_IDTable_T oITable);
+
 /* Returns the number of children that oNParent has. */
 size_t Node_getNumChildren(Node_T oNParent);
 
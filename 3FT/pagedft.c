@@ -0,0 +1,992 @@
+/*--------------------------------------------------------------------*/
+/* pagedft.c                                                          */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for pthread_rwlock_t */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef FT_NO_LOCKING
+#include <pthread.h>
+#endif
+#include "dynarray.h"
+#include "image.h"
+#include "ft.h"
+#include "pagedft.h"
+
+/* The states of a directory of the image in the resident FT */
+enum pageState {
+   /* the directory is not resident: it was evicted, and its stub
+      could not be put back */
+   PAGE_ABSENT,
+   /* the directory is resident, but none of its children are */
+   PAGE_STUB,
+   /* the directory and all of its children are resident */
+   PAGE_LOADED,
+   /* the directory was evicted with an ancestor, and its page is to
+      be freed */
+   PAGE_GONE
+};
+
+/*
+  The page of a directory of the image whose parent is resident.
+  Directories that the client inserts have no pages: they, and
+  everything below them, are always resident.
+*/
+struct page {
+   /* the directory's absolute path */
+   char *pcPath;
+   /* the index of the directory's node in the image */
+   size_t ulImage;
+   /* the directory's state */
+   enum pageState eState;
+   /* TRUE if the directory's subtree has changed since it was paged
+      in, so that it no longer matches the image and is never
+      evicted */
+   boolean bDirty;
+   /* the use clock's value when an operation last passed through the
+      directory, no smaller than that of any directory below it */
+   size_t ulUsed;
+};
+
+/* A File Tree paged in from an image */
+struct pagedFT {
+   /* the image the hierarchy was opened from */
+   Image_T oIImage;
+   /* the resident part of the hierarchy */
+   FT_T oFTree;
+   /* the pages of the directories of the image that are resident or
+      whose parents are, sorted by path */
+   DynArray_T oDPages;
+   /* the number of resident nodes beyond which directories are
+      evicted */
+   size_t ulMaxResident;
+   /* the number of nodes in the hierarchy, resident or not */
+   size_t ulCount;
+   /* the use clock, advanced by each operation */
+   size_t ulClock;
+   /* the number of directories paged in since the image was opened */
+   size_t ulPageIns;
+   /* the number of directories evicted since the image was opened */
+   size_t ulEvictions;
+#ifndef FT_NO_LOCKING
+   /* the lock that operations reading only resident directories hold
+      shared, and that all others hold exclusively */
+   pthread_rwlock_t sLock;
+#endif
+};
+
+/* A path's prefix, as sought among pages */
+struct prefix {
+   /* the path */
+   const char *pcPath;
+   /* the length of the prefix */
+   size_t ulLength;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Acquires oPTree's lock shared. */
+static void PagedFT_lockShared(PagedFT_T oPTree) {
+   assert(oPTree != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_rdlock(&oPTree->sLock);
+#else
+   (void) oPTree;
+#endif
+}
+
+/* Acquires oPTree's lock exclusively. */
+static void PagedFT_lockExclusive(PagedFT_T oPTree) {
+   assert(oPTree != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_wrlock(&oPTree->sLock);
+#else
+   (void) oPTree;
+#endif
+}
+
+/* Releases oPTree's lock. */
+static void PagedFT_unlock(PagedFT_T oPTree) {
+   assert(oPTree != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_unlock(&oPTree->sLock);
+#else
+   (void) oPTree;
+#endif
+}
+
+/*
+  Compares the path of page pvPage with prefix pvPrefix, as strcmp
+  would compare them as strings.
+*/
+static int PagedFT_comparePrefix(const void *pvPage,
+                                 const void *pvPrefix) {
+   const struct page *psPage = pvPage;
+   const struct prefix *psPrefix = pvPrefix;
+   int iCompare;
+
+   assert(psPage != NULL);
+   assert(psPrefix != NULL);
+
+   iCompare = strncmp(psPage->pcPath, psPrefix->pcPath,
+                      psPrefix->ulLength);
+   if(iCompare != 0)
+      return iCompare;
+   return psPage->pcPath[psPrefix->ulLength] != '\0';
+}
+
+/*
+  Returns the page of oPTree whose path is the first ulLength
+  characters of pcPath, or NULL if there is none, and stores in
+  *pulIndex the index at which it is or would be.
+*/
+static struct page *PagedFT_findPage(PagedFT_T oPTree, const char *pcPath,
+                                     size_t ulLength, size_t *pulIndex) {
+   struct prefix sPrefix;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+   assert(pulIndex != NULL);
+
+   sPrefix.pcPath = pcPath;
+   sPrefix.ulLength = ulLength;
+   if(!DynArray_bsearch(oPTree->oDPages, &sPrefix, pulIndex,
+                        PagedFT_comparePrefix))
+      return NULL;
+   return DynArray_get(oPTree->oDPages, *pulIndex);
+}
+
+/*
+  Returns whether pcPage is pcPath, of length ulLength, or the path
+  of a node below it.
+*/
+static boolean PagedFT_isAtOrBelow(const char *pcPage, const char *pcPath,
+                                   size_t ulLength) {
+   assert(pcPage != NULL);
+   assert(pcPath != NULL);
+
+   return (boolean) (strncmp(pcPage, pcPath, ulLength) == 0 &&
+                     (pcPage[ulLength] == '\0' ||
+                      pcPage[ulLength] == '/'));
+}
+
+/*
+  Adds to oPTree a page for the unloaded directory of the image whose
+  node is at index ulImage and whose path is pcPath, which the page
+  takes over, last used at ulStamp. Returns SUCCESS, or:
+  * IO_ERROR if the directory has a page already, which only a
+    damaged image gives it
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  in which case pcPath is freed.
+*/
+static int PagedFT_addPage(PagedFT_T oPTree, char *pcPath, size_t ulImage,
+                           size_t ulStamp) {
+   struct page *psNew;
+   size_t ulIndex;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   if(PagedFT_findPage(oPTree, pcPath, strlen(pcPath), &ulIndex) != NULL) {
+      free(pcPath);
+      return IO_ERROR;
+   }
+
+   psNew = malloc(sizeof(struct page));
+   if(psNew == NULL) {
+      free(pcPath);
+      return MEMORY_ERROR;
+   }
+   psNew->pcPath = pcPath;
+   psNew->ulImage = ulImage;
+   psNew->eState = PAGE_STUB;
+   psNew->bDirty = FALSE;
+   psNew->ulUsed = ulStamp;
+   if(!DynArray_addAt(oPTree->oDPages, ulIndex, psNew)) {
+      free(pcPath);
+      free(psNew);
+      return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+/* Frees page psPage. */
+static void PagedFT_freePage(struct page *psPage) {
+   assert(psPage != NULL);
+
+   free(psPage->pcPath);
+   free(psPage);
+}
+
+/*
+  Drops the pages of oPTree below the directory with path pcPath, and
+  its own page too if bInclusive is TRUE. If bDefer is TRUE, only
+  marks them gone, to be freed by PagedFT_sweep, so that pointers to
+  them stay valid meanwhile; otherwise, frees them at once.
+*/
+static void PagedFT_dropPages(PagedFT_T oPTree, const char *pcPath,
+                              boolean bInclusive, boolean bDefer) {
+   size_t ulLength, ulIndex;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   /* every path with pcPath as a prefix sorts at or after pcPath, and
+      before every path without it */
+   ulLength = strlen(pcPath);
+   (void) PagedFT_findPage(oPTree, pcPath, ulLength, &ulIndex);
+   while(ulIndex < DynArray_getLength(oPTree->oDPages)) {
+      struct page *psPage = DynArray_get(oPTree->oDPages, ulIndex);
+
+      if(strncmp(psPage->pcPath, pcPath, ulLength) != 0)
+         break;
+      if(!PagedFT_isAtOrBelow(psPage->pcPath, pcPath, ulLength) ||
+         (psPage->pcPath[ulLength] == '\0' && !bInclusive)) {
+         ulIndex++;
+         continue;
+      }
+      if(bDefer) {
+         psPage->eState = PAGE_GONE;
+         ulIndex++;
+      }
+      else {
+         (void) DynArray_removeAt(oPTree->oDPages, ulIndex);
+         PagedFT_freePage(psPage);
+      }
+   }
+}
+
+/* Frees the pages of oPTree that PagedFT_dropPages marked gone. */
+static void PagedFT_sweep(PagedFT_T oPTree) {
+   size_t ulKept = 0;
+   size_t i;
+
+   assert(oPTree != NULL);
+
+   for(i = 0; i < DynArray_getLength(oPTree->oDPages); i++) {
+      struct page *psPage = DynArray_get(oPTree->oDPages, i);
+
+      if(psPage->eState == PAGE_GONE)
+         PagedFT_freePage(psPage);
+      else
+         (void) DynArray_set(oPTree->oDPages, ulKept++, psPage);
+   }
+   while(DynArray_getLength(oPTree->oDPages) > ulKept)
+      (void) DynArray_removeAt(oPTree->oDPages,
+                               DynArray_getLength(oPTree->oDPages) - 1);
+}
+
+/* Returns the number of nodes resident in oPTree. */
+static size_t PagedFT_getResident(PagedFT_T oPTree) {
+   size_t ulResident = 0;
+
+   assert(oPTree != NULL);
+
+   (void) FT_getCountIn(oPTree->oFTree, &ulResident);
+   return ulResident;
+}
+
+/*
+  Returns iStatus, a status of the resident FT while paging in from
+  oPTree's image, as the status of the page-in: the FT rejects only
+  what a damaged image holds, so any failure but MEMORY_ERROR is an
+  IO_ERROR.
+*/
+static int PagedFT_imageStatus(int iStatus) {
+   if(iStatus == SUCCESS || iStatus == MEMORY_ERROR)
+      return iStatus;
+   return IO_ERROR;
+}
+
+/*
+  Evicts the subtree of the directory of page psPage from oPTree's
+  resident FT, leaving the directory a stub, or absent if the stub
+  cannot be put back, and drops the pages below it as
+  PagedFT_dropPages does with bDefer. Returns SUCCESS, or the status
+  of FT_rmDir if nothing could be evicted.
+*/
+static int PagedFT_evict(PagedFT_T oPTree, struct page *psPage,
+                         boolean bDefer) {
+   int iStatus;
+
+   assert(oPTree != NULL);
+   assert(psPage != NULL);
+
+   iStatus = FT_rmDirIn(oPTree->oFTree, psPage->pcPath);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   PagedFT_dropPages(oPTree, psPage->pcPath, FALSE, bDefer);
+   psPage->eState = PAGE_ABSENT;
+   if(FT_insertDirIn(oPTree->oFTree, psPage->pcPath) == SUCCESS)
+      psPage->eState = PAGE_STUB;
+   return SUCCESS;
+}
+
+/*
+  Makes the directory of page psPage resident in oPTree, if it is
+  absent, and pages in its children if bChildren is TRUE, their pages
+  last used at ulStamp. A page-in that fails is undone. Returns
+  SUCCESS, or:
+  * IO_ERROR if the image is damaged
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int PagedFT_pageIn(PagedFT_T oPTree, struct page *psPage,
+                          boolean bChildren, size_t ulStamp) {
+   const char *pcName;
+   boolean bIsFile;
+   size_t ulSize, ulFirst, ulParentLength, c;
+   void *pvContents;
+   int iStatus;
+
+   assert(oPTree != NULL);
+   assert(psPage != NULL);
+   assert(psPage->eState != PAGE_GONE);
+
+   if(psPage->eState == PAGE_ABSENT) {
+      iStatus = FT_insertDirIn(oPTree->oFTree, psPage->pcPath);
+      if(iStatus != SUCCESS)
+         return PagedFT_imageStatus(iStatus);
+      psPage->eState = PAGE_STUB;
+   }
+   if(!bChildren || psPage->eState == PAGE_LOADED)
+      return SUCCESS;
+
+   iStatus = Image_getNode(oPTree->oIImage, psPage->ulImage, &pcName,
+                           &bIsFile, &ulSize, &ulFirst, &pvContents);
+   if(iStatus == SUCCESS && bIsFile)
+      iStatus = IO_ERROR;
+
+   ulParentLength = strlen(psPage->pcPath);
+   for(c = 0; c < ulSize && iStatus == SUCCESS; c++) {
+      size_t ulChildSize, ulChildFirst;
+      char *pcPath;
+
+      iStatus = Image_getNode(oPTree->oIImage, ulFirst + c, &pcName,
+                              &bIsFile, &ulChildSize, &ulChildFirst,
+                              &pvContents);
+      if(iStatus != SUCCESS)
+         break;
+
+      pcPath = malloc(ulParentLength + strlen(pcName) + 2);
+      if(pcPath == NULL) {
+         iStatus = MEMORY_ERROR;
+         break;
+      }
+      memcpy(pcPath, psPage->pcPath, ulParentLength);
+      pcPath[ulParentLength] = '/';
+      strcpy(pcPath + ulParentLength + 1, pcName);
+
+      if(bIsFile) {
+         iStatus = FT_insertFileIn(oPTree->oFTree, pcPath, pvContents,
+                                   ulChildSize);
+         free(pcPath);
+      }
+      else {
+         iStatus = FT_insertDirIn(oPTree->oFTree, pcPath);
+         if(iStatus == SUCCESS)
+            iStatus = PagedFT_addPage(oPTree, pcPath, ulFirst + c,
+                                      ulStamp);
+         else
+            free(pcPath);
+      }
+   }
+
+   if(iStatus != SUCCESS) {
+      (void) PagedFT_evict(oPTree, psPage, FALSE);
+      return PagedFT_imageStatus(iStatus);
+   }
+   psPage->eState = PAGE_LOADED;
+   oPTree->ulPageIns++;
+   return SUCCESS;
+}
+
+/*
+  Adds to *pulCount the number of nodes below the node at index
+  ulIndex of image oIImage. Returns SUCCESS, or IO_ERROR if the image
+  is damaged below it.
+*/
+static int PagedFT_countImage(Image_T oIImage, size_t ulIndex,
+                              size_t *pulCount) {
+   const char *pcName;
+   boolean bIsFile;
+   size_t ulSize, ulFirst, c;
+   void *pvContents;
+   int iStatus;
+
+   assert(oIImage != NULL);
+   assert(pulCount != NULL);
+
+   iStatus = Image_getNode(oIImage, ulIndex, &pcName, &bIsFile, &ulSize,
+                           &ulFirst, &pvContents);
+   if(iStatus != SUCCESS || bIsFile)
+      return iStatus;
+   *pulCount += ulSize;
+   for(c = 0; c < ulSize && iStatus == SUCCESS; c++)
+      iStatus = PagedFT_countImage(oIImage, ulFirst + c, pulCount);
+   return iStatus;
+}
+
+/*
+  Sets *pulCount to the number of nodes at or below pcPath in oPTree
+  that are not resident. Returns SUCCESS, or IO_ERROR if the image is
+  damaged below them.
+*/
+static int PagedFT_countUnloaded(PagedFT_T oPTree, const char *pcPath,
+                                 size_t *pulCount) {
+   size_t ulLength, ulIndex;
+   int iStatus = SUCCESS;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+   assert(pulCount != NULL);
+
+   /* a stub's descendants are all unloaded, and a loaded directory's
+      children all resident */
+   *pulCount = 0;
+   ulLength = strlen(pcPath);
+   (void) PagedFT_findPage(oPTree, pcPath, ulLength, &ulIndex);
+   for(; ulIndex < DynArray_getLength(oPTree->oDPages) &&
+          iStatus == SUCCESS; ulIndex++) {
+      struct page *psPage = DynArray_get(oPTree->oDPages, ulIndex);
+
+      if(strncmp(psPage->pcPath, pcPath, ulLength) != 0)
+         break;
+      if(!PagedFT_isAtOrBelow(psPage->pcPath, pcPath, ulLength) ||
+         psPage->eState == PAGE_LOADED)
+         continue;
+      if(psPage->eState == PAGE_ABSENT)
+         (*pulCount)++;
+      iStatus = PagedFT_countImage(oPTree->oIImage, psPage->ulImage,
+                                   pulCount);
+   }
+   return iStatus;
+}
+
+/* Returns a new value of oPTree's use clock. */
+static size_t PagedFT_newStamp(PagedFT_T oPTree) {
+   assert(oPTree != NULL);
+
+   return __atomic_add_fetch(&oPTree->ulClock, 1, __ATOMIC_RELAXED);
+}
+
+/*
+  Returns whether pcPath can be reached in oPTree's resident FT as it
+  stands: whether every directory of the image that is a proper
+  prefix of pcPath is loaded, and pcPath, if it is a directory of the
+  image, resident. Stamps the pages of those directories with a new
+  use meanwhile. Must be called with oPTree's lock held.
+*/
+static boolean PagedFT_isResident(PagedFT_T oPTree, const char *pcPath) {
+   const char *pcEnd = pcPath;
+   size_t ulStamp, ulIndex;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   ulStamp = PagedFT_newStamp(oPTree);
+   for(;;) {
+      struct page *psPage;
+
+      pcEnd = strchr(pcEnd, '/');
+      psPage = PagedFT_findPage(oPTree, pcPath,
+                                pcEnd != NULL ? (size_t) (pcEnd - pcPath)
+                                              : strlen(pcPath),
+                                &ulIndex);
+      if(psPage != NULL) {
+         __atomic_store_n(&psPage->ulUsed, ulStamp, __ATOMIC_RELAXED);
+         if(psPage->eState == PAGE_ABSENT ||
+            (pcEnd != NULL && psPage->eState != PAGE_LOADED))
+            return FALSE;
+      }
+      if(pcEnd == NULL)
+         return TRUE;
+      pcEnd++;
+   }
+}
+
+/*
+  Makes pcPath reachable in oPTree's resident FT, as
+  PagedFT_isResident checks, by paging in every unloaded directory of
+  the image that is a proper prefix of pcPath, and pcPath itself if
+  it is absent, stamping each page along pcPath with a new use. Must
+  be called with oPTree's lock held exclusively. Returns SUCCESS, or
+  the status of the page-in that failed.
+*/
+static int PagedFT_enter(PagedFT_T oPTree, const char *pcPath) {
+   const char *pcEnd = pcPath;
+   size_t ulStamp, ulIndex;
+   int iStatus;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   ulStamp = PagedFT_newStamp(oPTree);
+   for(;;) {
+      struct page *psPage;
+
+      pcEnd = strchr(pcEnd, '/');
+      psPage = PagedFT_findPage(oPTree, pcPath,
+                                pcEnd != NULL ? (size_t) (pcEnd - pcPath)
+                                              : strlen(pcPath),
+                                &ulIndex);
+      if(psPage != NULL) {
+         __atomic_store_n(&psPage->ulUsed, ulStamp, __ATOMIC_RELAXED);
+         iStatus = PagedFT_pageIn(oPTree, psPage,
+                                  (boolean) (pcEnd != NULL), ulStamp);
+         if(iStatus != SUCCESS)
+            return iStatus;
+      }
+      if(pcEnd == NULL)
+         return SUCCESS;
+      pcEnd++;
+   }
+}
+
+/*
+  Marks the pages of the directories that are proper prefixes of
+  pcPath dirty, once a write to pcPath has changed their subtrees.
+*/
+static void PagedFT_markDirty(PagedFT_T oPTree, const char *pcPath) {
+   const char *pcEnd = pcPath;
+   size_t ulIndex;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   while((pcEnd = strchr(pcEnd, '/')) != NULL) {
+      struct page *psPage = PagedFT_findPage(oPTree, pcPath,
+                                             (size_t) (pcEnd - pcPath),
+                                             &ulIndex);
+      if(psPage != NULL)
+         psPage->bDirty = TRUE;
+      pcEnd++;
+   }
+}
+
+/*
+  Orders pages pvFirst and pvSecond for eviction: least recently used
+  first, and of pages last used at once, the deeper first, so that
+  every directory comes after those below it.
+*/
+static int PagedFT_compareUse(const void *pvFirst, const void *pvSecond) {
+   const struct page *psFirst = pvFirst;
+   const struct page *psSecond = pvSecond;
+   size_t ulFirst, ulSecond;
+
+   assert(psFirst != NULL);
+   assert(psSecond != NULL);
+
+   ulFirst = __atomic_load_n(&psFirst->ulUsed, __ATOMIC_RELAXED);
+   ulSecond = __atomic_load_n(&psSecond->ulUsed, __ATOMIC_RELAXED);
+   if(ulFirst != ulSecond)
+      return ulFirst < ulSecond ? -1 : 1;
+   ulFirst = strlen(psFirst->pcPath);
+   ulSecond = strlen(psSecond->pcPath);
+   if(ulFirst != ulSecond)
+      return ulFirst > ulSecond ? -1 : 1;
+   return 0;
+}
+
+/*
+  Evicts the least recently used clean directories of oPTree until no
+  more nodes are resident than its limit allows, or no clean
+  directory is left. Must be called with oPTree's lock held
+  exclusively.
+*/
+static void PagedFT_trim(PagedFT_T oPTree) {
+   DynArray_T oDCandidates;
+   size_t ulResident, i;
+
+   assert(oPTree != NULL);
+
+   ulResident = PagedFT_getResident(oPTree);
+   if(ulResident <= oPTree->ulMaxResident)
+      return;
+
+   oDCandidates = DynArray_new(0);
+   if(oDCandidates == NULL)
+      return;
+   for(i = 0; i < DynArray_getLength(oPTree->oDPages); i++) {
+      struct page *psPage = DynArray_get(oPTree->oDPages, i);
+
+      if(psPage->eState == PAGE_LOADED && !psPage->bDirty &&
+         !DynArray_add(oDCandidates, psPage)) {
+         DynArray_free(oDCandidates);
+         return;
+      }
+   }
+   DynArray_sort(oDCandidates, PagedFT_compareUse);
+
+   /* evicting a directory drops the pages below it, which come
+      before it, so they are only marked gone until the end */
+   for(i = 0; i < DynArray_getLength(oDCandidates) &&
+          ulResident > oPTree->ulMaxResident; i++) {
+      struct page *psPage = DynArray_get(oDCandidates, i);
+
+      if(psPage->eState != PAGE_LOADED)
+         continue;
+      if(PagedFT_evict(oPTree, psPage, TRUE) == SUCCESS) {
+         oPTree->ulEvictions++;
+         ulResident = PagedFT_getResident(oPTree);
+      }
+   }
+   PagedFT_sweep(oPTree);
+   DynArray_free(oDCandidates);
+}
+
+/*
+  Acquires oPTree's lock for an operation that only reads pcPath:
+  shared, if pcPath can be reached in the resident FT as it stands,
+  or else exclusively, once it is paged in. Sets *pbExclusive to
+  whether the lock is held exclusively. Returns SUCCESS, or the
+  status of the page-in that failed, with the lock held in either
+  case.
+*/
+static int PagedFT_lockPath(PagedFT_T oPTree, const char *pcPath,
+                            boolean *pbExclusive) {
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+   assert(pbExclusive != NULL);
+
+   PagedFT_lockShared(oPTree);
+   if(PagedFT_isResident(oPTree, pcPath)) {
+      *pbExclusive = FALSE;
+      return SUCCESS;
+   }
+   PagedFT_unlock(oPTree);
+
+   PagedFT_lockExclusive(oPTree);
+   *pbExclusive = TRUE;
+   return PagedFT_enter(oPTree, pcPath);
+}
+
+/*
+  Releases the lock that PagedFT_lockPath acquired, first evicting
+  what oPTree's limit does not allow if it is held exclusively.
+*/
+static void PagedFT_unlockPath(PagedFT_T oPTree, boolean bExclusive) {
+   assert(oPTree != NULL);
+
+   if(bExclusive)
+      PagedFT_trim(oPTree);
+   PagedFT_unlock(oPTree);
+}
+
+/*--------------------------------------------------------------------*/
+
+int PagedFT_open(const char *pcImage, size_t ulMaxResident,
+                 PagedFT_T *poPResult) {
+   PagedFT_T oPNew;
+   const char *pcName;
+   boolean bIsFile;
+   size_t ulSize, ulFirst;
+   void *pvContents;
+   char *pcRoot;
+   int iStatus;
+
+   assert(pcImage != NULL);
+   assert(poPResult != NULL);
+
+   oPNew = malloc(sizeof(struct pagedFT));
+   if(oPNew == NULL)
+      return MEMORY_ERROR;
+   oPNew->oFTree = FT_new();
+   oPNew->oDPages = DynArray_new(0);
+   if(oPNew->oFTree == NULL || oPNew->oDPages == NULL) {
+      FT_free(oPNew->oFTree);
+      if(oPNew->oDPages != NULL)
+         DynArray_free(oPNew->oDPages);
+      free(oPNew);
+      return MEMORY_ERROR;
+   }
+#ifndef FT_NO_LOCKING
+   if(pthread_rwlock_init(&oPNew->sLock, NULL) != 0) {
+      FT_free(oPNew->oFTree);
+      DynArray_free(oPNew->oDPages);
+      free(oPNew);
+      return MEMORY_ERROR;
+   }
+#endif
+   oPNew->oIImage = NULL;
+   oPNew->ulMaxResident = ulMaxResident;
+   oPNew->ulCount = 0;
+   oPNew->ulClock = 0;
+   oPNew->ulPageIns = 0;
+   oPNew->ulEvictions = 0;
+
+   /* only the root is made resident, as an unloaded stub */
+   iStatus = Image_open(pcImage, &oPNew->oIImage);
+   if(iStatus == SUCCESS && Image_getCount(oPNew->oIImage) != 0)
+      iStatus = Image_getNode(oPNew->oIImage, 0, &pcName, &bIsFile,
+                              &ulSize, &ulFirst, &pvContents);
+   if(iStatus == SUCCESS && Image_getCount(oPNew->oIImage) != 0) {
+      pcRoot = malloc(strlen(pcName) + 1);
+      if(pcRoot == NULL)
+         iStatus = MEMORY_ERROR;
+      else if(bIsFile) {
+         strcpy(pcRoot, pcName);
+         iStatus = PagedFT_imageStatus(
+            FT_insertFileIn(oPNew->oFTree, pcRoot, pvContents, ulSize));
+         free(pcRoot);
+      }
+      else {
+         strcpy(pcRoot, pcName);
+         iStatus = FT_insertDirIn(oPNew->oFTree, pcRoot);
+         if(iStatus == SUCCESS)
+            iStatus = PagedFT_addPage(oPNew, pcRoot, 0, 0);
+         else
+            free(pcRoot);
+         iStatus = PagedFT_imageStatus(iStatus);
+      }
+   }
+   if(iStatus != SUCCESS) {
+      PagedFT_free(oPNew);
+      return iStatus;
+   }
+   oPNew->ulCount = Image_getCount(oPNew->oIImage);
+
+   *poPResult = oPNew;
+   return SUCCESS;
+}
+
+void PagedFT_free(PagedFT_T oPTree) {
+   size_t i;
+
+   if(oPTree == NULL)
+      return;
+
+   for(i = 0; i < DynArray_getLength(oPTree->oDPages); i++)
+      PagedFT_freePage(DynArray_get(oPTree->oDPages, i));
+   DynArray_free(oPTree->oDPages);
+   FT_free(oPTree->oFTree);
+   Image_close(oPTree->oIImage);
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_destroy(&oPTree->sLock);
+#endif
+   free(oPTree);
+}
+
+/*
+  Inserts a directory (if bIsFile is FALSE) or a file with contents
+  pvContents of size ulLength bytes (if bIsFile is TRUE) into oPTree
+  with absolute path pcPath. Returns the same statuses as
+  PagedFT_insertDir or PagedFT_insertFile.
+*/
+static int PagedFT_insert(PagedFT_T oPTree, const char *pcPath,
+                          boolean bIsFile, void *pvContents,
+                          size_t ulLength) {
+   size_t ulBefore;
+   int iStatus;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   PagedFT_lockExclusive(oPTree);
+   iStatus = PagedFT_enter(oPTree, pcPath);
+   if(iStatus == SUCCESS) {
+      ulBefore = PagedFT_getResident(oPTree);
+      if(bIsFile)
+         iStatus = FT_insertFileIn(oPTree->oFTree, pcPath, pvContents,
+                                   ulLength);
+      else
+         iStatus = FT_insertDirIn(oPTree->oFTree, pcPath);
+      if(iStatus == SUCCESS) {
+         oPTree->ulCount += PagedFT_getResident(oPTree) - ulBefore;
+         PagedFT_markDirty(oPTree, pcPath);
+      }
+   }
+   PagedFT_trim(oPTree);
+   PagedFT_unlock(oPTree);
+   return iStatus;
+}
+
+int PagedFT_insertDir(PagedFT_T oPTree, const char *pcPath) {
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   return PagedFT_insert(oPTree, pcPath, FALSE, NULL, 0);
+}
+
+int PagedFT_insertFile(PagedFT_T oPTree, const char *pcPath,
+                       void *pvContents, size_t ulLength) {
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   return PagedFT_insert(oPTree, pcPath, TRUE, pvContents, ulLength);
+}
+
+int PagedFT_rmDir(PagedFT_T oPTree, const char *pcPath) {
+   size_t ulBefore, ulUnloaded;
+   int iStatus;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   /* the unloaded part of the subtree is removed along with the
+      resident part, so the count drops by both */
+   PagedFT_lockExclusive(oPTree);
+   iStatus = PagedFT_enter(oPTree, pcPath);
+   if(iStatus == SUCCESS)
+      iStatus = PagedFT_countUnloaded(oPTree, pcPath, &ulUnloaded);
+   if(iStatus == SUCCESS) {
+      ulBefore = PagedFT_getResident(oPTree);
+      iStatus = FT_rmDirIn(oPTree->oFTree, pcPath);
+      if(iStatus == SUCCESS) {
+         oPTree->ulCount -= ulBefore - PagedFT_getResident(oPTree)
+                            + ulUnloaded;
+         PagedFT_dropPages(oPTree, pcPath, TRUE, FALSE);
+         PagedFT_markDirty(oPTree, pcPath);
+      }
+   }
+   PagedFT_trim(oPTree);
+   PagedFT_unlock(oPTree);
+   return iStatus;
+}
+
+int PagedFT_rmFile(PagedFT_T oPTree, const char *pcPath) {
+   int iStatus;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   PagedFT_lockExclusive(oPTree);
+   iStatus = PagedFT_enter(oPTree, pcPath);
+   if(iStatus == SUCCESS)
+      iStatus = FT_rmFileIn(oPTree->oFTree, pcPath);
+   if(iStatus == SUCCESS) {
+      oPTree->ulCount--;
+      PagedFT_markDirty(oPTree, pcPath);
+   }
+   PagedFT_trim(oPTree);
+   PagedFT_unlock(oPTree);
+   return iStatus;
+}
+
+void *PagedFT_replaceFileContents(PagedFT_T oPTree, const char *pcPath,
+                                  void *pvNewContents,
+                                  size_t ulNewLength) {
+   void *pvResult = NULL;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   PagedFT_lockExclusive(oPTree);
+   if(PagedFT_enter(oPTree, pcPath) == SUCCESS &&
+      FT_containsFileIn(oPTree->oFTree, pcPath)) {
+      pvResult = FT_replaceFileContentsIn(oPTree->oFTree, pcPath,
+                                          pvNewContents, ulNewLength);
+      PagedFT_markDirty(oPTree, pcPath);
+   }
+   PagedFT_trim(oPTree);
+   PagedFT_unlock(oPTree);
+   return pvResult;
+}
+
+boolean PagedFT_containsDir(PagedFT_T oPTree, const char *pcPath) {
+   boolean bResult = FALSE;
+   boolean bExclusive;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   if(PagedFT_lockPath(oPTree, pcPath, &bExclusive) == SUCCESS)
+      bResult = FT_containsDirIn(oPTree->oFTree, pcPath);
+   PagedFT_unlockPath(oPTree, bExclusive);
+   return bResult;
+}
+
+boolean PagedFT_containsFile(PagedFT_T oPTree, const char *pcPath) {
+   boolean bResult = FALSE;
+   boolean bExclusive;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   if(PagedFT_lockPath(oPTree, pcPath, &bExclusive) == SUCCESS)
+      bResult = FT_containsFileIn(oPTree->oFTree, pcPath);
+   PagedFT_unlockPath(oPTree, bExclusive);
+   return bResult;
+}
+
+void *PagedFT_getFileContents(PagedFT_T oPTree, const char *pcPath) {
+   void *pvResult = NULL;
+   boolean bExclusive;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   if(PagedFT_lockPath(oPTree, pcPath, &bExclusive) == SUCCESS)
+      pvResult = FT_getFileContentsIn(oPTree->oFTree, pcPath);
+   PagedFT_unlockPath(oPTree, bExclusive);
+   return pvResult;
+}
+
+int PagedFT_stat(PagedFT_T oPTree, const char *pcPath,
+                 boolean *pbIsFile, size_t *pulSize) {
+   boolean bExclusive;
+   int iStatus;
+
+   assert(oPTree != NULL);
+   assert(pcPath != NULL);
+
+   iStatus = PagedFT_lockPath(oPTree, pcPath, &bExclusive);
+   if(iStatus == SUCCESS)
+      iStatus = FT_statIn(oPTree->oFTree, pcPath, pbIsFile, pulSize);
+   PagedFT_unlockPath(oPTree, bExclusive);
+   return iStatus;
+}
+
+int PagedFT_getCount(PagedFT_T oPTree, size_t *pulCount) {
+   assert(oPTree != NULL);
+   assert(pulCount != NULL);
+
+   PagedFT_lockShared(oPTree);
+   *pulCount = oPTree->ulCount;
+   PagedFT_unlock(oPTree);
+   return SUCCESS;
+}
+
+char *PagedFT_toString(PagedFT_T oPTree) {
+   char *pcResult = NULL;
+   size_t ulStamp, i;
+   int iStatus = SUCCESS;
+
+   assert(oPTree != NULL);
+
+   /* paging in a directory adds pages only after its own, so one
+      pass pages in the whole hierarchy */
+   PagedFT_lockExclusive(oPTree);
+   ulStamp = PagedFT_newStamp(oPTree);
+   for(i = 0; i < DynArray_getLength(oPTree->oDPages) &&
+          iStatus == SUCCESS; i++)
+      iStatus = PagedFT_pageIn(oPTree, DynArray_get(oPTree->oDPages, i),
+                               TRUE, ulStamp);
+   if(iStatus == SUCCESS)
+      pcResult = FT_toStringIn(oPTree->oFTree);
+   PagedFT_trim(oPTree);
+   PagedFT_unlock(oPTree);
+   return pcResult;
+}
+
+int PagedFT_getPagingStats(PagedFT_T oPTree, size_t *pulPageIns,
+                           size_t *pulEvictions, size_t *pulResident) {
+   assert(oPTree != NULL);
+
+   PagedFT_lockShared(oPTree);
+   if(pulPageIns != NULL)
+      *pulPageIns = oPTree->ulPageIns;
+   if(pulEvictions != NULL)
+      *pulEvictions = oPTree->ulEvictions;
+   if(pulResident != NULL)
+      *pulResident = PagedFT_getResident(oPTree);
+   PagedFT_unlock(oPTree);
+   return SUCCESS;
+}
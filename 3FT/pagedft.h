@@ -0,0 +1,101 @@
+/*--------------------------------------------------------------------*/
+/* pagedft.h                                                          */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef PAGEDFT_INCLUDED
+#define PAGEDFT_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A PagedFT_T is a File Tree opened from an image (see FT_saveImage)
+  whose directories are paged into memory only as operations first
+  pass through them, for hierarchies too large to hold in memory of
+  which only part is in use. Opening one maps the image and makes the
+  root resident as an unloaded stub, whatever the image's size; an
+  operation on a path first pages in each unloaded directory along
+  it, which adds the directory's children to memory, its directories
+  as stubs in turn. Once more nodes are resident than the limit that
+  the PagedFT_T was opened with, the least recently used directories
+  whose subtrees are clean, unchanged since they were paged in, are
+  evicted back to stubs, so that the resident part of the hierarchy
+  tracks its working set. A subtree that has been changed stays
+  resident.
+
+  The contents of files paged in from the image lie in its mapping:
+  they must not be written or freed, and are valid until the
+  PagedFT_T is freed. The contents of files inserted are the
+  client's, as in an FT_T.
+
+  A PagedFT_T offers the FT's operations on absolute paths, which
+  return what they would for a single FT_T holding the same
+  hierarchy, except that they return IO_ERROR or MEMORY_ERROR, as a
+  status or as the failure value of a function that returns none, if
+  a directory along the path could not be paged in. A PagedFT_T may
+  be shared between threads: operations on paths whose directories
+  are all resident, and that only read, run concurrently, and all
+  others one at a time.
+*/
+typedef struct pagedFT *PagedFT_T;
+
+/*
+  Opens the image in the file named pcImage as a new PagedFT_T that
+  keeps no more than about ulMaxResident nodes resident, and sets
+  *poPResult to it. Returns SUCCESS, or:
+  * IO_ERROR if the file cannot be opened or mapped, or does not hold
+    an image that FT_openImage could open
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int PagedFT_open(const char *pcImage, size_t ulMaxResident,
+                 PagedFT_T *poPResult);
+
+/*
+  Frees oPTree and all of its contents, and unmaps its image. Does
+  nothing if oPTree is NULL. No other operation may overlap
+  PagedFT_free.
+*/
+void PagedFT_free(PagedFT_T oPTree);
+
+/*
+  Each of the following functions behaves as the FT function of the
+  same name, but on oPTree. PagedFT_toString pages in the whole
+  hierarchy, before evicting what the limit does not allow.
+*/
+
+int PagedFT_insertDir(PagedFT_T oPTree, const char *pcPath);
+
+boolean PagedFT_containsDir(PagedFT_T oPTree, const char *pcPath);
+
+int PagedFT_rmDir(PagedFT_T oPTree, const char *pcPath);
+
+int PagedFT_insertFile(PagedFT_T oPTree, const char *pcPath,
+                       void *pvContents, size_t ulLength);
+
+boolean PagedFT_containsFile(PagedFT_T oPTree, const char *pcPath);
+
+int PagedFT_rmFile(PagedFT_T oPTree, const char *pcPath);
+
+void *PagedFT_getFileContents(PagedFT_T oPTree, const char *pcPath);
+
+void *PagedFT_replaceFileContents(PagedFT_T oPTree, const char *pcPath,
+                                  void *pvNewContents,
+                                  size_t ulNewLength);
+
+int PagedFT_stat(PagedFT_T oPTree, const char *pcPath,
+                 boolean *pbIsFile, size_t *pulSize);
+
+int PagedFT_getCount(PagedFT_T oPTree, size_t *pulCount);
+
+char *PagedFT_toString(PagedFT_T oPTree);
+
+/*
+  Stores oPTree's paging counters into the non-NULL parameters: the
+  number of directories paged in and evicted since it was opened, and
+  the number of nodes now resident. Returns SUCCESS.
+*/
+int PagedFT_getPagingStats(PagedFT_T oPTree, size_t *pulPageIns,
+                           size_t *pulEvictions, size_t *pulResident);
+
+#endif
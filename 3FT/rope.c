@@ -0,0 +1,298 @@
+/*--------------------------------------------------------------------*/
+/* rope.c                                                             */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rope.h"
+
+/*
+  A version's bytes lie in chunks of CHUNK_BYTES bytes, grouped in
+  leaves of LEAF_CHUNKS chunks, so that a write into a version copies
+  the version's array of leaves, the leaf of each chunk it touches,
+  and those chunks, but nothing else: about 8 KB for a small write,
+  however long the version.
+*/
+enum { CHUNK_BYTES = 4096, LEAF_CHUNKS = 256 };
+
+/* The number of bytes a leaf covers */
+#define LEAF_BYTES ((size_t) CHUNK_BYTES * LEAF_CHUNKS)
+
+/*
+  A chunk of bytes, shared by every version that holds it. The bytes
+  of the last chunk of a version past the version's end are zeros.
+*/
+struct chunk {
+   /* the number of leaves holding the chunk */
+   size_t ulRefs;
+   /* the bytes */
+   unsigned char aucBytes[CHUNK_BYTES];
+};
+
+/*
+  A leaf of chunks, shared by every version that holds it. A NULL
+  chunk holds only zeros.
+*/
+struct leaf {
+   /* the number of versions holding the leaf */
+   size_t ulRefs;
+   /* the chunks */
+   struct chunk *apsChunks[LEAF_CHUNKS];
+};
+
+/* A version of a byte string. A NULL leaf holds only zeros. */
+struct rope {
+   /* the number of bytes in the version */
+   size_t ulLength;
+   /* the number of leaves, enough to cover ulLength bytes */
+   size_t ulLeaves;
+   /* the leaves */
+   struct leaf **ppsLeaves;
+   /* the version's bytes in one block, or NULL until Rope_flatten
+      makes it */
+   void *pvFlat;
+};
+
+/* Adds a reference to the count at pulRefs. */
+static void Rope_hold(size_t *pulRefs) {
+   assert(pulRefs != NULL);
+
+   (void) __atomic_add_fetch(pulRefs, 1, __ATOMIC_RELAXED);
+}
+
+/*
+  Drops a reference from the count at pulRefs, and returns TRUE if it
+  was the last.
+*/
+static boolean Rope_drop(size_t *pulRefs) {
+   assert(pulRefs != NULL);
+
+   return (boolean) (__atomic_sub_fetch(pulRefs, 1, __ATOMIC_ACQ_REL)
+                     == 0);
+}
+
+/*
+  Drops a version's reference to psLeaf, freeing it and the chunks
+  that no other leaf holds if it was the last. Does nothing if psLeaf
+  is NULL.
+*/
+static void Rope_dropLeaf(struct leaf *psLeaf) {
+   size_t i;
+
+   if(psLeaf == NULL || !Rope_drop(&psLeaf->ulRefs))
+      return;
+
+   for(i = 0; i < LEAF_CHUNKS; i++)
+      if(psLeaf->apsChunks[i] != NULL
+         && Rope_drop(&psLeaf->apsChunks[i]->ulRefs))
+         free(psLeaf->apsChunks[i]);
+   free(psLeaf);
+}
+
+/*
+  Returns a new leaf holding the chunks of psOld, or NULL chunks if
+  psOld is NULL, with the bytes of the write of ulLength bytes at
+  pvBytes to ulOffset that fall within the leaf starting at byte
+  ulLeafStart copied into new chunks. Returns NULL if insufficient
+  memory is available.
+*/
+static struct leaf *Rope_writeLeaf(struct leaf *psOld,
+                                   size_t ulLeafStart, size_t ulOffset,
+                                   const unsigned char *pucBytes,
+                                   size_t ulLength) {
+   struct leaf *psLeaf;
+   struct chunk *psChunk;
+   struct chunk *psNew;
+   size_t ulEnd = ulOffset + ulLength;
+   size_t ulChunkStart;
+   size_t ulFrom, ulTo;
+   size_t i;
+
+   assert(pucBytes != NULL);
+
+   psLeaf = calloc(1, sizeof(struct leaf));
+   if(psLeaf == NULL)
+      return NULL;
+   psLeaf->ulRefs = 1;
+
+   for(i = 0; i < LEAF_CHUNKS; i++) {
+      psChunk = psOld == NULL ? NULL : psOld->apsChunks[i];
+      ulChunkStart = ulLeafStart + i * CHUNK_BYTES;
+
+      /* share the chunks that the write does not touch */
+      if(ulEnd <= ulChunkStart || ulOffset >= ulChunkStart + CHUNK_BYTES) {
+         if(psChunk != NULL)
+            Rope_hold(&psChunk->ulRefs);
+         psLeaf->apsChunks[i] = psChunk;
+         continue;
+      }
+
+      psNew = malloc(sizeof(struct chunk));
+      if(psNew == NULL) {
+         Rope_dropLeaf(psLeaf);
+         return NULL;
+      }
+      psNew->ulRefs = 1;
+      if(psChunk != NULL)
+         memcpy(psNew->aucBytes, psChunk->aucBytes, CHUNK_BYTES);
+      else
+         memset(psNew->aucBytes, 0, CHUNK_BYTES);
+      ulFrom = ulOffset > ulChunkStart ? ulOffset : ulChunkStart;
+      ulTo = ulEnd < ulChunkStart + CHUNK_BYTES ? ulEnd
+         : ulChunkStart + CHUNK_BYTES;
+      memcpy(psNew->aucBytes + (ulFrom - ulChunkStart),
+             pucBytes + (ulFrom - ulOffset), ulTo - ulFrom);
+      psLeaf->apsChunks[i] = psNew;
+   }
+
+   return psLeaf;
+}
+
+Rope_T Rope_write(Rope_T oRBase, size_t ulOffset, const void *pvBytes,
+                  size_t ulLength) {
+   Rope_T oRNew;
+   struct leaf *psOld;
+   size_t ulNewLength;
+   size_t ulLeafStart;
+   size_t i;
+
+   assert(pvBytes != NULL || ulLength == 0);
+
+   if(ulLength > (size_t) -1 - ulOffset)
+      return NULL;
+
+   /* a write of no bytes extends nothing */
+   ulNewLength = oRBase == NULL ? 0 : oRBase->ulLength;
+   if(ulLength != 0 && ulOffset + ulLength > ulNewLength)
+      ulNewLength = ulOffset + ulLength;
+
+   oRNew = malloc(sizeof(struct rope));
+   if(oRNew == NULL)
+      return NULL;
+   oRNew->ulLength = ulNewLength;
+   oRNew->ulLeaves = ulNewLength / LEAF_BYTES
+      + (ulNewLength % LEAF_BYTES != 0);
+   oRNew->pvFlat = NULL;
+   oRNew->ppsLeaves = calloc(oRNew->ulLeaves != 0 ? oRNew->ulLeaves : 1,
+                             sizeof(struct leaf *));
+   if(oRNew->ppsLeaves == NULL) {
+      free(oRNew);
+      return NULL;
+   }
+
+   for(i = 0; i < oRNew->ulLeaves; i++) {
+      psOld = oRBase != NULL && i < oRBase->ulLeaves
+         ? oRBase->ppsLeaves[i] : NULL;
+      ulLeafStart = i * LEAF_BYTES;
+
+      /* share the leaves that the write does not touch */
+      if(ulLength == 0 || ulOffset + ulLength <= ulLeafStart
+         || ulOffset >= ulLeafStart + LEAF_BYTES) {
+         if(psOld != NULL)
+            Rope_hold(&psOld->ulRefs);
+         oRNew->ppsLeaves[i] = psOld;
+         continue;
+      }
+
+      oRNew->ppsLeaves[i] = Rope_writeLeaf(psOld, ulLeafStart, ulOffset,
+                                           pvBytes, ulLength);
+      if(oRNew->ppsLeaves[i] == NULL) {
+         Rope_free(oRNew);
+         return NULL;
+      }
+   }
+
+   return oRNew;
+}
+
+void Rope_free(void *pvRope) {
+   Rope_T oRRope = pvRope;
+   size_t i;
+
+   assert(oRRope != NULL);
+
+   for(i = 0; i < oRRope->ulLeaves; i++)
+      Rope_dropLeaf(oRRope->ppsLeaves[i]);
+   free(oRRope->ppsLeaves);
+   free(oRRope->pvFlat);
+   free(oRRope);
+}
+
+size_t Rope_getLength(Rope_T oRRope) {
+   assert(oRRope != NULL);
+
+   return oRRope->ulLength;
+}
+
+size_t Rope_read(Rope_T oRRope, size_t ulOffset, void *pvBuf,
+                 size_t ulLength) {
+   struct leaf *psLeaf;
+   struct chunk *psChunk;
+   size_t ulPosition;
+   size_t ulWithin;
+   size_t ulCopied;
+   size_t ulDone = 0;
+
+   assert(oRRope != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+
+   if(ulOffset >= oRRope->ulLength)
+      return 0;
+   if(ulLength > oRRope->ulLength - ulOffset)
+      ulLength = oRRope->ulLength - ulOffset;
+
+   while(ulDone < ulLength) {
+      ulPosition = ulOffset + ulDone;
+      psLeaf = oRRope->ppsLeaves[ulPosition / LEAF_BYTES];
+      psChunk = psLeaf == NULL ? NULL
+         : psLeaf->apsChunks[ulPosition % LEAF_BYTES / CHUNK_BYTES];
+      ulWithin = ulPosition % CHUNK_BYTES;
+      ulCopied = CHUNK_BYTES - ulWithin;
+      if(ulCopied > ulLength - ulDone)
+         ulCopied = ulLength - ulDone;
+
+      if(psChunk != NULL)
+         memcpy((unsigned char *) pvBuf + ulDone,
+                psChunk->aucBytes + ulWithin, ulCopied);
+      else
+         memset((unsigned char *) pvBuf + ulDone, 0, ulCopied);
+      ulDone += ulCopied;
+   }
+
+   return ulLength;
+}
+
+boolean Rope_isFlat(Rope_T oRRope) {
+   assert(oRRope != NULL);
+
+   return (boolean) (__atomic_load_n(&oRRope->pvFlat, __ATOMIC_ACQUIRE)
+                     != NULL);
+}
+
+void *Rope_flatten(Rope_T oRRope) {
+   void *pvFlat;
+   void *pvExpected = NULL;
+
+   assert(oRRope != NULL);
+
+   pvFlat = __atomic_load_n(&oRRope->pvFlat, __ATOMIC_ACQUIRE);
+   if(pvFlat != NULL)
+      return pvFlat;
+
+   pvFlat = malloc(oRRope->ulLength != 0 ? oRRope->ulLength : 1);
+   if(pvFlat == NULL)
+      return NULL;
+   (void) Rope_read(oRRope, 0, pvFlat, oRRope->ulLength);
+
+   /* of threads flattening the version at once, the first to publish
+      its block wins */
+   if(!__atomic_compare_exchange_n(&oRRope->pvFlat, &pvExpected, pvFlat,
+                                   0, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+      free(pvFlat);
+      return pvExpected;
+   }
+   return pvFlat;
+}
@@ -0,0 +1,63 @@
+/*--------------------------------------------------------------------*/
+/* rope.h                                                             */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef ROPE_INCLUDED
+#define ROPE_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Rope_T is one version of a byte string stored in fixed-size
+  chunks rather than in one block, so that writing a few bytes into a
+  long string copies only the chunks they fall in. Versions are never
+  changed once made: a write makes a new version that shares every
+  chunk it does not touch with the version it was made from, so an
+  older version stays intact for whoever still holds it. Chunks are
+  reference counted, and versions may be made, read and freed by
+  different threads at once.
+*/
+typedef struct rope *Rope_T;
+
+/*
+  Returns a new version that holds the bytes of oRBase, or none if
+  oRBase is NULL, with the ulLength bytes at pvBytes written at
+  ulOffset, or NULL if insufficient memory is available. The version
+  is extended as far as the write reaches, and any gap between its
+  old end and ulOffset reads as zeros. oRBase is unchanged.
+*/
+Rope_T Rope_write(Rope_T oRBase, size_t ulOffset, const void *pvBytes,
+                  size_t ulLength);
+
+/*
+  Frees the version pvRope, a Rope_T, and every chunk that no other
+  version shares. Has the signature of a function that frees
+  contents, so that versions can be given owners (see Node_newOwner).
+*/
+void Rope_free(void *pvRope);
+
+/* Returns the number of bytes in oRRope. */
+size_t Rope_getLength(Rope_T oRRope);
+
+/*
+  Copies up to ulLength bytes of oRRope from ulOffset into pvBuf, and
+  returns the number copied: fewer than ulLength if oRRope ends
+  first, and 0 if ulOffset is at or past its end.
+*/
+size_t Rope_read(Rope_T oRRope, size_t ulOffset, void *pvBuf,
+                 size_t ulLength);
+
+/* Returns TRUE if oRRope has its flattened block, FALSE if not. */
+boolean Rope_isFlat(Rope_T oRRope);
+
+/*
+  Returns the bytes of oRRope in one contiguous block, valid until
+  oRRope is freed, or NULL if insufficient memory is available. The
+  block is made by the first call and kept with the version, so it
+  costs the version's length in memory until then.
+*/
+void *Rope_flatten(Rope_T oRRope);
+
+#endif
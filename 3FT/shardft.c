@@ -0,0 +1,625 @@
+/*--------------------------------------------------------------------*/
+/* shardft.c                                                          */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for pthread_rwlock_t */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef FT_NO_LOCKING
+#include <pthread.h>
+#endif
+#include "dynarray.h"
+#include "ft.h"
+#include "shardft.h"
+
+enum { CACHE_LINE = 64 };
+
+/* One shard of a ShardFT_T */
+struct shard {
+   /* the FT holding the root and the subtrees of the root's children
+      that hash to this shard */
+   FT_T oFTree;
+#ifndef FT_NO_LOCKING
+   /* the lock that writes routed to this shard hold shared, and that
+      operations involving every shard hold exclusively */
+   pthread_rwlock_t sLock;
+#endif
+   /* padding, so that no two shards' locks share a cache line */
+   char acPad[CACHE_LINE];
+};
+
+/*
+  A File Tree partitioned into shards. Either every shard holds the
+  root or none does: the shards agree on the root because only
+  operations holding every shard's lock create or remove it.
+*/
+struct shardFT {
+   /* the shards */
+   struct shard *psShards;
+   /* the number of shards */
+   size_t ulShards;
+   /* TRUE if every shard holds the root, or FALSE if none does */
+   boolean bHasRoot;
+};
+
+/* A directory or file that is a child of the root, and its subtree,
+   in the string representation of one shard */
+struct rootChild {
+   /* the child's path, which its line ends with */
+   const char *pcPath;
+   /* the lines of the child's subtree below it */
+   const char *pcBelow;
+   /* the length of those lines */
+   size_t ulBelowLength;
+   /* whether the child is a file */
+   boolean bIsFile;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns whether pcPath names the root, having only one component. */
+static boolean ShardFT_isRootPath(const char *pcPath) {
+   assert(pcPath != NULL);
+
+   return (boolean) (strchr(pcPath, '/') == NULL);
+}
+
+/*
+  Returns the index of the shard of oSTree that absolute path pcPath
+  belongs to: the hash of its second component, or 0 if it has none.
+  A malformed path may be routed to any shard, which rejects it.
+*/
+static size_t ShardFT_route(ShardFT_T oSTree, const char *pcPath) {
+   const unsigned long FNV_PRIME = 16777619UL;
+   const unsigned long MASK = 0xffffffffUL;
+   unsigned long ulHash = 2166136261UL;
+   const char *pc;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   pc = strchr(pcPath, '/');
+   if(pc == NULL)
+      return 0;
+
+   /* a 32-bit FNV-1a hash of the second component */
+   for(pc++; *pc != '\0' && *pc != '/'; pc++)
+      ulHash = ((ulHash ^ (unsigned char) *pc) * FNV_PRIME) & MASK;
+   return (size_t) (ulHash % oSTree->ulShards);
+}
+
+/* Acquires the lock of oSTree's ulShard'th shard shared. */
+static void ShardFT_lockShard(ShardFT_T oSTree, size_t ulShard) {
+   assert(oSTree != NULL);
+   assert(ulShard < oSTree->ulShards);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_rdlock(&oSTree->psShards[ulShard].sLock);
+#else
+   (void) oSTree;
+   (void) ulShard;
+#endif
+}
+
+/* Releases the lock of oSTree's ulShard'th shard. */
+static void ShardFT_unlockShard(ShardFT_T oSTree, size_t ulShard) {
+   assert(oSTree != NULL);
+   assert(ulShard < oSTree->ulShards);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_rwlock_unlock(&oSTree->psShards[ulShard].sLock);
+#else
+   (void) oSTree;
+   (void) ulShard;
+#endif
+}
+
+/*
+  Acquires the locks of all of oSTree's shards exclusively, in order
+  of index, so that no two threads doing so deadlock.
+*/
+static void ShardFT_lockAll(ShardFT_T oSTree) {
+   size_t i;
+
+   assert(oSTree != NULL);
+
+   for(i = 0; i < oSTree->ulShards; i++) {
+#ifndef FT_NO_LOCKING
+      (void) pthread_rwlock_wrlock(&oSTree->psShards[i].sLock);
+#endif
+   }
+}
+
+/* Releases the locks that ShardFT_lockAll acquired. */
+static void ShardFT_unlockAll(ShardFT_T oSTree) {
+   size_t i;
+
+   assert(oSTree != NULL);
+
+   for(i = oSTree->ulShards; i > 0; i--) {
+#ifndef FT_NO_LOCKING
+      (void) pthread_rwlock_unlock(&oSTree->psShards[i - 1].sLock);
+#endif
+   }
+}
+
+/* Returns the FT of oSTree's shard that pcPath belongs to. */
+static FT_T ShardFT_shardOf(ShardFT_T oSTree, const char *pcPath) {
+   assert(oSTree != NULL);
+
+   return oSTree->psShards[ShardFT_route(oSTree, pcPath)].oFTree;
+}
+
+/*--------------------------------------------------------------------*/
+
+ShardFT_T ShardFT_new(size_t ulShards) {
+   ShardFT_T oSNew;
+   size_t i;
+
+   assert(ulShards > 0);
+
+   oSNew = malloc(sizeof(struct shardFT));
+   if(oSNew == NULL)
+      return NULL;
+   oSNew->psShards = malloc(ulShards * sizeof(struct shard));
+   if(oSNew->psShards == NULL) {
+      free(oSNew);
+      return NULL;
+   }
+
+   for(i = 0; i < ulShards; i++) {
+      oSNew->psShards[i].oFTree = FT_new();
+#ifndef FT_NO_LOCKING
+      if(oSNew->psShards[i].oFTree != NULL &&
+         pthread_rwlock_init(&oSNew->psShards[i].sLock, NULL) != 0) {
+         FT_free(oSNew->psShards[i].oFTree);
+         oSNew->psShards[i].oFTree = NULL;
+      }
+#endif
+      if(oSNew->psShards[i].oFTree == NULL) {
+         oSNew->ulShards = i;
+         ShardFT_free(oSNew);
+         return NULL;
+      }
+   }
+   oSNew->ulShards = ulShards;
+   oSNew->bHasRoot = FALSE;
+
+   return oSNew;
+}
+
+void ShardFT_free(ShardFT_T oSTree) {
+   size_t i;
+
+   if(oSTree == NULL)
+      return;
+
+   for(i = 0; i < oSTree->ulShards; i++) {
+      FT_free(oSTree->psShards[i].oFTree);
+#ifndef FT_NO_LOCKING
+      (void) pthread_rwlock_destroy(&oSTree->psShards[i].sLock);
+#endif
+   }
+   free(oSTree->psShards);
+   free(oSTree);
+}
+
+/*
+  Inserts a directory (if bIsFile is FALSE) or a file with contents
+  pvContents of size ulLength bytes (if bIsFile is TRUE) into oSTree
+  with absolute path pcPath, with the locks of all of oSTree's shards
+  held exclusively. If the insertion creates the root, creates it in
+  every other shard too, or else undoes the insertion. Returns the
+  same statuses as FT_insertDir or FT_insertFile.
+*/
+static int ShardFT_insertAll(ShardFT_T oSTree, const char *pcPath,
+                             boolean bIsFile, void *pvContents,
+                             size_t ulLength) {
+   int iStatus;
+   size_t ulHome, ulRootLength, i;
+   char *pcRoot;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   /* if the insertion creates the root, pcPath is well-formed and its
+      first component names it */
+   ulRootLength = strcspn(pcPath, "/");
+   pcRoot = malloc(ulRootLength + 1);
+   if(pcRoot == NULL)
+      return MEMORY_ERROR;
+   strncpy(pcRoot, pcPath, ulRootLength);
+   pcRoot[ulRootLength] = '\0';
+
+   ulHome = ShardFT_route(oSTree, pcPath);
+   if(bIsFile)
+      iStatus = FT_insertFileIn(oSTree->psShards[ulHome].oFTree, pcPath,
+                                pvContents, ulLength);
+   else
+      iStatus = FT_insertDirIn(oSTree->psShards[ulHome].oFTree, pcPath);
+   if(iStatus != SUCCESS || oSTree->bHasRoot) {
+      free(pcRoot);
+      return iStatus;
+   }
+
+   for(i = 0; i < oSTree->ulShards; i++) {
+      if(i == ulHome)
+         continue;
+      iStatus = FT_insertDirIn(oSTree->psShards[i].oFTree, pcRoot);
+      if(iStatus != SUCCESS)
+         break;
+   }
+
+   if(iStatus != SUCCESS) {
+      /* removing the root from every shard that has one undoes it */
+      for(i = 0; i < oSTree->ulShards; i++)
+         (void) FT_rmDirIn(oSTree->psShards[i].oFTree, pcRoot);
+   }
+   else
+      oSTree->bHasRoot = TRUE;
+
+   free(pcRoot);
+   return iStatus;
+}
+
+/*
+  Inserts a node into oSTree as ShardFT_insertAll does. A write below
+  the root needs only the lock of its own shard, unless the root does
+  not exist yet: every shard must then receive it at once.
+*/
+static int ShardFT_insert(ShardFT_T oSTree, const char *pcPath,
+                          boolean bIsFile, void *pvContents,
+                          size_t ulLength) {
+   int iStatus;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   if(!ShardFT_isRootPath(pcPath)) {
+      size_t ulShard = ShardFT_route(oSTree, pcPath);
+
+      ShardFT_lockShard(oSTree, ulShard);
+      if(oSTree->bHasRoot) {
+         if(bIsFile)
+            iStatus = FT_insertFileIn(oSTree->psShards[ulShard].oFTree,
+                                      pcPath, pvContents, ulLength);
+         else
+            iStatus = FT_insertDirIn(oSTree->psShards[ulShard].oFTree,
+                                     pcPath);
+         ShardFT_unlockShard(oSTree, ulShard);
+         return iStatus;
+      }
+      ShardFT_unlockShard(oSTree, ulShard);
+   }
+
+   ShardFT_lockAll(oSTree);
+   iStatus = ShardFT_insertAll(oSTree, pcPath, bIsFile, pvContents,
+                               ulLength);
+   ShardFT_unlockAll(oSTree);
+   return iStatus;
+}
+
+int ShardFT_insertDir(ShardFT_T oSTree, const char *pcPath) {
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   return ShardFT_insert(oSTree, pcPath, FALSE, NULL, 0);
+}
+
+int ShardFT_insertFile(ShardFT_T oSTree, const char *pcPath,
+                       void *pvContents, size_t ulLength) {
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   return ShardFT_insert(oSTree, pcPath, TRUE, pvContents, ulLength);
+}
+
+int ShardFT_rmDir(ShardFT_T oSTree, const char *pcPath) {
+   int iStatus;
+   size_t ulShard, i;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   ulShard = ShardFT_route(oSTree, pcPath);
+   if(!ShardFT_isRootPath(pcPath)) {
+      ShardFT_lockShard(oSTree, ulShard);
+      iStatus = FT_rmDirIn(oSTree->psShards[ulShard].oFTree, pcPath);
+      ShardFT_unlockShard(oSTree, ulShard);
+      return iStatus;
+   }
+
+   /* removing the root removes it from every shard */
+   ShardFT_lockAll(oSTree);
+   iStatus = FT_rmDirIn(oSTree->psShards[0].oFTree, pcPath);
+   if(iStatus == SUCCESS) {
+      for(i = 1; i < oSTree->ulShards; i++)
+         (void) FT_rmDirIn(oSTree->psShards[i].oFTree, pcPath);
+      oSTree->bHasRoot = FALSE;
+   }
+   ShardFT_unlockAll(oSTree);
+   return iStatus;
+}
+
+int ShardFT_rmFile(ShardFT_T oSTree, const char *pcPath) {
+   int iStatus;
+   size_t ulShard;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   ulShard = ShardFT_route(oSTree, pcPath);
+   ShardFT_lockShard(oSTree, ulShard);
+   iStatus = FT_rmFileIn(oSTree->psShards[ulShard].oFTree, pcPath);
+   ShardFT_unlockShard(oSTree, ulShard);
+   return iStatus;
+}
+
+void *ShardFT_replaceFileContents(ShardFT_T oSTree, const char *pcPath,
+                                  void *pvNewContents,
+                                  size_t ulNewLength) {
+   void *pvOldContents;
+   size_t ulShard;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   ulShard = ShardFT_route(oSTree, pcPath);
+   ShardFT_lockShard(oSTree, ulShard);
+   pvOldContents = FT_replaceFileContentsIn(
+      oSTree->psShards[ulShard].oFTree, pcPath, pvNewContents,
+      ulNewLength);
+   ShardFT_unlockShard(oSTree, ulShard);
+   return pvOldContents;
+}
+
+/* Reads take no lock of oSTree's, as they take none of the FT's. */
+
+boolean ShardFT_containsDir(ShardFT_T oSTree, const char *pcPath) {
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   return FT_containsDirIn(ShardFT_shardOf(oSTree, pcPath), pcPath);
+}
+
+boolean ShardFT_containsFile(ShardFT_T oSTree, const char *pcPath) {
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   return FT_containsFileIn(ShardFT_shardOf(oSTree, pcPath), pcPath);
+}
+
+void *ShardFT_getFileContents(ShardFT_T oSTree, const char *pcPath) {
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   return FT_getFileContentsIn(ShardFT_shardOf(oSTree, pcPath), pcPath);
+}
+
+int ShardFT_stat(ShardFT_T oSTree, const char *pcPath,
+                 boolean *pbIsFile, size_t *pulSize) {
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   return FT_statIn(ShardFT_shardOf(oSTree, pcPath), pcPath, pbIsFile,
+                    pulSize);
+}
+
+int ShardFT_getCount(ShardFT_T oSTree, size_t *pulCount) {
+   size_t ulCount, ulTotal = 0;
+   size_t i;
+
+   assert(oSTree != NULL);
+   assert(pulCount != NULL);
+
+   ShardFT_lockAll(oSTree);
+   for(i = 0; i < oSTree->ulShards; i++) {
+      (void) FT_getCountIn(oSTree->psShards[i].oFTree, &ulCount);
+      ulTotal += ulCount;
+   }
+   /* every shard counts the root */
+   if(oSTree->bHasRoot)
+      ulTotal -= oSTree->ulShards - 1;
+   ShardFT_unlockAll(oSTree);
+
+   *pulCount = ulTotal;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Compares the root's children *psFirst and *psSecond in the order of
+  FT_toString: files before directories, each in lexicographic order.
+*/
+static int ShardFT_compareChildren(const struct rootChild *psFirst,
+                                   const struct rootChild *psSecond) {
+   assert(psFirst != NULL);
+   assert(psSecond != NULL);
+
+   if(psFirst->bIsFile != psSecond->bIsFile)
+      return psFirst->bIsFile ? -1 : 1;
+   return strcmp(psFirst->pcPath, psSecond->pcPath);
+}
+
+/*
+  Splits pcString, the string representation of shard oFTree, into
+  the root's children and their subtrees, adding each to the array
+  psChildren from index *pulChildren on and pointers to them to
+  oDChildren, and advancing *pulChildren. Terminates each child's
+  path in pcString in place. The root must exist. Returns SUCCESS, or
+  MEMORY_ERROR if oDChildren cannot grow.
+*/
+static int ShardFT_splitShard(FT_T oFTree, char *pcString,
+                              struct rootChild *psChildren,
+                              size_t *pulChildren,
+                              DynArray_T oDChildren) {
+   char *pc;
+
+   assert(oFTree != NULL);
+   assert(pcString != NULL);
+   assert(psChildren != NULL);
+   assert(pulChildren != NULL);
+   assert(oDChildren != NULL);
+
+   /* skip the root's line */
+   pc = strchr(pcString, '\n') + 1;
+   while(*pc != '\0') {
+      struct rootChild *psChild = &psChildren[*pulChildren];
+      size_t ulPathLength = (size_t) (strchr(pc, '\n') - pc);
+
+      /* the child's line, then the lines of its descendants */
+      psChild->pcPath = pc;
+      pc[ulPathLength] = '\0';
+      psChild->pcBelow = pc + ulPathLength + 1;
+      for(pc = pc + ulPathLength + 1;
+          !strncmp(pc, psChild->pcPath, ulPathLength) &&
+             pc[ulPathLength] == '/';
+          pc = strchr(pc, '\n') + 1)
+         ;
+      psChild->ulBelowLength = (size_t) (pc - psChild->pcBelow);
+
+      /* only a child without lines below it may be a file */
+      psChild->bIsFile = FALSE;
+      if(psChild->ulBelowLength == 0)
+         psChild->bIsFile = FT_containsFileIn(oFTree, psChild->pcPath);
+
+      if(!DynArray_add(oDChildren, psChild))
+         return MEMORY_ERROR;
+      (*pulChildren)++;
+   }
+   return SUCCESS;
+}
+
+/*
+  Merges the string representations ppcStrings of the shards of
+  oSTree, whose root exists, into one of ulLength bytes (including
+  the terminating null) by interleaving the root's children in order.
+  The strings may be modified. Returns the merged string, or NULL if
+  insufficient memory is available.
+*/
+static char *ShardFT_mergeStrings(ShardFT_T oSTree, char **ppcStrings,
+                                  size_t ulLength) {
+   struct rootChild *psChildren;
+   DynArray_T oDChildren;
+   char *pcResult = NULL;
+   size_t ulRootLength, ulChildren, ulMax;
+   size_t i;
+
+   assert(oSTree != NULL);
+   assert(ppcStrings != NULL);
+   assert(oSTree->bHasRoot);
+
+   /* each shard's root has at most one child per line after its own */
+   ulMax = 0;
+   for(i = 0; i < oSTree->ulShards; i++) {
+      const char *pc;
+      for(pc = strchr(ppcStrings[i], '\n') + 1; *pc != '\0'; pc++)
+         if(*pc == '\n')
+            ulMax++;
+   }
+
+   psChildren = malloc((ulMax + 1) * sizeof(struct rootChild));
+   if(psChildren == NULL)
+      return NULL;
+   oDChildren = DynArray_new(0);
+   if(oDChildren == NULL) {
+      free(psChildren);
+      return NULL;
+   }
+
+   ulChildren = 0;
+   for(i = 0; i < oSTree->ulShards; i++)
+      if(ShardFT_splitShard(oSTree->psShards[i].oFTree, ppcStrings[i],
+                            psChildren, &ulChildren, oDChildren)
+         != SUCCESS)
+         break;
+   if(i == oSTree->ulShards)
+      pcResult = malloc(ulLength);
+
+   if(pcResult != NULL) {
+      char *pcOut = pcResult;
+
+      DynArray_sort(oDChildren,
+         (int (*)(const void *, const void *)) ShardFT_compareChildren);
+
+      ulRootLength = (size_t) (strchr(ppcStrings[0], '\n')
+                               - ppcStrings[0]) + 1;
+      memcpy(pcOut, ppcStrings[0], ulRootLength);
+      pcOut += ulRootLength;
+      for(i = 0; i < DynArray_getLength(oDChildren); i++) {
+         struct rootChild *psChild = DynArray_get(oDChildren, i);
+         size_t ulPathLength = strlen(psChild->pcPath);
+
+         memcpy(pcOut, psChild->pcPath, ulPathLength);
+         pcOut += ulPathLength;
+         *pcOut++ = '\n';
+         memcpy(pcOut, psChild->pcBelow, psChild->ulBelowLength);
+         pcOut += psChild->ulBelowLength;
+      }
+      *pcOut = '\0';
+      assert((size_t) (pcOut - pcResult) + 1 == ulLength);
+   }
+
+   DynArray_free(oDChildren);
+   free(psChildren);
+   return pcResult;
+}
+
+/*
+  ShardFT_toString, with the locks of all of oSTree's shards held
+  exclusively, so that the string reflects one state of every shard.
+*/
+static char *ShardFT_toStringAll(ShardFT_T oSTree) {
+   char **ppcStrings;
+   char *pcResult = NULL;
+   size_t ulLength = 1;
+   size_t ulRootLength = 0;
+   size_t i;
+
+   assert(oSTree != NULL);
+
+   if(!oSTree->bHasRoot)
+      return FT_toStringIn(oSTree->psShards[0].oFTree);
+
+   ppcStrings = calloc(oSTree->ulShards, sizeof(char *));
+   if(ppcStrings == NULL)
+      return NULL;
+
+   /* the root's line is the first of every shard's, and appears once
+      in the merged string */
+   for(i = 0; i < oSTree->ulShards; i++) {
+      ppcStrings[i] = FT_toStringIn(oSTree->psShards[i].oFTree);
+      if(ppcStrings[i] == NULL)
+         break;
+      ulLength += strlen(ppcStrings[i]);
+   }
+   if(i == oSTree->ulShards) {
+      ulRootLength = (size_t) (strchr(ppcStrings[0], '\n')
+                               - ppcStrings[0]) + 1;
+      ulLength -= (oSTree->ulShards - 1) * ulRootLength;
+      for(i = 1; i < oSTree->ulShards; i++)
+         assert(!strncmp(ppcStrings[i], ppcStrings[0], ulRootLength));
+      pcResult = ShardFT_mergeStrings(oSTree, ppcStrings, ulLength);
+   }
+
+   for(i = 0; i < oSTree->ulShards; i++)
+      free(ppcStrings[i]);
+   free(ppcStrings);
+   return pcResult;
+}
+
+char *ShardFT_toString(ShardFT_T oSTree) {
+   char *pcResult;
+
+   assert(oSTree != NULL);
+
+   ShardFT_lockAll(oSTree);
+   pcResult = ShardFT_toStringAll(oSTree);
+   ShardFT_unlockAll(oSTree);
+   return pcResult;
+}
@@ -0,0 +1,73 @@
+/*--------------------------------------------------------------------*/
+/* shardft.h                                                          */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef SHARDFT_INCLUDED
+#define SHARDFT_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A ShardFT_T is a File Tree partitioned into independent shards by
+  the second component of each path, for hierarchies whose root has
+  many children that are used independently of each other. Every
+  node below the root lives in the shard that the name of its
+  depth-2 ancestor hashes to, and each shard is an FT_T of its own,
+  with its own locks, node identifiers and count, so writes below
+  different children of the root contend for nothing, not even the
+  root. Only operations on the root itself, ShardFT_getCount and
+  ShardFT_toString involve every shard, and exclude all writes.
+
+  A ShardFT_T offers the FT's operations on absolute paths, which
+  return what they would for a single FT_T holding the same
+  hierarchy, and which may be shared between threads as an FT_T's
+  may (see ft.h).
+*/
+typedef struct shardFT *ShardFT_T;
+
+/*
+  Returns a new, empty ShardFT_T with ulShards shards, or NULL if
+  insufficient memory is available. ulShards must be positive.
+*/
+ShardFT_T ShardFT_new(size_t ulShards);
+
+/*
+  Frees oSTree and all of its contents. Does nothing if oSTree is
+  NULL. No other operation may overlap ShardFT_free.
+*/
+void ShardFT_free(ShardFT_T oSTree);
+
+/*
+  Each of the following functions behaves as the FT function of the
+  same name, but on oSTree.
+*/
+
+int ShardFT_insertDir(ShardFT_T oSTree, const char *pcPath);
+
+boolean ShardFT_containsDir(ShardFT_T oSTree, const char *pcPath);
+
+int ShardFT_rmDir(ShardFT_T oSTree, const char *pcPath);
+
+int ShardFT_insertFile(ShardFT_T oSTree, const char *pcPath,
+                       void *pvContents, size_t ulLength);
+
+boolean ShardFT_containsFile(ShardFT_T oSTree, const char *pcPath);
+
+int ShardFT_rmFile(ShardFT_T oSTree, const char *pcPath);
+
+void *ShardFT_getFileContents(ShardFT_T oSTree, const char *pcPath);
+
+void *ShardFT_replaceFileContents(ShardFT_T oSTree, const char *pcPath,
+                                  void *pvNewContents,
+                                  size_t ulNewLength);
+
+int ShardFT_stat(ShardFT_T oSTree, const char *pcPath,
+                 boolean *pbIsFile, size_t *pulSize);
+
+int ShardFT_getCount(ShardFT_T oSTree, size_t *pulCount);
+
+char *ShardFT_toString(ShardFT_T oSTree);
+
+#endif
@@ -0,0 +1,463 @@
+/*--------------------------------------------------------------------*/
+/* spill.c                                                            */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for pread, pwrite, ftruncate, posix_fadvise and pthread_mutex_t */
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifndef FT_NO_LOCKING
+#include <pthread.h>
+#endif
+#include "spill.h"
+
+/*
+  A run of bytes of a spill file: the place of the bytes of one or
+  more blocks, or, once no block holds it, a hole that later blocks
+  may fill
+*/
+struct extent {
+   /* the offset of the run in the file */
+   size_t ulOffset;
+   /* the number of bytes in the run */
+   size_t ulLength;
+   /* the number of blocks holding the run */
+   size_t ulRefs;
+   /* the next hole in the file, by offset, if the run is a hole */
+   struct extent *psNext;
+};
+
+/* A spill file */
+struct spill {
+   /* the file's descriptor */
+   int iFd;
+   /* the number of holds on the file: one per block, and one until it
+      is closed */
+   size_t ulRefs;
+   /* the size of the file, the end of its last block */
+   size_t ulEnd;
+   /* the holes left by blocks freed before the end, in order of
+      offset, no two adjacent */
+   struct extent *psHoles;
+   /* the numbers of blocks written, loaded back, and prefetched */
+   size_t ulSpills;
+   size_t ulReloads;
+   size_t ulPrefetches;
+#ifndef FT_NO_LOCKING
+   /* the lock serializing changes to the holes and the size */
+   pthread_mutex_t sLock;
+#endif
+};
+
+/* A block written to a spill file */
+struct spillBlock {
+   /* the file that the block was written to */
+   Spill_T oSFile;
+   /* the place of the block's bytes in the file */
+   struct extent *psExtent;
+   /* the loaded copy, or NULL until Spill_load makes it */
+   void *pvLoaded;
+};
+
+/* Acquires oSFile's lock. */
+static void Spill_lock(Spill_T oSFile) {
+   assert(oSFile != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_mutex_lock(&oSFile->sLock);
+#else
+   (void) oSFile;
+#endif
+}
+
+/* Releases oSFile's lock. */
+static void Spill_unlock(Spill_T oSFile) {
+   assert(oSFile != NULL);
+
+#ifndef FT_NO_LOCKING
+   (void) pthread_mutex_unlock(&oSFile->sLock);
+#else
+   (void) oSFile;
+#endif
+}
+
+/*
+  Places a run of psExtent->ulLength bytes in oSFile, in the first
+  hole large enough to hold it, or at the end, growing the file, if
+  there is none, and sets psExtent->ulOffset to where. Must be called
+  with oSFile's lock held.
+*/
+static void Spill_place(Spill_T oSFile, struct extent *psExtent) {
+   struct extent **ppsHole;
+   struct extent *psHole;
+
+   assert(oSFile != NULL);
+   assert(psExtent != NULL);
+
+   for(ppsHole = &oSFile->psHoles; *ppsHole != NULL;
+       ppsHole = &(*ppsHole)->psNext) {
+      psHole = *ppsHole;
+      if(psHole->ulLength < psExtent->ulLength)
+         continue;
+      psExtent->ulOffset = psHole->ulOffset;
+      psHole->ulOffset += psExtent->ulLength;
+      psHole->ulLength -= psExtent->ulLength;
+      if(psHole->ulLength == 0) {
+         *ppsHole = psHole->psNext;
+         free(psHole);
+      }
+      return;
+   }
+   psExtent->ulOffset = oSFile->ulEnd;
+   __atomic_store_n(&oSFile->ulEnd, oSFile->ulEnd + psExtent->ulLength,
+                    __ATOMIC_RELAXED);
+}
+
+/*
+  Makes run psExtent of oSFile, which no block holds, a hole, merging
+  it with the holes next to it, and shrinks the file if it ends with
+  the hole. Must be called with oSFile's lock held.
+*/
+static void Spill_vacate(Spill_T oSFile, struct extent *psExtent) {
+   /* the link to the hole that psExtent goes after, or NULL, and the
+      link where psExtent goes */
+   struct extent **ppsPrevLink = NULL;
+   struct extent **ppsLink;
+   struct extent *psNext;
+
+   assert(oSFile != NULL);
+   assert(psExtent != NULL);
+
+   if(psExtent->ulLength == 0) {
+      free(psExtent);
+      return;
+   }
+   for(ppsLink = &oSFile->psHoles;
+       *ppsLink != NULL && (*ppsLink)->ulOffset < psExtent->ulOffset;
+       ppsLink = &(*ppsLink)->psNext)
+      ppsPrevLink = ppsLink;
+
+   psNext = *ppsLink;
+   if(psNext != NULL
+      && psExtent->ulOffset + psExtent->ulLength == psNext->ulOffset) {
+      psExtent->ulLength += psNext->ulLength;
+      psExtent->psNext = psNext->psNext;
+      free(psNext);
+   }
+   else
+      psExtent->psNext = psNext;
+   if(ppsPrevLink != NULL && (*ppsPrevLink)->ulOffset
+      + (*ppsPrevLink)->ulLength == psExtent->ulOffset) {
+      (*ppsPrevLink)->ulLength += psExtent->ulLength;
+      (*ppsPrevLink)->psNext = psExtent->psNext;
+      free(psExtent);
+      ppsLink = ppsPrevLink;
+      psExtent = *ppsLink;
+   }
+   else
+      *ppsLink = psExtent;
+
+   /* a hole at the end is given back, so that freeing blocks shrinks
+      the file rather than leaving it as large as it ever was */
+   if(psExtent->ulOffset + psExtent->ulLength == oSFile->ulEnd) {
+      assert(psExtent->psNext == NULL);
+      *ppsLink = NULL;
+      __atomic_store_n(&oSFile->ulEnd, psExtent->ulOffset,
+                       __ATOMIC_RELAXED);
+      (void) ftruncate(oSFile->iFd, (off_t) psExtent->ulOffset);
+      free(psExtent);
+   }
+}
+
+/* Adds the atomic counter at pulCounter ulAmount. */
+static void Spill_count(size_t *pulCounter, size_t ulAmount) {
+   assert(pulCounter != NULL);
+
+   (void) __atomic_add_fetch(pulCounter, ulAmount, __ATOMIC_RELAXED);
+}
+
+/* Drops a hold on oSFile, closing it if that was the last. */
+static void Spill_drop(Spill_T oSFile) {
+   struct extent *psHole;
+
+   assert(oSFile != NULL);
+
+   if(__atomic_sub_fetch(&oSFile->ulRefs, 1, __ATOMIC_ACQ_REL) == 0) {
+      while(oSFile->psHoles != NULL) {
+         psHole = oSFile->psHoles;
+         oSFile->psHoles = psHole->psNext;
+         free(psHole);
+      }
+#ifndef FT_NO_LOCKING
+      (void) pthread_mutex_destroy(&oSFile->sLock);
+#endif
+      (void) close(oSFile->iFd);
+      free(oSFile);
+   }
+}
+
+/*
+  Reads ulBytes bytes from file descriptor iFd at offset ulOffset into
+  pc. Returns TRUE if they were all read, and FALSE otherwise.
+*/
+static boolean Spill_readAll(int iFd, size_t ulOffset, char *pc,
+                             size_t ulBytes) {
+   ssize_t lRead;
+
+   assert(pc != NULL || ulBytes == 0);
+
+   while(ulBytes > 0) {
+      lRead = pread(iFd, pc, ulBytes, (off_t) ulOffset);
+      if(lRead < 0 && errno == EINTR)
+         continue;
+      if(lRead <= 0)
+         return FALSE;
+      pc += lRead;
+      ulOffset += (size_t) lRead;
+      ulBytes -= (size_t) lRead;
+   }
+   return TRUE;
+}
+
+/*
+  Writes the ulBytes bytes at pc to file descriptor iFd at offset
+  ulOffset. Returns TRUE if they were all written, and FALSE
+  otherwise.
+*/
+static boolean Spill_writeAll(int iFd, size_t ulOffset, const char *pc,
+                              size_t ulBytes) {
+   ssize_t lWritten;
+
+   assert(pc != NULL || ulBytes == 0);
+
+   while(ulBytes > 0) {
+      lWritten = pwrite(iFd, pc, ulBytes, (off_t) ulOffset);
+      if(lWritten < 0) {
+         if(errno == EINTR)
+            continue;
+         return FALSE;
+      }
+      pc += lWritten;
+      ulOffset += (size_t) lWritten;
+      ulBytes -= (size_t) lWritten;
+   }
+   return TRUE;
+}
+
+int Spill_open(const char *pcFile, Spill_T *poSResult) {
+   Spill_T oSNew;
+
+   assert(pcFile != NULL);
+   assert(poSResult != NULL);
+
+   oSNew = calloc(1, sizeof(struct spill));
+   if(oSNew == NULL)
+      return MEMORY_ERROR;
+#ifndef FT_NO_LOCKING
+   if(pthread_mutex_init(&oSNew->sLock, NULL) != 0) {
+      free(oSNew);
+      return MEMORY_ERROR;
+   }
+#endif
+   oSNew->iFd = open(pcFile, O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if(oSNew->iFd < 0) {
+#ifndef FT_NO_LOCKING
+      (void) pthread_mutex_destroy(&oSNew->sLock);
+#endif
+      free(oSNew);
+      return IO_ERROR;
+   }
+   /* the open descriptor keeps the file until it is closed */
+   (void) unlink(pcFile);
+   oSNew->ulRefs = 1;
+
+   *poSResult = oSNew;
+   return SUCCESS;
+}
+
+void Spill_close(Spill_T oSFile) {
+   if(oSFile != NULL)
+      Spill_drop(oSFile);
+}
+
+/*
+  Returns a new block of oSFile holding run psExtent, taking over the
+  caller's hold on the run, not loaded, or NULL if insufficient memory
+  is available, in which case the caller keeps its hold.
+*/
+static Spill_Block_T Spill_newBlock(Spill_T oSFile,
+                                    struct extent *psExtent) {
+   Spill_Block_T oSNew;
+
+   assert(oSFile != NULL);
+   assert(psExtent != NULL);
+
+   oSNew = malloc(sizeof(struct spillBlock));
+   if(oSNew == NULL)
+      return NULL;
+   oSNew->oSFile = oSFile;
+   oSNew->psExtent = psExtent;
+   oSNew->pvLoaded = NULL;
+   Spill_count(&oSFile->ulRefs, 1);
+   return oSNew;
+}
+
+Spill_Block_T Spill_write(Spill_T oSFile, const void *pvBytes,
+                          size_t ulLength) {
+   struct extent *psExtent;
+   Spill_Block_T oSNew;
+
+   assert(oSFile != NULL);
+   assert(pvBytes != NULL || ulLength == 0);
+
+   psExtent = malloc(sizeof(struct extent));
+   if(psExtent == NULL)
+      return NULL;
+   psExtent->ulLength = ulLength;
+   psExtent->ulRefs = 1;
+   psExtent->psNext = NULL;
+   Spill_lock(oSFile);
+   Spill_place(oSFile, psExtent);
+   Spill_unlock(oSFile);
+
+   oSNew = NULL;
+   if(Spill_writeAll(oSFile->iFd, psExtent->ulOffset, pvBytes, ulLength))
+      oSNew = Spill_newBlock(oSFile, psExtent);
+   /* a failed write leaves a hole for a later block to fill */
+   if(oSNew == NULL) {
+      Spill_lock(oSFile);
+      Spill_vacate(oSFile, psExtent);
+      Spill_unlock(oSFile);
+      return NULL;
+   }
+   Spill_count(&oSFile->ulSpills, 1);
+   return oSNew;
+}
+
+Spill_Block_T Spill_share(Spill_Block_T oSBlock) {
+   Spill_Block_T oSNew;
+
+   assert(oSBlock != NULL);
+
+   Spill_count(&oSBlock->psExtent->ulRefs, 1);
+   oSNew = Spill_newBlock(oSBlock->oSFile, oSBlock->psExtent);
+   if(oSNew == NULL)
+      (void) __atomic_sub_fetch(&oSBlock->psExtent->ulRefs, 1,
+                                __ATOMIC_RELAXED);
+   return oSNew;
+}
+
+void Spill_free(void *pvBlock) {
+   Spill_Block_T oSBlock = pvBlock;
+
+   assert(oSBlock != NULL);
+
+   /* the last block holding its bytes leaves a hole in their place */
+   if(__atomic_sub_fetch(&oSBlock->psExtent->ulRefs, 1,
+                         __ATOMIC_ACQ_REL) == 0) {
+      Spill_lock(oSBlock->oSFile);
+      Spill_vacate(oSBlock->oSFile, oSBlock->psExtent);
+      Spill_unlock(oSBlock->oSFile);
+   }
+   Spill_drop(oSBlock->oSFile);
+   free(oSBlock->pvLoaded);
+   free(oSBlock);
+}
+
+size_t Spill_getLength(Spill_Block_T oSBlock) {
+   assert(oSBlock != NULL);
+
+   return oSBlock->psExtent->ulLength;
+}
+
+boolean Spill_isLoaded(Spill_Block_T oSBlock) {
+   assert(oSBlock != NULL);
+
+   return (boolean) (__atomic_load_n(&oSBlock->pvLoaded, __ATOMIC_ACQUIRE)
+                     != NULL);
+}
+
+void *Spill_load(Spill_Block_T oSBlock) {
+   struct extent *psExtent;
+   void *pvLoaded;
+   void *pvExpected = NULL;
+
+   assert(oSBlock != NULL);
+
+   pvLoaded = __atomic_load_n(&oSBlock->pvLoaded, __ATOMIC_ACQUIRE);
+   if(pvLoaded != NULL)
+      return pvLoaded;
+
+   psExtent = oSBlock->psExtent;
+   pvLoaded = malloc(psExtent->ulLength != 0 ? psExtent->ulLength : 1);
+   if(pvLoaded == NULL)
+      return NULL;
+   if(!Spill_readAll(oSBlock->oSFile->iFd, psExtent->ulOffset, pvLoaded,
+                     psExtent->ulLength)) {
+      free(pvLoaded);
+      return NULL;
+   }
+   Spill_count(&oSBlock->oSFile->ulReloads, 1);
+
+   /* of threads loading the block at once, the first to publish its
+      copy wins */
+   if(!__atomic_compare_exchange_n(&oSBlock->pvLoaded, &pvExpected,
+                                   pvLoaded, 0, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+      free(pvLoaded);
+      return pvExpected;
+   }
+   return pvLoaded;
+}
+
+boolean Spill_read(Spill_Block_T oSBlock, size_t ulOffset, void *pvBuf,
+                   size_t ulLength) {
+   void *pvLoaded;
+
+   assert(oSBlock != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+   assert(ulOffset <= oSBlock->psExtent->ulLength);
+   assert(ulLength <= oSBlock->psExtent->ulLength - ulOffset);
+
+   pvLoaded = __atomic_load_n(&oSBlock->pvLoaded, __ATOMIC_ACQUIRE);
+   if(pvLoaded != NULL) {
+      memcpy(pvBuf, (char *) pvLoaded + ulOffset, ulLength);
+      return TRUE;
+   }
+   return Spill_readAll(oSBlock->oSFile->iFd,
+                        oSBlock->psExtent->ulOffset + ulOffset, pvBuf,
+                        ulLength);
+}
+
+void Spill_prefetch(Spill_Block_T oSBlock) {
+   assert(oSBlock != NULL);
+
+   if(Spill_isLoaded(oSBlock))
+      return;
+   (void) posix_fadvise(oSBlock->oSFile->iFd,
+                        (off_t) oSBlock->psExtent->ulOffset,
+                        (off_t) oSBlock->psExtent->ulLength,
+                        POSIX_FADV_WILLNEED);
+   Spill_count(&oSBlock->oSFile->ulPrefetches, 1);
+}
+
+void Spill_getStats(Spill_T oSFile, size_t *pulSpills, size_t *pulReloads,
+                    size_t *pulPrefetches, size_t *pulFileBytes) {
+   assert(oSFile != NULL);
+
+   if(pulSpills != NULL)
+      *pulSpills = __atomic_load_n(&oSFile->ulSpills, __ATOMIC_RELAXED);
+   if(pulReloads != NULL)
+      *pulReloads = __atomic_load_n(&oSFile->ulReloads, __ATOMIC_RELAXED);
+   if(pulPrefetches != NULL)
+      *pulPrefetches = __atomic_load_n(&oSFile->ulPrefetches,
+                                       __ATOMIC_RELAXED);
+   if(pulFileBytes != NULL)
+      *pulFileBytes = __atomic_load_n(&oSFile->ulEnd, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,104 @@
+/*--------------------------------------------------------------------*/
+/* spill.h                                                            */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef SPILL_INCLUDED
+#define SPILL_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Spill_T is a spill file: a scratch file that byte strings are
+  written out to, to free the memory they took, and read back from
+  when they are needed again. Each string written is a block, which
+  holds its place in the file and, once someone has asked for it, a
+  copy of its bytes loaded back into memory, kept with the block until
+  the block is freed. The file is removed from its directory as soon
+  as it is opened, so it never outlives the process. The space of
+  blocks freed is written over by later blocks, and space freed at the
+  end of the file is given back. Blocks may be loaded, read and freed by
+  different threads at once, and written by one thread at a time.
+*/
+typedef struct spill *Spill_T;
+
+/* A block of bytes written to a spill file (see Spill_T) */
+typedef struct spillBlock *Spill_Block_T;
+
+/*
+  Creates the spill file pcFile, replacing any file of that name, and
+  sets *poSResult to it. Returns SUCCESS, MEMORY_ERROR if insufficient
+  memory is available, or IO_ERROR if the file could not be created,
+  in which case *poSResult is unchanged.
+*/
+int Spill_open(const char *pcFile, Spill_T *poSResult);
+
+/*
+  Closes oSFile to further writes, and closes the file once the last
+  of its blocks is freed, at once if it has none. Does nothing if
+  oSFile is NULL.
+*/
+void Spill_close(Spill_T oSFile);
+
+/*
+  Writes the ulLength bytes at pvBytes to oSFile, and returns a new
+  block holding them, not loaded, or NULL if they could not be written
+  or insufficient memory is available. oSFile must not be closed.
+*/
+Spill_Block_T Spill_write(Spill_T oSFile, const void *pvBytes,
+                          size_t ulLength);
+
+/*
+  Returns a new block holding the same place in the same file as
+  oSBlock, but not loaded, or NULL if insufficient memory is
+  available. oSBlock is unchanged.
+*/
+Spill_Block_T Spill_share(Spill_Block_T oSBlock);
+
+/*
+  Frees the block pvBlock, a Spill_Block_T, and its loaded copy. Has
+  the signature of a function that frees contents, so that blocks can
+  be given owners (see Node_newOwner).
+*/
+void Spill_free(void *pvBlock);
+
+/* Returns the number of bytes that oSBlock holds. */
+size_t Spill_getLength(Spill_Block_T oSBlock);
+
+/* Returns TRUE if oSBlock has its loaded copy, FALSE if not. */
+boolean Spill_isLoaded(Spill_Block_T oSBlock);
+
+/*
+  Returns the loaded copy of oSBlock's bytes, valid until oSBlock is
+  freed, or NULL if they could not be read or insufficient memory is
+  available. The first call reads them from the file, and counts a
+  reload; every later one returns the copy.
+*/
+void *Spill_load(Spill_Block_T oSBlock);
+
+/*
+  Copies the ulLength bytes of oSBlock from ulOffset on into pvBuf,
+  from its loaded copy if it has one and from the file otherwise,
+  without loading it. The bytes must lie within the block. Returns
+  TRUE if they are copied, and FALSE if they could not be read.
+*/
+boolean Spill_read(Spill_Block_T oSBlock, size_t ulOffset, void *pvBuf,
+                   size_t ulLength);
+
+/*
+  Advises the system that oSBlock is about to be loaded, so that it
+  reads the block's bytes ahead in the background, and counts a
+  prefetch. Does nothing if oSBlock is loaded already.
+*/
+void Spill_prefetch(Spill_Block_T oSBlock);
+
+/*
+  Stores oSFile's statistics into the non-NULL parameters: the number
+  of blocks written to it, the number loaded back, the number of
+  prefetches advised, and the size of the file in bytes.
+*/
+void Spill_getStats(Spill_T oSFile, size_t *pulSpills, size_t *pulReloads,
+                    size_t *pulPrefetches, size_t *pulFileBytes);
+
+#endif
@@ -0,0 +1,574 @@
+/*--------------------------------------------------------------------*/
+/* wal.c                                                              */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+/* for fdatasync, ftruncate and pthread_mutex_t */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "wal.h"
+
+/*
+  The layout of a log file: an 8-byte header naming the format and
+  its version, then the records. Each record is a 4-byte CRC-32, an
+  8-byte length, and a body of that length holding a 1-byte kind, a
+  1-byte flag set if the record has contents, the 8-byte length of
+  the path, the path (without its terminating '\0'), the 8-byte
+  length of the contents, and the contents. The CRC covers the record
+  from its length to the end. All numbers are little-endian.
+*/
+enum { WAL_HEADER_BYTES = 8, RECORD_HEADER_BYTES = 12,
+       BODY_FIXED_BYTES = 18, READ_BYTES = 65536 };
+
+/* The header of a log file of the current version */
+static const char acWalHeader[WAL_HEADER_BYTES] = "FTWAL\0\0\1";
+
+/* A write-ahead log */
+struct wal {
+   /* the log file, open for appending */
+   int iFd;
+   /* the number of records per sync */
+   size_t ulGroupSize;
+   /* the table of the CRC-32 of every byte value */
+   unsigned long aulCrcTable[256];
+   /* the records waiting to be written, and the buffer's capacity */
+   char *pcBuffer;
+   size_t ulUsed;
+   size_t ulCapacity;
+   /* a second buffer, which a flush in progress writes from, or NULL
+      while one does */
+   char *pcSpare;
+   size_t ulSpareCapacity;
+   /* the number of records appended, and of those synced */
+   size_t ulAppended;
+   size_t ulDurable;
+   /* the number of syncs */
+   size_t ulSyncs;
+   /* TRUE while a thread writes and syncs a group */
+   boolean bFlushing;
+   /* SUCCESS, or the status of the first failure */
+   int iError;
+   /* the lock guarding all of the above but the file, the group size
+      and the table, and the condition signalled when a flush ends */
+   pthread_mutex_t sLock;
+   pthread_cond_t sFlushed;
+};
+
+/* Stores the ulBytes low bytes of ulValue at puc, little-endian. */
+static void Wal_putNumber(unsigned char *puc, size_t ulValue,
+                          size_t ulBytes) {
+   size_t i;
+
+   assert(puc != NULL);
+
+   for(i = 0; i < ulBytes; i++) {
+      puc[i] = (unsigned char) (ulValue & 0xFF);
+      ulValue >>= 8;
+   }
+}
+
+/* Returns the little-endian number of ulBytes bytes at puc. */
+static size_t Wal_getNumber(const unsigned char *puc, size_t ulBytes) {
+   size_t ulValue = 0;
+   size_t i;
+
+   assert(puc != NULL);
+
+   for(i = ulBytes; i > 0; i--)
+      ulValue = (ulValue << 8) | puc[i - 1];
+   return ulValue;
+}
+
+/* Fills oWLog's table of the CRC-32 of every byte value. */
+static void Wal_initCrc(Wal_T oWLog) {
+   unsigned long ulByte;
+
+   assert(oWLog != NULL);
+
+   for(ulByte = 0; ulByte < 256; ulByte++) {
+      unsigned long ulCrc = ulByte;
+      int iBit;
+
+      for(iBit = 0; iBit < 8; iBit++)
+         ulCrc = (ulCrc & 1) ? (ulCrc >> 1) ^ 0xEDB88320UL : ulCrc >> 1;
+      oWLog->aulCrcTable[ulByte] = ulCrc;
+   }
+}
+
+/*
+  Returns the running CRC-32 ulCrc extended by the ulBytes bytes at
+  pv. A CRC starts at 0xFFFFFFFF and ends XORed with 0xFFFFFFFF.
+*/
+static unsigned long Wal_crc(Wal_T oWLog, unsigned long ulCrc,
+                             const void *pv, size_t ulBytes) {
+   const unsigned char *puc = pv;
+   size_t i;
+
+   assert(oWLog != NULL);
+
+   for(i = 0; i < ulBytes; i++)
+      ulCrc = oWLog->aulCrcTable[(ulCrc ^ puc[i]) & 0xFF] ^ (ulCrc >> 8);
+   return ulCrc & 0xFFFFFFFFUL;
+}
+
+/*
+  Writes the ulBytes bytes at pc to file descriptor iFd. Returns
+  SUCCESS, or IO_ERROR if they could not all be written.
+*/
+static int Wal_writeAll(int iFd, const char *pc, size_t ulBytes) {
+   assert(pc != NULL || ulBytes == 0);
+
+   while(ulBytes > 0) {
+      ssize_t lWritten = write(iFd, pc, ulBytes);
+      if(lWritten < 0) {
+         if(errno == EINTR)
+            continue;
+         return IO_ERROR;
+      }
+      pc += lWritten;
+      ulBytes -= (size_t) lWritten;
+   }
+   return SUCCESS;
+}
+
+int Wal_open(const char *pcPath, size_t ulGroupSize, Wal_T *poWResult) {
+   Wal_T oWNew;
+   char acHeader[WAL_HEADER_BYTES];
+   off_t lSize;
+
+   assert(pcPath != NULL);
+   assert(ulGroupSize > 0);
+   assert(poWResult != NULL);
+
+   oWNew = malloc(sizeof(struct wal));
+   if(oWNew == NULL)
+      return MEMORY_ERROR;
+   if(pthread_mutex_init(&oWNew->sLock, NULL) != 0) {
+      free(oWNew);
+      return MEMORY_ERROR;
+   }
+   if(pthread_cond_init(&oWNew->sFlushed, NULL) != 0) {
+      (void) pthread_mutex_destroy(&oWNew->sLock);
+      free(oWNew);
+      return MEMORY_ERROR;
+   }
+
+   oWNew->iFd = open(pcPath, O_RDWR | O_CREAT | O_APPEND, 0666);
+   lSize = oWNew->iFd < 0 ? -1 : lseek(oWNew->iFd, 0, SEEK_END);
+   if(lSize >= 0 && lSize < WAL_HEADER_BYTES) {
+      /* a new log starts with its header, synced before any record,
+         and a log whose header was torn has no records to lose */
+      if(ftruncate(oWNew->iFd, 0) != 0 ||
+         Wal_writeAll(oWNew->iFd, acWalHeader, WAL_HEADER_BYTES)
+         != SUCCESS || fdatasync(oWNew->iFd) != 0)
+         lSize = -1;
+   }
+   else if(lSize > 0) {
+      if(lseek(oWNew->iFd, 0, SEEK_SET) != 0 ||
+         read(oWNew->iFd, acHeader, WAL_HEADER_BYTES)
+         != WAL_HEADER_BYTES ||
+         memcmp(acHeader, acWalHeader, WAL_HEADER_BYTES) != 0)
+         lSize = -1;
+   }
+   if(lSize < 0) {
+      if(oWNew->iFd >= 0)
+         (void) close(oWNew->iFd);
+      (void) pthread_cond_destroy(&oWNew->sFlushed);
+      (void) pthread_mutex_destroy(&oWNew->sLock);
+      free(oWNew);
+      return IO_ERROR;
+   }
+
+   oWNew->ulGroupSize = ulGroupSize;
+   Wal_initCrc(oWNew);
+   oWNew->pcBuffer = NULL;
+   oWNew->ulUsed = 0;
+   oWNew->ulCapacity = 0;
+   oWNew->pcSpare = NULL;
+   oWNew->ulSpareCapacity = 0;
+   oWNew->ulAppended = 0;
+   oWNew->ulDurable = 0;
+   oWNew->ulSyncs = 0;
+   oWNew->bFlushing = FALSE;
+   oWNew->iError = SUCCESS;
+
+   *poWResult = oWNew;
+   return SUCCESS;
+}
+
+/* A buffered sequential reader of a log file */
+struct walReader {
+   /* the file */
+   int iFd;
+   /* the bytes read from the file but not yet consumed: those of
+      aucBuffer from ulPos up to ulLength */
+   unsigned char aucBuffer[READ_BYTES];
+   size_t ulPos;
+   size_t ulLength;
+};
+
+/*
+  Copies the next ulBytes bytes of psReader's file to pv. Returns
+  SUCCESS, NO_SUCH_PATH if the file ends first, or IO_ERROR if it
+  cannot be read.
+*/
+static int Wal_read(struct walReader *psReader, void *pv,
+                    size_t ulBytes) {
+   unsigned char *puc = pv;
+
+   assert(psReader != NULL);
+   assert(pv != NULL || ulBytes == 0);
+
+   while(ulBytes > 0) {
+      size_t ulChunk;
+
+      if(psReader->ulPos == psReader->ulLength) {
+         ssize_t lRead = read(psReader->iFd, psReader->aucBuffer,
+                              READ_BYTES);
+         if(lRead < 0) {
+            if(errno == EINTR)
+               continue;
+            return IO_ERROR;
+         }
+         if(lRead == 0)
+            return NO_SUCH_PATH;
+         psReader->ulPos = 0;
+         psReader->ulLength = (size_t) lRead;
+      }
+
+      ulChunk = psReader->ulLength - psReader->ulPos;
+      if(ulChunk > ulBytes)
+         ulChunk = ulBytes;
+      memcpy(puc, psReader->aucBuffer + psReader->ulPos, ulChunk);
+      psReader->ulPos += ulChunk;
+      puc += ulChunk;
+      ulBytes -= ulChunk;
+   }
+   return SUCCESS;
+}
+
+int Wal_replay(Wal_T oWLog,
+               int (*pfApply)(void *pvExtra, int iKind,
+                              const char *pcPath, void *pvContents,
+                              size_t ulLength),
+               void *pvExtra) {
+   struct walReader *psReader;
+   unsigned char aucHeader[RECORD_HEADER_BYTES];
+   unsigned char *pucBody = NULL;
+   size_t ulBodyCapacity = 0;
+   size_t ulValidEnd = WAL_HEADER_BYTES;
+   off_t lSize;
+   int iStatus = SUCCESS;
+
+   assert(oWLog != NULL);
+   assert(pfApply != NULL);
+
+   psReader = malloc(sizeof(struct walReader));
+   if(psReader == NULL)
+      return MEMORY_ERROR;
+   psReader->iFd = oWLog->iFd;
+   psReader->ulPos = 0;
+   psReader->ulLength = 0;
+   lSize = lseek(oWLog->iFd, 0, SEEK_END);
+   if(lSize < 0 ||
+      lseek(oWLog->iFd, WAL_HEADER_BYTES, SEEK_SET) != WAL_HEADER_BYTES) {
+      free(psReader);
+      return IO_ERROR;
+   }
+
+   for(;;) {
+      size_t ulBody, ulPathLength, ulLength;
+      unsigned long ulCrc;
+      int iKind;
+      char *pcPath = NULL;
+      void *pvContents = NULL;
+
+      iStatus = Wal_read(psReader, aucHeader, RECORD_HEADER_BYTES);
+      if(iStatus != SUCCESS)
+         break;
+      ulBody = Wal_getNumber(aucHeader + 4, 8);
+      if(ulBody < BODY_FIXED_BYTES || ulBody > (size_t) lSize -
+         ulValidEnd - RECORD_HEADER_BYTES) {
+         iStatus = NO_SUCH_PATH;
+         break;
+      }
+      if(ulBody > ulBodyCapacity) {
+         unsigned char *pucNew = realloc(pucBody, ulBody);
+         if(pucNew == NULL) {
+            iStatus = MEMORY_ERROR;
+            break;
+         }
+         pucBody = pucNew;
+         ulBodyCapacity = ulBody;
+      }
+      iStatus = Wal_read(psReader, pucBody, ulBody);
+      if(iStatus != SUCCESS)
+         break;
+
+      ulCrc = Wal_crc(oWLog, 0xFFFFFFFFUL, aucHeader + 4, 8);
+      ulCrc = Wal_crc(oWLog, ulCrc, pucBody, ulBody) ^ 0xFFFFFFFFUL;
+      ulPathLength = Wal_getNumber(pucBody + 2, 8);
+      iKind = pucBody[0];
+      if(ulCrc != Wal_getNumber(aucHeader, 4) || iKind > WAL_WRITE ||
+         ulPathLength > ulBody - BODY_FIXED_BYTES) {
+         iStatus = NO_SUCH_PATH;
+         break;
+      }
+      ulLength = Wal_getNumber(pucBody + 10 + ulPathLength, 8);
+      if(ulLength != ulBody - BODY_FIXED_BYTES - ulPathLength) {
+         iStatus = NO_SUCH_PATH;
+         break;
+      }
+
+      /* the path is terminated over the length that follows it, which
+         is already decoded */
+      if(ulPathLength > 0) {
+         pcPath = (char *) pucBody + 10;
+         pcPath[ulPathLength] = '\0';
+      }
+      if(pucBody[1])
+         pvContents = pucBody + BODY_FIXED_BYTES + ulPathLength;
+
+      iStatus = (*pfApply)(pvExtra, iKind, pcPath, pvContents, ulLength);
+      if(iStatus != SUCCESS)
+         break;
+      ulValidEnd += RECORD_HEADER_BYTES + ulBody;
+   }
+   free(pucBody);
+   free(psReader);
+
+   /* the log ends at its first torn or corrupt record, if any: a
+      crash can tear only the last group written */
+   if(iStatus == NO_SUCH_PATH) {
+      iStatus = SUCCESS;
+      if(ftruncate(oWLog->iFd, (off_t) ulValidEnd) != 0 ||
+         fdatasync(oWLog->iFd) != 0)
+         iStatus = IO_ERROR;
+   }
+   return iStatus;
+}
+
+/*
+  Makes room for ulBytes more bytes in oWLog's buffer of waiting
+  records. Returns TRUE, or FALSE if no memory is available.
+*/
+static boolean Wal_reserve(Wal_T oWLog, size_t ulBytes) {
+   size_t ulNewCapacity;
+   char *pcNew;
+
+   assert(oWLog != NULL);
+
+   if(oWLog->ulCapacity - oWLog->ulUsed >= ulBytes)
+      return TRUE;
+
+   ulNewCapacity = oWLog->ulCapacity == 0 ? READ_BYTES
+                                          : 2 * oWLog->ulCapacity;
+   while(ulNewCapacity - oWLog->ulUsed < ulBytes)
+      ulNewCapacity *= 2;
+   pcNew = realloc(oWLog->pcBuffer, ulNewCapacity);
+   if(pcNew == NULL)
+      return FALSE;
+   oWLog->pcBuffer = pcNew;
+   oWLog->ulCapacity = ulNewCapacity;
+   return TRUE;
+}
+
+/*
+  Makes record ulSeq of oWLog, and every record before it, durable:
+  waits for the flush in progress, if any, and unless that flush
+  included record ulSeq, writes and syncs every waiting record.
+  Appending continues meanwhile, into the other buffer. Must be
+  called with oWLog's lock held. Returns SUCCESS, or the status of
+  oWLog's first failure.
+*/
+static int Wal_flush(Wal_T oWLog, size_t ulSeq) {
+   char *pcOut;
+   size_t ulOut, ulOutCapacity, ulTarget;
+   int iStatus;
+
+   assert(oWLog != NULL);
+
+   while(oWLog->bFlushing && oWLog->ulDurable < ulSeq)
+      (void) pthread_cond_wait(&oWLog->sFlushed, &oWLog->sLock);
+   if(oWLog->ulDurable >= ulSeq || oWLog->iError != SUCCESS)
+      return oWLog->iError;
+
+   pcOut = oWLog->pcBuffer;
+   ulOut = oWLog->ulUsed;
+   ulOutCapacity = oWLog->ulCapacity;
+   oWLog->pcBuffer = oWLog->pcSpare;
+   oWLog->ulCapacity = oWLog->ulSpareCapacity;
+   oWLog->ulUsed = 0;
+   oWLog->pcSpare = NULL;
+   oWLog->ulSpareCapacity = 0;
+   ulTarget = oWLog->ulAppended;
+   oWLog->bFlushing = TRUE;
+   (void) pthread_mutex_unlock(&oWLog->sLock);
+
+   iStatus = Wal_writeAll(oWLog->iFd, pcOut, ulOut);
+   if(iStatus == SUCCESS && fdatasync(oWLog->iFd) != 0)
+      iStatus = IO_ERROR;
+
+   (void) pthread_mutex_lock(&oWLog->sLock);
+   oWLog->pcSpare = pcOut;
+   oWLog->ulSpareCapacity = ulOutCapacity;
+   if(iStatus != SUCCESS)
+      oWLog->iError = iStatus;
+   else
+      oWLog->ulDurable = ulTarget;
+   oWLog->ulSyncs++;
+   oWLog->bFlushing = FALSE;
+   (void) pthread_cond_broadcast(&oWLog->sFlushed);
+   return oWLog->iError;
+}
+
+/*
+  Appends a record of kind iKind to oWLog, with path pcPath and, if
+  bHasContents is TRUE, contents made of the ulPrefix bytes at
+  pvPrefix followed by the ulLength bytes at pvContents, as
+  Wal_append describes.
+*/
+static int Wal_appendParts(Wal_T oWLog, int iKind, const char *pcPath,
+                           boolean bHasContents, const void *pvPrefix,
+                           size_t ulPrefix, const void *pvContents,
+                           size_t ulLength) {
+   unsigned char aucFixed[RECORD_HEADER_BYTES + 10];
+   unsigned char aucLength[8];
+   size_t ulPathLength, ulBody;
+   unsigned long ulCrc;
+   int iStatus = SUCCESS;
+
+   assert(oWLog != NULL);
+   assert(iKind >= WAL_INSERT_DIR && iKind <= WAL_WRITE);
+   assert(pvPrefix != NULL || ulPrefix == 0);
+   assert(pvContents != NULL || ulLength == 0);
+
+   /* the record is encoded and checksummed before the lock is taken,
+      so appenders contend only to copy it into the buffer */
+   ulPathLength = pcPath == NULL ? 0 : strlen(pcPath);
+   ulBody = BODY_FIXED_BYTES + ulPathLength + ulPrefix + ulLength;
+   Wal_putNumber(aucFixed + 4, ulBody, 8);
+   aucFixed[12] = (unsigned char) iKind;
+   aucFixed[13] = (unsigned char) bHasContents;
+   Wal_putNumber(aucFixed + 14, ulPathLength, 8);
+   Wal_putNumber(aucLength, ulPrefix + ulLength, 8);
+   ulCrc = Wal_crc(oWLog, 0xFFFFFFFFUL, aucFixed + 4, sizeof(aucFixed) - 4);
+   ulCrc = Wal_crc(oWLog, ulCrc, pcPath, ulPathLength);
+   ulCrc = Wal_crc(oWLog, ulCrc, aucLength, 8);
+   ulCrc = Wal_crc(oWLog, ulCrc, pvPrefix, ulPrefix);
+   ulCrc = Wal_crc(oWLog, ulCrc, pvContents, ulLength) ^ 0xFFFFFFFFUL;
+   Wal_putNumber(aucFixed, ulCrc, 4);
+
+   (void) pthread_mutex_lock(&oWLog->sLock);
+   if(oWLog->iError != SUCCESS) {
+      iStatus = oWLog->iError;
+      (void) pthread_mutex_unlock(&oWLog->sLock);
+      return iStatus;
+   }
+   if(!Wal_reserve(oWLog, sizeof(aucFixed) + ulPathLength + 8 +
+                          ulPrefix + ulLength)) {
+      oWLog->iError = MEMORY_ERROR;
+      (void) pthread_mutex_unlock(&oWLog->sLock);
+      return MEMORY_ERROR;
+   }
+
+   memcpy(oWLog->pcBuffer + oWLog->ulUsed, aucFixed, sizeof(aucFixed));
+   oWLog->ulUsed += sizeof(aucFixed);
+   if(ulPathLength > 0)
+      memcpy(oWLog->pcBuffer + oWLog->ulUsed, pcPath, ulPathLength);
+   oWLog->ulUsed += ulPathLength;
+   memcpy(oWLog->pcBuffer + oWLog->ulUsed, aucLength, 8);
+   oWLog->ulUsed += 8;
+   if(ulPrefix > 0)
+      memcpy(oWLog->pcBuffer + oWLog->ulUsed, pvPrefix, ulPrefix);
+   oWLog->ulUsed += ulPrefix;
+   if(ulLength > 0)
+      memcpy(oWLog->pcBuffer + oWLog->ulUsed, pvContents, ulLength);
+   oWLog->ulUsed += ulLength;
+
+   oWLog->ulAppended++;
+   if(oWLog->ulAppended - oWLog->ulDurable >= oWLog->ulGroupSize)
+      iStatus = Wal_flush(oWLog, oWLog->ulAppended);
+   (void) pthread_mutex_unlock(&oWLog->sLock);
+   return iStatus;
+}
+
+int Wal_append(Wal_T oWLog, int iKind, const char *pcPath,
+               const void *pvContents, size_t ulLength) {
+   assert(iKind != WAL_WRITE);
+
+   return Wal_appendParts(oWLog, iKind, pcPath,
+                          (boolean) (pvContents != NULL), NULL, 0,
+                          pvContents, ulLength);
+}
+
+int Wal_appendWrite(Wal_T oWLog, const char *pcPath, size_t ulOffset,
+                    const void *pvBytes, size_t ulLength) {
+   unsigned char aucOffset[8];
+
+   assert(pcPath != NULL);
+
+   Wal_putNumber(aucOffset, ulOffset, 8);
+   return Wal_appendParts(oWLog, WAL_WRITE, pcPath, TRUE, aucOffset, 8,
+                          pvBytes, ulLength);
+}
+
+boolean Wal_decodeWrite(const void *pvContents, size_t ulLength,
+                        size_t *pulOffset, const void **ppvBytes,
+                        size_t *pulBytes) {
+   assert(pulOffset != NULL);
+   assert(ppvBytes != NULL);
+   assert(pulBytes != NULL);
+
+   if(pvContents == NULL || ulLength < 8)
+      return FALSE;
+   *pulOffset = Wal_getNumber(pvContents, 8);
+   *ppvBytes = (const unsigned char *) pvContents + 8;
+   *pulBytes = ulLength - 8;
+   return TRUE;
+}
+
+int Wal_sync(Wal_T oWLog) {
+   int iStatus;
+
+   assert(oWLog != NULL);
+
+   (void) pthread_mutex_lock(&oWLog->sLock);
+   iStatus = Wal_flush(oWLog, oWLog->ulAppended);
+   (void) pthread_mutex_unlock(&oWLog->sLock);
+   return iStatus;
+}
+
+void Wal_getStats(Wal_T oWLog, size_t *pulRecords, size_t *pulSyncs) {
+   assert(oWLog != NULL);
+
+   (void) pthread_mutex_lock(&oWLog->sLock);
+   if(pulRecords != NULL)
+      *pulRecords = oWLog->ulAppended;
+   if(pulSyncs != NULL)
+      *pulSyncs = oWLog->ulSyncs;
+   (void) pthread_mutex_unlock(&oWLog->sLock);
+}
+
+int Wal_close(Wal_T oWLog) {
+   int iStatus;
+
+   assert(oWLog != NULL);
+
+   iStatus = Wal_sync(oWLog);
+   if(close(oWLog->iFd) != 0 && iStatus == SUCCESS)
+      iStatus = IO_ERROR;
+   (void) pthread_cond_destroy(&oWLog->sFlushed);
+   (void) pthread_mutex_destroy(&oWLog->sLock);
+   free(oWLog->pcBuffer);
+   free(oWLog->pcSpare);
+   free(oWLog);
+   return iStatus;
+}
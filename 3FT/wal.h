@@ -0,0 +1,113 @@
+/*--------------------------------------------------------------------*/
+/* wal.h                                                              */
+/* Authors: David Wang, Will Grimes                                   */
+/*--------------------------------------------------------------------*/
+
+#ifndef WAL_INCLUDED
+#define WAL_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Wal_T is an append-only write-ahead log of changes to a File
+  Tree, stored in a file. Each record holds one change: its kind, an
+  absolute path and, for the kinds that set a file's contents, the
+  contents' bytes, all protected by a CRC-32, so that replaying the
+  log after a crash stops at the first record that was torn or
+  corrupted.
+
+  Records are buffered in memory and forced to disk in groups: once
+  ulGroupSize records are waiting (see Wal_open), the thread
+  appending the last of them writes and syncs them all at once, and
+  records appended by other threads meanwhile join the next group.
+  A crash thus loses at most the records of the last incomplete
+  group. Any number of threads may append concurrently.
+*/
+typedef struct wal *Wal_T;
+
+/* The kinds of record in a log */
+enum { WAL_INSERT_DIR, WAL_INSERT_FILE, WAL_REMOVE, WAL_REPLACE,
+       WAL_BEGIN, WAL_COMMIT, WAL_ABORT, WAL_WRITE };
+
+/*
+  Opens the log in the file named pcPath, creating it if it does not
+  exist, and sets *poWResult to it. Records are synced in groups of
+  ulGroupSize, which must be positive. Records already in the file
+  must be replayed with Wal_replay before any is appended. Returns
+  SUCCESS, or:
+  * IO_ERROR if the file cannot be opened or created, or is not a log
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Wal_open(const char *pcPath, size_t ulGroupSize, Wal_T *poWResult);
+
+/*
+  Calls (*pfApply)(pvExtra, iKind, pcPath, pvContents, ulLength) for
+  every intact record in oWLog, in the order they were appended, then
+  cuts the log short after the last of them, so that new records
+  follow intact ones. pvContents is NULL for records without contents,
+  or for contents that were NULL, and is valid only during the call.
+  Stops early, leaving the log as it is, if pfApply returns anything
+  but SUCCESS. Returns SUCCESS, the status that pfApply returned, or:
+  * IO_ERROR if the file cannot be read or cut short
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Wal_replay(Wal_T oWLog,
+               int (*pfApply)(void *pvExtra, int iKind,
+                              const char *pcPath, void *pvContents,
+                              size_t ulLength),
+               void *pvExtra);
+
+/*
+  Appends a record of kind iKind to oWLog, with path pcPath (which
+  may be NULL for records of transactions) and, for WAL_INSERT_FILE
+  and WAL_REPLACE, contents pvContents of ulLength bytes, syncing the
+  log if it completes a group. A failure to buffer, write or sync a
+  record sticks: every later call fails too, so that the log never
+  holds a change without those before it. Returns SUCCESS, or:
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * IO_ERROR if the log could not be written or synced
+*/
+int Wal_append(Wal_T oWLog, int iKind, const char *pcPath,
+               const void *pvContents, size_t ulLength);
+
+/*
+  Appends a record of kind WAL_WRITE to oWLog, of a write of the
+  ulLength bytes at pvBytes at byte ulOffset of the file pcPath, as
+  Wal_append appends other records. Its contents, as Wal_replay passes
+  them, encode the offset and the bytes for Wal_decodeWrite.
+*/
+int Wal_appendWrite(Wal_T oWLog, const char *pcPath, size_t ulOffset,
+                    const void *pvBytes, size_t ulLength);
+
+/*
+  Decodes pvContents, the ulLength bytes of contents of a WAL_WRITE
+  record, into the offset of the write, *pulOffset, and the bytes
+  written, *ppvBytes and *pulBytes, which lie within pvContents.
+  Returns TRUE, or FALSE if the contents are too short to be those of
+  a write.
+*/
+boolean Wal_decodeWrite(const void *pvContents, size_t ulLength,
+                        size_t *pulOffset, const void **ppvBytes,
+                        size_t *pulBytes);
+
+/*
+  Writes and syncs every record appended to oWLog so far. Returns
+  SUCCESS, or the status of the first failure of oWLog, as for
+  Wal_append.
+*/
+int Wal_sync(Wal_T oWLog);
+
+/*
+  Stores the number of records appended to oWLog and the number of
+  times it was synced into the non-NULL parameters.
+*/
+void Wal_getStats(Wal_T oWLog, size_t *pulRecords, size_t *pulSyncs);
+
+/*
+  Syncs and closes oWLog, and frees it. Returns SUCCESS, or the
+  status of the first failure of oWLog, as for Wal_append.
+*/
+int Wal_close(Wal_T oWLog);
+
+#endif